@@ -24,6 +24,7 @@
 
 #include "hit.h"
 #include "neutron.h"
+#include "tpx3_reader.h"
 
 std::vector<char> readTPX3RawToCharVec(const std::string& tpx3file);
 
@@ -88,14 +89,17 @@ void appendNeutronToHDF5(const std::string& out_file_name,
 void appendNeutronToHDF5(const std::string& out_file_name,
                          const std::vector<Neutron>& neutrons);
 
-class TPX3FileReader {
+class TPX3FileReader : public ITPX3Reader {
  public:
   TPX3FileReader(const std::string& filename);
-  ~TPX3FileReader();
+  ~TPX3FileReader() override;
 
-  std::vector<char> readChunk(size_t chunkSize);
-  bool isEOF() const { return currentPosition >= fileSize; }
-  size_t getTotalSize() const { return fileSize; }
+  std::vector<char> readChunk(size_t chunkSize) override;
+  size_t readChunkInto(size_t chunkSize, std::vector<char>& buffer) override;
+  void seek(size_t position) override;
+  bool isEOF() const override { return currentPosition >= fileSize; }
+  size_t getTotalSize() const override { return fileSize; }
+  size_t getPosition() const override { return currentPosition; }
 
  private:
   int fd;
@@ -104,9 +108,66 @@ class TPX3FileReader {
   size_t currentPosition;
 };
 
+/**
+ * @brief Follows a .tpx3 file that is still being written.
+ *
+ * Every call to readAppended returns the bytes appended since the previous
+ * call, cut at the last complete TPX3 batch. The partial batch at the end is
+ * kept and prepended to the next read, so every returned buffer starts on a
+ * batch header and can be processed on its own.
+ */
+class TPX3FileFollower {
+ public:
+  // position: batch aligned offset to start from, e.g. from a checkpoint
+  explicit TPX3FileFollower(const std::string& filename, size_t position = 0);
+  ~TPX3FileFollower();
+
+  TPX3FileFollower(const TPX3FileFollower&) = delete;
+  TPX3FileFollower& operator=(const TPX3FileFollower&) = delete;
+
+  // maxBytes = 0 reads everything appended so far
+  std::vector<char> readAppended(size_t maxBytes = 0);
+  size_t getPosition() const { return m_position; }
+  size_t getPendingBytes() const { return m_pending.size(); }
+  // offset of the first byte not returned yet
+  size_t getConsumedPosition() const { return m_position - m_pending.size(); }
+  size_t getFileSize() const;
+
+ private:
+  std::string m_filename;
+  int m_fd = -1;
+  size_t m_position = 0;  // bytes read from the file
+  std::vector<char> m_pending;
+};
+size_t findLastCompleteTPX3Batch(const char* data, size_t size);
+
 // Helper functions to append data to extendible datasets
 void createOrExtendDataset(H5::Group& group, const std::string& datasetName,
                            const std::vector<double>& data);
-void appendHitsToHDF5Extendible(H5::H5File& file, const std::vector<Hit>& hits);
+// Layout of the hits/neutrons datasets
+// legacy: every column is a double, times in ns
+// compact: native narrow types, times in clock ticks with unit attributes
+enum class HDF5Schema { legacy, compact };
+HDF5Schema parseHDF5Schema(const std::string& name);
+H5::Group openOrCreateGroup(H5::H5File& file, const std::string& groupName,
+                            HDF5Schema schema);
+void setDatasetUnits(H5::Group& group, const std::string& datasetName,
+                     const std::string& units, double scaleToNs = 0);
+void appendHitsToHDF5Extendible(H5::H5File& file, const std::vector<Hit>& hits,
+                                HDF5Schema schema = HDF5Schema::legacy);
 void appendNeutronsToHDF5Extendible(H5::H5File& file,
-                                    const std::vector<Neutron>& neutrons);
+                                    const std::vector<Neutron>& neutrons,
+                                    HDF5Schema schema = HDF5Schema::legacy);
+std::vector<Hit> readHitsFromHDF5(const std::string& filename);
+std::vector<Neutron> readNeutronsFromHDF5(const std::string& filename);
+
+// Compression filters for chunked HDF5 datasets
+// NOTE: lz4 and zstd are registered (plugin) filters, they fall back to deflate
+//       when the plugin is not available to the HDF5 library at runtime.
+enum class H5Compression { none, deflate, lz4, zstd };
+static constexpr H5Z_filter_t H5Z_FILTER_LZ4_PLUGIN = 32004;
+static constexpr H5Z_filter_t H5Z_FILTER_ZSTD_PLUGIN = 32015;
+H5Compression parseH5Compression(const std::string& name);
+void setH5Compression(H5::DSetCreatPropList& propList,
+                      H5Compression compression, int level = 4,
+                      bool shuffle = true);
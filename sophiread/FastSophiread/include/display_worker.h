@@ -0,0 +1,117 @@
+/**
+ * @file display_worker.h
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Background reduction of a raw file into a running image for display
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "neutron.h"
+#include "ring_buffer.h"
+#include "tpx3_fast.h"
+#include "tpx3_reader.h"
+
+struct DisplayWorkerOptions {
+  // clustering
+  double radius = 5.0;
+  unsigned long min_cluster_size = 1;
+  unsigned long spider_time_range = 75;
+  std::string method = "centroid";  // peak fitting, see ABS
+  // image of 517 * super_resolution pixels a side
+  double super_resolution = 1.0;
+  // rotation in degrees about the image origin, applied to every neutron
+  // before it is binned, e.g. to correct the mounting angle of the detector
+  double rotation = 0.0;
+  bool use_gdc = false;
+  size_t chunk_size = 16 * 1024 * 1024;  // bytes read at once
+  size_t batches_per_block = 256;        // batches handed over at once
+  size_t blocks = 16;                    // blocks in flight
+  bool keep_neutrons = false;            // e.g. to save them afterwards
+  // about 64 bytes each, the later ones are dropped with a warning
+  size_t max_kept_neutrons = 4000000;
+};
+
+struct DisplayProgress {
+  uint64_t bytes_read = 0;
+  uint64_t total_bytes = 0;  // bytes received so far for a stream
+  uint64_t hits = 0;
+  uint64_t neutrons = 0;
+  bool done = false;
+};
+
+/**
+ * @brief Reduces a raw file or stream into a running neutron image on two
+ * threads, for a display to show while the data comes in.
+ *
+ * The parser thread reads chunks, cuts them at whole batches, time-stamps
+ * them and extracts the hits, then hands blocks of batches to the clustering
+ * thread through an SPSC ring; blocks are moved, never copied. The clustering
+ * thread sleeps while the ring is empty, so an idle worker costs no CPU, and
+ * adds the neutrons of each block to the image. copyImage() gives the display
+ * a snapshot whenever the image changed.
+ */
+class DisplayWorker {
+ public:
+  explicit DisplayWorker(const DisplayWorkerOptions& options = {});
+  ~DisplayWorker();
+
+  DisplayWorker(const DisplayWorker&) = delete;
+  DisplayWorker& operator=(const DisplayWorker&) = delete;
+
+  // Start reducing input, a file or a stream (see openTPX3Reader)
+  void start(const std::string& input);
+  // Cancel the reduction, keeping what was reduced so far
+  void stop();
+  // Wait for the reduction to finish
+  void wait();
+  bool isRunning() const;
+
+  uint32_t getImageSize() const { return m_image_size; }
+  DisplayProgress getProgress() const;
+  // Copy the image (row major, y then x) if it changed since version
+  bool copyImage(std::vector<uint32_t>& image, uint64_t& version) const;
+  // First neutrons in input order, up to max_kept_neutrons with
+  // keep_neutrons, once the worker is done
+  const std::vector<Neutron>& getNeutrons() const { return m_neutrons; }
+  // Message of the error that stopped the worker, empty if none
+  std::string getError() const;
+
+ private:
+  void parse(const std::string& input);
+  void cluster();
+  void keepNeutrons(const std::vector<Neutron>& neutrons);
+  void fail(std::exception_ptr error);
+
+  DisplayWorkerOptions m_options;
+  uint32_t m_image_size;
+  std::unique_ptr<SPSCRing<std::vector<TPX3>>> m_blocks;  // one per run
+  std::shared_ptr<ITPX3Reader> m_reader;  // interrupted by stop() and fail()
+  std::thread m_parser;
+  std::thread m_clusterer;
+  std::atomic<bool> m_stop{false};
+  std::atomic<bool> m_done{true};
+
+  std::atomic<uint64_t> m_bytes_read{0};
+  std::atomic<uint64_t> m_total_bytes{0};
+  std::atomic<uint64_t> m_hits{0};
+  std::atomic<uint64_t> m_neutron_count{0};
+
+  mutable std::mutex m_mutex;  // guards the image, the error and the reader
+  std::vector<uint32_t> m_image;
+  uint64_t m_image_version = 0;
+  std::exception_ptr m_error;
+  std::vector<Neutron> m_neutrons;  // clustering thread only
+};
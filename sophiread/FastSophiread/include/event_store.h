@@ -0,0 +1,133 @@
+/**
+ * @file event_store.h
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Append-only columnar event store with a sparse spidertime index
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "neutron.h"
+
+/**
+ * @brief Layout of an event store directory.
+ *
+ * Every column is a raw little-endian array in its own file:
+ *   x.f32, y.f32       detector pixel, without super resolution; rebinning
+ *                      (sophiread::rebinEventStore) applies it
+ *   tof.f32, tot.f32   25 ns ticks
+ *   nhits.u16          cluster size
+ *   spidertime.u64     25 ns ticks
+ * index.bin holds one EventStoreIndexEntry per block of index_stride events,
+ * and header.json the number of events, the stride and the column list. Only
+ * the first "events" rows of each column are valid, so a crashed writer
+ * leaves a readable store behind.
+ */
+struct EventStoreIndexEntry {
+  uint64_t first_row;
+  uint64_t min_spidertime;
+  uint64_t max_spidertime;
+};
+
+/**
+ * @brief Appends neutron events to an event store directory.
+ */
+class EventStoreWriter {
+ public:
+  EventStoreWriter(const std::string& directory, bool append = false,
+                   uint64_t index_stride = 1 << 16);
+  ~EventStoreWriter();
+
+  EventStoreWriter(const EventStoreWriter&) = delete;
+  EventStoreWriter& operator=(const EventStoreWriter&) = delete;
+
+  void append(const std::vector<Neutron>& neutrons);
+  void truncate(uint64_t events);
+  void flush();
+  void close();
+
+  uint64_t getEvents() const { return m_events; }
+
+ private:
+  void openColumns(bool keep);
+  void writeIndexAndHeader();
+
+  std::string m_directory;
+  uint64_t m_index_stride;
+  uint64_t m_events = 0;
+  std::vector<EventStoreIndexEntry> m_index;
+  std::ofstream m_x, m_y, m_tof, m_tot, m_nhits, m_spidertime;
+  bool m_closed = false;
+};
+
+/**
+ * @brief Memory-maps an event store for zero-copy reads.
+ *
+ * The column accessors point straight into the page cache; the whole store
+ * is never copied, so re-binning is bound by the storage bandwidth.
+ */
+class EventStoreReader {
+ public:
+  explicit EventStoreReader(const std::string& directory);
+  ~EventStoreReader();
+
+  EventStoreReader(const EventStoreReader&) = delete;
+  EventStoreReader& operator=(const EventStoreReader&) = delete;
+
+  uint64_t getEvents() const { return m_events; }
+  uint64_t getIndexStride() const { return m_index_stride; }
+  const std::vector<EventStoreIndexEntry>& getIndex() const { return m_index; }
+
+  const float* getX() const { return m_x; }
+  const float* getY() const { return m_y; }
+  const float* getTOF() const { return m_tof; }
+  const float* getTOT() const { return m_tot; }
+  const uint16_t* getNHits() const { return m_nhits; }
+  const uint64_t* getSpidertime() const { return m_spidertime; }
+
+  // Row ranges [first, last) of the index blocks overlapping the spidertime
+  // window [begin, end); rows inside still need their spidertime checked
+  std::vector<std::pair<uint64_t, uint64_t>> findRows(
+      uint64_t begin_spidertime, uint64_t end_spidertime) const;
+  std::vector<Neutron> readNeutrons(uint64_t first_row,
+                                    uint64_t last_row) const;
+
+  /**
+   * @brief Call func(row) for every event with begin <= spidertime < end.
+   */
+  template <typename Func>
+  void forEachEventInWindow(uint64_t begin_spidertime, uint64_t end_spidertime,
+                            Func&& func) const {
+    for (const auto& [first, last] :
+         findRows(begin_spidertime, end_spidertime)) {
+      for (uint64_t row = first; row < last; ++row) {
+        const uint64_t t = m_spidertime[row];
+        if (t >= begin_spidertime && t < end_spidertime) func(row);
+      }
+    }
+  }
+
+ private:
+  const void* mapColumn(const std::string& name, size_t element_size);
+
+  std::string m_directory;
+  uint64_t m_events = 0;
+  uint64_t m_index_stride = 0;
+  std::vector<EventStoreIndexEntry> m_index;
+  std::vector<std::pair<void*, size_t>> m_maps;  // address, length
+  const float* m_x = nullptr;
+  const float* m_y = nullptr;
+  const float* m_tof = nullptr;
+  const float* m_tot = nullptr;
+  const uint16_t* m_nhits = nullptr;
+  const uint64_t* m_spidertime = nullptr;
+};
@@ -0,0 +1,131 @@
+/**
+ * @file hdf5_appender.h
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Buffered column appender writing large compressed HDF5 chunks
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#pragma once
+
+#include <H5Cpp.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "disk_io.h"
+#include "hit.h"
+#include "neutron.h"
+
+/**
+ * @brief Options shared by the column appenders.
+ *
+ * NOTE: lz4 and zstd need the compressor libraries at build time
+ *       (SOPHIREAD_HAS_LZ4/SOPHIREAD_HAS_ZSTD) and the matching HDF5 filter
+ *       plugin to read the file back; deflate is used when not built in.
+ */
+struct HDF5AppenderOptions {
+  size_t chunk_rows = 1 << 20;  // rows per chunk (1M)
+  H5Compression compression = H5Compression::deflate;
+  int level = 1;        // fast deflate, the shuffle does most of the work
+  bool shuffle = true;  // byte shuffle before compression
+};
+
+/**
+ * @brief Appends rows to a set of 1D datasets of the same length.
+ *
+ * The datasets are kept open, rows are buffered until a full chunk is
+ * available, and every chunk is shuffled/compressed on the TBB worker threads
+ * before being handed to HDF5 with a direct chunk write. The last, partial
+ * chunk is written on close(), or on flush() for live (SWMR) readers.
+ * Columns reopened with openColumn() continue after the given row, e.g. to
+ * resume from a checkpoint.
+ */
+class HDF5ColumnAppender {
+ public:
+  HDF5ColumnAppender(const H5::Group& group,
+                     const HDF5AppenderOptions& options = {});
+  ~HDF5ColumnAppender();
+
+  HDF5ColumnAppender(const HDF5ColumnAppender&) = delete;
+  HDF5ColumnAppender& operator=(const HDF5ColumnAppender&) = delete;
+
+  size_t addColumn(const std::string& name, const H5::PredType& type,
+                   const std::string& units = "", double scale_to_ns = 0);
+  // reopen a column written before, keeping its first rows only
+  size_t openColumn(const std::string& name, const H5::PredType& type,
+                    size_t rows);
+  // one pointer per column, in the order of addColumn, each holding rows
+  // elements of the column type
+  void append(const std::vector<const void*>& columns, size_t rows);
+  void flush();
+  void close();
+
+  size_t getRows() const { return m_rows; }
+  size_t getChunkRows() const { return m_options.chunk_rows; }
+
+ private:
+  struct Column {
+    H5::DataSet dataset;
+    size_t element_size;
+    std::vector<char> buffer;
+  };
+
+  void writeChunks(size_t n_chunks, bool pad_last, bool consume = true);
+
+  H5::Group m_group;
+  HDF5AppenderOptions m_options;
+  std::vector<Column> m_columns;
+  size_t m_rows = 0;          // rows appended so far
+  size_t m_written_rows = 0;  // rows already written to the file
+  bool m_closed = false;
+};
+
+/**
+ * @brief Buffered appender for the "hits" group.
+ */
+class HitsHDF5Appender {
+ public:
+  // resume_rows: continue the datasets of a previous run after that row
+  HitsHDF5Appender(H5::H5File& file, HDF5Schema schema = HDF5Schema::legacy,
+                   const HDF5AppenderOptions& options = {},
+                   std::optional<size_t> resume_rows = std::nullopt);
+
+  void append(const std::vector<Hit>& hits);
+  void flush() { m_appender.flush(); }
+  void close() { m_appender.close(); }
+  size_t getRows() const { return m_appender.getRows(); }
+
+ private:
+  HDF5Schema m_schema;
+  HDF5ColumnAppender m_appender;
+};
+
+/**
+ * @brief Buffered appender for the "neutrons" group.
+ */
+class NeutronsHDF5Appender {
+ public:
+  NeutronsHDF5Appender(H5::H5File& file,
+                       HDF5Schema schema = HDF5Schema::legacy,
+                       const HDF5AppenderOptions& options = {},
+                       std::optional<size_t> resume_rows = std::nullopt);
+
+  void append(const std::vector<Neutron>& neutrons);
+  void flush() { m_appender.flush(); }
+  void close() { m_appender.close(); }
+  size_t getRows() const { return m_appender.getRows(); }
+
+ private:
+  HDF5Schema m_schema;
+  HDF5ColumnAppender m_appender;
+};
+
+// Single-writer/multiple-reader support
+H5::H5File createHDF5File(const std::string& filename, bool swmr = false);
+H5::H5File openHDF5File(const std::string& filename, bool swmr = false);
+void startSWMRWrite(H5::H5File& file);
@@ -0,0 +1,133 @@
+/**
+ * @file live_image.h
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Running image, spectrum and counters shared with live viewers
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Layout of a live image segment (POSIX shared memory).
+ *
+ * The header is followed by two frame buffers, each a LiveImageCounters,
+ * then width * height image counts (row major) and tof_bins spectrum counts,
+ * all uint32. The publisher fills the buffer the viewers are not told about,
+ * then points "latest" at it; each buffer has a sequence number that is odd
+ * while it is being written (a seqlock), so a viewer copying a buffer the
+ * publisher came back to sees the number change and copies again. The
+ * publisher never waits for the viewers, which only map the segment
+ * read-only.
+ */
+struct LiveImageCounters {
+  uint64_t frame = 0;  // frames published before this one, plus one
+  uint64_t hits = 0;
+  uint64_t neutrons = 0;
+  uint64_t bytes = 0;  // raw bytes reduced
+  double elapsed = 0;  // seconds since the publisher started
+};
+
+struct LiveImageHeader {
+  char magic[8];  // "SPHRLIVE"
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t tof_bins;
+  uint64_t frame_bytes;  // size of one frame buffer
+  std::atomic<uint64_t> latest;  // newest complete frame, 0 before the first
+  std::atomic<uint64_t> sequence[2];  // seqlock of each frame buffer
+  std::atomic<uint32_t> finished;     // the publisher is done
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "the seqlock needs address-free atomics");
+
+/**
+ * @brief A copy of one published frame.
+ */
+struct LiveImageFrame {
+  LiveImageCounters counters;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<uint32_t> image;  // row major, width * height
+  std::vector<uint32_t> spectrum;
+};
+
+/**
+ * @brief Publishes a running image to a shared memory segment.
+ *
+ * The image, spectrum and counters are accumulated in private memory and
+ * copied to the segment by publish(), so the segment only costs one copy per
+ * frame however many viewers there are. The segment is removed when the
+ * publisher is destroyed; viewers that still map it keep the last frame.
+ */
+class LiveImagePublisher {
+ public:
+  // name: POSIX shared memory name, e.g. "/sophiread"
+  LiveImagePublisher(const std::string& name, uint32_t width, uint32_t height,
+                     uint32_t tof_bins);
+  ~LiveImagePublisher();
+
+  LiveImagePublisher(const LiveImagePublisher&) = delete;
+  LiveImagePublisher& operator=(const LiveImagePublisher&) = delete;
+
+  uint32_t getWidth() const { return m_width; }
+  uint32_t getHeight() const { return m_height; }
+  uint32_t getTOFBins() const { return m_tof_bins; }
+  std::vector<uint32_t>& image() { return m_image; }
+  std::vector<uint32_t>& spectrum() { return m_spectrum; }
+  LiveImageCounters& counters() { return m_counters; }
+
+  void publish();
+  // Publish the last frame and tell the viewers nothing more will come
+  void finish();
+
+ private:
+  std::string m_name;
+  uint32_t m_width;
+  uint32_t m_height;
+  uint32_t m_tof_bins;
+  void* m_segment = nullptr;
+  size_t m_segment_size = 0;
+  std::vector<uint32_t> m_image;
+  std::vector<uint32_t> m_spectrum;
+  LiveImageCounters m_counters;
+};
+
+/**
+ * @brief Maps a live image segment read-only and copies out its frames.
+ */
+class LiveImageReader {
+ public:
+  explicit LiveImageReader(const std::string& name);
+  ~LiveImageReader();
+
+  LiveImageReader(const LiveImageReader&) = delete;
+  LiveImageReader& operator=(const LiveImageReader&) = delete;
+
+  uint32_t getWidth() const;
+  uint32_t getHeight() const;
+  uint32_t getTOFBins() const;
+  // Frame number of the newest frame, 0 before the first one
+  uint64_t getLatestFrame() const;
+  bool isFinished() const;
+
+  // Copy the newest frame; false if none was published yet
+  bool read(LiveImageFrame& frame) const;
+
+ private:
+  const LiveImageHeader* header() const {
+    return static_cast<const LiveImageHeader*>(m_segment);
+  }
+
+  void* m_segment = nullptr;
+  size_t m_segment_size = 0;
+};
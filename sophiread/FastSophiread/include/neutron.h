@@ -18,8 +18,13 @@
 class Neutron : public IPositionTOF {
  public:
   Neutron(const double x, const double y, const double tof, const double tot,
-          const int nHits)
-      : m_x(x), m_y(y), m_tof(tof), m_tot(tot), m_nHits(nHits){};
+          const int nHits, const unsigned long long spidertime = 0)
+      : m_x(x),
+        m_y(y),
+        m_tof(tof),
+        m_tot(tot),
+        m_nHits(nHits),
+        m_spidertime(spidertime){};
 
   double getX() const { return m_x; };
   double getY() const { return m_y; };
@@ -28,6 +33,7 @@ class Neutron : public IPositionTOF {
   double getTOF_ns() const { return m_tof * m_scale_to_ns_40mhz; };
   double getTOT_ns() const { return m_tot * m_scale_to_ns_40mhz; };
   int getNHits() const { return m_nHits; };
+  unsigned long long getSPIDERTIME() const { return m_spidertime; };
 
   std::string toString() const {
     std::stringstream ss;
@@ -46,6 +52,8 @@ class Neutron : public IPositionTOF {
   double m_tof;     // time of flight
   double m_tot;     // time-over-threshold
   int m_nHits;      // number of hits in the event (cluster size)
+  unsigned long long
+      m_spidertime;  // earliest spidertime of the hits (in the unit of 25ns)
   double m_scale_to_ns_40mhz =
       25.0;  // 40 MHz clock is used for the coarse time of arrival.
 };
\ No newline at end of file
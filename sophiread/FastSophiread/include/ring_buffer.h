@@ -0,0 +1,302 @@
+/**
+ * @file ring_buffer.h
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Bounded lock-free queues for handing buffers between threads
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+/**
+ * @brief Bounded multi-producer multi-consumer ring.
+ *
+ * Every cell carries a sequence number telling whether it is free for the
+ * push of a given lap or holds the value of the pop of that lap, so producers
+ * and consumers only contend on their own position with a compare-exchange
+ * (D. Vyukov's bounded MPMC queue). The ring is meant to carry small handles,
+ * e.g. indices of preallocated slabs, rather than the data itself.
+ *
+ * push() and pop() block while the ring is full or empty: they retry for a
+ * short while, then sleep on a futex-backed counter instead of spinning, and
+ * the counters are only notified when someone sleeps on them.
+ * Once closed, pushes fail and pops drain what is left, then fail, so the
+ * producers close the ring when they are done.
+ */
+template <typename T>
+class RingBuffer {
+ public:
+  explicit RingBuffer(size_t capacity) {
+    if (capacity == 0) {
+      throw std::invalid_argument("Ring buffer capacity must be positive");
+    }
+    // a power of two, with at least two cells a full cell never looks free
+    // to the next lap
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+    m_mask = size - 1;
+    m_cells = std::make_unique<Cell[]>(size);
+    for (size_t i = 0; i < size; ++i) {
+      m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  RingBuffer(const RingBuffer&) = delete;
+  RingBuffer& operator=(const RingBuffer&) = delete;
+
+  size_t capacity() const { return m_mask + 1; }
+
+  template <typename U>
+  bool tryPush(U&& value) {
+    size_t position = m_push_position.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &m_cells[position & m_mask];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const auto lap = static_cast<std::ptrdiff_t>(sequence - position);
+      if (lap == 0) {
+        if (m_push_position.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (lap < 0) {
+        return false;  // full
+      } else {
+        position = m_push_position.load(std::memory_order_relaxed);
+      }
+    }
+    cell->value = std::forward<U>(value);
+    cell->sequence.store(position + 1, std::memory_order_release);
+    wake(m_pushes);
+    return true;
+  }
+
+  bool tryPop(T& value) {
+    size_t position = m_pop_position.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &m_cells[position & m_mask];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const auto lap = static_cast<std::ptrdiff_t>(sequence - (position + 1));
+      if (lap == 0) {
+        if (m_pop_position.compare_exchange_weak(position, position + 1,
+                                                 std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (lap < 0) {
+        return false;  // empty
+      } else {
+        position = m_pop_position.load(std::memory_order_relaxed);
+      }
+    }
+    value = std::move(cell->value);
+    cell->sequence.store(position + m_mask + 1, std::memory_order_release);
+    wake(m_pops);
+    return true;
+  }
+
+  // Blocks while full, false once closed
+  template <typename U>
+  bool push(U&& value) {
+    for (int attempt = 0;; ++attempt) {
+      const uint32_t pops = m_pops.load();
+      if (isClosed()) return false;
+      // NOTE: the value is only moved from by a successful push
+      if (tryPush(std::forward<U>(value))) return true;
+      if (attempt >= kSpins) sleep(m_pops, pops);
+    }
+  }
+
+  // Blocks while empty, false once closed and drained
+  bool pop(T& value) {
+    for (int attempt = 0;; ++attempt) {
+      const uint32_t pushes = m_pushes.load();
+      if (tryPop(value)) return true;
+      if (isClosed()) return tryPop(value);
+      if (attempt >= kSpins) sleep(m_pushes, pushes);
+    }
+  }
+
+  // Wakes every blocked push and pop
+  void close() {
+    m_closed.store(true);
+    wake(m_pushes);
+    wake(m_pops);
+  }
+  bool isClosed() const { return m_closed.load(std::memory_order_acquire); }
+
+  // Number of values held, exact only when no push or pop is under way
+  size_t sizeApprox() const {
+    const size_t pushed = m_push_position.load(std::memory_order_relaxed);
+    const size_t popped = m_pop_position.load(std::memory_order_relaxed);
+    return pushed > popped ? pushed - popped : 0;
+  }
+
+ private:
+  static constexpr int kSpins = 64;
+
+  // NOTE: sequentially consistent, a sleeper either sees the new count or is
+  //       seen by the waker
+  void wake(std::atomic<uint32_t>& counter) {
+    counter.fetch_add(1);
+    if (m_sleepers.load() > 0) counter.notify_all();
+  }
+  void sleep(std::atomic<uint32_t>& counter, uint32_t seen) {
+    m_sleepers.fetch_add(1);
+    counter.wait(seen);
+    m_sleepers.fetch_sub(1);
+  }
+
+  struct alignas(64) Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  std::unique_ptr<Cell[]> m_cells;
+  size_t m_mask = 0;
+  alignas(64) std::atomic<size_t> m_push_position{0};
+  alignas(64) std::atomic<size_t> m_pop_position{0};
+  // bumped on every push and pop, the counters blocked threads sleep on
+  alignas(64) std::atomic<uint32_t> m_pushes{0};
+  alignas(64) std::atomic<uint32_t> m_pops{0};
+  std::atomic<uint32_t> m_sleepers{0};
+  std::atomic<bool> m_closed{false};
+};
+
+/**
+ * @brief Bounded single-producer single-consumer ring.
+ *
+ * Each side owns one index and only publishes it with a release store, so a
+ * hand-off costs no read-modify-write; each side also keeps a copy of the
+ * other's index and only reloads it when the ring looks full or empty. Large
+ * values, e.g. blocks of hits, are moved in and out, and a second ring can
+ * hand the emptied blocks back for reuse.
+ *
+ * push() and pop() block like RingBuffer's, sleeping on a futex-backed
+ * signal that is only bumped when the other side sleeps, so an idle
+ * consumer costs no CPU. close() follows RingBuffer.
+ */
+template <typename T>
+class SPSCRing {
+ public:
+  explicit SPSCRing(size_t capacity) {
+    if (capacity == 0) {
+      throw std::invalid_argument("Ring buffer capacity must be positive");
+    }
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    m_mask = size - 1;
+    m_values = std::make_unique<T[]>(size);
+  }
+
+  SPSCRing(const SPSCRing&) = delete;
+  SPSCRing& operator=(const SPSCRing&) = delete;
+
+  size_t capacity() const { return m_mask + 1; }
+
+  // Producer side
+  template <typename U>
+  bool tryPush(U&& value) {
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_cached_head > m_mask) {
+      m_cached_head = m_head.load(std::memory_order_acquire);
+      if (tail - m_cached_head > m_mask) return false;  // full
+    }
+    m_values[tail & m_mask] = std::forward<U>(value);
+    m_tail.store(tail + 1, std::memory_order_release);
+    wake();
+    return true;
+  }
+
+  // Consumer side
+  bool tryPop(T& value) {
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_cached_tail) {
+      m_cached_tail = m_tail.load(std::memory_order_acquire);
+      if (head == m_cached_tail) return false;  // empty
+    }
+    value = std::move(m_values[head & m_mask]);
+    m_head.store(head + 1, std::memory_order_release);
+    wake();
+    return true;
+  }
+
+  // Blocks while full, false once closed
+  template <typename U>
+  bool push(U&& value) {
+    for (int attempt = 0;; ++attempt) {
+      if (isClosed()) return false;
+      // NOTE: the value is only moved from by a successful push
+      if (tryPush(std::forward<U>(value))) return true;
+      if (attempt >= kSpins) sleep([this]() { return isFull(); });
+    }
+  }
+
+  // Blocks while empty, false once closed and drained
+  bool pop(T& value) {
+    for (int attempt = 0;; ++attempt) {
+      if (tryPop(value)) return true;
+      if (isClosed()) return tryPop(value);
+      if (attempt >= kSpins) sleep([this]() { return isEmpty(); });
+    }
+  }
+
+  void close() {
+    m_closed.store(true);
+    m_signal.fetch_add(1);
+    m_signal.notify_all();
+  }
+  bool isClosed() const { return m_closed.load(std::memory_order_acquire); }
+
+  size_t sizeApprox() const {
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+ private:
+  static constexpr int kSpins = 64;
+
+  bool isFull() const {
+    return m_tail.load() - m_head.load() > m_mask;
+  }
+  bool isEmpty() const { return m_tail.load() == m_head.load(); }
+
+  // NOTE: the fence pairs with the sleeper's count and re-check, either the
+  //       sleeper sees the new index or the waker sees the sleeper
+  void wake() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleepers.load(std::memory_order_relaxed) > 0) {
+      m_signal.fetch_add(1);
+      m_signal.notify_all();
+    }
+  }
+  template <typename Blocked>
+  void sleep(Blocked blocked) {
+    const uint32_t seen = m_signal.load();
+    m_sleepers.fetch_add(1);
+    if (blocked() && !isClosed()) m_signal.wait(seen);
+    m_sleepers.fetch_sub(1);
+  }
+
+  std::unique_ptr<T[]> m_values;
+  size_t m_mask = 0;
+  // the consumer's index and its copy of the producer's
+  alignas(64) std::atomic<size_t> m_head{0};
+  size_t m_cached_tail = 0;
+  // the producer's index and its copy of the consumer's
+  alignas(64) std::atomic<size_t> m_tail{0};
+  size_t m_cached_head = 0;
+  alignas(64) std::atomic<uint32_t> m_signal{0};
+  std::atomic<uint32_t> m_sleepers{0};
+  std::atomic<bool> m_closed{false};
+};
@@ -0,0 +1,143 @@
+/**
+ * @file tpx3_index.h
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Batch index sidecar for random access into large .tpx3 files
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tpx3_fast.h"
+#include "tpx3_reader.h"
+
+/**
+ * @brief A block of consecutive TPX3 batches with the timestamps it starts
+ * from.
+ *
+ * The timestamps are the state updateTimestamp hands to the first batch, so
+ * the block can be reduced on its own. The state at the end of a block is the
+ * state at the start of the next one, which the index keeps for the last
+ * block as an extra entry.
+ */
+struct TPX3IndexEntry {
+  uint64_t offset;         // file offset of the first TPX3 header
+  uint64_t size;           // bytes up to the end of the last batch
+  uint64_t tdc_timestamp;  // 25 ns ticks
+  uint64_t gdc_timestamp;  // 25 ns ticks
+  uint32_t timer_lsb32;
+  uint32_t batches;
+  uint32_t packets;
+  uint32_t chip_mask;  // bit i for chip i, chips from 31 on share bit 31
+};
+static_assert(sizeof(TPX3IndexEntry) == 48, "TPX3IndexEntry must be packed");
+
+/**
+ * @brief What a piece of raw data does to the TDC/GDC timestamps.
+ *
+ * In GDC mode every update overwrites its variable from the packet and the
+ * current value of another one (TDC from GDC, GDC from Timer_LSB32), so the
+ * end state only depends on the last writes: the summary keeps those time
+ * packets, in file order, and replaying them over the state at the start of
+ * the piece gives the state at its end. In TDC mode the TDC carries its
+ * rollovers instead, and the first TDC, the last one and the rollovers in
+ * between are kept.
+ *
+ * Pieces scanned independently are chained with append(), which is
+ * associative, so a prefix scan over the pieces gives the state each of them
+ * starts from. The summary is trivially copyable to be sent as raw bytes.
+ */
+struct TPX3TimestampSummary {
+  static constexpr uint32_t kMaxPackets = 32;
+
+  uint32_t num_packets = 0;
+  uint32_t has_tdc = 0;
+  uint32_t first_tdc = 0;
+  uint32_t last_tdc = 0;
+  uint64_t tdc_rollovers = 0;
+  uint64_t packets[kMaxPackets] = {};
+
+  void add(const char* packet);
+  void addBatch(const TPX3& batch, const std::vector<char>& raw_bytes);
+  void append(const TPX3TimestampSummary& next);
+  void apply(bool use_gdc, unsigned long& tdc_timestamp,
+             unsigned long long& gdc_timestamp,
+             unsigned long& timer_lsb32) const;
+};
+
+/**
+ * @brief Sparse batch index of a raw .tpx3 file, kept in a binary sidecar.
+ *
+ * The index is built with the same chunked scan as the reduction, findTPX3H
+ * then updateTimestamp in file order, and starts a new block at the first
+ * batch past block_size bytes. Blocks always hold whole batches, so a reader
+ * can start at any of them without scanning what comes before. In TDC mode
+ * the TDC timestamp evolves without the GDC, the index records the timing
+ * mode it was built for.
+ *
+ * The sidecar is a 32 byte header (magic, version, timing mode, size of the
+ * raw file, number of blocks) followed by the entries, all little-endian.
+ */
+class TPX3Index {
+ public:
+  // A hit is at most this far after the clock state of its batch, the same
+  // bound as the spidertime rollover check of Hit
+  static constexpr uint64_t kClockSlack = 40000000;  // 1 s in 25 ns ticks
+  static constexpr size_t kDefaultBlockSize = 1024 * 1024;
+
+  TPX3Index() = default;
+  TPX3Index(bool use_gdc, uint64_t file_size,
+            std::vector<TPX3IndexEntry> entries);
+
+  static TPX3Index build(const std::string& tpx3_file, bool use_gdc,
+                         size_t block_size = kDefaultBlockSize,
+                         size_t chunk_size = 512 * 1024 * 1024);
+  // Blocks of the batches with a header in [begin, end), for indexing parts
+  // of a file in parallel: the timestamps are only known after rebase()
+  static TPX3Index buildRange(const std::string& tpx3_file, bool use_gdc,
+                              uint64_t begin, uint64_t end,
+                              TPX3TimestampSummary& summary,
+                              size_t block_size = kDefaultBlockSize,
+                              size_t chunk_size = 512 * 1024 * 1024);
+  void rebase(unsigned long tdc_timestamp, unsigned long long gdc_timestamp,
+              unsigned long timer_lsb32);
+  static TPX3Index load(const std::string& index_file);
+  static TPX3Index loadOrBuild(const std::string& tpx3_file,
+                               const std::string& index_file, bool use_gdc);
+  void save(const std::string& index_file) const;
+
+  size_t size() const { return m_entries.size() - 1; }
+  bool empty() const { return size() == 0; }
+  bool usesGDC() const { return m_use_gdc; }
+  uint64_t getFileSize() const { return m_file_size; }
+  const TPX3IndexEntry& operator[](size_t i) const { return m_entries[i]; }
+  const std::vector<TPX3IndexEntry>& getEntries() const { return m_entries; }
+  // state after block i, the entry of the next block (or of the file end)
+  const TPX3IndexEntry& getEndState(size_t i) const { return m_entries[i + 1]; }
+  uint64_t getBlockEnd(size_t i) const;
+  uint64_t getClock(size_t i) const;
+
+  // Blocks [first, last) that may hold hits with begin <= t < end, with t
+  // the spidertime in GDC mode and the TDC in TDC mode (25 ns ticks)
+  std::pair<size_t, size_t> findTimeRange(uint64_t begin, uint64_t end) const;
+  // Split [first, last) into parts ranges of about the same number of bytes
+  std::vector<std::pair<size_t, size_t>> split(size_t parts, size_t first,
+                                               size_t last) const;
+
+  size_t readBatches(ITPX3Reader& reader, size_t first, size_t last,
+                     size_t max_bytes, std::vector<char>& chunk,
+                     std::vector<TPX3>& batches, int chip_id = -1) const;
+
+ private:
+  bool m_use_gdc = false;
+  uint64_t m_file_size = 0;
+  std::vector<TPX3IndexEntry> m_entries{TPX3IndexEntry{}};  // size() + 1
+  std::vector<TPX3TimestampSummary> m_summaries;  // per block, buildRange only
+};
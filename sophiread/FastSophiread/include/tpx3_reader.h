@@ -0,0 +1,282 @@
+/**
+ * @file tpx3_reader.h
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Chunked readers for raw .tpx3 files
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#pragma once
+
+#include <tbb/concurrent_queue.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Sequential chunked access to a raw .tpx3 file.
+ *
+ * Chunks are returned in file order and are not batch aligned, the caller
+ * keeps using the same chunk size so that a checkpointed offset can be
+ * resumed with seek(). Streams are the exception, see TPX3StreamReader.
+ */
+class ITPX3Reader {
+ public:
+  virtual ~ITPX3Reader() = default;
+
+  virtual std::vector<char> readChunk(size_t chunkSize) = 0;
+  // Appends the next chunk to buffer, reusing its capacity where the reader
+  // can; returns the number of bytes appended
+  virtual size_t readChunkInto(size_t chunkSize, std::vector<char>& buffer);
+  virtual void seek(size_t position) = 0;
+  virtual bool isEOF() const = 0;
+  virtual size_t getTotalSize() const = 0;
+  virtual size_t getPosition() const = 0;
+  virtual bool isSeekable() const { return true; }
+  // Live readers return what they hold once its oldest byte has waited this
+  // long rather than fill the chunk; 0 lifts the bound
+  virtual void setMaxLatency(std::chrono::milliseconds) {}
+  // Ends a live input from another thread: a blocked read returns what it
+  // holds and the reader is at its end from then on
+  virtual void interrupt() {}
+};
+
+// How the raw file is read
+// mmap: map the whole file and copy each chunk out of the mapping
+// pread: prefetch the next chunks with pread on I/O threads
+enum class TPX3ReaderBackend { mmap, pread };
+TPX3ReaderBackend parseTPX3ReaderBackend(const std::string& name);
+
+struct TPX3ReaderOptions {
+  TPX3ReaderBackend backend = TPX3ReaderBackend::mmap;
+  size_t queue_depth = 2;                 // chunks in flight (pread)
+  size_t io_threads = 4;                  // pread threads
+  size_t request_size = 8 * 1024 * 1024;  // bytes per pread call
+  bool direct_io = false;                 // O_DIRECT (pread)
+};
+
+// Opens streams with TPX3StreamReader and compressed archives with
+// TPX3CompressedReader whatever the backend
+std::unique_ptr<ITPX3Reader> openTPX3Reader(
+    const std::string& filename,
+    const TPX3ReaderOptions& options = TPX3ReaderOptions());
+
+// Raw streams: "-" (stdin), a FIFO, socket or character device, or a socket
+// address "tcp://[listen@]host:port" or "unix://[listen@]path"
+bool isTPX3Stream(const std::string& source);
+// Connected socket of a tcp:// or unix:// address, accepting one connection
+// with listen@; socket_path gets a unix socket created to listen on
+int openTPX3StreamSocket(const std::string& address,
+                         std::string* socket_path = nullptr);
+
+// Compression of .tpx3 archives, detected from the magic number of the file
+enum class TPX3Codec { none, zstd, lz4 };
+TPX3Codec parseTPX3Codec(const std::string& name);
+TPX3Codec detectTPX3Codec(const std::string& filename);
+bool isTPX3CodecAvailable(TPX3Codec codec);
+
+struct TPX3CompressOptions {
+  TPX3Codec codec = TPX3Codec::zstd;
+  int level = 3;
+  size_t frame_size = 4 * 1024 * 1024;  // raw bytes per frame
+};
+
+uint64_t compressTPX3File(
+    const std::string& input, const std::string& output,
+    const TPX3CompressOptions& options = TPX3CompressOptions());
+
+/**
+ * @brief Reads a .tpx3 file with large preads issued ahead of the consumer.
+ *
+ * Every chunk is read into one buffer of a ring of queue_depth aligned
+ * buffers. Each read is split into request_size preads served by a pool of
+ * io_threads, and as soon as a chunk is handed out its buffer is queued again
+ * for the chunk after the ones already in flight, so the next chunks are read
+ * while the current one is processed. Prefetching assumes the chunk size does
+ * not change, a different size or a seek drops what was read ahead.
+ *
+ * With direct_io the file is opened with O_DIRECT and every pread is aligned
+ * to kDirectIOAlignment, which bypasses the page cache of the client. Falls
+ * back to buffered reads when the file system does not support it.
+ *
+ * NOTE: memory use is queue_depth + 1 chunks, as readChunk returns a copy.
+ */
+class TPX3PrefetchReader : public ITPX3Reader {
+ public:
+  static constexpr size_t kDirectIOAlignment = 4096;
+
+  explicit TPX3PrefetchReader(
+      const std::string& filename,
+      const TPX3ReaderOptions& options = TPX3ReaderOptions());
+  ~TPX3PrefetchReader() override;
+
+  TPX3PrefetchReader(const TPX3PrefetchReader&) = delete;
+  TPX3PrefetchReader& operator=(const TPX3PrefetchReader&) = delete;
+
+  std::vector<char> readChunk(size_t chunkSize) override;
+  void seek(size_t position) override;
+  bool isEOF() const override { return m_position >= m_file_size; }
+  size_t getTotalSize() const override { return m_file_size; }
+  size_t getPosition() const override { return m_position; }
+  bool isDirectIO() const { return m_direct_io; }
+
+ private:
+  struct Buffer {
+    std::unique_ptr<char, void (*)(void*)> data{nullptr, nullptr};
+    size_t capacity = 0;
+    size_t offset = 0;     // file offset of the chunk
+    size_t size = 0;       // bytes of the chunk
+    size_t skip = 0;       // bytes read before offset to stay aligned
+    size_t remaining = 0;  // requests not completed yet
+    int error = 0;         // errno of the first failed request
+    bool busy = false;     // holds a chunk, loaded or in flight
+  };
+  struct Request {
+    Buffer* buffer = nullptr;  // nullptr stops the I/O thread
+    size_t offset = 0;
+    size_t length = 0;
+    char* destination = nullptr;
+  };
+
+  void prefetch();
+  void submit(Buffer& buffer, size_t offset, size_t size);
+  void wait(Buffer& buffer);
+  void drain();
+  void run();
+
+  std::string m_filename;
+  int m_fd = -1;
+  bool m_direct_io = false;
+  size_t m_file_size = 0;
+  size_t m_position = 0;     // first byte not returned yet
+  size_t m_next_offset = 0;  // first byte not requested yet
+  size_t m_chunk_size = 0;
+  size_t m_request_size = 0;
+
+  std::vector<Buffer> m_ring;
+  size_t m_head = 0;  // buffer holding the chunk at m_position
+
+  tbb::concurrent_bounded_queue<Request> m_requests;
+  std::vector<std::thread> m_threads;
+  std::mutex m_mutex;
+  std::condition_variable m_done;
+};
+
+/**
+ * @brief Reads a zstd or lz4 compressed .tpx3 archive as if it was raw.
+ *
+ * An archive is a sequence of independent standard frames, each holding
+ * frame_size bytes of the raw file, so `zstd -d` or `lz4 -d` restore the raw
+ * file. compressTPX3File appends a seek table in a skippable frame (the zstd
+ * seekable format, also used for lz4), which gives the raw offset of every
+ * frame without reading them. Archives without a seek table are indexed by
+ * walking the frame headers, their frames must record the content size.
+ *
+ * The frames of a chunk are decompressed in parallel straight into the chunk.
+ * The frame cut by the end of a chunk is kept for the next one.
+ */
+class TPX3CompressedReader : public ITPX3Reader {
+ public:
+  explicit TPX3CompressedReader(const std::string& filename);
+  ~TPX3CompressedReader() override;
+
+  TPX3CompressedReader(const TPX3CompressedReader&) = delete;
+  TPX3CompressedReader& operator=(const TPX3CompressedReader&) = delete;
+
+  std::vector<char> readChunk(size_t chunkSize) override;
+  void seek(size_t position) override;
+  bool isEOF() const override { return m_position >= m_total_size; }
+  size_t getTotalSize() const override { return m_total_size; }
+  size_t getPosition() const override { return m_position; }
+  size_t getCompressedSize() const { return m_file_size; }
+  size_t getFrames() const { return m_frames.size(); }
+
+ private:
+  struct Frame {
+    size_t compressed_offset;
+    size_t compressed_size;
+    size_t raw_offset;
+    size_t raw_size;
+  };
+
+  bool readSeekTable();
+  void walkFrames();
+  void decompress(const Frame& frame, char* destination) const;
+
+  std::string m_filename;
+  int m_fd = -1;
+  char* m_map = nullptr;
+  size_t m_file_size = 0;
+  size_t m_total_size = 0;
+  size_t m_position = 0;
+  std::vector<Frame> m_frames;
+
+  size_t m_cached_frame = SIZE_MAX;  // frame held in m_cache
+  std::vector<char> m_cache;
+};
+
+/**
+ * @brief Reads raw TPX3 packets from stdin, a pipe or a socket.
+ *
+ * A stream can neither be mapped nor seeked, so its chunks are cut at the
+ * last complete batch instead, like TPX3FileFollower does, and the partial
+ * batch at the end is kept for the next chunk. readChunk returns as soon as
+ * it holds a complete batch and no more data is waiting, so a live stream is
+ * reduced as it arrives rather than a chunk size at a time.
+ *
+ * A socket address connects to the sender, or with listen@ accepts a single
+ * connection from it. The stream ends when the sender closes it.
+ *
+ * With a maximum latency, a chunk is also cut once its oldest byte has waited
+ * that long, even while more data keeps arriving.
+ *
+ * interrupt() wakes a read blocked on an idle stream through a self-pipe and
+ * ends the stream there, so a consumer can be stopped without a sender.
+ *
+ * NOTE: a chunk may exceed the chunk size by up to one batch (64 KiB) when
+ *       the chunk size is smaller than that.
+ */
+class TPX3StreamReader : public ITPX3Reader {
+ public:
+  explicit TPX3StreamReader(const std::string& source);
+  ~TPX3StreamReader() override;
+
+  TPX3StreamReader(const TPX3StreamReader&) = delete;
+  TPX3StreamReader& operator=(const TPX3StreamReader&) = delete;
+
+  std::vector<char> readChunk(size_t chunkSize) override;
+  void seek(size_t position) override;
+  bool isEOF() const override { return m_eof && m_pending.empty(); }
+  // bytes received so far, the size of a stream is only known at its end
+  size_t getTotalSize() const override { return m_received; }
+  size_t getPosition() const override { return m_position; }
+  bool isSeekable() const override { return false; }
+  void setMaxLatency(std::chrono::milliseconds latency) override {
+    m_max_latency = latency;
+  }
+  void interrupt() override;
+
+ private:
+  bool isDataWaiting() const;
+  bool waitForData();
+
+  std::string m_source;
+  int m_fd = -1;
+  bool m_owns_fd = true;
+  int m_wake[2] = {-1, -1};  // self-pipe written by interrupt()
+  std::string m_socket_path;  // unix socket created by listen@
+  bool m_eof = false;
+  size_t m_received = 0;
+  size_t m_position = 0;  // bytes returned
+  std::vector<char> m_pending;
+  std::chrono::steady_clock::time_point m_pending_since;  // oldest byte
+  std::chrono::milliseconds m_max_latency{0};
+};
@@ -11,6 +11,9 @@
  */
 #include "centroid.h"
 
+#include <algorithm>
+#include <climits>
+
 /**
  * @brief Perform centroid fitting on the hits.
  *
@@ -22,6 +25,7 @@ Neutron Centroid::fit(const std::vector<Hit>& data) {
   double y = 0;
   double tof = 0;
   double tot = 0;
+  unsigned long long spidertime = ULLONG_MAX;
 
   if (data.size() == 0) {
     return Neutron(0, 0, 0, 0, 0);
@@ -38,6 +42,7 @@ Neutron Centroid::fit(const std::vector<Hit>& data) {
       y += m_super_resolution_factor * hit_y * hit_tot;
       tof += hit_tof;
       tot += hit_tot;
+      spidertime = std::min(spidertime, hit.getSPIDERTIME());
     }
     const auto tot_inv = 1.0 / tot;
     x *= tot_inv;
@@ -48,6 +53,7 @@ Neutron Centroid::fit(const std::vector<Hit>& data) {
       y += m_super_resolution_factor * hit.getY();
       tof += hit.getTOF();
       tot += hit.getTOT();
+      spidertime = std::min(spidertime, hit.getSPIDERTIME());
     }
     const auto data_size_inv = 1.0 / data.size();
     x *= data_size_inv;
@@ -56,5 +62,5 @@ Neutron Centroid::fit(const std::vector<Hit>& data) {
 
   tof /= data.size();
 
-  return Neutron(x, y, tof, tot, data.size());
+  return Neutron(x, y, tof, tot, data.size(), spidertime);
 }
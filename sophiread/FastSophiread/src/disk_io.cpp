@@ -10,6 +10,12 @@
  */
 #include "disk_io.h"
 
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
 
 #include "spdlog/spdlog.h"
@@ -496,15 +502,164 @@ std::vector<char> TPX3FileReader::readChunk(size_t chunkSize) {
   return chunk;
 }
 
+/**
+ * @brief Append the next chunk straight from the mapping.
+ *
+ * @param[in] chunkSize
+ * @param[in,out] buffer
+ * @return size_t: bytes appended, 0 at the end of the file
+ */
+size_t TPX3FileReader::readChunkInto(size_t chunkSize,
+                                     std::vector<char> &buffer) {
+  const size_t bytesToRead =
+      std::min(chunkSize, fileSize - std::min(currentPosition, fileSize));
+  buffer.insert(buffer.end(), map + currentPosition,
+                map + currentPosition + bytesToRead);
+  currentPosition += bytesToRead;
+  return bytesToRead;
+}
+
+/**
+ * @brief Move to a byte offset, e.g. to resume from a checkpoint.
+ *
+ * @param[in] position: offset from the start of the file
+ */
+void TPX3FileReader::seek(size_t position) {
+  if (position > fileSize) {
+    spdlog::error("Cannot seek to {} in a file of {} bytes", position,
+                  fileSize);
+    throw std::out_of_range("Seek past the end of file");
+  }
+  currentPosition = position;
+}
+
+/**
+ * @brief Find the end of the last complete TPX3 batch in a buffer.
+ *
+ * @note Walks from header to header, a header whose packets are not all in
+ *       the buffer marks the end. Words outside a batch are skipped 8 bytes
+ *       at a time, like findTPX3H does.
+ *
+ * @param[in] data: buffer starting on an 8 byte boundary of the file
+ * @param[in] size
+ * @return size_t: number of bytes that only hold complete batches
+ */
+size_t findLastCompleteTPX3Batch(const char *data, size_t size) {
+  size_t complete = 0;
+  size_t pos = 0;
+  while (pos + 8 <= size) {
+    const char *word = data + pos;
+    if (word[0] == 'T' && word[1] == 'P' && word[2] == 'X') {
+      const size_t batch_size = ((0xff & word[7]) << 8) | (0xff & word[6]);
+      if (pos + 8 + batch_size > size) break;
+      pos += 8 + batch_size;
+    } else {
+      pos += 8;
+    }
+    complete = pos;
+  }
+  return complete;
+}
+
+/**
+ * @brief Construct a new TPX3FileFollower object
+ *
+ * @param[in] filename
+ * @param[in] position: batch aligned offset of the first byte to read
+ */
+TPX3FileFollower::TPX3FileFollower(const std::string &filename,
+                                   size_t position)
+    : m_filename(filename), m_position(position) {
+  m_fd = open(filename.c_str(), O_RDONLY);
+  if (m_fd == -1) {
+    spdlog::error("Failed to open file: {}", filename);
+    throw std::runtime_error("Failed to open file");
+  }
+  spdlog::info("Following file: {} from byte {}", filename, position);
+}
+
+/**
+ * @brief Destroy the TPX3FileFollower object
+ */
+TPX3FileFollower::~TPX3FileFollower() {
+  if (m_fd != -1) {
+    close(m_fd);
+  }
+}
+
+/**
+ * @brief Current size of the followed file.
+ */
+size_t TPX3FileFollower::getFileSize() const {
+  struct stat sb;
+  if (fstat(m_fd, &sb) == -1) {
+    spdlog::error("Failed to get size of {}", m_filename);
+    throw std::runtime_error("Failed to get file size");
+  }
+  return sb.st_size;
+}
+
+/**
+ * @brief Read the complete batches appended since the last call.
+ *
+ * @param[in] maxBytes: upper bound of new bytes to read, 0 for no bound
+ * @return std::vector<char>: batch aligned raw data, empty if nothing new
+ */
+std::vector<char> TPX3FileFollower::readAppended(size_t maxBytes) {
+  const size_t fileSize = getFileSize();
+  if (fileSize < m_position) {
+    spdlog::error("{} shrank from {} to {} bytes", m_filename, m_position,
+                  fileSize);
+    throw std::runtime_error("Followed file was truncated");
+  }
+
+  size_t bytesToRead = fileSize - m_position;
+  if (maxBytes > 0) bytesToRead = std::min(bytesToRead, maxBytes);
+
+  std::vector<char> buffer = std::move(m_pending);
+  m_pending.clear();
+  const size_t carried = buffer.size();
+  buffer.resize(carried + bytesToRead);
+
+  size_t done = 0;
+  while (done < bytesToRead) {
+    const ssize_t n = pread(m_fd, buffer.data() + carried + done,
+                            bytesToRead - done, m_position + done);
+    if (n == -1 && errno == EINTR) continue;
+    if (n == -1) {
+      spdlog::error("Failed to read {}: {}", m_filename, strerror(errno));
+      throw std::runtime_error("Failed to read followed file");
+    }
+    if (n == 0) break;  // raced with a truncation, take what we have
+    done += n;
+  }
+  m_position += done;
+  buffer.resize(carried + done);
+
+  // keep the partial batch at the end for the next call
+  const size_t complete =
+      findLastCompleteTPX3Batch(buffer.data(), buffer.size());
+  m_pending.assign(buffer.begin() + complete, buffer.end());
+  buffer.resize(complete);
+
+  spdlog::debug("Followed {}: {} new bytes, {} pending, position {}",
+                m_filename, buffer.size(), m_pending.size(), m_position);
+  return buffer;
+}
+
 /**
  * @brief Create or extend a dataset in a HDF5 group.
  *
+ * @tparam T: element type of the dataset
  * @param[in] group: HDF5 group
  * @param[in] datasetName: name of the dataset
  * @param[in] data: data to write to the dataset
+ * @param[in] dataType: HDF5 type matching T
  */
+template <typename T>
 void createOrExtendDataset(H5::Group &group, const std::string &datasetName,
-                           const std::vector<double> &data) {
+                           const std::vector<T> &data,
+                           const H5::PredType &dataType) {
   spdlog::debug("Creating or extending dataset '{}' with {} elements",
                 datasetName, data.size());
 
@@ -542,8 +697,7 @@ void createOrExtendDataset(H5::Group &group, const std::string &datasetName,
     filespace.selectHyperslab(H5S_SELECT_SET, dims, offset);
 
     H5::DataSpace memspace(1, dims);
-    dataset.write(data.data(), H5::PredType::NATIVE_DOUBLE, memspace,
-                  filespace);
+    dataset.write(data.data(), dataType, memspace, filespace);
   } else {
     spdlog::debug("Dataset '{}' doesn't exist, creating a new one",
                   datasetName);
@@ -555,9 +709,9 @@ void createOrExtendDataset(H5::Group &group, const std::string &datasetName,
     propList.setChunk(1, chunkdims);
 
     try {
-      H5::DataSet dataset = group.createDataSet(
-          datasetName, H5::PredType::NATIVE_DOUBLE, dataspace, propList);
-      dataset.write(data.data(), H5::PredType::NATIVE_DOUBLE);
+      H5::DataSet dataset =
+          group.createDataSet(datasetName, dataType, dataspace, propList);
+      dataset.write(data.data(), dataType);
     } catch (H5::Exception &create_e) {
       spdlog::error("Failed to create dataset '{}': {}", datasetName,
                     create_e.getDetailMsg());
@@ -566,28 +720,185 @@ void createOrExtendDataset(H5::Group &group, const std::string &datasetName,
   }
 }
 
+/**
+ * @brief Create or extend a dataset of doubles in a HDF5 group.
+ *
+ * @param[in] group: HDF5 group
+ * @param[in] datasetName: name of the dataset
+ * @param[in] data: data to write to the dataset
+ */
+void createOrExtendDataset(H5::Group &group, const std::string &datasetName,
+                           const std::vector<double> &data) {
+  createOrExtendDataset(group, datasetName, data, H5::PredType::NATIVE_DOUBLE);
+}
+
+/**
+ * @brief Parse the name of a hits/neutrons HDF5 schema.
+ *
+ * @param[in] name: "legacy" or "compact"
+ * @return HDF5Schema
+ */
+HDF5Schema parseHDF5Schema(const std::string &name) {
+  if (name == "legacy") return HDF5Schema::legacy;
+  if (name == "compact") return HDF5Schema::compact;
+  throw std::runtime_error("Invalid HDF5 schema. Use 'legacy' or 'compact'.");
+}
+
+/**
+ * @brief Open a group, creating it (tagged with its schema) if needed.
+ *
+ * @param[in] file: HDF5 file
+ * @param[in] groupName: name of the group
+ * @param[in] schema: schema of the datasets in the group
+ * @return H5::Group
+ */
+H5::Group openOrCreateGroup(H5::H5File &file, const std::string &groupName,
+                            HDF5Schema schema) {
+  try {
+    return file.openGroup(groupName);
+  } catch (H5::Exception &e) {
+    H5::Group group = file.createGroup(groupName);
+    if (schema == HDF5Schema::compact) {
+      H5::StrType strType(H5::PredType::C_S1, H5T_VARIABLE);
+      group.createAttribute("schema", strType, H5::DataSpace(H5S_SCALAR))
+          .write(strType, std::string("compact"));
+    }
+    return group;
+  }
+}
+
+/**
+ * @brief Attach the unit and the scale to ns of a compact dataset.
+ *
+ * @param[in] group: HDF5 group
+ * @param[in] datasetName: name of the dataset
+ * @param[in] units: unit of the stored values
+ * @param[in] scaleToNs: factor converting stored values to ns, 0 if not a time
+ */
+void setDatasetUnits(H5::Group &group, const std::string &datasetName,
+                     const std::string &units, double scaleToNs) {
+  H5::DataSet dataset = group.openDataSet(datasetName);
+  if (dataset.attrExists("units")) return;
+
+  H5::StrType strType(H5::PredType::C_S1, H5T_VARIABLE);
+  H5::DataSpace scalar(H5S_SCALAR);
+  dataset.createAttribute("units", strType, scalar).write(strType, units);
+  if (scaleToNs > 0) {
+    dataset.createAttribute("scale_to_ns", H5::PredType::NATIVE_DOUBLE, scalar)
+        .write(H5::PredType::NATIVE_DOUBLE, &scaleToNs);
+  }
+}
+
+/**
+ * @brief Read the schema tag of a hits/neutrons group.
+ *
+ * @param[in] group: HDF5 group
+ * @return HDF5Schema
+ */
+static HDF5Schema readGroupSchema(const H5::Group &group) {
+  if (!group.attrExists("schema")) return HDF5Schema::legacy;
+
+  H5::Attribute attr = group.openAttribute("schema");
+  std::string name;
+  attr.read(attr.getStrType(), name);
+  return parseHDF5Schema(name);
+}
+
+/**
+ * @brief Read a whole 1D dataset, converting to T.
+ *
+ * @tparam T: element type in memory
+ * @param[in] group: HDF5 group
+ * @param[in] datasetName: name of the dataset
+ * @param[in] dataType: HDF5 type matching T
+ * @return std::vector<T>
+ */
+template <typename T>
+static std::vector<T> readDataset(const H5::Group &group,
+                                  const std::string &datasetName,
+                                  const H5::PredType &dataType) {
+  H5::DataSet dataset = group.openDataSet(datasetName);
+  hsize_t dims[1] = {0};
+  dataset.getSpace().getSimpleExtentDims(dims);
+  std::vector<T> data(dims[0]);
+  if (!data.empty()) {
+    dataset.read(data.data(), dataType);
+  }
+  return data;
+}
+
 /**
  * @brief Append hits to an extendible HDF5 file.
  *
+ * The legacy schema stores every column as double (times in ns), the compact
+ * schema stores the native integer types (times in clock ticks) and records
+ * the unit and the scale to ns as attributes of each dataset.
+ *
  * @param[in] file: HDF5 file
  * @param[in] hits: vector of hits to append
+ * @param[in] schema: layout of the datasets
  */
-void appendHitsToHDF5Extendible(H5::H5File &file,
-                                const std::vector<Hit> &hits) {
+void appendHitsToHDF5Extendible(H5::H5File &file, const std::vector<Hit> &hits,
+                                HDF5Schema schema) {
   if (hits.empty()) {
     spdlog::debug("Attempting to append empty hit vector to HDF5 file");
     return;
   }
 
-  H5::Group group;
-  try {
-    group = file.openGroup("hits");
-  } catch (H5::Exception &e) {
-    group = file.createGroup("hits");
-  }
+  H5::Group group = openOrCreateGroup(file, "hits", schema);
 
   spdlog::debug("Appending {} hits to HDF5 file", hits.size());
 
+  if (schema == HDF5Schema::compact) {
+    std::vector<uint16_t> xData, yData, totData, toaData;
+    std::vector<uint8_t> ftoaData;
+    std::vector<uint32_t> tofData;
+    std::vector<uint64_t> spidertimeData;
+    xData.reserve(hits.size());
+    yData.reserve(hits.size());
+    totData.reserve(hits.size());
+    toaData.reserve(hits.size());
+    ftoaData.reserve(hits.size());
+    tofData.reserve(hits.size());
+    spidertimeData.reserve(hits.size());
+
+    for (const auto &hit : hits) {
+      xData.push_back(static_cast<uint16_t>(hit.getX()));
+      yData.push_back(static_cast<uint16_t>(hit.getY()));
+      totData.push_back(static_cast<uint16_t>(hit.getTOT()));
+      toaData.push_back(static_cast<uint16_t>(hit.getTOA()));
+      ftoaData.push_back(static_cast<uint8_t>(hit.getFTOA()));
+      tofData.push_back(hit.getTOF());
+      spidertimeData.push_back(hit.getSPIDERTIME());
+    }
+
+    try {
+      createOrExtendDataset(group, "x", xData, H5::PredType::NATIVE_UINT16);
+      createOrExtendDataset(group, "y", yData, H5::PredType::NATIVE_UINT16);
+      createOrExtendDataset(group, "tot", totData, H5::PredType::NATIVE_UINT16);
+      createOrExtendDataset(group, "toa", toaData, H5::PredType::NATIVE_UINT16);
+      createOrExtendDataset(group, "ftoa", ftoaData,
+                            H5::PredType::NATIVE_UINT8);
+      createOrExtendDataset(group, "tof", tofData, H5::PredType::NATIVE_UINT32);
+      createOrExtendDataset(group, "spidertime", spidertimeData,
+                            H5::PredType::NATIVE_UINT64);
+
+      setDatasetUnits(group, "x", "pixel");
+      setDatasetUnits(group, "y", "pixel");
+      setDatasetUnits(group, "tot", "25 ns", 25.0);
+      setDatasetUnits(group, "toa", "25 ns", 25.0);
+      setDatasetUnits(group, "ftoa", "1.5625 ns", 25.0 / 16.0);
+      setDatasetUnits(group, "tof", "25 ns", 25.0);
+      setDatasetUnits(group, "spidertime", "25 ns", 25.0);
+    } catch (H5::Exception &e) {
+      spdlog::error("Failed to append hits to HDF5 file: {}",
+                    e.getDetailMsg());
+    }
+
+    group.close();
+    return;
+  }
+
   std::vector<double> xData, yData, totData, toaData, ftoaData, tofData,
       spidertimeData;
   xData.reserve(hits.size());
@@ -628,19 +939,51 @@ void appendHitsToHDF5Extendible(H5::H5File &file,
  *
  * @param[in] file: HDF5 file
  * @param[in] neutrons: vector of neutrons to append
+ * @param[in] schema: layout of the datasets
  */
 void appendNeutronsToHDF5Extendible(H5::H5File &file,
-                                    const std::vector<Neutron> &neutrons) {
+                                    const std::vector<Neutron> &neutrons,
+                                    HDF5Schema schema) {
   if (neutrons.empty()) {
     spdlog::debug("Attempting to append empty neutron vector to HDF5 file");
     return;
   }
 
-  H5::Group group;
-  try {
-    group = file.openGroup("neutrons");
-  } catch (H5::Exception &e) {
-    group = file.createGroup("neutrons");
+  H5::Group group = openOrCreateGroup(file, "neutrons", schema);
+
+  if (schema == HDF5Schema::compact) {
+    std::vector<float> xData, yData, tofData, totData;
+    std::vector<uint16_t> nHitsData;
+    xData.reserve(neutrons.size());
+    yData.reserve(neutrons.size());
+    tofData.reserve(neutrons.size());
+    totData.reserve(neutrons.size());
+    nHitsData.reserve(neutrons.size());
+
+    for (const auto &neutron : neutrons) {
+      xData.push_back(static_cast<float>(neutron.getX()));
+      yData.push_back(static_cast<float>(neutron.getY()));
+      tofData.push_back(static_cast<float>(neutron.getTOF()));
+      totData.push_back(static_cast<float>(neutron.getTOT()));
+      nHitsData.push_back(static_cast<uint16_t>(
+          std::min(neutron.getNHits(), int(UINT16_MAX))));
+    }
+
+    createOrExtendDataset(group, "x", xData, H5::PredType::NATIVE_FLOAT);
+    createOrExtendDataset(group, "y", yData, H5::PredType::NATIVE_FLOAT);
+    createOrExtendDataset(group, "tof", tofData, H5::PredType::NATIVE_FLOAT);
+    createOrExtendDataset(group, "tot", totData, H5::PredType::NATIVE_FLOAT);
+    createOrExtendDataset(group, "nHits", nHitsData,
+                          H5::PredType::NATIVE_UINT16);
+
+    setDatasetUnits(group, "x", "pixel");
+    setDatasetUnits(group, "y", "pixel");
+    setDatasetUnits(group, "tof", "25 ns", 25.0);
+    setDatasetUnits(group, "tot", "25 ns", 25.0);
+    setDatasetUnits(group, "nHits", "count");
+
+    group.close();
+    return;
   }
 
   std::vector<double> xData, yData, tofData, totData, nHitsData;
@@ -665,4 +1008,164 @@ void appendNeutronsToHDF5Extendible(H5::H5File &file,
   createOrExtendDataset(group, "nHits", nHitsData);
 
   group.close();
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Read the hits written by appendHitsToHDF5Extendible.
+ *
+ * Both schemas are supported, times are converted back to clock ticks so the
+ * Hit getters scale them to ns on demand.
+ *
+ * @param[in] filename: HDF5 file
+ * @return std::vector<Hit>
+ */
+std::vector<Hit> readHitsFromHDF5(const std::string &filename) {
+  H5::H5File file(filename, H5F_ACC_RDONLY);
+  H5::Group group = file.openGroup("hits");
+  std::vector<Hit> hits;
+
+  if (readGroupSchema(group) == HDF5Schema::compact) {
+    const auto x =
+        readDataset<uint16_t>(group, "x", H5::PredType::NATIVE_UINT16);
+    const auto y =
+        readDataset<uint16_t>(group, "y", H5::PredType::NATIVE_UINT16);
+    const auto tot =
+        readDataset<uint16_t>(group, "tot", H5::PredType::NATIVE_UINT16);
+    const auto toa =
+        readDataset<uint16_t>(group, "toa", H5::PredType::NATIVE_UINT16);
+    const auto ftoa =
+        readDataset<uint8_t>(group, "ftoa", H5::PredType::NATIVE_UINT8);
+    const auto tof =
+        readDataset<uint32_t>(group, "tof", H5::PredType::NATIVE_UINT32);
+    const auto spidertime = readDataset<uint64_t>(group, "spidertime",
+                                                  H5::PredType::NATIVE_UINT64);
+
+    hits.reserve(x.size());
+    for (size_t i = 0; i < x.size(); ++i) {
+      hits.emplace_back(x[i], y[i], tot[i], toa[i], ftoa[i], tof[i],
+                        spidertime[i]);
+    }
+    return hits;
+  }
+
+  const auto x = readDataset<double>(group, "x", H5::PredType::NATIVE_DOUBLE);
+  const auto y = readDataset<double>(group, "y", H5::PredType::NATIVE_DOUBLE);
+  const auto tot =
+      readDataset<double>(group, "tot_ns", H5::PredType::NATIVE_DOUBLE);
+  const auto toa =
+      readDataset<double>(group, "toa_ns", H5::PredType::NATIVE_DOUBLE);
+  const auto ftoa =
+      readDataset<double>(group, "ftoa_ns", H5::PredType::NATIVE_DOUBLE);
+  const auto tof =
+      readDataset<double>(group, "tof_ns", H5::PredType::NATIVE_DOUBLE);
+  const auto spidertime =
+      readDataset<double>(group, "spidertime_ns", H5::PredType::NATIVE_DOUBLE);
+
+  hits.reserve(x.size());
+  for (size_t i = 0; i < x.size(); ++i) {
+    hits.emplace_back(static_cast<int>(x[i]), static_cast<int>(y[i]),
+                      static_cast<int>(std::llround(tot[i] / 25.0)),
+                      static_cast<int>(std::llround(toa[i] / 25.0)),
+                      static_cast<int>(std::llround(ftoa[i] / (25.0 / 16.0))),
+                      static_cast<unsigned int>(std::llround(tof[i] / 25.0)),
+                      static_cast<unsigned long long>(
+                          std::llround(spidertime[i] / 25.0)));
+  }
+  return hits;
+}
+
+/**
+ * @brief Read the neutrons written by appendNeutronsToHDF5Extendible.
+ *
+ * @param[in] filename: HDF5 file
+ * @return std::vector<Neutron>
+ */
+std::vector<Neutron> readNeutronsFromHDF5(const std::string &filename) {
+  H5::H5File file(filename, H5F_ACC_RDONLY);
+  H5::Group group = file.openGroup("neutrons");
+  const bool compact = readGroupSchema(group) == HDF5Schema::compact;
+
+  // HDF5 converts the stored type to double on read
+  const auto x = readDataset<double>(group, "x", H5::PredType::NATIVE_DOUBLE);
+  const auto y = readDataset<double>(group, "y", H5::PredType::NATIVE_DOUBLE);
+  const auto tof = readDataset<double>(group, compact ? "tof" : "tof_ns",
+                                       H5::PredType::NATIVE_DOUBLE);
+  const auto tot = readDataset<double>(group, compact ? "tot" : "tot_ns",
+                                       H5::PredType::NATIVE_DOUBLE);
+  const auto nHits =
+      readDataset<int>(group, "nHits", H5::PredType::NATIVE_INT);
+
+  // legacy files store times in ns
+  const double scale = compact ? 1.0 : 1.0 / 25.0;
+  std::vector<Neutron> neutrons;
+  neutrons.reserve(x.size());
+  for (size_t i = 0; i < x.size(); ++i) {
+    neutrons.emplace_back(x[i], y[i], tof[i] * scale, tot[i] * scale,
+                          nHits[i]);
+  }
+  return neutrons;
+}
+
+/**
+ * @brief Parse the name of a HDF5 compression filter.
+ *
+ * @param[in] name: one of "none", "deflate", "lz4", "zstd"
+ * @return H5Compression
+ */
+H5Compression parseH5Compression(const std::string &name) {
+  if (name == "none") return H5Compression::none;
+  if (name == "deflate" || name == "gzip") return H5Compression::deflate;
+  if (name == "lz4") return H5Compression::lz4;
+  if (name == "zstd") return H5Compression::zstd;
+  throw std::runtime_error(
+      "Invalid compression. Use 'none', 'deflate', 'lz4' or 'zstd'.");
+}
+
+/**
+ * @brief Configure the filter pipeline of a chunked dataset.
+ *
+ * @param[in, out] propList: dataset creation property list (chunked)
+ * @param[in] compression: compression filter to use
+ * @param[in] level: compression level
+ * @param[in] shuffle: apply the byte shuffle filter before compression
+ */
+void setH5Compression(H5::DSetCreatPropList &propList,
+                      H5Compression compression, int level, bool shuffle) {
+  if (compression == H5Compression::none) {
+    return;
+  }
+
+  // byte shuffle makes the slowly varying high bytes compress much better
+  if (shuffle) {
+    propList.setShuffle();
+  }
+
+  // registered filters are only available through plugins
+  if (compression == H5Compression::lz4 &&
+      H5Zfilter_avail(H5Z_FILTER_LZ4_PLUGIN) <= 0) {
+    spdlog::warn("HDF5 LZ4 filter plugin not available, using deflate");
+    compression = H5Compression::deflate;
+  }
+  if (compression == H5Compression::zstd &&
+      H5Zfilter_avail(H5Z_FILTER_ZSTD_PLUGIN) <= 0) {
+    spdlog::warn("HDF5 zstd filter plugin not available, using deflate");
+    compression = H5Compression::deflate;
+  }
+
+  switch (compression) {
+    case H5Compression::deflate:
+      propList.setDeflate(std::clamp(level, 0, 9));
+      break;
+    case H5Compression::lz4:
+      H5Pset_filter(propList.getId(), H5Z_FILTER_LZ4_PLUGIN, H5Z_FLAG_OPTIONAL,
+                    0, nullptr);
+      break;
+    case H5Compression::zstd: {
+      const unsigned int cd_values[1] = {static_cast<unsigned int>(level)};
+      H5Pset_filter(propList.getId(), H5Z_FILTER_ZSTD_PLUGIN,
+                    H5Z_FLAG_OPTIONAL, 1, cd_values);
+    } break;
+    default:
+      break;
+  }
+}
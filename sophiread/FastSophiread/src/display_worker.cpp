@@ -0,0 +1,287 @@
+/**
+ * @file display_worker.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Background reduction of a raw file into a running image for display
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include "display_worker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "abs.h"
+#include "disk_io.h"
+#include "spdlog/spdlog.h"
+
+DisplayWorker::DisplayWorker(const DisplayWorkerOptions& options)
+    : m_options(options),
+      m_image_size(static_cast<uint32_t>(517 * options.super_resolution)) {
+  if (m_image_size == 0 || m_options.batches_per_block == 0 ||
+      m_options.blocks == 0 || m_options.chunk_size == 0) {
+    throw std::invalid_argument("Invalid display worker options");
+  }
+  m_image.assign(static_cast<size_t>(m_image_size) * m_image_size, 0);
+}
+
+DisplayWorker::~DisplayWorker() { stop(); }
+
+/**
+ * @brief Start the parser and clustering threads on a new input.
+ *
+ * @param[in] input: file or stream, see openTPX3Reader
+ */
+void DisplayWorker::start(const std::string& input) {
+  if (isRunning()) {
+    throw std::runtime_error("Display worker already running");
+  }
+  wait();
+
+  m_bytes_read = 0;
+  m_total_bytes = 0;
+  m_hits = 0;
+  m_neutron_count = 0;
+  m_neutrons.clear();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::fill(m_image.begin(), m_image.end(), 0);
+    ++m_image_version;
+    m_error = nullptr;
+  }
+  m_stop = false;
+  m_done = false;
+  m_blocks =
+      std::make_unique<SPSCRing<std::vector<TPX3>>>(m_options.blocks);
+
+  m_parser = std::thread([this, input]() {
+    try {
+      parse(input);
+    } catch (...) {
+      fail(std::current_exception());
+    }
+    m_blocks->close();
+  });
+  m_clusterer = std::thread([this]() {
+    try {
+      cluster();
+    } catch (...) {
+      fail(std::current_exception());
+    }
+    m_done = true;
+  });
+}
+
+/**
+ * @brief Cancel the reduction, waking a parser blocked on an idle stream.
+ */
+void DisplayWorker::stop() {
+  m_stop = true;
+  if (m_blocks) m_blocks->close();
+  {
+    // NOTE: a parser that publishes its reader after this sees m_stop
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_reader) m_reader->interrupt();
+  }
+  wait();
+}
+
+void DisplayWorker::wait() {
+  if (m_parser.joinable()) m_parser.join();
+  if (m_clusterer.joinable()) m_clusterer.join();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_reader.reset();
+}
+
+bool DisplayWorker::isRunning() const { return !m_done; }
+
+DisplayProgress DisplayWorker::getProgress() const {
+  DisplayProgress progress;
+  progress.bytes_read = m_bytes_read;
+  progress.total_bytes = m_total_bytes;
+  progress.hits = m_hits;
+  progress.neutrons = m_neutron_count;
+  progress.done = m_done;
+  return progress;
+}
+
+/**
+ * @brief Copy the image if it changed since the given version.
+ *
+ * @param[out] image
+ * @param[in,out] version: version of the copy held by the caller
+ * @return true if the image was copied
+ */
+bool DisplayWorker::copyImage(std::vector<uint32_t>& image,
+                              uint64_t& version) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (version == m_image_version) return false;
+  image = m_image;
+  version = m_image_version;
+  return true;
+}
+
+std::string DisplayWorker::getError() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_error) return "";
+  try {
+    std::rethrow_exception(m_error);
+  } catch (const std::exception& e) {
+    return e.what();
+  } catch (...) {
+    return "Unknown error";
+  }
+}
+
+/**
+ * @brief Parser thread: whole batches, timestamps and hits, handed over in
+ * blocks of batches.
+ *
+ * @note The partial batch at the end of a chunk is moved to the front of the
+ *       next one, and what is parsed of a chunk is handed over at its end, so
+ *       a slow stream still shows up on the display.
+ *
+ * @param[in] input
+ */
+void DisplayWorker::parse(const std::string& input) {
+  std::shared_ptr<ITPX3Reader> reader = openTPX3Reader(input);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_reader = reader;
+  }
+  m_total_bytes = reader->getTotalSize();
+
+  unsigned long tdc_timestamp = 0;
+  unsigned long long gdc_timestamp = 0;
+  unsigned long timer_lsb32 = 0;
+  std::vector<char> raw, pending;
+  std::vector<TPX3> block;
+  block.reserve(m_options.batches_per_block);
+  const auto handOver = [&]() {
+    if (block.empty()) return true;
+    if (!m_blocks->push(std::move(block))) return false;
+    block.clear();
+    block.reserve(m_options.batches_per_block);
+    return true;
+  };
+
+  bool done = false;
+  while (!done && !m_stop) {
+    raw.assign(pending.begin(), pending.end());
+    const size_t appended = reader->readChunkInto(m_options.chunk_size, raw);
+    done = appended == 0 || reader->isEOF();
+
+    const size_t complete =
+        done ? raw.size() : findLastCompleteTPX3Batch(raw.data(), raw.size());
+    pending.assign(raw.begin() + complete, raw.end());
+    raw.resize(complete);
+
+    for (auto& batch : findTPX3H(raw)) {
+      if (m_options.use_gdc) {
+        updateTimestamp(batch, raw, tdc_timestamp, gdc_timestamp,
+                        timer_lsb32);
+        extractHits(batch, raw);
+      } else {
+        updateTimestamp(batch, raw, tdc_timestamp);
+        extractHitsTDC(batch, raw);
+      }
+      m_hits += batch.hits.size();
+      block.push_back(std::move(batch));
+      if (block.size() >= m_options.batches_per_block && !handOver()) return;
+    }
+    m_bytes_read += complete;
+    m_total_bytes = std::max<uint64_t>(m_total_bytes, reader->getTotalSize());
+    if (!handOver()) return;
+  }
+}
+
+/**
+ * @brief Clustering thread: neutrons of each block, added to the image.
+ */
+void DisplayWorker::cluster() {
+  ABS abs_alg(m_options.radius, m_options.min_cluster_size,
+              m_options.spider_time_range);
+  const double super_resolution = m_options.super_resolution;
+  const int size = static_cast<int>(m_image_size);
+  const bool rotate = m_options.rotation != 0.0;
+  const double cos_rotation = std::cos(m_options.rotation * M_PI / 180.0);
+  const double sin_rotation = std::sin(m_options.rotation * M_PI / 180.0);
+
+  std::vector<TPX3> block;
+  std::vector<size_t> pixels;
+  while (!m_stop && m_blocks->pop(block)) {
+    pixels.clear();
+    uint64_t neutrons = 0;
+    for (auto& batch : block) {
+      abs_alg.reset();
+      abs_alg.set_method(m_options.method);
+      abs_alg.fit(batch.hits);
+      batch.neutrons = abs_alg.get_events(batch.hits);
+      neutrons += batch.neutrons.size();
+
+      for (const auto& neutron : batch.neutrons) {
+        double fx = neutron.getX() * super_resolution;
+        double fy = neutron.getY() * super_resolution;
+        // NOTE: rotated per neutron, binned pixels would alias (moire)
+        if (rotate) {
+          const double rx = fx * cos_rotation - fy * sin_rotation;
+          fy = fx * sin_rotation + fy * cos_rotation;
+          fx = rx;
+        }
+        const int x = std::round(fx);
+        const int y = std::round(fy);
+        if (x >= 0 && x < size && y >= 0 && y < size) {
+          pixels.push_back(static_cast<size_t>(y) * size + x);
+        }
+      }
+      if (m_options.keep_neutrons) {
+        keepNeutrons(batch.neutrons);
+      }
+    }
+
+    // NOTE: the display only waits for this short update, not the clustering
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      for (const size_t pixel : pixels) ++m_image[pixel];
+      ++m_image_version;
+    }
+    m_neutron_count += neutrons;
+  }
+}
+
+/**
+ * @brief Keep the neutrons of a batch, up to max_kept_neutrons for the run.
+ *
+ * @param[in] neutrons
+ */
+void DisplayWorker::keepNeutrons(const std::vector<Neutron>& neutrons) {
+  const size_t room = m_options.max_kept_neutrons - m_neutrons.size();
+  if (neutrons.size() > room && room > 0) {
+    spdlog::warn("Display worker keeps the first {} neutrons only",
+                 m_options.max_kept_neutrons);
+  }
+  const size_t kept = std::min(neutrons.size(), room);
+  m_neutrons.insert(m_neutrons.end(), neutrons.begin(),
+                    neutrons.begin() + kept);
+}
+
+/**
+ * @brief Record the error and cancel the reduction, waking a parser blocked
+ * on an idle stream.
+ *
+ * @param[in] error
+ */
+void DisplayWorker::fail(std::exception_ptr error) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_error) m_error = error;
+  }
+  spdlog::error("Display worker stopped: {}", getError());
+  m_stop = true;
+  m_blocks->close();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_reader) m_reader->interrupt();
+}
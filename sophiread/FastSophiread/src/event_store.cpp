@@ -0,0 +1,434 @@
+/**
+ * @file event_store.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Append-only columnar event store with a sparse spidertime index
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include "event_store.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <iterator>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+
+#include "spdlog/spdlog.h"
+
+namespace {
+
+const char* const kFormatName = "sophiread-event-store";
+const int kFormatVersion = 1;
+
+struct ColumnSpec {
+  const char* name;
+  const char* file;
+  const char* type;
+  const char* units;
+  size_t element_size;
+};
+
+const ColumnSpec kColumns[] = {
+    {"x", "x.f32", "float32", "pixel", sizeof(float)},
+    {"y", "y.f32", "float32", "pixel", sizeof(float)},
+    {"tof", "tof.f32", "float32", "25 ns", sizeof(float)},
+    {"tot", "tot.f32", "float32", "25 ns", sizeof(float)},
+    {"nhits", "nhits.u16", "uint16", "", sizeof(uint16_t)},
+    {"spidertime", "spidertime.u64", "uint64", "25 ns", sizeof(uint64_t)},
+};
+
+/**
+ * @brief Read and check header.json of an event store.
+ *
+ * @param[in] directory
+ * @return nlohmann::json
+ */
+nlohmann::json readHeader(const std::filesystem::path& directory) {
+  std::ifstream file(directory / "header.json");
+  if (!file.is_open()) {
+    throw std::runtime_error("Cannot open event store header in " +
+                             directory.string());
+  }
+  const nlohmann::json header = nlohmann::json::parse(file);
+  if (header.value("format", "") != kFormatName ||
+      header.value("version", 0) != kFormatVersion) {
+    throw std::runtime_error("Unsupported event store format in " +
+                             directory.string());
+  }
+  return header;
+}
+
+/**
+ * @brief Read the first n_entries of index.bin.
+ *
+ * @param[in] directory
+ * @param[in] n_entries
+ * @return std::vector<EventStoreIndexEntry>
+ */
+std::vector<EventStoreIndexEntry> readIndex(
+    const std::filesystem::path& directory, size_t n_entries) {
+  std::vector<EventStoreIndexEntry> index(n_entries);
+  std::ifstream file(directory / "index.bin", std::ios::binary);
+  if (!file.read(reinterpret_cast<char*>(index.data()),
+                 n_entries * sizeof(EventStoreIndexEntry))) {
+    throw std::runtime_error("Truncated event store index in " +
+                             directory.string());
+  }
+  return index;
+}
+
+/**
+ * @brief Write a file next to its final location and rename it in place.
+ *
+ * @param[in] path
+ * @param[in] data
+ * @param[in] size
+ */
+void writeFileAtomically(const std::filesystem::path& path, const char* data,
+                         size_t size) {
+  const std::filesystem::path tmp = path.string() + ".tmp";
+  {
+    std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+    if (!file.write(data, size)) {
+      throw std::runtime_error("Failed to write " + tmp.string());
+    }
+  }
+  std::filesystem::rename(tmp, path);
+}
+
+}  // namespace
+
+/**
+ * @brief Open an event store for writing.
+ *
+ * @param[in] directory: created if missing
+ * @param[in] append: keep the events of an existing store
+ * @param[in] index_stride: events per index block (an existing store keeps
+ *                          its own stride)
+ */
+EventStoreWriter::EventStoreWriter(const std::string& directory, bool append,
+                                   uint64_t index_stride)
+    : m_directory(directory), m_index_stride(index_stride) {
+  if (m_index_stride == 0) {
+    throw std::invalid_argument("Event store index stride must be positive");
+  }
+  const std::filesystem::path dir(m_directory);
+  std::filesystem::create_directories(dir);
+
+  const bool resume = append && std::filesystem::exists(dir / "header.json");
+  if (resume) {
+    const nlohmann::json header = readHeader(dir);
+    m_events = header.at("events").get<uint64_t>();
+    m_index_stride = header.at("index_stride").get<uint64_t>();
+    m_index = readIndex(dir, (m_events + m_index_stride - 1) / m_index_stride);
+  }
+
+  // on resume, drop rows written after the last header update
+  openColumns(resume);
+  writeIndexAndHeader();
+}
+
+/**
+ * @brief Open every column file, cut to the current number of events.
+ *
+ * @param[in] keep: keep the first m_events rows, otherwise start empty
+ */
+void EventStoreWriter::openColumns(bool keep) {
+  const std::filesystem::path dir(m_directory);
+  std::ofstream* streams[] = {&m_x,   &m_y,     &m_tof,
+                              &m_tot, &m_nhits, &m_spidertime};
+  for (size_t i = 0; i < std::size(kColumns); ++i) {
+    const std::filesystem::path path = dir / kColumns[i].file;
+    if (streams[i]->is_open()) streams[i]->close();
+    if (keep) {
+      std::filesystem::resize_file(path, m_events * kColumns[i].element_size);
+      streams[i]->open(path, std::ios::binary | std::ios::app);
+    } else {
+      streams[i]->open(path, std::ios::binary | std::ios::trunc);
+    }
+    if (!streams[i]->is_open()) {
+      throw std::runtime_error("Cannot open event store column " +
+                               path.string());
+    }
+  }
+}
+
+EventStoreWriter::~EventStoreWriter() {
+  try {
+    close();
+  } catch (const std::exception& e) {
+    spdlog::error("Failed to close event store {}: {}", m_directory,
+                  e.what());
+  }
+}
+
+/**
+ * @brief Append neutrons to every column and update the index.
+ *
+ * @param[in] neutrons
+ */
+void EventStoreWriter::append(const std::vector<Neutron>& neutrons) {
+  if (m_closed) {
+    throw std::runtime_error("Event store is closed: " + m_directory);
+  }
+  if (neutrons.empty()) return;
+
+  const size_t n = neutrons.size();
+  std::vector<float> x(n), y(n), tof(n), tot(n);
+  std::vector<uint16_t> nhits(n);
+  std::vector<uint64_t> spidertime(n);
+  for (size_t i = 0; i < n; ++i) {
+    const auto& neutron = neutrons[i];
+    x[i] = static_cast<float>(neutron.getX());
+    y[i] = static_cast<float>(neutron.getY());
+    tof[i] = static_cast<float>(neutron.getTOF());
+    tot[i] = static_cast<float>(neutron.getTOT());
+    nhits[i] = static_cast<uint16_t>(
+        std::min(neutron.getNHits(), int(UINT16_MAX)));
+    spidertime[i] = neutron.getSPIDERTIME();
+
+    const uint64_t row = m_events + i;
+    if (row % m_index_stride == 0) {
+      m_index.push_back({row, spidertime[i], spidertime[i]});
+    } else {
+      auto& block = m_index.back();
+      block.min_spidertime = std::min(block.min_spidertime, spidertime[i]);
+      block.max_spidertime = std::max(block.max_spidertime, spidertime[i]);
+    }
+  }
+
+  m_x.write(reinterpret_cast<const char*>(x.data()), n * sizeof(float));
+  m_y.write(reinterpret_cast<const char*>(y.data()), n * sizeof(float));
+  m_tof.write(reinterpret_cast<const char*>(tof.data()), n * sizeof(float));
+  m_tot.write(reinterpret_cast<const char*>(tot.data()), n * sizeof(float));
+  m_nhits.write(reinterpret_cast<const char*>(nhits.data()),
+                n * sizeof(uint16_t));
+  m_spidertime.write(reinterpret_cast<const char*>(spidertime.data()),
+                     n * sizeof(uint64_t));
+  if (!m_x || !m_y || !m_tof || !m_tot || !m_nhits || !m_spidertime) {
+    throw std::runtime_error("Failed to write event store columns in " +
+                             m_directory);
+  }
+  m_events += n;
+}
+
+/**
+ * @brief Make the appended events visible to readers.
+ *
+ * The columns are flushed before the header, so the event count in the
+ * header never covers rows that are not on disk yet.
+ */
+void EventStoreWriter::flush() {
+  if (m_closed) return;
+  for (auto* stream : {&m_x, &m_y, &m_tof, &m_tot, &m_nhits, &m_spidertime}) {
+    stream->flush();
+  }
+  writeIndexAndHeader();
+}
+
+/**
+ * @brief Drop the events past the first ones, e.g. to resume a run from a
+ * checkpoint taken before the last flush.
+ *
+ * @param[in] events: number of events to keep
+ */
+void EventStoreWriter::truncate(uint64_t events) {
+  if (m_closed) {
+    throw std::runtime_error("Event store is closed: " + m_directory);
+  }
+  if (events > m_events) {
+    throw std::out_of_range("Event store " + m_directory + " has " +
+                            std::to_string(m_events) + " events, cannot keep " +
+                            std::to_string(events));
+  }
+  for (auto* stream : {&m_x, &m_y, &m_tof, &m_tot, &m_nhits, &m_spidertime}) {
+    stream->flush();
+  }
+  m_events = events;
+  openColumns(true);
+
+  // the last block may have lost rows, recompute its time range
+  m_index.resize((m_events + m_index_stride - 1) / m_index_stride);
+  if (!m_index.empty()) {
+    auto& block = m_index.back();
+    std::vector<uint64_t> spidertime(m_events - block.first_row);
+    std::ifstream file(std::filesystem::path(m_directory) / "spidertime.u64",
+                       std::ios::binary);
+    file.seekg(block.first_row * sizeof(uint64_t));
+    if (!file.read(reinterpret_cast<char*>(spidertime.data()),
+                   spidertime.size() * sizeof(uint64_t))) {
+      throw std::runtime_error("Truncated event store column in " +
+                               m_directory);
+    }
+    block.min_spidertime =
+        *std::min_element(spidertime.begin(), spidertime.end());
+    block.max_spidertime =
+        *std::max_element(spidertime.begin(), spidertime.end());
+  }
+  writeIndexAndHeader();
+}
+
+/**
+ * @brief Flush and close the columns.
+ */
+void EventStoreWriter::close() {
+  if (m_closed) return;
+  flush();
+  for (auto* stream : {&m_x, &m_y, &m_tof, &m_tot, &m_nhits, &m_spidertime}) {
+    stream->close();
+  }
+  m_closed = true;
+}
+
+/**
+ * @brief Rewrite index.bin and header.json.
+ */
+void EventStoreWriter::writeIndexAndHeader() {
+  const std::filesystem::path dir(m_directory);
+  writeFileAtomically(dir / "index.bin",
+                      reinterpret_cast<const char*>(m_index.data()),
+                      m_index.size() * sizeof(EventStoreIndexEntry));
+
+  nlohmann::json header;
+  header["format"] = kFormatName;
+  header["version"] = kFormatVersion;
+  header["events"] = m_events;
+  header["index_stride"] = m_index_stride;
+  header["columns"] = nlohmann::json::array();
+  for (const auto& column : kColumns) {
+    header["columns"].push_back({{"name", column.name},
+                                 {"file", column.file},
+                                 {"type", column.type},
+                                 {"units", column.units}});
+  }
+  const std::string text = header.dump(2);
+  writeFileAtomically(dir / "header.json", text.data(), text.size());
+}
+
+/**
+ * @brief Open and memory-map an event store.
+ *
+ * @param[in] directory
+ */
+EventStoreReader::EventStoreReader(const std::string& directory)
+    : m_directory(directory) {
+  const std::filesystem::path dir(m_directory);
+  const nlohmann::json header = readHeader(dir);
+  m_events = header.at("events").get<uint64_t>();
+  m_index_stride = header.at("index_stride").get<uint64_t>();
+  if (m_index_stride == 0) {
+    throw std::runtime_error("Invalid event store index stride in " +
+                             m_directory);
+  }
+  m_index = readIndex(dir, (m_events + m_index_stride - 1) / m_index_stride);
+
+  try {
+    m_x = static_cast<const float*>(mapColumn("x.f32", sizeof(float)));
+    m_y = static_cast<const float*>(mapColumn("y.f32", sizeof(float)));
+    m_tof = static_cast<const float*>(mapColumn("tof.f32", sizeof(float)));
+    m_tot = static_cast<const float*>(mapColumn("tot.f32", sizeof(float)));
+    m_nhits =
+        static_cast<const uint16_t*>(mapColumn("nhits.u16", sizeof(uint16_t)));
+    m_spidertime = static_cast<const uint64_t*>(
+        mapColumn("spidertime.u64", sizeof(uint64_t)));
+  } catch (...) {
+    for (const auto& [address, length] : m_maps) munmap(address, length);
+    throw;
+  }
+}
+
+EventStoreReader::~EventStoreReader() {
+  for (const auto& [address, length] : m_maps) {
+    munmap(address, length);
+  }
+}
+
+/**
+ * @brief Map the valid rows of one column read-only.
+ *
+ * @param[in] name: column file name
+ * @param[in] element_size
+ * @return const void*: nullptr for an empty store
+ */
+const void* EventStoreReader::mapColumn(const std::string& name,
+                                        size_t element_size) {
+  const size_t length = m_events * element_size;
+  if (length == 0) return nullptr;
+
+  const std::string path = (std::filesystem::path(m_directory) / name).string();
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    throw std::runtime_error("Cannot open event store column " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < length) {
+    ::close(fd);
+    throw std::runtime_error("Truncated event store column " + path);
+  }
+  void* address = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);  // the mapping keeps the file alive
+  if (address == MAP_FAILED) {
+    throw std::runtime_error("Failed to mmap event store column " + path);
+  }
+  madvise(address, length, MADV_SEQUENTIAL);
+  m_maps.emplace_back(address, length);
+  return address;
+}
+
+/**
+ * @brief Find the rows whose index block overlaps a spidertime window.
+ *
+ * Adjacent blocks are merged into one range.
+ *
+ * @param[in] begin_spidertime: inclusive
+ * @param[in] end_spidertime: exclusive
+ * @return std::vector<std::pair<uint64_t, uint64_t>>
+ */
+std::vector<std::pair<uint64_t, uint64_t>> EventStoreReader::findRows(
+    uint64_t begin_spidertime, uint64_t end_spidertime) const {
+  std::vector<std::pair<uint64_t, uint64_t>> ranges;
+  for (size_t i = 0; i < m_index.size(); ++i) {
+    const auto& block = m_index[i];
+    if (block.max_spidertime < begin_spidertime ||
+        block.min_spidertime >= end_spidertime) {
+      continue;
+    }
+    const uint64_t last =
+        i + 1 < m_index.size() ? m_index[i + 1].first_row : m_events;
+    if (!ranges.empty() && ranges.back().second == block.first_row) {
+      ranges.back().second = last;
+    } else {
+      ranges.emplace_back(block.first_row, last);
+    }
+  }
+  return ranges;
+}
+
+/**
+ * @brief Copy a range of rows out as neutrons.
+ *
+ * @param[in] first_row
+ * @param[in] last_row: exclusive, clamped to the number of events
+ * @return std::vector<Neutron>
+ */
+std::vector<Neutron> EventStoreReader::readNeutrons(uint64_t first_row,
+                                                    uint64_t last_row) const {
+  last_row = std::min(last_row, m_events);
+  std::vector<Neutron> neutrons;
+  if (first_row >= last_row) return neutrons;
+
+  neutrons.reserve(last_row - first_row);
+  for (uint64_t row = first_row; row < last_row; ++row) {
+    neutrons.emplace_back(m_x[row], m_y[row], m_tof[row], m_tot[row],
+                          m_nhits[row], m_spidertime[row]);
+  }
+  return neutrons;
+}
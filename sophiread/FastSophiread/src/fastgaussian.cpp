@@ -16,6 +16,7 @@
 
 #include <Eigen/Dense>
 #include <algorithm>
+#include <climits>
 #include <numeric>
 
 /**
@@ -61,11 +62,13 @@ Neutron FastGaussian::fit(const std::vector<Hit>& data) {
   tof.reserve(data.size());
   std::vector<double> tot;
   tot.reserve(data.size());
+  unsigned long long spidertime = ULLONG_MAX;
   for (const auto& hit : data) {
     x.push_back((double)m_super_resolution_factor * hit.getX());
     y.push_back((double)m_super_resolution_factor * hit.getY());
     tof.push_back((double)hit.getTOF());
     tot.push_back((double)hit.getTOT());
+    spidertime = std::min(spidertime, hit.getSPIDERTIME());
   }
 
   // calculate the median of tot
@@ -123,5 +126,6 @@ Neutron FastGaussian::fit(const std::vector<Hit>& data) {
 
   // even if we are throwing away to bottom half, we still need to return the
   // pre-filtered number of hits
-  return Neutron(x_event, y_event, tof_event, tot_event, tof.size());
+  return Neutron(x_event, y_event, tof_event, tot_event, tof.size(),
+                 spidertime);
 }
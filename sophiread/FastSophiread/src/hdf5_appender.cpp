@@ -0,0 +1,670 @@
+/**
+ * @file hdf5_appender.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Buffered column appender writing large compressed HDF5 chunks
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include "hdf5_appender.h"
+
+#include <tbb/tbb.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "spdlog/spdlog.h"
+
+#ifdef SOPHIREAD_HAS_ZSTD
+#include <zstd.h>
+#endif
+#ifdef SOPHIREAD_HAS_LZ4
+#include <lz4.h>
+#endif
+
+namespace {
+
+/**
+ * @brief HDF5 byte shuffle: byte i of every element is stored contiguously.
+ *
+ * @param[in] src: raw chunk
+ * @param[in] nbytes: size of the chunk in bytes
+ * @param[in] element_size: size of one element in bytes
+ * @return std::vector<char>
+ */
+std::vector<char> shuffleBytes(const char* src, size_t nbytes,
+                               size_t element_size) {
+  std::vector<char> dst(nbytes);
+  const size_t n_elements = nbytes / element_size;
+  for (size_t byte = 0; byte < element_size; ++byte) {
+    char* out = dst.data() + byte * n_elements;
+    for (size_t i = 0; i < n_elements; ++i) {
+      out[i] = src[i * element_size + byte];
+    }
+  }
+  return dst;
+}
+
+/**
+ * @brief Compress a chunk the way the HDF5 deflate filter expects (zlib).
+ */
+std::vector<char> deflateChunk(const std::vector<char>& src, int level) {
+  uLongf nbytes = compressBound(src.size());
+  std::vector<char> dst(nbytes);
+  if (compress2(reinterpret_cast<Bytef*>(dst.data()), &nbytes,
+                reinterpret_cast<const Bytef*>(src.data()), src.size(),
+                std::clamp(level, 0, 9)) != Z_OK) {
+    throw std::runtime_error("zlib compression of HDF5 chunk failed");
+  }
+  dst.resize(nbytes);
+  return dst;
+}
+
+#ifdef SOPHIREAD_HAS_ZSTD
+/**
+ * @brief Compress a chunk for the HDF5 zstd filter (one zstd frame).
+ */
+std::vector<char> zstdChunk(const std::vector<char>& src, int level) {
+  std::vector<char> dst(ZSTD_compressBound(src.size()));
+  const size_t nbytes =
+      ZSTD_compress(dst.data(), dst.size(), src.data(), src.size(), level);
+  if (ZSTD_isError(nbytes)) {
+    throw std::runtime_error(std::string("zstd compression failed: ") +
+                             ZSTD_getErrorName(nbytes));
+  }
+  dst.resize(nbytes);
+  return dst;
+}
+#endif
+
+#ifdef SOPHIREAD_HAS_LZ4
+/**
+ * @brief Write a big endian integer, as used by the HDF5 lz4 filter framing.
+ */
+template <typename T>
+void putBigEndian(char* dst, T value) {
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    dst[i] = static_cast<char>((value >> (8 * (sizeof(T) - 1 - i))) & 0xFF);
+  }
+}
+
+/**
+ * @brief Compress a chunk for the HDF5 lz4 filter.
+ *
+ * Layout: original size (8 bytes), block size (4 bytes), then for each block
+ * its compressed size (4 bytes) and data; incompressible blocks are stored
+ * as is with compressed size == block size.
+ */
+std::vector<char> lz4Chunk(const std::vector<char>& src) {
+  const uint32_t block_size = static_cast<uint32_t>(
+      std::min<size_t>(src.size(), size_t(1) << 30));
+  const size_t n_blocks = (src.size() + block_size - 1) / block_size;
+  std::vector<char> dst(12 + n_blocks * (4 + LZ4_compressBound(block_size)));
+
+  putBigEndian<uint64_t>(dst.data(), src.size());
+  putBigEndian<uint32_t>(dst.data() + 8, block_size);
+  size_t out = 12;
+  for (size_t offset = 0; offset < src.size(); offset += block_size) {
+    const int in_bytes =
+        static_cast<int>(std::min<size_t>(block_size, src.size() - offset));
+    int nbytes = LZ4_compress_default(src.data() + offset, dst.data() + out + 4,
+                                      in_bytes, LZ4_compressBound(in_bytes));
+    if (nbytes <= 0 || nbytes >= in_bytes) {
+      std::memcpy(dst.data() + out + 4, src.data() + offset, in_bytes);
+      nbytes = in_bytes;
+    }
+    putBigEndian<uint32_t>(dst.data() + out, static_cast<uint32_t>(nbytes));
+    out += 4 + nbytes;
+  }
+  dst.resize(out);
+  return dst;
+}
+#endif
+
+/**
+ * @brief Compression actually available in this build.
+ */
+H5Compression resolveCompression(H5Compression compression) {
+#ifndef SOPHIREAD_HAS_ZSTD
+  if (compression == H5Compression::zstd) {
+    spdlog::warn("Built without zstd, HDF5 appender uses deflate");
+    return H5Compression::deflate;
+  }
+#endif
+#ifndef SOPHIREAD_HAS_LZ4
+  if (compression == H5Compression::lz4) {
+    spdlog::warn("Built without lz4, HDF5 appender uses deflate");
+    return H5Compression::deflate;
+  }
+#endif
+  return compression;
+}
+
+}  // namespace
+
+/**
+ * @brief Construct a new HDF5ColumnAppender on an open group.
+ *
+ * @param[in] group: group receiving the datasets
+ * @param[in] options: chunking and compression
+ */
+HDF5ColumnAppender::HDF5ColumnAppender(const H5::Group& group,
+                                       const HDF5AppenderOptions& options)
+    : m_group(group), m_options(options) {
+  if (m_options.chunk_rows == 0) {
+    throw std::invalid_argument("HDF5ColumnAppender: chunk_rows must be > 0");
+  }
+  m_options.compression = resolveCompression(m_options.compression);
+}
+
+/**
+ * @brief Write the remaining rows, errors are only logged.
+ */
+HDF5ColumnAppender::~HDF5ColumnAppender() {
+  try {
+    close();
+  } catch (const std::exception& e) {
+    spdlog::error("Failed to close HDF5 appender: {}", e.what());
+  }
+}
+
+/**
+ * @brief Create an empty, chunked and filtered dataset for a new column.
+ *
+ * @param[in] name: dataset name
+ * @param[in] type: HDF5 type of the elements
+ * @param[in] units: value of the "units" attribute, skipped if empty
+ * @param[in] scale_to_ns: value of the "scale_to_ns" attribute, skipped if 0
+ * @return index of the column
+ */
+size_t HDF5ColumnAppender::addColumn(const std::string& name,
+                                     const H5::PredType& type,
+                                     const std::string& units,
+                                     double scale_to_ns) {
+  if (m_rows > 0) {
+    throw std::logic_error("HDF5ColumnAppender: add columns before appending");
+  }
+
+  hsize_t dims[1] = {0};
+  hsize_t maxdims[1] = {H5S_UNLIMITED};
+  hsize_t chunkdims[1] = {m_options.chunk_rows};
+  H5::DataSpace dataspace(1, dims, maxdims);
+
+  H5::DSetCreatPropList propList;
+  propList.setChunk(1, chunkdims);
+  // the chunks are filtered by us, HDF5 only needs the pipeline description
+  if (m_options.compression != H5Compression::none) {
+    if (m_options.shuffle) propList.setShuffle();
+    switch (m_options.compression) {
+      case H5Compression::deflate:
+        propList.setDeflate(std::clamp(m_options.level, 0, 9));
+        break;
+      case H5Compression::zstd: {
+        const unsigned int cd_values[1] = {
+            static_cast<unsigned int>(m_options.level)};
+        H5Pset_filter(propList.getId(), H5Z_FILTER_ZSTD_PLUGIN,
+                      H5Z_FLAG_OPTIONAL, 1, cd_values);
+      } break;
+      case H5Compression::lz4:
+        H5Pset_filter(propList.getId(), H5Z_FILTER_LZ4_PLUGIN,
+                      H5Z_FLAG_OPTIONAL, 0, nullptr);
+        break;
+      default:
+        break;
+    }
+  }
+
+  Column column;
+  column.dataset = m_group.createDataSet(name, type, dataspace, propList);
+  column.element_size = type.getSize();
+  column.buffer.reserve(m_options.chunk_rows * column.element_size);
+  m_columns.push_back(std::move(column));
+
+  if (!units.empty()) {
+    setDatasetUnits(m_group, name, units, scale_to_ns);
+  }
+  return m_columns.size() - 1;
+}
+
+/**
+ * @brief Reopen an existing column and drop its rows past the given one.
+ *
+ * The rows of the last, partial chunk are read back into the buffer, so the
+ * chunk is rewritten whole once more rows arrive. The dataset must have been
+ * written with the same chunk rows and compression.
+ *
+ * @param[in] name: dataset name
+ * @param[in] type: HDF5 type of the elements
+ * @param[in] rows: number of rows to keep
+ * @return index of the column
+ */
+size_t HDF5ColumnAppender::openColumn(const std::string& name,
+                                      const H5::PredType& type, size_t rows) {
+  if (!m_columns.empty() && rows != m_rows) {
+    throw std::logic_error("HDF5ColumnAppender: columns differ in length");
+  }
+
+  Column column;
+  column.dataset = m_group.openDataSet(name);
+  column.element_size = type.getSize();
+  if (!(column.dataset.getDataType() == type)) {
+    throw std::runtime_error("HDF5ColumnAppender: type mismatch for " + name);
+  }
+
+  H5::DSetCreatPropList propList = column.dataset.getCreatePlist();
+  hsize_t chunkdims[1] = {0};
+  if (propList.getLayout() != H5D_CHUNKED ||
+      propList.getChunk(1, chunkdims) != 1 ||
+      chunkdims[0] != m_options.chunk_rows) {
+    throw std::runtime_error("HDF5ColumnAppender: chunk rows mismatch for " +
+                             name);
+  }
+  if ((propList.getNfilters() > 0) !=
+      (m_options.compression != H5Compression::none)) {
+    throw std::runtime_error("HDF5ColumnAppender: compression mismatch for " +
+                             name);
+  }
+
+  hsize_t current_size[1] = {0};
+  column.dataset.getSpace().getSimpleExtentDims(current_size);
+  if (current_size[0] < rows) {
+    throw std::runtime_error("HDF5ColumnAppender: " + name + " has " +
+                             std::to_string(current_size[0]) +
+                             " rows, expected at least " +
+                             std::to_string(rows));
+  }
+  const hsize_t new_size[1] = {rows};
+  column.dataset.extend(new_size);
+
+  // read back the partial chunk
+  const size_t chunk_rows = m_options.chunk_rows;
+  const size_t written_rows = rows / chunk_rows * chunk_rows;
+  column.buffer.reserve(chunk_rows * column.element_size);
+  column.buffer.resize((rows - written_rows) * column.element_size);
+  if (rows > written_rows) {
+    const hsize_t offset[1] = {written_rows};
+    const hsize_t count[1] = {rows - written_rows};
+    H5::DataSpace filespace = column.dataset.getSpace();
+    filespace.selectHyperslab(H5S_SELECT_SET, count, offset);
+    H5::DataSpace memspace(1, count);
+    column.dataset.read(column.buffer.data(), type, memspace, filespace);
+  }
+  m_columns.push_back(std::move(column));
+
+  m_rows = rows;
+  m_written_rows = written_rows;
+  return m_columns.size() - 1;
+}
+
+/**
+ * @brief Buffer rows, writing every chunk that becomes full.
+ *
+ * @param[in] columns: one pointer per column
+ * @param[in] rows: number of rows behind each pointer
+ */
+void HDF5ColumnAppender::append(const std::vector<const void*>& columns,
+                                size_t rows) {
+  if (m_closed) {
+    throw std::logic_error("HDF5ColumnAppender: append after close");
+  }
+  if (columns.size() != m_columns.size()) {
+    throw std::invalid_argument(
+        "HDF5ColumnAppender: expected one pointer per column");
+  }
+  if (rows == 0) return;
+
+  for (size_t i = 0; i < columns.size(); ++i) {
+    const char* src = static_cast<const char*>(columns[i]);
+    auto& buffer = m_columns[i].buffer;
+    buffer.insert(buffer.end(), src, src + rows * m_columns[i].element_size);
+  }
+  m_rows += rows;
+
+  const size_t n_chunks = (m_rows - m_written_rows) / m_options.chunk_rows;
+  if (n_chunks > 0) {
+    writeChunks(n_chunks, false);
+  }
+}
+
+/**
+ * @brief Write the last, partial chunk and release the datasets.
+ */
+void HDF5ColumnAppender::close() {
+  if (m_closed) return;
+  m_closed = true;
+
+  if (m_rows > m_written_rows) {
+    writeChunks(1, true);
+  }
+  for (auto& column : m_columns) {
+    column.dataset.close();
+    std::vector<char>().swap(column.buffer);
+  }
+}
+
+/**
+ * @brief Make every appended row visible to readers.
+ *
+ * The buffered partial chunk is written padded but kept in memory, it is
+ * written again once more rows arrive. The datasets are then flushed, which
+ * is what SWMR readers need to see the new extent.
+ */
+void HDF5ColumnAppender::flush() {
+  if (m_closed) return;
+
+  if (m_rows > m_written_rows) {
+    writeChunks(1, true, false);
+  }
+  for (auto& column : m_columns) {
+    if (H5Dflush(column.dataset.getId()) < 0) {
+      throw std::runtime_error("H5Dflush failed");
+    }
+  }
+}
+
+/**
+ * @brief Filter the first n_chunks buffered chunks of every column in
+ * parallel, then write them with direct chunk writes.
+ *
+ * @param[in] n_chunks: number of chunks to write
+ * @param[in] pad_last: the last chunk is partial and padded with zeros
+ * @param[in] consume: drop the written rows from the buffers
+ */
+void HDF5ColumnAppender::writeChunks(size_t n_chunks, bool pad_last,
+                                     bool consume) {
+  const size_t chunk_rows = m_options.chunk_rows;
+  const size_t n_rows =
+      pad_last ? m_rows - m_written_rows : n_chunks * chunk_rows;
+  const size_t n_columns = m_columns.size();
+  std::vector<std::vector<char>> filtered(n_columns * n_chunks);
+
+  // 1. shuffle and compress on the worker threads
+  tbb::parallel_for(size_t(0), filtered.size(), [&](size_t task) {
+    const Column& column = m_columns[task / n_chunks];
+    const size_t chunk = task % n_chunks;
+    const size_t chunk_bytes = chunk_rows * column.element_size;
+
+    std::vector<char> raw(chunk_bytes, 0);
+    const size_t begin = chunk * chunk_bytes;
+    const size_t end =
+        std::min(begin + chunk_bytes, n_rows * column.element_size);
+    std::copy(column.buffer.begin() + begin, column.buffer.begin() + end,
+              raw.begin());
+
+    if (m_options.compression == H5Compression::none) {
+      filtered[task] = std::move(raw);
+      return;
+    }
+    if (m_options.shuffle && column.element_size > 1) {
+      raw = shuffleBytes(raw.data(), raw.size(), column.element_size);
+    }
+    switch (m_options.compression) {
+#ifdef SOPHIREAD_HAS_ZSTD
+      case H5Compression::zstd:
+        filtered[task] = zstdChunk(raw, m_options.level);
+        break;
+#endif
+#ifdef SOPHIREAD_HAS_LZ4
+      case H5Compression::lz4:
+        filtered[task] = lz4Chunk(raw);
+        break;
+#endif
+      default:
+        filtered[task] = deflateChunk(raw, m_options.level);
+        break;
+    }
+  });
+
+  // 2. grow the datasets and hand over the chunks (HDF5 is single threaded)
+  const hsize_t new_size[1] = {m_written_rows + n_rows};
+  for (size_t col = 0; col < n_columns; ++col) {
+    H5::DataSet& dataset = m_columns[col].dataset;
+    hsize_t current_size[1] = {0};
+    dataset.getSpace().getSimpleExtentDims(current_size);
+    if (current_size[0] != new_size[0]) {
+      dataset.extend(new_size);
+    }
+    for (size_t chunk = 0; chunk < n_chunks; ++chunk) {
+      const hsize_t offset[1] = {m_written_rows + chunk * chunk_rows};
+      const auto& data = filtered[col * n_chunks + chunk];
+      if (H5Dwrite_chunk(dataset.getId(), H5P_DEFAULT, 0, offset, data.size(),
+                         data.data()) < 0) {
+        throw std::runtime_error("H5Dwrite_chunk failed");
+      }
+    }
+  }
+
+  // 3. drop the written rows from the buffers
+  if (!consume) return;
+  for (auto& column : m_columns) {
+    const size_t nbytes =
+        std::min(column.buffer.size(), n_rows * column.element_size);
+    column.buffer.erase(column.buffer.begin(), column.buffer.begin() + nbytes);
+  }
+  m_written_rows += n_rows;
+  spdlog::debug("HDF5 appender wrote {} chunks, {} rows in total", n_chunks,
+                m_written_rows);
+}
+
+/**
+ * @brief Construct a new HitsHDF5Appender, creating the "hits" datasets.
+ *
+ * @param[in] file: HDF5 file
+ * @param[in] schema: layout of the datasets
+ * @param[in] options: chunking and compression
+ * @param[in] resume_rows: reopen the datasets and keep that many rows
+ */
+HitsHDF5Appender::HitsHDF5Appender(H5::H5File& file, HDF5Schema schema,
+                                   const HDF5AppenderOptions& options,
+                                   std::optional<size_t> resume_rows)
+    : m_schema(schema),
+      m_appender(openOrCreateGroup(file, "hits", schema), options) {
+  auto add = [&](const char* name, const H5::PredType& type,
+                 const std::string& units = "", double scale_to_ns = 0) {
+    if (resume_rows) {
+      m_appender.openColumn(name, type, *resume_rows);
+    } else {
+      m_appender.addColumn(name, type, units, scale_to_ns);
+    }
+  };
+  if (m_schema == HDF5Schema::compact) {
+    add("x", H5::PredType::NATIVE_UINT16, "pixel");
+    add("y", H5::PredType::NATIVE_UINT16, "pixel");
+    add("tot", H5::PredType::NATIVE_UINT16, "25 ns", 25.0);
+    add("toa", H5::PredType::NATIVE_UINT16, "25 ns", 25.0);
+    add("ftoa", H5::PredType::NATIVE_UINT8, "1.5625 ns", 25.0 / 16.0);
+    add("tof", H5::PredType::NATIVE_UINT32, "25 ns", 25.0);
+    add("spidertime", H5::PredType::NATIVE_UINT64, "25 ns", 25.0);
+  } else {
+    for (const auto name : {"x", "y", "tot_ns", "toa_ns", "ftoa_ns", "tof_ns",
+                            "spidertime_ns"}) {
+      add(name, H5::PredType::NATIVE_DOUBLE);
+    }
+  }
+}
+
+/**
+ * @brief Append hits, see appendHitsToHDF5Extendible for the layouts.
+ *
+ * @param[in] hits
+ */
+void HitsHDF5Appender::append(const std::vector<Hit>& hits) {
+  if (hits.empty()) return;
+
+  if (m_schema == HDF5Schema::compact) {
+    std::vector<uint16_t> x(hits.size()), y(hits.size()), tot(hits.size()),
+        toa(hits.size());
+    std::vector<uint8_t> ftoa(hits.size());
+    std::vector<uint32_t> tof(hits.size());
+    std::vector<uint64_t> spidertime(hits.size());
+    for (size_t i = 0; i < hits.size(); ++i) {
+      x[i] = static_cast<uint16_t>(hits[i].getX());
+      y[i] = static_cast<uint16_t>(hits[i].getY());
+      tot[i] = static_cast<uint16_t>(hits[i].getTOT());
+      toa[i] = static_cast<uint16_t>(hits[i].getTOA());
+      ftoa[i] = static_cast<uint8_t>(hits[i].getFTOA());
+      tof[i] = hits[i].getTOF();
+      spidertime[i] = hits[i].getSPIDERTIME();
+    }
+    m_appender.append({x.data(), y.data(), tot.data(), toa.data(), ftoa.data(),
+                       tof.data(), spidertime.data()},
+                      hits.size());
+    return;
+  }
+
+  std::vector<double> x(hits.size()), y(hits.size()), tot(hits.size()),
+      toa(hits.size()), ftoa(hits.size()), tof(hits.size()),
+      spidertime(hits.size());
+  for (size_t i = 0; i < hits.size(); ++i) {
+    x[i] = static_cast<double>(hits[i].getX());
+    y[i] = static_cast<double>(hits[i].getY());
+    tot[i] = hits[i].getTOT_ns();
+    toa[i] = hits[i].getTOA_ns();
+    ftoa[i] = hits[i].getFTOA_ns();
+    tof[i] = hits[i].getTOF_ns();
+    spidertime[i] = hits[i].getSPIDERTIME_ns();
+  }
+  m_appender.append({x.data(), y.data(), tot.data(), toa.data(), ftoa.data(),
+                     tof.data(), spidertime.data()},
+                    hits.size());
+}
+
+/**
+ * @brief Construct a new NeutronsHDF5Appender, creating the "neutrons"
+ * datasets.
+ *
+ * @param[in] file: HDF5 file
+ * @param[in] schema: layout of the datasets
+ * @param[in] options: chunking and compression
+ * @param[in] resume_rows: reopen the datasets and keep that many rows
+ */
+NeutronsHDF5Appender::NeutronsHDF5Appender(H5::H5File& file, HDF5Schema schema,
+                                           const HDF5AppenderOptions& options,
+                                           std::optional<size_t> resume_rows)
+    : m_schema(schema),
+      m_appender(openOrCreateGroup(file, "neutrons", schema), options) {
+  auto add = [&](const char* name, const H5::PredType& type,
+                 const std::string& units = "", double scale_to_ns = 0) {
+    if (resume_rows) {
+      m_appender.openColumn(name, type, *resume_rows);
+    } else {
+      m_appender.addColumn(name, type, units, scale_to_ns);
+    }
+  };
+  if (m_schema == HDF5Schema::compact) {
+    add("x", H5::PredType::NATIVE_FLOAT, "pixel");
+    add("y", H5::PredType::NATIVE_FLOAT, "pixel");
+    add("tof", H5::PredType::NATIVE_FLOAT, "25 ns", 25.0);
+    add("tot", H5::PredType::NATIVE_FLOAT, "25 ns", 25.0);
+    add("nHits", H5::PredType::NATIVE_UINT16, "count");
+  } else {
+    for (const auto name : {"x", "y", "tof_ns", "tot_ns", "nHits"}) {
+      add(name, H5::PredType::NATIVE_DOUBLE);
+    }
+  }
+}
+
+/**
+ * @brief Append neutrons, see appendNeutronsToHDF5Extendible for the layouts.
+ *
+ * @param[in] neutrons
+ */
+void NeutronsHDF5Appender::append(const std::vector<Neutron>& neutrons) {
+  if (neutrons.empty()) return;
+
+  if (m_schema == HDF5Schema::compact) {
+    std::vector<float> x(neutrons.size()), y(neutrons.size()),
+        tof(neutrons.size()), tot(neutrons.size());
+    std::vector<uint16_t> nHits(neutrons.size());
+    for (size_t i = 0; i < neutrons.size(); ++i) {
+      x[i] = static_cast<float>(neutrons[i].getX());
+      y[i] = static_cast<float>(neutrons[i].getY());
+      tof[i] = static_cast<float>(neutrons[i].getTOF());
+      tot[i] = static_cast<float>(neutrons[i].getTOT());
+      nHits[i] = static_cast<uint16_t>(
+          std::min(neutrons[i].getNHits(), int(UINT16_MAX)));
+    }
+    m_appender.append({x.data(), y.data(), tof.data(), tot.data(), nHits.data()},
+                      neutrons.size());
+    return;
+  }
+
+  std::vector<double> x(neutrons.size()), y(neutrons.size()),
+      tof(neutrons.size()), tot(neutrons.size()), nHits(neutrons.size());
+  for (size_t i = 0; i < neutrons.size(); ++i) {
+    x[i] = neutrons[i].getX();
+    y[i] = neutrons[i].getY();
+    tof[i] = neutrons[i].getTOF_ns();
+    tot[i] = neutrons[i].getTOT_ns();
+    nHits[i] = static_cast<double>(neutrons[i].getNHits());
+  }
+  m_appender.append({x.data(), y.data(), tof.data(), tot.data(), nHits.data()},
+                    neutrons.size());
+}
+
+/**
+ * @brief Create (truncate) a HDF5 file, ready for SWMR writing if requested.
+ *
+ * SWMR needs the latest file format; call startSWMRWrite once every dataset
+ * and attribute has been created.
+ *
+ * @param[in] filename
+ * @param[in] swmr
+ * @return H5::H5File
+ */
+H5::H5File createHDF5File(const std::string& filename, bool swmr) {
+  H5::FileAccPropList accessList;
+  if (swmr) {
+    accessList.setLibverBounds(H5F_LIBVER_LATEST, H5F_LIBVER_LATEST);
+  }
+  return H5::H5File(filename, H5F_ACC_TRUNC, H5::FileCreatPropList::DEFAULT,
+                    accessList);
+}
+
+/**
+ * @brief Open an existing HDF5 file for writing, e.g. to resume a run.
+ *
+ * NOTE: a writer that did not close its file can leave the end of allocation
+ *       short of chunks it flushed, and a SWMR file marked as open for
+ *       writing; both are fixed like `h5clear -s --increment=0` does.
+ *
+ * @param[in] filename
+ * @param[in] swmr: the file was created with createHDF5File(filename, true)
+ * @return H5::H5File
+ */
+H5::H5File openHDF5File(const std::string& filename, bool swmr) {
+  H5::FileAccPropList accessList;
+  if (swmr) {
+    accessList.setLibverBounds(H5F_LIBVER_LATEST, H5F_LIBVER_LATEST);
+    hbool_t clear = true;
+    H5Pset(accessList.getId(), "clear_status_flags", &clear);
+  }
+  try {
+    H5::H5File file(filename, H5F_ACC_RDWR, H5::FileCreatPropList::DEFAULT,
+                    accessList);
+    if (H5Fincrement_filesize(file.getId(), 0) < 0) {
+      throw std::runtime_error("H5Fincrement_filesize failed for " + filename);
+    }
+    return file;
+  } catch (H5::Exception& e) {
+    spdlog::error("Failed to open {} for writing: {}", filename,
+                  e.getDetailMsg());
+    throw std::runtime_error("Failed to open HDF5 file: " + filename);
+  }
+}
+
+/**
+ * @brief Switch an open file to single-writer/multiple-reader mode.
+ *
+ * @param[in] file
+ */
+void startSWMRWrite(H5::H5File& file) {
+  if (H5Fstart_swmr_write(file.getId()) < 0) {
+    throw std::runtime_error("H5Fstart_swmr_write failed for " +
+                             file.getFileName());
+  }
+}
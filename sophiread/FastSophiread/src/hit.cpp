@@ -128,6 +128,9 @@ Hit::Hit(const char *packet, const unsigned long long TDC_timestamp,
   // Store the spidertime
   m_spidertime = Timestamp25ns;
   // TOF calculation
+  // NOTE: a hit before the first TDC has no TOF, leave it at 0 instead of
+  //       whatever was on the heap
+  m_tof = 0;
   if (Timestamp25ns >= TDC_timestamp) {
     m_tof = Timestamp25ns - TDC_timestamp;
   }
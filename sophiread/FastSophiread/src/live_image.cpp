@@ -0,0 +1,226 @@
+/**
+ * @file live_image.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Running image, spectrum and counters shared with live viewers
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include "live_image.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include "spdlog/spdlog.h"
+
+namespace {
+
+const char kMagic[8] = {'S', 'P', 'H', 'R', 'L', 'I', 'V', 'E'};
+const uint32_t kVersion = 1;
+
+size_t roundUp(size_t size) { return (size + 63) / 64 * 64; }
+
+size_t headerBytes() { return roundUp(sizeof(LiveImageHeader)); }
+
+size_t frameBytes(uint64_t width, uint64_t height, uint64_t tof_bins) {
+  return roundUp(sizeof(LiveImageCounters) +
+                 (width * height + tof_bins) * sizeof(uint32_t));
+}
+
+}  // namespace
+
+/**
+ * @brief Create the segment, replacing a stale one of the same name.
+ *
+ * @param[in] name: POSIX shared memory name
+ * @param[in] width
+ * @param[in] height
+ * @param[in] tof_bins
+ */
+LiveImagePublisher::LiveImagePublisher(const std::string& name,
+                                       uint32_t width, uint32_t height,
+                                       uint32_t tof_bins)
+    : m_name(name),
+      m_width(width),
+      m_height(height),
+      m_tof_bins(tof_bins),
+      m_image(static_cast<size_t>(width) * height, 0),
+      m_spectrum(tof_bins, 0) {
+  const size_t frame_bytes = frameBytes(width, height, tof_bins);
+  m_segment_size = headerBytes() + 2 * frame_bytes;
+
+  // NOTE: viewers of a previous run keep their mapping of the old segment
+  shm_unlink(m_name.c_str());
+  const int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd == -1) {
+    spdlog::error("Cannot create shared memory {}: {}", m_name,
+                  strerror(errno));
+    throw std::runtime_error("Cannot create shared memory " + m_name);
+  }
+  if (ftruncate(fd, m_segment_size) == -1) {
+    spdlog::error("Cannot size shared memory {}: {}", m_name, strerror(errno));
+    close(fd);
+    shm_unlink(m_name.c_str());
+    throw std::runtime_error("Cannot size shared memory " + m_name);
+  }
+  m_segment = mmap(nullptr, m_segment_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+  close(fd);
+  if (m_segment == MAP_FAILED) {
+    m_segment = nullptr;
+    shm_unlink(m_name.c_str());
+    throw std::runtime_error("Cannot map shared memory " + m_name);
+  }
+
+  auto* header = new (m_segment) LiveImageHeader{};
+  header->version = kVersion;
+  header->width = width;
+  header->height = height;
+  header->tof_bins = tof_bins;
+  header->frame_bytes = frame_bytes;
+  // the magic goes last, a viewer attaching early does not accept the segment
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(header->magic, kMagic, sizeof(kMagic));
+
+  spdlog::info("Publishing a {}x{} live image with {} TOF bins to {}", width,
+               height, tof_bins, m_name);
+}
+
+LiveImagePublisher::~LiveImagePublisher() {
+  if (m_segment == nullptr) return;
+  static_cast<LiveImageHeader*>(m_segment)->finished.store(1);
+  munmap(m_segment, m_segment_size);
+  shm_unlink(m_name.c_str());
+}
+
+/**
+ * @brief Copy the running image to the frame buffer the viewers are not
+ * pointed at, then point them at it.
+ */
+void LiveImagePublisher::publish() {
+  auto* header = static_cast<LiveImageHeader*>(m_segment);
+  const uint64_t frame = header->latest.load(std::memory_order_relaxed) + 1;
+  m_counters.frame = frame;
+
+  auto& sequence = header->sequence[frame % 2];
+  const uint64_t before = sequence.load(std::memory_order_relaxed);
+  sequence.store(before + 1, std::memory_order_relaxed);
+  // NOTE: orders the odd sequence before the frame, a viewer seeing any of
+  //       the new frame sees the buffer as being written
+  std::atomic_thread_fence(std::memory_order_release);
+
+  char* buffer = static_cast<char*>(m_segment) + headerBytes() +
+                 (frame % 2) * header->frame_bytes;
+  std::memcpy(buffer, &m_counters, sizeof(m_counters));
+  buffer += sizeof(m_counters);
+  std::memcpy(buffer, m_image.data(), m_image.size() * sizeof(uint32_t));
+  buffer += m_image.size() * sizeof(uint32_t);
+  std::memcpy(buffer, m_spectrum.data(), m_spectrum.size() * sizeof(uint32_t));
+
+  sequence.store(before + 2, std::memory_order_release);
+  header->latest.store(frame, std::memory_order_release);
+}
+
+void LiveImagePublisher::finish() {
+  publish();
+  static_cast<LiveImageHeader*>(m_segment)->finished.store(
+      1, std::memory_order_release);
+}
+
+/**
+ * @brief Map a live image segment read-only.
+ *
+ * @param[in] name: POSIX shared memory name
+ */
+LiveImageReader::LiveImageReader(const std::string& name) {
+  const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd == -1) {
+    spdlog::error("Cannot open shared memory {}: {}", name, strerror(errno));
+    throw std::runtime_error("Cannot open shared memory " + name);
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 ||
+      static_cast<size_t>(st.st_size) < headerBytes()) {
+    close(fd);
+    throw std::runtime_error("Not a live image segment: " + name);
+  }
+  m_segment_size = st.st_size;
+  m_segment = mmap(nullptr, m_segment_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (m_segment == MAP_FAILED) {
+    m_segment = nullptr;
+    throw std::runtime_error("Cannot map shared memory " + name);
+  }
+
+  const LiveImageHeader* h = header();
+  if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 ||
+      h->version != kVersion ||
+      h->frame_bytes != frameBytes(h->width, h->height, h->tof_bins) ||
+      m_segment_size < headerBytes() + 2 * h->frame_bytes) {
+    munmap(m_segment, m_segment_size);
+    m_segment = nullptr;
+    throw std::runtime_error("Not a live image segment: " + name);
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+}
+
+LiveImageReader::~LiveImageReader() {
+  if (m_segment != nullptr) munmap(m_segment, m_segment_size);
+}
+
+uint32_t LiveImageReader::getWidth() const { return header()->width; }
+uint32_t LiveImageReader::getHeight() const { return header()->height; }
+uint32_t LiveImageReader::getTOFBins() const { return header()->tof_bins; }
+
+uint64_t LiveImageReader::getLatestFrame() const {
+  return header()->latest.load(std::memory_order_acquire);
+}
+
+bool LiveImageReader::isFinished() const {
+  return header()->finished.load(std::memory_order_acquire) != 0;
+}
+
+/**
+ * @brief Copy the newest frame, again if the publisher rewrote it meanwhile.
+ *
+ * @param[out] frame
+ * @return true once a frame was published
+ */
+bool LiveImageReader::read(LiveImageFrame& frame) const {
+  const LiveImageHeader* h = header();
+  frame.width = h->width;
+  frame.height = h->height;
+  frame.image.resize(static_cast<size_t>(h->width) * h->height);
+  frame.spectrum.resize(h->tof_bins);
+
+  while (true) {
+    const uint64_t latest = h->latest.load(std::memory_order_acquire);
+    if (latest == 0) return false;
+    const auto& sequence = h->sequence[latest % 2];
+    const uint64_t before = sequence.load(std::memory_order_acquire);
+    if (before % 2 == 0) {
+      const char* buffer = static_cast<const char*>(m_segment) +
+                           headerBytes() + (latest % 2) * h->frame_bytes;
+      std::memcpy(&frame.counters, buffer, sizeof(frame.counters));
+      buffer += sizeof(frame.counters);
+      std::memcpy(frame.image.data(), buffer,
+                  frame.image.size() * sizeof(uint32_t));
+      buffer += frame.image.size() * sizeof(uint32_t);
+      std::memcpy(frame.spectrum.data(), buffer,
+                  frame.spectrum.size() * sizeof(uint32_t));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence.load(std::memory_order_relaxed) == before) return true;
+    }
+    std::this_thread::yield();
+  }
+}
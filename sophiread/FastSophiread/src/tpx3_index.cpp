@@ -0,0 +1,655 @@
+/**
+ * @file tpx3_index.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Batch index sidecar for random access into large .tpx3 files
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include "tpx3_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+
+#include "spdlog/spdlog.h"
+
+namespace {
+
+const char kIndexMagic[8] = {'T', 'P', 'X', '3', 'I', 'D', 'X', '\0'};
+const uint32_t kIndexVersion = 1;
+const uint32_t kIndexUsesGDC = 0x1;
+
+struct IndexHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint64_t file_size;
+  uint64_t blocks;
+};
+static_assert(sizeof(IndexHeader) == 32, "IndexHeader must be packed");
+
+/**
+ * @brief Whether a TDC went backwards far enough to count as a rollover, the
+ * same test as update_tdc_timestamp without GDC.
+ */
+bool isTDCRollover(uint64_t previous, uint64_t tdc) {
+  return tdc < previous && (previous - tdc) > 0x80000000;
+}
+
+/**
+ * @brief Drop the GDC mode time packets the end state does not depend on.
+ *
+ * Walks back from the end with the variables still needed: the TDC needs the
+ * GDC before it, the GDC needs Timer_LSB32 before it. A GDC with zero MSB16
+ * keeps the previous GDC when the timer is zero, so it only settles the GDC
+ * once the timer it read is known to be nonzero.
+ *
+ * @param[in, out] summary
+ */
+void prunePackets(TPX3TimestampSummary& summary) {
+  enum : unsigned { kTDC = 0x1, kGDC = 0x2, kTimer = 0x4 };
+  unsigned needed = kTDC | kGDC | kTimer;
+  bool gdc_needs_timer = false;
+  bool keep[TPX3TimestampSummary::kMaxPackets] = {};
+  for (uint32_t i = summary.num_packets; i-- > 0 && needed != 0;) {
+    const uint64_t packet = summary.packets[i];
+    if ((packet >> 56) == 0x6F) {
+      if (needed & kTDC) {
+        keep[i] = true;
+        needed = (needed & ~kTDC) | kGDC;
+        gdc_needs_timer = false;
+      }
+    } else if (((packet >> 56) & 0xF) == 0x5) {
+      if (needed & kGDC) {
+        keep[i] = true;
+        needed |= kTimer;
+        gdc_needs_timer = ((packet >> 16) & 0xFFFF) == 0;
+        if (!gdc_needs_timer) needed &= ~kGDC;
+      }
+    } else if (needed & kTimer) {
+      keep[i] = true;
+      needed &= ~kTimer;
+      if (gdc_needs_timer && ((packet >> 16) & 0xFFFFFFFF) != 0) {
+        needed &= ~kGDC;
+      }
+      gdc_needs_timer = false;
+    }
+  }
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < summary.num_packets; ++i) {
+    if (keep[i]) summary.packets[kept++] = summary.packets[i];
+  }
+  summary.num_packets = kept;
+}
+
+void pushPacket(TPX3TimestampSummary& summary, uint64_t packet) {
+  if (summary.num_packets == TPX3TimestampSummary::kMaxPackets) {
+    prunePackets(summary);
+  }
+  if (summary.num_packets == TPX3TimestampSummary::kMaxPackets) {
+    throw std::runtime_error("Too many time packets to summarize");
+  }
+  summary.packets[summary.num_packets++] = packet;
+}
+
+/**
+ * @brief Chunked scan of the batches with a header in [begin, end).
+ *
+ * @note A batch cut by the end of a chunk is carried over to the next one, so
+ *       the chunk size does not change what is scanned. The last batch may
+ *       extend past end.
+ *
+ * @param[in, out] reader
+ * @param[in] begin: file offset, a multiple of 8
+ * @param[in] end
+ * @param[in] chunk_size: bytes read at a time
+ * @param[in] on_batch: called in file order with the batch, the buffer it
+ *            indexes into and the file offset of the buffer
+ */
+void scanBatches(
+    ITPX3Reader& reader, uint64_t begin, uint64_t end, size_t chunk_size,
+    const std::function<void(TPX3&, const std::vector<char>&, uint64_t)>&
+        on_batch) {
+  if (begin % 8 != 0) {
+    throw std::invalid_argument("TPX3 scan must start at a multiple of 8");
+  }
+  if (reader.getPosition() != begin) reader.seek(begin);
+
+  // buffer starts at file offset base, always a multiple of 8
+  std::vector<char> buffer;
+  uint64_t base = begin;
+  while (base < end && !reader.isEOF()) {
+    auto chunk = reader.readChunk(chunk_size);
+    if (chunk.empty()) break;
+    buffer.insert(buffer.end(), chunk.begin(), chunk.end());
+    std::vector<char>().swap(chunk);
+    const bool last_chunk = reader.isEOF();
+
+    auto batches = findTPX3H(buffer);
+    size_t done = last_chunk ? buffer.size() : buffer.size() & ~size_t(7);
+    for (auto& batch : batches) {
+      if (base + batch.index >= end) {
+        done = buffer.size();
+        break;
+      }
+      const size_t batch_end = batch.index + 8 + 8 * batch.num_packets;
+      if (batch_end > buffer.size() && !last_chunk) {
+        done = batch.index;
+        break;
+      }
+      on_batch(batch, buffer, base);
+    }
+    buffer.erase(buffer.begin(), buffer.begin() + done);
+    base += done;
+  }
+}
+
+/**
+ * @brief Add a batch to the last block, or start a new one past block_size.
+ *
+ * @return true if the batch starts a new block
+ */
+bool addToBlock(std::vector<TPX3IndexEntry>& entries, const TPX3& batch,
+                uint64_t base, size_t buffer_size, size_t block_size) {
+  const bool new_block = entries.empty() || entries.back().size >= block_size;
+  if (new_block) {
+    TPX3IndexEntry entry{};
+    entry.offset = base + batch.index;
+    entries.push_back(entry);
+  }
+  TPX3IndexEntry& block = entries.back();
+  const size_t batch_end = batch.index + 8 + 8 * batch.num_packets;
+  const uint64_t end = base + std::min(batch_end, buffer_size);
+  block.size = std::max(block.size, end - block.offset);
+  block.batches += 1;
+  block.packets += batch.num_packets;
+  block.chip_mask |= 1u << std::clamp(batch.chip_layout_type, 0, 31);
+  return new_block;
+}
+
+void setState(TPX3IndexEntry& entry, unsigned long tdc_timestamp,
+              unsigned long long gdc_timestamp, unsigned long timer_lsb32) {
+  entry.tdc_timestamp = tdc_timestamp;
+  entry.gdc_timestamp = gdc_timestamp;
+  entry.timer_lsb32 = static_cast<uint32_t>(timer_lsb32);
+}
+
+}  // namespace
+
+/**
+ * @brief Add a packet, time packets are kept and the others ignored.
+ *
+ * @param[in] packet: 8 bytes of raw data
+ */
+void TPX3TimestampSummary::add(const char* packet) {
+  uint64_t raw;
+  std::memcpy(&raw, packet, sizeof(raw));
+  if (packet[7] == 0x6F) {
+    const uint32_t tdc = static_cast<uint32_t>((raw >> 12) & 0xFFFFFFFF);
+    if (has_tdc) {
+      tdc_rollovers += isTDCRollover(last_tdc, tdc);
+    } else {
+      first_tdc = tdc;
+      has_tdc = 1;
+    }
+    last_tdc = tdc;
+    pushPacket(*this, raw);
+  } else if ((packet[7] & 0xF0) == 0x40) {
+    const uint64_t type = (raw >> 56) & 0xF;
+    if (type == 0x4 || type == 0x5) pushPacket(*this, raw);
+  }
+}
+
+/**
+ * @brief Add the packets of a batch the way process_tpx3_packets walks them.
+ *
+ * @param[in] batch
+ * @param[in] raw_bytes
+ */
+void TPX3TimestampSummary::addBatch(const TPX3& batch,
+                                    const std::vector<char>& raw_bytes) {
+  size_t offset = batch.index;
+  for (int j = 0; j < batch.num_packets; ++j) {
+    if (offset + 8 >= raw_bytes.size()) continue;
+    offset += 8;
+    add(&raw_bytes[offset]);
+  }
+}
+
+/**
+ * @brief Chain the summary of the piece right after this one.
+ *
+ * @param[in] next
+ */
+void TPX3TimestampSummary::append(const TPX3TimestampSummary& next) {
+  for (uint32_t i = 0; i < next.num_packets; ++i) {
+    pushPacket(*this, next.packets[i]);
+  }
+  if (next.has_tdc) {
+    if (has_tdc) {
+      tdc_rollovers += isTDCRollover(last_tdc, next.first_tdc);
+      tdc_rollovers += next.tdc_rollovers;
+    } else {
+      first_tdc = next.first_tdc;
+      tdc_rollovers = next.tdc_rollovers;
+      has_tdc = 1;
+    }
+    last_tdc = next.last_tdc;
+  }
+}
+
+/**
+ * @brief Evolve the state at the start of the piece to the state at its end.
+ *
+ * @note In TDC mode the rollovers are added in one go, the same as one at a
+ *       time for runs shorter than 2^48 ticks (81 days).
+ *
+ * @param[in] use_gdc
+ * @param[in, out] tdc_timestamp
+ * @param[in, out] gdc_timestamp
+ * @param[in, out] timer_lsb32
+ */
+void TPX3TimestampSummary::apply(bool use_gdc, unsigned long& tdc_timestamp,
+                                 unsigned long long& gdc_timestamp,
+                                 unsigned long& timer_lsb32) const {
+  if (use_gdc) {
+    for (uint32_t i = 0; i < num_packets; ++i) {
+      char packet[8];
+      std::memcpy(packet, &packets[i], sizeof(packet));
+      if (packet[7] == 0x6F) {
+        update_tdc_timestamp(packet, gdc_timestamp, tdc_timestamp);
+      } else {
+        update_gdc_timestamp_and_timer_lsb32(packet, timer_lsb32,
+                                             gdc_timestamp);
+      }
+    }
+  } else if (has_tdc) {
+    unsigned long high_bits = tdc_timestamp & 0xFFFF00000000;
+    const uint64_t rollovers =
+        isTDCRollover(tdc_timestamp & 0xFFFFFFFF, first_tdc) + tdc_rollovers;
+    high_bits += rollovers * 0x100000000;
+    tdc_timestamp = high_bits | last_tdc;
+  }
+}
+
+TPX3Index::TPX3Index(bool use_gdc, uint64_t file_size,
+                     std::vector<TPX3IndexEntry> entries)
+    : m_use_gdc(use_gdc),
+      m_file_size(file_size),
+      m_entries(std::move(entries)) {
+  if (m_entries.empty()) {
+    throw std::invalid_argument("TPX3 index needs the end of file entry");
+  }
+}
+
+/**
+ * @brief Scan a raw file and record a block of batches every block_size bytes.
+ *
+ * @param[in] tpx3_file: raw or compressed .tpx3 file
+ * @param[in] use_gdc: evolve the timestamps as the GDC mode does
+ * @param[in] block_size: bytes of batches per block, at least one batch
+ * @param[in] chunk_size: bytes read at a time
+ * @return TPX3Index
+ */
+TPX3Index TPX3Index::build(const std::string& tpx3_file, bool use_gdc,
+                           size_t block_size, size_t chunk_size) {
+  auto reader = openTPX3Reader(tpx3_file);
+
+  TPX3Index index;
+  index.m_use_gdc = use_gdc;
+  index.m_file_size = reader->getTotalSize();
+  index.m_entries.clear();
+
+  unsigned long tdc_timestamp = 0;
+  unsigned long long gdc_timestamp = 0;
+  unsigned long timer_lsb32 = 0;
+  scanBatches(*reader, 0, index.m_file_size, chunk_size,
+              [&](TPX3& batch, const std::vector<char>& buffer, uint64_t base) {
+                auto& entries = index.m_entries;
+                if (addToBlock(entries, batch, base, buffer.size(),
+                               block_size)) {
+                  setState(entries.back(), tdc_timestamp, gdc_timestamp,
+                           timer_lsb32);
+                }
+                if (use_gdc) {
+                  updateTimestamp(batch, buffer, tdc_timestamp, gdc_timestamp,
+                                  timer_lsb32);
+                } else {
+                  updateTimestamp(batch, buffer, tdc_timestamp);
+                }
+              });
+  TPX3IndexEntry end{};
+  end.offset = index.m_file_size;
+  setState(end, tdc_timestamp, gdc_timestamp, timer_lsb32);
+  index.m_entries.push_back(end);
+
+  spdlog::info("Indexed {} blocks of {}", index.size(), tpx3_file);
+  return index;
+}
+
+/**
+ * @brief Index the batches whose header lies in a byte range of the file.
+ *
+ * The ranges [0, b1), [b1, b2), ... of a file index every batch once, like a
+ * single build() with the same block size would if each range boundary fell
+ * on a block. The timestamps are zero until rebase() gives the state at
+ * begin, which is what the summaries of the ranges before it chain up to.
+ *
+ * @param[in] tpx3_file: raw or compressed .tpx3 file
+ * @param[in] use_gdc
+ * @param[in] begin: file offset, a multiple of 8
+ * @param[in] end: file offset, batches starting here or later are left out
+ * @param[out] summary: what the range does to the timestamps
+ * @param[in] block_size
+ * @param[in] chunk_size
+ * @return TPX3Index: its extra entry is at end (clamped to the file size)
+ *         with the state after the last batch
+ */
+TPX3Index TPX3Index::buildRange(const std::string& tpx3_file, bool use_gdc,
+                                uint64_t begin, uint64_t end,
+                                TPX3TimestampSummary& summary,
+                                size_t block_size, size_t chunk_size) {
+  auto reader = openTPX3Reader(tpx3_file);
+
+  TPX3Index index;
+  index.m_use_gdc = use_gdc;
+  index.m_file_size = reader->getTotalSize();
+  index.m_entries.clear();
+  end = std::min(end, index.m_file_size);
+
+  if (begin < end) {
+    scanBatches(
+        *reader, begin, end, chunk_size,
+        [&](TPX3& batch, const std::vector<char>& buffer, uint64_t base) {
+          if (addToBlock(index.m_entries, batch, base, buffer.size(),
+                         block_size)) {
+            index.m_summaries.emplace_back();
+          }
+          index.m_summaries.back().addBatch(batch, buffer);
+        });
+  }
+  TPX3IndexEntry last{};
+  last.offset = end;
+  index.m_entries.push_back(last);
+
+  summary = TPX3TimestampSummary();
+  for (const auto& block : index.m_summaries) summary.append(block);
+
+  spdlog::debug("Indexed {} blocks in [{}, {}) of {}", index.size(), begin,
+                end, tpx3_file);
+  return index;
+}
+
+/**
+ * @brief Evolve the timestamps of a buildRange() index from the state at the
+ * start of its range.
+ *
+ * @param[in] tdc_timestamp
+ * @param[in] gdc_timestamp
+ * @param[in] timer_lsb32
+ */
+void TPX3Index::rebase(unsigned long tdc_timestamp,
+                       unsigned long long gdc_timestamp,
+                       unsigned long timer_lsb32) {
+  if (m_summaries.size() != size()) {
+    throw std::logic_error("Only a TPX3 index built by range can be rebased");
+  }
+  for (size_t i = 0; i <= size(); ++i) {
+    setState(m_entries[i], tdc_timestamp, gdc_timestamp, timer_lsb32);
+    if (i < size()) {
+      m_summaries[i].apply(m_use_gdc, tdc_timestamp, gdc_timestamp,
+                           timer_lsb32);
+    }
+  }
+}
+
+/**
+ * @brief Read an index sidecar.
+ *
+ * @param[in] index_file
+ * @return TPX3Index
+ */
+TPX3Index TPX3Index::load(const std::string& index_file) {
+  std::ifstream file(index_file, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Cannot open TPX3 index: " + index_file);
+  }
+  IndexHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      std::memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+      header.version != kIndexVersion) {
+    throw std::runtime_error("Unsupported TPX3 index format: " + index_file);
+  }
+  const uint64_t expected =
+      sizeof(header) + (header.blocks + 1) * sizeof(TPX3IndexEntry);
+  if (std::filesystem::file_size(index_file) != expected) {
+    throw std::runtime_error("Truncated TPX3 index: " + index_file);
+  }
+
+  TPX3Index index;
+  index.m_use_gdc = (header.flags & kIndexUsesGDC) != 0;
+  index.m_file_size = header.file_size;
+  index.m_entries.resize(header.blocks + 1);
+  if (!file.read(reinterpret_cast<char*>(index.m_entries.data()),
+                 index.m_entries.size() * sizeof(TPX3IndexEntry))) {
+    throw std::runtime_error("Truncated TPX3 index: " + index_file);
+  }
+  return index;
+}
+
+/**
+ * @brief Load the sidecar of a raw file, rebuilding it when it is missing or
+ * does not match the file.
+ *
+ * @param[in] tpx3_file
+ * @param[in] index_file
+ * @param[in] use_gdc
+ * @return TPX3Index
+ */
+TPX3Index TPX3Index::loadOrBuild(const std::string& tpx3_file,
+                                 const std::string& index_file,
+                                 bool use_gdc) {
+  if (std::filesystem::exists(index_file)) {
+    try {
+      TPX3Index index = load(index_file);
+      const uint64_t file_size = openTPX3Reader(tpx3_file)->getTotalSize();
+      if (index.usesGDC() == use_gdc && index.getFileSize() == file_size) {
+        spdlog::info("Loaded {} blocks from {}", index.size(), index_file);
+        return index;
+      }
+      spdlog::warn("TPX3 index {} does not match {}, rebuilding it",
+                   index_file, tpx3_file);
+    } catch (const std::exception& e) {
+      spdlog::warn("{}, rebuilding it", e.what());
+    }
+  }
+  TPX3Index index = build(tpx3_file, use_gdc);
+  index.save(index_file);
+  return index;
+}
+
+/**
+ * @brief Write the sidecar next to its final location and rename it in place.
+ *
+ * @param[in] index_file
+ */
+void TPX3Index::save(const std::string& index_file) const {
+  IndexHeader header;
+  std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+  header.version = kIndexVersion;
+  header.flags = m_use_gdc ? kIndexUsesGDC : 0;
+  header.file_size = m_file_size;
+  header.blocks = size();
+
+  const std::string tmp = index_file + ".tmp";
+  {
+    std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(m_entries.data()),
+               m_entries.size() * sizeof(TPX3IndexEntry));
+    if (!file) {
+      throw std::runtime_error("Failed to write " + tmp);
+    }
+  }
+  std::filesystem::rename(tmp, index_file);
+}
+
+/**
+ * @brief End of the last batch of block i.
+ *
+ * @param[in] i
+ * @return uint64_t
+ */
+uint64_t TPX3Index::getBlockEnd(size_t i) const {
+  return m_entries[i].offset + m_entries[i].size;
+}
+
+/**
+ * @brief Clock that orders the batches in time, GDC or TDC by timing mode.
+ *
+ * @param[in] i: block, or size() for the end of the file
+ * @return uint64_t
+ */
+uint64_t TPX3Index::getClock(size_t i) const {
+  return m_use_gdc ? m_entries[i].gdc_timestamp : m_entries[i].tdc_timestamp;
+}
+
+/**
+ * @brief Locate the blocks overlapping a time window.
+ *
+ * The hits of block i come after its starting clock and at most kClockSlack
+ * after its end state. The range covers every such block, rounded out to a
+ * contiguous run, so hits in it still need their own time checked.
+ *
+ * @param[in] begin
+ * @param[in] end
+ * @return std::pair<size_t, size_t>: [first, last), empty if none
+ */
+std::pair<size_t, size_t> TPX3Index::findTimeRange(uint64_t begin,
+                                                   uint64_t end) const {
+  size_t first = size();
+  size_t last = 0;
+  for (size_t i = 0; i < size(); ++i) {
+    if (getClock(i) < end && getClock(i + 1) + kClockSlack > begin) {
+      first = std::min(first, i);
+      last = i + 1;
+    }
+  }
+  if (first >= last) return {0, 0};
+  return {first, last};
+}
+
+/**
+ * @brief Split a range of blocks into contiguous parts of similar size.
+ *
+ * @param[in] parts
+ * @param[in] first
+ * @param[in] last
+ * @return std::vector<std::pair<size_t, size_t>>: parts ranges, some may be
+ *         empty when there are fewer blocks than parts
+ */
+std::vector<std::pair<size_t, size_t>> TPX3Index::split(size_t parts,
+                                                        size_t first,
+                                                        size_t last) const {
+  if (parts == 0) {
+    throw std::invalid_argument("TPX3 index split needs at least one part");
+  }
+  last = std::min(last, size());
+  first = std::min(first, last);
+
+  std::vector<std::pair<size_t, size_t>> ranges;
+  ranges.reserve(parts);
+  const uint64_t begin = m_entries[first].offset;
+  const uint64_t bytes = m_entries[last].offset - begin;
+  size_t start = first;
+  for (size_t part = 1; part <= parts; ++part) {
+    // first block starting at or after the part boundary
+    const uint64_t boundary = begin + bytes * part / parts;
+    size_t stop = start;
+    while (stop < last && m_entries[stop].offset < boundary) ++stop;
+    if (part == parts) stop = last;
+    ranges.emplace_back(start, stop);
+    start = stop;
+  }
+  return ranges;
+}
+
+/**
+ * @brief Read the blocks from first on in one contiguous piece.
+ *
+ * Blocks are added while the piece stays within max_bytes (at least one is
+ * read). The batches are located and their timestamps evolved from the state
+ * of the first block, so they go straight to extractHits.
+ *
+ * @param[in, out] reader: seeked only when not already at the first block
+ * @param[in] first
+ * @param[in] last
+ * @param[in] max_bytes
+ * @param[out] chunk
+ * @param[out] batches
+ * @param[in] chip_id: only keep the batches of this chip, -1 for all
+ * @return size_t: first block not read
+ */
+size_t TPX3Index::readBatches(ITPX3Reader& reader, size_t first, size_t last,
+                              size_t max_bytes, std::vector<char>& chunk,
+                              std::vector<TPX3>& batches, int chip_id) const {
+  chunk.clear();
+  batches.clear();
+  last = std::min(last, size());
+  if (first >= last) return first;
+
+  // skip the blocks without the chip
+  const uint32_t chip_bit = 1u << std::clamp(chip_id, 0, 31);
+  const auto has_chip = [&](size_t i) {
+    return chip_id < 0 || (m_entries[i].chip_mask & chip_bit) != 0;
+  };
+  while (first < last && !has_chip(first)) ++first;
+  if (first >= last) return last;
+
+  const uint64_t begin = m_entries[first].offset;
+  size_t next = first + 1;
+  while (next < last && has_chip(next) &&
+         getBlockEnd(next) - begin <= max_bytes) {
+    ++next;
+  }
+  const uint64_t end = getBlockEnd(next - 1);
+
+  if (reader.getPosition() != begin) reader.seek(begin);
+  chunk = reader.readChunk(end - begin);
+  if (chunk.size() != end - begin) {
+    throw std::runtime_error("TPX3 index does not match the file");
+  }
+
+  // NOTE: the timestamps evolve through the batches of every chip
+  batches = findTPX3H(chunk);
+  unsigned long tdc_timestamp = m_entries[first].tdc_timestamp;
+  unsigned long long gdc_timestamp = m_entries[first].gdc_timestamp;
+  unsigned long timer_lsb32 = m_entries[first].timer_lsb32;
+  for (auto& batch : batches) {
+    if (m_use_gdc) {
+      updateTimestamp(batch, chunk, tdc_timestamp, gdc_timestamp,
+                      timer_lsb32);
+    } else {
+      updateTimestamp(batch, chunk, tdc_timestamp);
+    }
+  }
+
+  if (chip_id >= 0) {
+    std::vector<TPX3> chip_batches;
+    for (const auto& batch : batches) {
+      if (batch.chip_layout_type != chip_id) continue;
+      chip_batches.emplace_back(batch.index, batch.num_packets, chip_id);
+      chip_batches.back().tdc_timestamp = batch.tdc_timestamp;
+      chip_batches.back().gdc_timestamp = batch.gdc_timestamp;
+      chip_batches.back().timer_lsb32 = batch.timer_lsb32;
+    }
+    batches.swap(chip_batches);
+  }
+  return next;
+}
@@ -0,0 +1,1186 @@
+/**
+ * @file tpx3_reader.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Chunked readers for raw .tpx3 files
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include "tpx3_reader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef SOPHIREAD_HAS_ZSTD
+#include <zstd.h>
+#endif
+#ifdef SOPHIREAD_HAS_LZ4
+#include <lz4frame.h>
+#endif
+
+#include "disk_io.h"
+#include "spdlog/spdlog.h"
+
+namespace {
+
+// Frame magic numbers, little endian on disk
+constexpr uint32_t kZstdMagic = 0xFD2FB528;
+constexpr uint32_t kLZ4Magic = 0x184D2204;
+constexpr uint32_t kSkippableMagic = 0x184D2A50;  // low 4 bits are free
+constexpr uint32_t kSkippableMask = 0xFFFFFFF0;
+
+// zstd seekable format: a skippable frame with one entry per frame
+// (compressed size, raw size) and a footer at the very end of the file
+constexpr uint32_t kSeekTableMagic = 0x184D2A5E;
+constexpr uint32_t kSeekableMagic = 0x8F92EAB1;
+constexpr size_t kSeekTableFooterSize = 9;
+constexpr size_t kSeekTableEntrySize = 8;
+constexpr uint8_t kSeekTableChecksumFlag = 0x80;
+
+uint32_t readLE32(const char *data) {
+  const auto *bytes = reinterpret_cast<const unsigned char *>(data);
+  return static_cast<uint32_t>(bytes[0]) |
+         (static_cast<uint32_t>(bytes[1]) << 8) |
+         (static_cast<uint32_t>(bytes[2]) << 16) |
+         (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+void writeLE32(std::ostream &out, uint32_t value) {
+  const char bytes[4] = {static_cast<char>(value & 0xff),
+                         static_cast<char>((value >> 8) & 0xff),
+                         static_cast<char>((value >> 16) & 0xff),
+                         static_cast<char>((value >> 24) & 0xff)};
+  out.write(bytes, sizeof(bytes));
+}
+
+const char *codecName(TPX3Codec codec) {
+  switch (codec) {
+    case TPX3Codec::zstd:
+      return "zstd";
+    case TPX3Codec::lz4:
+      return "lz4";
+    default:
+      return "none";
+  }
+}
+
+/**
+ * @brief Compress a block of the raw file into one standard frame.
+ *
+ * @param[in] codec
+ * @param[in] level
+ * @param[in] data
+ * @param[in] size
+ * @param[out] frame
+ */
+void compressFrame(TPX3Codec codec, int level, const char *data, size_t size,
+                   std::vector<char> &frame) {
+#ifdef SOPHIREAD_HAS_ZSTD
+  if (codec == TPX3Codec::zstd) {
+    frame.resize(ZSTD_compressBound(size));
+    const size_t written =
+        ZSTD_compress(frame.data(), frame.size(), data, size, level);
+    if (ZSTD_isError(written)) {
+      throw std::runtime_error(std::string("zstd compression failed: ") +
+                               ZSTD_getErrorName(written));
+    }
+    frame.resize(written);
+    return;
+  }
+#endif
+#ifdef SOPHIREAD_HAS_LZ4
+  if (codec == TPX3Codec::lz4) {
+    LZ4F_preferences_t preferences;
+    std::memset(&preferences, 0, sizeof(preferences));
+    preferences.frameInfo.blockSizeID = LZ4F_max4MB;
+    preferences.frameInfo.contentSize = size;
+    preferences.compressionLevel = level;
+    frame.resize(LZ4F_compressFrameBound(size, &preferences));
+    const size_t written = LZ4F_compressFrame(frame.data(), frame.size(),
+                                              data, size, &preferences);
+    if (LZ4F_isError(written)) {
+      throw std::runtime_error(std::string("lz4 compression failed: ") +
+                               LZ4F_getErrorName(written));
+    }
+    frame.resize(written);
+    return;
+  }
+#endif
+  (void)level;
+  (void)data;
+  (void)size;
+  (void)frame;
+  throw std::runtime_error(std::string("Sophiread was built without ") +
+                           codecName(codec) + " support");
+}
+
+}  // namespace
+
+/**
+ * @brief Append the next chunk to a buffer, through a copy by default.
+ *
+ * @param[in] chunkSize
+ * @param[in,out] buffer
+ * @return size_t: bytes appended, 0 at the end of the input
+ */
+size_t ITPX3Reader::readChunkInto(size_t chunkSize, std::vector<char> &buffer) {
+  const std::vector<char> chunk = readChunk(chunkSize);
+  buffer.insert(buffer.end(), chunk.begin(), chunk.end());
+  return chunk.size();
+}
+
+/**
+ * @brief Parse the name of a raw file reader backend.
+ *
+ * @param[in] name: "mmap" or "pread"
+ * @return TPX3ReaderBackend
+ */
+TPX3ReaderBackend parseTPX3ReaderBackend(const std::string &name) {
+  if (name == "mmap") return TPX3ReaderBackend::mmap;
+  if (name == "pread") return TPX3ReaderBackend::pread;
+  throw std::runtime_error("Invalid reader. Use 'mmap' or 'pread'.");
+}
+
+/**
+ * @brief Open a raw file with the selected backend.
+ *
+ * @param[in] filename
+ * @param[in] options
+ * @return std::unique_ptr<ITPX3Reader>
+ */
+std::unique_ptr<ITPX3Reader> openTPX3Reader(const std::string &filename,
+                                            const TPX3ReaderOptions &options) {
+  // NOTE: checked first, detecting the codec would consume the stream
+  if (isTPX3Stream(filename)) {
+    return std::make_unique<TPX3StreamReader>(filename);
+  }
+  if (detectTPX3Codec(filename) != TPX3Codec::none) {
+    if (options.backend != TPX3ReaderBackend::mmap || options.direct_io) {
+      spdlog::info("Compressed input is read through a memory map");
+    }
+    return std::make_unique<TPX3CompressedReader>(filename);
+  }
+  if (options.backend == TPX3ReaderBackend::pread) {
+    return std::make_unique<TPX3PrefetchReader>(filename, options);
+  }
+  if (options.direct_io) {
+    spdlog::warn("O_DIRECT is only used by the pread reader, ignored");
+  }
+  return std::make_unique<TPX3FileReader>(filename);
+}
+
+/**
+ * @brief Open the file and start the I/O threads.
+ *
+ * @param[in] filename
+ * @param[in] options
+ */
+TPX3PrefetchReader::TPX3PrefetchReader(const std::string &filename,
+                                       const TPX3ReaderOptions &options)
+    : m_filename(filename) {
+  if (options.queue_depth == 0 || options.io_threads == 0 ||
+      options.request_size == 0) {
+    throw std::invalid_argument(
+        "The pread reader needs a queue depth, I/O threads and a request "
+        "size of at least one");
+  }
+
+  if (options.direct_io) {
+    m_fd = open(filename.c_str(), O_RDONLY | O_DIRECT);
+    if (m_fd == -1 && errno == EINVAL) {
+      spdlog::warn("O_DIRECT is not supported for {}, using buffered reads",
+                   filename);
+    }
+    m_direct_io = m_fd != -1;
+  }
+  if (m_fd == -1) {
+    m_fd = open(filename.c_str(), O_RDONLY);
+  }
+  if (m_fd == -1) {
+    spdlog::error("Failed to open file: {}", filename);
+    throw std::runtime_error("Failed to open file");
+  }
+
+  struct stat sb;
+  if (fstat(m_fd, &sb) == -1) {
+    spdlog::error("Failed to get file size");
+    close(m_fd);
+    throw std::runtime_error("Failed to get file size");
+  }
+  m_file_size = sb.st_size;
+  if (!m_direct_io) {
+    posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+
+  // O_DIRECT reads must cover whole blocks
+  m_request_size = options.request_size;
+  if (m_direct_io) {
+    m_request_size = (m_request_size + kDirectIOAlignment - 1) /
+                     kDirectIOAlignment * kDirectIOAlignment;
+  }
+
+  m_ring.resize(options.queue_depth);
+  for (size_t i = 0; i < options.io_threads; ++i) {
+    m_threads.emplace_back(&TPX3PrefetchReader::run, this);
+  }
+  spdlog::info("Opened file: {}, size: {} bytes, {} pread threads{}", filename,
+               m_file_size, options.io_threads,
+               m_direct_io ? ", O_DIRECT" : "");
+}
+
+/**
+ * @brief Wait for the reads in flight and stop the I/O threads.
+ */
+TPX3PrefetchReader::~TPX3PrefetchReader() {
+  drain();
+  // an empty request is the stop signal, one per thread
+  for (size_t i = 0; i < m_threads.size(); ++i) {
+    m_requests.push(Request());
+  }
+  for (auto &thread : m_threads) {
+    thread.join();
+  }
+  close(m_fd);
+}
+
+/**
+ * @brief Return the next chunk, reading ahead the ones after it.
+ *
+ * @param[in] chunkSize: size of the chunk to read
+ * @return std::vector<char>: empty at the end of the file
+ */
+std::vector<char> TPX3PrefetchReader::readChunk(size_t chunkSize) {
+  if (isEOF() || chunkSize == 0) {
+    return std::vector<char>();
+  }
+
+  // what was read ahead was cut for another chunk size
+  if (chunkSize != m_chunk_size) {
+    drain();
+    m_chunk_size = chunkSize;
+  }
+  prefetch();
+
+  Buffer &buffer = m_ring[m_head];
+  try {
+    wait(buffer);
+  } catch (...) {
+    drain();
+    throw;
+  }
+
+  const char *begin = buffer.data.get() + buffer.skip;
+  std::vector<char> chunk(begin, begin + buffer.size);
+  buffer.busy = false;
+  m_head = (m_head + 1) % m_ring.size();
+  m_position += chunk.size();
+
+  // reuse the buffer for the chunk after the ones in flight
+  prefetch();
+
+  spdlog::debug("Read chunk of size {} bytes, current position: {}/{}",
+                chunk.size(), m_position, m_file_size);
+  return chunk;
+}
+
+/**
+ * @brief Move to a byte offset, e.g. to resume from a checkpoint.
+ *
+ * @param[in] position: offset from the start of the file
+ */
+void TPX3PrefetchReader::seek(size_t position) {
+  if (position > m_file_size) {
+    spdlog::error("Cannot seek to {} in a file of {} bytes", position,
+                  m_file_size);
+    throw std::out_of_range("Seek past the end of file");
+  }
+  if (position == m_position) return;
+  drain();
+  m_position = position;
+  m_next_offset = position;
+}
+
+/**
+ * @brief Queue reads for the free buffers of the ring.
+ *
+ * @note Buffers in flight always follow m_head in file order, the free ones
+ *       come after them.
+ */
+void TPX3PrefetchReader::prefetch() {
+  for (size_t i = 0; i < m_ring.size(); ++i) {
+    Buffer &buffer = m_ring[(m_head + i) % m_ring.size()];
+    if (buffer.busy) continue;
+    if (m_next_offset >= m_file_size) break;
+
+    const size_t size = std::min(m_chunk_size, m_file_size - m_next_offset);
+    submit(buffer, m_next_offset, size);
+    m_next_offset += size;
+  }
+}
+
+/**
+ * @brief Split the read of a chunk into requests for the I/O threads.
+ *
+ * @param[in, out] buffer
+ * @param[in] offset
+ * @param[in] size
+ */
+void TPX3PrefetchReader::submit(Buffer &buffer, size_t offset, size_t size) {
+  size_t first = offset;
+  size_t last = offset + size;
+  if (m_direct_io) {
+    first = offset / kDirectIOAlignment * kDirectIOAlignment;
+    last = (last + kDirectIOAlignment - 1) / kDirectIOAlignment *
+           kDirectIOAlignment;
+  }
+  const size_t length = last - first;
+
+  if (buffer.capacity < length) {
+    void *data = nullptr;
+    if (posix_memalign(&data, kDirectIOAlignment, length) != 0) {
+      throw std::bad_alloc();
+    }
+    buffer.data = std::unique_ptr<char, void (*)(void *)>(
+        static_cast<char *>(data), std::free);
+    buffer.capacity = length;
+  }
+
+  buffer.offset = offset;
+  buffer.size = size;
+  buffer.skip = offset - first;
+  buffer.remaining = (length + m_request_size - 1) / m_request_size;
+  buffer.error = 0;
+  buffer.busy = true;
+
+  for (size_t pos = 0; pos < length; pos += m_request_size) {
+    m_requests.push({&buffer, first + pos,
+                     std::min(m_request_size, length - pos),
+                     buffer.data.get() + pos});
+  }
+}
+
+/**
+ * @brief Block until every request of a buffer has completed.
+ *
+ * @param[in] buffer
+ */
+void TPX3PrefetchReader::wait(Buffer &buffer) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_done.wait(lock, [&buffer]() { return buffer.remaining == 0; });
+  if (buffer.error != 0) {
+    buffer.busy = false;
+    spdlog::error("Failed to read {} at {}: {}", m_filename, buffer.offset,
+                  std::strerror(buffer.error));
+    throw std::runtime_error("Failed to read chunk");
+  }
+}
+
+/**
+ * @brief Wait for the reads in flight and forget what was read ahead.
+ */
+void TPX3PrefetchReader::drain() {
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this]() {
+      return std::all_of(m_ring.begin(), m_ring.end(),
+                         [](const Buffer &b) { return b.remaining == 0; });
+    });
+  }
+  for (auto &buffer : m_ring) {
+    buffer.busy = false;
+  }
+  m_head = 0;
+  m_next_offset = m_position;
+}
+
+/**
+ * @brief I/O thread loop.
+ */
+void TPX3PrefetchReader::run() {
+  while (true) {
+    Request request;
+    m_requests.pop(request);
+    if (request.buffer == nullptr) break;
+
+    // a direct read can go past the end of the file, stop there
+    int error = 0;
+    size_t done = 0;
+    while (done < request.length && request.offset + done < m_file_size) {
+      const ssize_t n = pread(m_fd, request.destination + done,
+                              request.length - done, request.offset + done);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        error = errno;
+        break;
+      }
+      if (n == 0) {
+        error = EIO;  // truncated since it was opened
+        break;
+      }
+      done += static_cast<size_t>(n);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (error != 0 && request.buffer->error == 0) {
+        request.buffer->error = error;
+      }
+      --request.buffer->remaining;
+    }
+    m_done.notify_all();
+  }
+}
+
+/**
+ * @brief Parse the name of an archive compression.
+ *
+ * @param[in] name: "zstd" or "lz4"
+ * @return TPX3Codec
+ */
+TPX3Codec parseTPX3Codec(const std::string &name) {
+  if (name == "zstd") return TPX3Codec::zstd;
+  if (name == "lz4") return TPX3Codec::lz4;
+  throw std::runtime_error("Invalid codec. Use 'zstd' or 'lz4'.");
+}
+
+/**
+ * @brief Tell a compressed archive from a raw .tpx3 file.
+ *
+ * @note Leading skippable frames are stepped over, an archive holding no data
+ *       frame at all is reported as zstd.
+ *
+ * @param[in] filename
+ * @return TPX3Codec: none for a raw file
+ */
+TPX3Codec detectTPX3Codec(const std::string &filename) {
+  std::ifstream in(filename, std::ios::binary);
+  char header[8];
+  bool skipped = false;
+  while (in.read(header, sizeof(header))) {
+    const uint32_t magic = readLE32(header);
+    if (magic == kZstdMagic) return TPX3Codec::zstd;
+    if (magic == kLZ4Magic) return TPX3Codec::lz4;
+    if ((magic & kSkippableMask) != kSkippableMagic) return TPX3Codec::none;
+    in.seekg(readLE32(header + 4), std::ios::cur);
+    skipped = true;
+  }
+  return skipped ? TPX3Codec::zstd : TPX3Codec::none;
+}
+
+/**
+ * @brief Whether this build can read and write a codec.
+ *
+ * @param[in] codec
+ * @return bool
+ */
+bool isTPX3CodecAvailable(TPX3Codec codec) {
+  switch (codec) {
+    case TPX3Codec::none:
+      return true;
+    case TPX3Codec::zstd:
+#ifdef SOPHIREAD_HAS_ZSTD
+      return true;
+#else
+      return false;
+#endif
+    case TPX3Codec::lz4:
+#ifdef SOPHIREAD_HAS_LZ4
+      return true;
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+/**
+ * @brief Write a seekable compressed archive of a raw .tpx3 file.
+ *
+ * The raw file is cut into frames of frame_size bytes, compressed in parallel
+ * and written in order, followed by the seek table.
+ *
+ * @param[in] input: raw .tpx3 file
+ * @param[in] output: archive, replaced if it exists
+ * @param[in] options
+ * @return uint64_t: size of the archive
+ */
+uint64_t compressTPX3File(const std::string &input, const std::string &output,
+                          const TPX3CompressOptions &options) {
+  if (options.codec == TPX3Codec::none) {
+    throw std::invalid_argument("No codec to compress with");
+  }
+  if (!isTPX3CodecAvailable(options.codec)) {
+    throw std::runtime_error(std::string("Sophiread was built without ") +
+                             codecName(options.codec) + " support");
+  }
+  if (options.frame_size == 0 || options.frame_size > (1u << 30)) {
+    throw std::invalid_argument("Frame size must be between 1 B and 1 GiB");
+  }
+
+  TPX3FileReader reader(input);
+  const std::string tmp_output = output + ".tmp";
+  std::ofstream out(tmp_output, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    throw std::runtime_error("Failed to open archive for writing: " +
+                             tmp_output);
+  }
+
+  // a few frames per thread at a time
+  const size_t frames_per_pass =
+      4 * static_cast<size_t>(tbb::this_task_arena::max_concurrency());
+  std::vector<std::pair<uint32_t, uint32_t>> seek_table;
+  uint64_t written = 0;
+  while (!reader.isEOF()) {
+    const auto raw = reader.readChunk(frames_per_pass * options.frame_size);
+    const size_t frames =
+        (raw.size() + options.frame_size - 1) / options.frame_size;
+    std::vector<std::vector<char>> compressed(frames);
+    tbb::parallel_for(size_t(0), frames, [&](size_t i) {
+      const size_t begin = i * options.frame_size;
+      const size_t size = std::min(options.frame_size, raw.size() - begin);
+      compressFrame(options.codec, options.level, raw.data() + begin, size,
+                    compressed[i]);
+    });
+
+    for (size_t i = 0; i < frames; ++i) {
+      out.write(compressed[i].data(), compressed[i].size());
+      const size_t size =
+          std::min(options.frame_size, raw.size() - i * options.frame_size);
+      seek_table.emplace_back(static_cast<uint32_t>(compressed[i].size()),
+                              static_cast<uint32_t>(size));
+      written += compressed[i].size();
+    }
+  }
+
+  const uint32_t table_size = static_cast<uint32_t>(
+      seek_table.size() * kSeekTableEntrySize + kSeekTableFooterSize);
+  writeLE32(out, kSeekTableMagic);
+  writeLE32(out, table_size);
+  for (const auto &[compressed_size, raw_size] : seek_table) {
+    writeLE32(out, compressed_size);
+    writeLE32(out, raw_size);
+  }
+  writeLE32(out, static_cast<uint32_t>(seek_table.size()));
+  out.put(0);  // descriptor: no checksums
+  writeLE32(out, kSeekableMagic);
+  written += 8 + table_size;
+
+  out.close();
+  if (!out) {
+    throw std::runtime_error("Failed to write archive: " + tmp_output);
+  }
+  std::filesystem::rename(tmp_output, output);
+
+  spdlog::info("Compressed {} ({} bytes) to {} ({} bytes, {} {} frames)",
+               input, reader.getTotalSize(), output, written,
+               seek_table.size(), codecName(options.codec));
+  return written;
+}
+
+/**
+ * @brief Map the archive and index its frames.
+ *
+ * @param[in] filename
+ */
+TPX3CompressedReader::TPX3CompressedReader(const std::string &filename)
+    : m_filename(filename) {
+  m_fd = open(filename.c_str(), O_RDONLY);
+  if (m_fd == -1) {
+    spdlog::error("Failed to open file: {}", filename);
+    throw std::runtime_error("Failed to open file");
+  }
+
+  struct stat sb;
+  if (fstat(m_fd, &sb) == -1 || sb.st_size == 0) {
+    spdlog::error("Failed to get the size of {}", filename);
+    close(m_fd);
+    throw std::runtime_error("Failed to get file size");
+  }
+  m_file_size = sb.st_size;
+  m_map = static_cast<char *>(
+      mmap(nullptr, m_file_size, PROT_READ, MAP_PRIVATE, m_fd, 0));
+  if (m_map == MAP_FAILED) {
+    spdlog::error("Failed to mmap file");
+    close(m_fd);
+    throw std::runtime_error("Failed to mmap file");
+  }
+  madvise(m_map, m_file_size, MADV_SEQUENTIAL);
+
+  try {
+    if (!readSeekTable()) {
+      spdlog::warn("No seek table in {}, indexing its frames", filename);
+      walkFrames();
+    }
+  } catch (...) {
+    munmap(m_map, m_file_size);
+    close(m_fd);
+    throw;
+  }
+  for (const auto &frame : m_frames) {
+    m_total_size += frame.raw_size;
+  }
+  spdlog::info("Opened archive: {}, {} frames, {} bytes ({} compressed)",
+               filename, m_frames.size(), m_total_size, m_file_size);
+}
+
+/**
+ * @brief Unmap the archive.
+ */
+TPX3CompressedReader::~TPX3CompressedReader() {
+  munmap(m_map, m_file_size);
+  close(m_fd);
+}
+
+/**
+ * @brief Decompress the next chunk of the raw file.
+ *
+ * @param[in] chunkSize: raw bytes to return
+ * @return std::vector<char>: empty at the end of the file
+ */
+std::vector<char> TPX3CompressedReader::readChunk(size_t chunkSize) {
+  if (isEOF() || chunkSize == 0) {
+    return std::vector<char>();
+  }
+  const size_t begin = m_position;
+  const size_t end = std::min(m_total_size, begin + chunkSize);
+  std::vector<char> chunk(end - begin);
+
+  // frames holding the first and the last byte of the chunk
+  auto frame_of = [this](size_t offset) {
+    auto it = std::partition_point(
+        m_frames.begin(), m_frames.end(),
+        [offset](const Frame &frame) { return frame.raw_offset <= offset; });
+    return static_cast<size_t>(std::distance(m_frames.begin(), it)) - 1;
+  };
+  const size_t first = frame_of(begin);
+  const size_t last = frame_of(end - 1);
+  const Frame &last_frame = m_frames[last];
+  const bool last_is_cut = end < last_frame.raw_offset + last_frame.raw_size;
+
+  std::vector<char> cut_frame;
+  tbb::parallel_for(first, last + 1, [&](size_t i) {
+    const Frame &frame = m_frames[i];
+    const size_t from = std::max(begin, frame.raw_offset);
+    const size_t to = std::min(end, frame.raw_offset + frame.raw_size);
+    if (from >= to) return;
+    char *destination = chunk.data() + (from - begin);
+
+    // whole frames go straight into the chunk
+    if (from == frame.raw_offset && to == frame.raw_offset + frame.raw_size) {
+      decompress(frame, destination);
+      return;
+    }
+
+    if (i == m_cached_frame) {
+      std::memcpy(destination, m_cache.data() + (from - frame.raw_offset),
+                  to - from);
+      return;
+    }
+    std::vector<char> raw(frame.raw_size);
+    decompress(frame, raw.data());
+    std::memcpy(destination, raw.data() + (from - frame.raw_offset), to - from);
+    if (i == last && last_is_cut) {
+      cut_frame = std::move(raw);
+    }
+  });
+
+  // the rest of the last frame starts the next chunk
+  if (last_is_cut && last != m_cached_frame) {
+    m_cache = std::move(cut_frame);
+    m_cached_frame = last;
+  }
+
+  m_position = end;
+  spdlog::debug("Read chunk of size {} bytes, current position: {}/{}",
+                chunk.size(), m_position, m_total_size);
+  return chunk;
+}
+
+/**
+ * @brief Move to a raw byte offset, e.g. to resume from a checkpoint.
+ *
+ * @param[in] position: offset from the start of the raw file
+ */
+void TPX3CompressedReader::seek(size_t position) {
+  if (position > m_total_size) {
+    spdlog::error("Cannot seek to {} in a file of {} bytes", position,
+                  m_total_size);
+    throw std::out_of_range("Seek past the end of file");
+  }
+  m_position = position;
+}
+
+/**
+ * @brief Index the frames from the seek table at the end of the archive.
+ *
+ * @return false if the archive has no seek table
+ */
+bool TPX3CompressedReader::readSeekTable() {
+  if (m_file_size < 8 + kSeekTableFooterSize) return false;
+  const char *footer = m_map + m_file_size - kSeekTableFooterSize;
+  if (readLE32(footer + 5) != kSeekableMagic) return false;
+
+  const size_t frames = readLE32(footer);
+  const uint8_t descriptor = static_cast<uint8_t>(footer[4]);
+  const size_t entry_size =
+      kSeekTableEntrySize + ((descriptor & kSeekTableChecksumFlag) ? 4 : 0);
+  const size_t table_size = frames * entry_size + kSeekTableFooterSize;
+  if (table_size + 8 > m_file_size) {
+    throw std::runtime_error("Corrupt seek table in " + m_filename);
+  }
+  const char *table = m_map + m_file_size - table_size - 8;
+  if (readLE32(table) != kSeekTableMagic || readLE32(table + 4) != table_size) {
+    throw std::runtime_error("Corrupt seek table in " + m_filename);
+  }
+
+  size_t compressed_offset = 0;
+  size_t raw_offset = 0;
+  const char *entry = table + 8;
+  for (size_t i = 0; i < frames; ++i, entry += entry_size) {
+    const size_t compressed_size = readLE32(entry);
+    const size_t raw_size = readLE32(entry + 4);
+    m_frames.push_back(
+        {compressed_offset, compressed_size, raw_offset, raw_size});
+    compressed_offset += compressed_size;
+    raw_offset += raw_size;
+  }
+  if (compressed_offset > m_file_size - table_size - 8) {
+    throw std::runtime_error("Corrupt seek table in " + m_filename);
+  }
+  return true;
+}
+
+/**
+ * @brief Index the frames of an archive without seek table from their headers.
+ */
+void TPX3CompressedReader::walkFrames() {
+  size_t pos = 0;
+  size_t raw_offset = 0;
+  while (pos + 8 <= m_file_size) {
+    const char *data = m_map + pos;
+    const size_t available = m_file_size - pos;
+    const uint32_t magic = readLE32(data);
+    size_t compressed_size = 0;
+    size_t raw_size = 0;
+
+    if ((magic & kSkippableMask) == kSkippableMagic) {
+      pos += 8 + static_cast<size_t>(readLE32(data + 4));
+      continue;
+    } else if (magic == kZstdMagic) {
+#ifdef SOPHIREAD_HAS_ZSTD
+      compressed_size = ZSTD_findFrameCompressedSize(data, available);
+      const unsigned long long content =
+          ZSTD_getFrameContentSize(data, available);
+      if (ZSTD_isError(compressed_size) ||
+          content == ZSTD_CONTENTSIZE_ERROR) {
+        throw std::runtime_error("Corrupt zstd frame in " + m_filename);
+      }
+      if (content == ZSTD_CONTENTSIZE_UNKNOWN) {
+        throw std::runtime_error(
+            "zstd frame without content size in " + m_filename +
+            ", recompress it with SophireadCompress");
+      }
+      raw_size = content;
+#else
+      throw std::runtime_error("Sophiread was built without zstd support");
+#endif
+    } else if (magic == kLZ4Magic) {
+      // FLG, BD, [content size], [dictionary ID], header checksum
+      const uint8_t flags = static_cast<uint8_t>(data[4]);
+      const bool has_content_size = flags & 0x08;
+      const size_t header = 4 + 2 + (has_content_size ? 8 : 0) +
+                            ((flags & 0x01) ? 4 : 0) + 1;
+      if (!has_content_size) {
+        throw std::runtime_error(
+            "lz4 frame without content size in " + m_filename +
+            ", recompress it with SophireadCompress");
+      }
+      for (int i = 0; i < 8; ++i) {
+        raw_size |= static_cast<size_t>(static_cast<uint8_t>(data[6 + i]))
+                    << (8 * i);
+      }
+      // blocks until the end mark, then the content checksum
+      size_t block = header;
+      while (true) {
+        if (block + 4 > available) {
+          throw std::runtime_error("Truncated lz4 frame in " + m_filename);
+        }
+        const uint32_t block_size = readLE32(data + block);
+        block += 4;
+        if (block_size == 0) break;
+        block += (block_size & 0x7FFFFFFF) + ((flags & 0x10) ? 4 : 0);
+      }
+      compressed_size = block + ((flags & 0x04) ? 4 : 0);
+    } else {
+      throw std::runtime_error("Unknown frame in " + m_filename);
+    }
+
+    if (compressed_size > available) {
+      throw std::runtime_error("Truncated frame in " + m_filename);
+    }
+    m_frames.push_back({pos, compressed_size, raw_offset, raw_size});
+    pos += compressed_size;
+    raw_offset += raw_size;
+  }
+}
+
+/**
+ * @brief Decompress one frame.
+ *
+ * @param[in] frame
+ * @param[out] destination: frame.raw_size bytes
+ */
+void TPX3CompressedReader::decompress(const Frame &frame,
+                                      char *destination) const {
+  const char *source = m_map + frame.compressed_offset;
+  const uint32_t magic = readLE32(source);
+#ifdef SOPHIREAD_HAS_ZSTD
+  if (magic == kZstdMagic) {
+    const size_t size = ZSTD_decompress(destination, frame.raw_size, source,
+                                        frame.compressed_size);
+    if (ZSTD_isError(size) || size != frame.raw_size) {
+      throw std::runtime_error("Failed to decompress zstd frame at " +
+                               std::to_string(frame.compressed_offset));
+    }
+    return;
+  }
+#endif
+#ifdef SOPHIREAD_HAS_LZ4
+  if (magic == kLZ4Magic) {
+    LZ4F_dctx *context = nullptr;
+    if (LZ4F_isError(
+            LZ4F_createDecompressionContext(&context, LZ4F_VERSION))) {
+      throw std::runtime_error("Failed to create lz4 context");
+    }
+    size_t read = 0;
+    size_t written = 0;
+    size_t status = 1;
+    while (status != 0 && read < frame.compressed_size) {
+      size_t source_size = frame.compressed_size - read;
+      size_t destination_size = frame.raw_size - written;
+      status = LZ4F_decompress(context, destination + written,
+                               &destination_size, source + read, &source_size,
+                               nullptr);
+      if (LZ4F_isError(status)) break;
+      read += source_size;
+      written += destination_size;
+    }
+    LZ4F_freeDecompressionContext(context);
+    if (status != 0 || written != frame.raw_size) {
+      throw std::runtime_error("Failed to decompress lz4 frame at " +
+                               std::to_string(frame.compressed_offset));
+    }
+    return;
+  }
+#endif
+  (void)magic;
+  (void)destination;
+  throw std::runtime_error("Cannot decompress frame at " +
+                           std::to_string(frame.compressed_offset) + " of " +
+                           m_filename);
+}
+
+/**
+ * @brief Whether a source has to be read as a stream.
+ *
+ * @param[in] source
+ * @return true for stdin, socket addresses, FIFOs, sockets and devices
+ */
+bool isTPX3Stream(const std::string &source) {
+  if (source == "-" || source.rfind("tcp://", 0) == 0 ||
+      source.rfind("unix://", 0) == 0) {
+    return true;
+  }
+  struct stat sb;
+  if (stat(source.c_str(), &sb) == -1) return false;
+  return S_ISFIFO(sb.st_mode) || S_ISSOCK(sb.st_mode) || S_ISCHR(sb.st_mode);
+}
+
+/**
+ * @brief Connect to a socket address, or accept one connection on it.
+ *
+ * @param[in] address: tcp://[listen@]host:port or unix://[listen@]path
+ * @param[out] socket_path: the unix socket listened on, to be removed by the
+ *             caller, empty otherwise
+ * @return int: connected socket
+ */
+int openTPX3StreamSocket(const std::string &address,
+                         std::string *socket_path) {
+  const bool tcp = address.rfind("tcp://", 0) == 0;
+  if (!tcp && address.rfind("unix://", 0) != 0) {
+    throw std::invalid_argument("Not a tcp:// or unix:// address: " +
+                                address);
+  }
+  std::string target = address.substr(tcp ? 6 : 7);
+  const bool listening = target.rfind("listen@", 0) == 0;
+  if (listening) target = target.substr(7);
+  if (socket_path) socket_path->clear();
+  const auto fail = [&](const std::string &what) {
+    spdlog::error("Failed to {} {}: {}", what, address, strerror(errno));
+    throw std::runtime_error("Failed to open stream");
+  };
+
+  int fd = -1;
+  if (tcp) {
+    const size_t colon = target.rfind(':');
+    if (colon == std::string::npos) {
+      throw std::invalid_argument("TCP stream needs host:port: " + address);
+    }
+    std::string host = target.substr(0, colon);
+    if (host.size() > 1 && host.front() == '[' && host.back() == ']') {
+      host = host.substr(1, host.size() - 2);  // [IPv6]
+    }
+    const std::string port = target.substr(colon + 1);
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    addrinfo *addresses = nullptr;
+    const int error = getaddrinfo(host.empty() ? nullptr : host.c_str(),
+                                  port.c_str(), &hints, &addresses);
+    if (error != 0) {
+      spdlog::error("Failed to resolve {}: {}", address, gai_strerror(error));
+      throw std::runtime_error("Failed to open stream");
+    }
+    for (addrinfo *ai = addresses; ai != nullptr; ai = ai->ai_next) {
+      fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+      if (fd == -1) continue;
+      if (listening) {
+        const int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 1) == 0) {
+          break;
+        }
+      } else if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+        break;
+      }
+      close(fd);
+      fd = -1;
+    }
+    freeaddrinfo(addresses);
+    if (fd == -1) fail(listening ? "listen on" : "connect to");
+  } else {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (target.size() >= sizeof(addr.sun_path)) {
+      throw std::invalid_argument("Unix socket path too long: " + address);
+    }
+    std::strncpy(addr.sun_path, target.c_str(), sizeof(addr.sun_path) - 1);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) fail("create a socket for");
+    if (listening) {
+      // a socket left over by a previous run would make bind fail
+      struct stat sb;
+      if (stat(target.c_str(), &sb) == 0 && S_ISSOCK(sb.st_mode)) {
+        unlink(target.c_str());
+      }
+      if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == -1 ||
+          listen(fd, 1) == -1) {
+        close(fd);
+        fail("listen on");
+      }
+      if (socket_path) *socket_path = target;
+    } else if (connect(fd, reinterpret_cast<sockaddr *>(&addr),
+                       sizeof(addr)) == -1) {
+      close(fd);
+      fail("connect to");
+    }
+  }
+
+  if (listening) {
+    spdlog::info("Waiting for a connection on {}", address);
+    int client;
+    do {
+      client = accept(fd, nullptr, nullptr);
+    } while (client == -1 && errno == EINTR);
+    close(fd);
+    if (client == -1) fail("accept a connection on");
+    fd = client;
+  }
+  return fd;
+}
+
+/**
+ * @brief Open the stream, waiting for the sender when listening.
+ *
+ * @param[in] source: see isTPX3Stream
+ */
+TPX3StreamReader::TPX3StreamReader(const std::string &source)
+    : m_source(source) {
+  if (source == "-") {
+    m_fd = STDIN_FILENO;
+    m_owns_fd = false;
+  } else if (source.rfind("tcp://", 0) == 0 ||
+             source.rfind("unix://", 0) == 0) {
+    m_fd = openTPX3StreamSocket(source, &m_socket_path);
+    // a larger receive buffer rides out the pauses of the consumer
+    const int receive_buffer = 8 * 1024 * 1024;
+    setsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &receive_buffer,
+               sizeof(receive_buffer));
+  } else {
+    // NOTE: opening a FIFO blocks until the writer opens it too
+    m_fd = open(source.c_str(), O_RDONLY);
+    if (m_fd == -1) {
+      spdlog::error("Failed to open stream {}: {}", source, strerror(errno));
+      throw std::runtime_error("Failed to open stream");
+    }
+  }
+  if (pipe(m_wake) == -1) {
+    if (m_owns_fd) close(m_fd);
+    spdlog::error("Failed to create the wake pipe of stream {}: {}", source,
+                  strerror(errno));
+    throw std::runtime_error("Failed to open stream");
+  }
+  // a full pipe already wakes the reader, interrupt() never blocks on it
+  fcntl(m_wake[1], F_SETFL, O_NONBLOCK);
+  spdlog::info("Reading stream: {}", source);
+}
+
+TPX3StreamReader::~TPX3StreamReader() {
+  if (m_fd != -1 && m_owns_fd) close(m_fd);
+  for (const int fd : m_wake) {
+    if (fd != -1) close(fd);
+  }
+  if (!m_socket_path.empty()) unlink(m_socket_path.c_str());
+}
+
+/**
+ * @brief Whether a read would return data (or the end) without blocking.
+ */
+bool TPX3StreamReader::isDataWaiting() const {
+  pollfd pfd{m_fd, POLLIN, 0};
+  int ready;
+  do {
+    ready = poll(&pfd, 1, 0);
+  } while (ready == -1 && errno == EINTR);
+  return ready > 0;
+}
+
+/**
+ * @brief Block until the stream can be read or the reader is interrupted.
+ *
+ * @return true if the stream can be read, false once interrupted
+ */
+bool TPX3StreamReader::waitForData() {
+  pollfd pfds[2] = {{m_fd, POLLIN, 0}, {m_wake[0], POLLIN, 0}};
+  int ready;
+  do {
+    ready = poll(pfds, 2, -1);
+  } while (ready == -1 && errno == EINTR);
+  if (ready == -1) {
+    spdlog::error("Failed to wait for stream {}: {}", m_source,
+                  strerror(errno));
+    throw std::runtime_error("Failed to read stream");
+  }
+  // NOTE: the wake byte is left in the pipe, an interrupted reader stays so
+  return (pfds[1].revents & POLLIN) == 0;
+}
+
+/**
+ * @brief End the stream from another thread, waking a blocked read.
+ */
+void TPX3StreamReader::interrupt() {
+  const char wake = 1;
+  ssize_t n;
+  do {
+    n = write(m_wake[1], &wake, 1);
+  } while (n == -1 && errno == EINTR);
+}
+
+/**
+ * @brief Read the next batch aligned chunk, blocking until there is one.
+ *
+ * @param[in] chunkSize: upper bound of the chunk
+ * @return std::vector<char>: complete batches, then at the end of the stream
+ *         whatever is left; empty once the stream is over
+ */
+std::vector<char> TPX3StreamReader::readChunk(size_t chunkSize) {
+  // a TPX3 batch is at most a header and 0xffff bytes of packets
+  const size_t limit = std::max<size_t>(chunkSize, 8 + 0xffff);
+  const size_t kReadSize = 16 * 1024 * 1024;
+
+  std::vector<char> buffer = std::move(m_pending);
+  m_pending.clear();
+  auto oldest = m_pending_since;
+  auto last_read = oldest;
+  size_t complete = 0;
+  while (true) {
+    complete = findLastCompleteTPX3Batch(buffer.data(),
+                                         std::min(buffer.size(), limit));
+    const bool overdue =
+        m_max_latency.count() > 0 &&
+        std::chrono::steady_clock::now() - oldest >= m_max_latency;
+    if (m_eof || (complete > 0 && (buffer.size() >= chunkSize || overdue ||
+                                   !isDataWaiting()))) {
+      break;
+    }
+
+    if (!waitForData()) {
+      spdlog::info("Stream {} interrupted after {} bytes", m_source,
+                   m_received);
+      m_eof = true;
+      break;
+    }
+    const size_t offset = buffer.size();
+    const size_t wanted = std::min(
+        kReadSize, std::max(limit - std::min(limit, offset), size_t(8)));
+    buffer.resize(offset + wanted);
+    ssize_t n;
+    do {
+      n = read(m_fd, buffer.data() + offset, wanted);
+    } while (n == -1 && errno == EINTR);
+    if (n == -1) {
+      spdlog::error("Failed to read stream {}: {}", m_source,
+                    strerror(errno));
+      throw std::runtime_error("Failed to read stream");
+    }
+    buffer.resize(offset + n);
+    m_received += n;
+    last_read = std::chrono::steady_clock::now();
+    if (offset == 0) oldest = last_read;
+    if (n == 0) {
+      spdlog::info("End of stream {} after {} bytes", m_source, m_received);
+      m_eof = true;
+    }
+  }
+
+  // at the end of the stream, the partial batch left goes out as is
+  if (complete == 0 && m_eof) complete = std::min(buffer.size(), limit);
+  m_pending.assign(buffer.begin() + complete, buffer.end());
+  // NOTE: the partial batch left over is at most 64 KiB, it came in with the
+  //       last read
+  m_pending_since = last_read;
+  buffer.resize(complete);
+  m_position += complete;
+  return buffer;
+}
+
+/**
+ * @brief Streams cannot be seeked, only the current position is accepted.
+ *
+ * @param[in] position
+ */
+void TPX3StreamReader::seek(size_t position) {
+  if (position != m_position) {
+    throw std::runtime_error("Cannot seek in stream " + m_source);
+  }
+}
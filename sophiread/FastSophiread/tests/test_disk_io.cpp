@@ -36,10 +36,15 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 
 #include <filesystem>
 #include <random>
 #include <regex>
+#include <thread>
 
 #include "disk_io.h"
 #include "spdlog/spdlog.h"
@@ -71,6 +76,253 @@ TEST(DiskIOTest, MmapTPX3RawToMapInfo) {
   EXPECT_EQ(raw.max, ref_size);
 }
 
+// a batch header with n_packets packets of 8 bytes filled with fill
+std::vector<char> makeTPX3Batch(int n_packets, char fill) {
+  std::vector<char> batch(8 + 8 * n_packets, fill);
+  const int size = 8 * n_packets;
+  batch[0] = 'T';
+  batch[1] = 'P';
+  batch[2] = 'X';
+  batch[3] = '3';
+  batch[4] = 0;
+  batch[5] = 0;
+  batch[6] = static_cast<char>(size & 0xff);
+  batch[7] = static_cast<char>((size >> 8) & 0xff);
+  return batch;
+}
+
+TEST(DiskIOTest, FollowGrowingTPX3File) {
+  const std::string filename = "test_follow.tpx3";
+  std::vector<char> contents;
+  for (int i = 0; i < 4; ++i) {
+    auto batch = makeTPX3Batch(10 + i, static_cast<char>(i + 1));
+    contents.insert(contents.end(), batch.begin(), batch.end());
+  }
+  const size_t first_batch = 8 + 8 * 10;
+  {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  }
+  TPX3FileFollower follower(filename);
+  EXPECT_TRUE(follower.readAppended().empty());
+
+  auto append = [&](size_t begin, size_t end) {
+    std::ofstream out(filename, std::ios::binary | std::ios::app);
+    out.write(contents.data() + begin, end - begin);
+  };
+
+  // first batch plus half of the header of the second
+  append(0, first_batch + 4);
+  std::vector<char> read = follower.readAppended();
+  EXPECT_EQ(read.size(), first_batch);
+  EXPECT_EQ(follower.getPendingBytes(), 4u);
+
+  // the rest of the file but the last packet
+  append(first_batch + 4, contents.size() - 8);
+  auto more = follower.readAppended();
+  read.insert(read.end(), more.begin(), more.end());
+  EXPECT_EQ(more[0], 'T');
+  EXPECT_EQ(read.size(), contents.size() - (8 + 8 * 13));
+
+  // completes the last batch, read in bounded steps
+  append(contents.size() - 8, contents.size());
+  while (follower.getPosition() < follower.getFileSize() ||
+         follower.getPendingBytes() > 0) {
+    more = follower.readAppended(16);
+    read.insert(read.end(), more.begin(), more.end());
+  }
+  EXPECT_EQ(read, contents);
+  EXPECT_TRUE(follower.readAppended().empty());
+
+  std::filesystem::remove(filename);
+}
+
+TEST(DiskIOTest, PrefetchReaderMatchesMmapReader) {
+  const std::string filename = "test_prefetch.tpx3";
+  std::vector<char> contents(3 * 100000 + 4321);
+  for (size_t i = 0; i < contents.size(); ++i) {
+    contents[i] = static_cast<char>((i * 2654435761u) >> 13);
+  }
+  {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(contents.data(), contents.size());
+  }
+
+  auto read_all = [](ITPX3Reader &reader, size_t chunk_size) {
+    std::vector<char> read;
+    while (!reader.isEOF()) {
+      auto chunk = reader.readChunk(chunk_size);
+      read.insert(read.end(), chunk.begin(), chunk.end());
+    }
+    return read;
+  };
+
+  TPX3FileReader mmap_reader(filename);
+  EXPECT_EQ(read_all(mmap_reader, 100000), contents);
+
+  for (bool direct_io : {false, true}) {
+    TPX3ReaderOptions options;
+    options.backend = TPX3ReaderBackend::pread;
+    options.queue_depth = 3;
+    options.io_threads = 3;
+    options.request_size = 10000;
+    options.direct_io = direct_io;
+    auto reader = openTPX3Reader(filename, options);
+    EXPECT_EQ(reader->getTotalSize(), contents.size());
+
+    // chunks not aligned to the requests, then a different chunk size
+    auto first = reader->readChunk(77777);
+    EXPECT_EQ(first, std::vector<char>(contents.begin(),
+                                       contents.begin() + 77777));
+    auto rest = read_all(*reader, 100000);
+    first.insert(first.end(), rest.begin(), rest.end());
+    EXPECT_EQ(first, contents);
+    EXPECT_TRUE(reader->readChunk(100000).empty());
+
+    // resume in the middle of the file
+    reader->seek(123457);
+    EXPECT_EQ(reader->getPosition(), 123457u);
+    EXPECT_EQ(read_all(*reader, 65536),
+              std::vector<char>(contents.begin() + 123457, contents.end()));
+    EXPECT_THROW(reader->seek(contents.size() + 1), std::out_of_range);
+  }
+
+  EXPECT_THROW(parseTPX3ReaderBackend("io_uring"), std::runtime_error);
+  std::filesystem::remove(filename);
+}
+
+TEST(DiskIOTest, CompressedReaderMatchesRawFile) {
+  const std::string filename = "test_compressed.tpx3";
+  std::vector<char> contents;
+  for (int i = 0; contents.size() < 300000; ++i) {
+    auto batch = makeTPX3Batch(50 + i % 7, static_cast<char>(i % 5));
+    contents.insert(contents.end(), batch.begin(), batch.end());
+  }
+  {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(contents.data(), contents.size());
+  }
+  EXPECT_EQ(detectTPX3Codec(filename), TPX3Codec::none);
+
+  bool tested = false;
+  for (TPX3Codec codec : {TPX3Codec::zstd, TPX3Codec::lz4}) {
+    if (!isTPX3CodecAvailable(codec)) continue;
+    tested = true;
+    const std::string archive = filename + ".archive";
+    TPX3CompressOptions options;
+    options.codec = codec;
+    options.frame_size = 10000;
+    const uint64_t size = compressTPX3File(filename, archive, options);
+    EXPECT_EQ(std::filesystem::file_size(archive), size);
+    EXPECT_LT(size, contents.size());
+    EXPECT_EQ(detectTPX3Codec(archive), codec);
+
+    auto reader = openTPX3Reader(archive);
+    EXPECT_EQ(reader->getTotalSize(), contents.size());
+    std::vector<char> read;
+    while (!reader->isEOF()) {
+      auto chunk = reader->readChunk(7777);
+      read.insert(read.end(), chunk.begin(), chunk.end());
+    }
+    EXPECT_EQ(read, contents);
+
+    reader->seek(123457);
+    auto chunk = reader->readChunk(25000);
+    EXPECT_EQ(chunk, std::vector<char>(contents.begin() + 123457,
+                                       contents.begin() + 148457));
+
+    // without the seek table the frames are found from their headers
+    const size_t frames = (contents.size() + 9999) / 10000;
+    std::filesystem::resize_file(archive, size - (8 + 8 * frames + 9));
+    TPX3CompressedReader walked(archive);
+    EXPECT_EQ(walked.getFrames(), frames);
+    EXPECT_EQ(walked.readChunk(contents.size()), contents);
+    std::filesystem::remove(archive);
+  }
+  std::filesystem::remove(filename);
+  if (!tested) GTEST_SKIP() << "built without zstd and lz4";
+}
+
+TEST(DiskIOTest, StreamReaderMatchesRawFile) {
+  std::vector<char> contents;
+  for (int i = 0; contents.size() < 300000; ++i) {
+    auto batch = makeTPX3Batch(50 + i % 7, static_cast<char>(i % 5));
+    contents.insert(contents.end(), batch.begin(), batch.end());
+  }
+  // the sender writes in pieces that cut batches
+  auto send = [&](int fd) {
+    for (size_t done = 0; done < contents.size();) {
+      const size_t n = std::min<size_t>(1001, contents.size() - done);
+      ASSERT_EQ(write(fd, contents.data() + done, n), static_cast<ssize_t>(n));
+      done += n;
+    }
+    close(fd);
+  };
+  // every chunk but the last starts on a batch header
+  auto receive = [&](ITPX3Reader& reader) {
+    EXPECT_FALSE(reader.isSeekable());
+    std::vector<char> read;
+    while (!reader.isEOF()) {
+      auto chunk = reader.readChunk(7777);
+      if (chunk.empty()) continue;
+      EXPECT_EQ(chunk[0], 'T');
+      EXPECT_LE(chunk.size(), 8u + 0xffff);
+      read.insert(read.end(), chunk.begin(), chunk.end());
+    }
+    EXPECT_EQ(reader.getTotalSize(), contents.size());
+    EXPECT_THROW(reader.seek(0), std::runtime_error);
+    return read;
+  };
+
+  // FIFO
+  const std::string fifo = "test_stream.fifo";
+  std::filesystem::remove(fifo);
+  ASSERT_EQ(mkfifo(fifo.c_str(), 0600), 0);
+  EXPECT_TRUE(isTPX3Stream(fifo));
+  std::thread fifo_writer([&] { send(open(fifo.c_str(), O_WRONLY)); });
+  EXPECT_EQ(receive(*openTPX3Reader(fifo)), contents);
+  fifo_writer.join();
+  std::filesystem::remove(fifo);
+
+  // TCP, the reader connects to the sender
+  const int server = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+  ASSERT_EQ(listen(server, 1), 0);
+  socklen_t len = sizeof(addr);
+  getsockname(server, reinterpret_cast<sockaddr*>(&addr), &len);
+  std::thread tcp_writer([&] { send(accept(server, nullptr, nullptr)); });
+  TPX3StreamReader tcp("tcp://127.0.0.1:" +
+                       std::to_string(ntohs(addr.sin_port)));
+  // chunks cut early by the latency bound are still whole batches
+  tcp.setMaxLatency(std::chrono::milliseconds(1));
+  EXPECT_EQ(receive(tcp), contents);
+  tcp_writer.join();
+  close(server);
+
+  // Unix socket, the reader listens for the sender
+  const std::string path = "test_stream.sock";
+  std::thread unix_writer([&] {
+    sockaddr_un unix_addr{};
+    unix_addr.sun_family = AF_UNIX;
+    std::strncpy(unix_addr.sun_path, path.c_str(),
+                 sizeof(unix_addr.sun_path) - 1);
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    while (connect(fd, reinterpret_cast<sockaddr*>(&unix_addr),
+                   sizeof(unix_addr)) == -1) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    send(fd);
+  });
+  {
+    TPX3StreamReader unix_stream("unix://listen@" + path);
+    EXPECT_EQ(receive(unix_stream), contents);
+  }
+  unix_writer.join();
+  EXPECT_FALSE(std::filesystem::exists(path));
+}
+
 class FileNameGeneratorTest : public ::testing::Test {
  protected:
   std::regex expectedPattern;
@@ -135,7 +387,11 @@ TEST_F(FileNameGeneratorTest, FileNameWithoutExtension) {
 
 class SaveHitsTest : public ::testing::Test {
  protected:
-  std::string testFileName = "testfile.hdf5";
+  // NOTE: one file per test, ctest -j runs them side by side
+  const ::testing::TestInfo* test_info =
+      ::testing::UnitTest::GetInstance()->current_test_info();
+  std::string testFileName = std::string(test_info->test_suite_name()) + "_" +
+                             test_info->name() + ".hdf5";
 
   // Helper function to generate random hits for testing
   std::vector<Hit> generateRandomHits(size_t numHits) {
@@ -189,9 +445,44 @@ TEST_F(SaveHitsTest, TestSaveAndAppendToHDF5) {
   file.close();
 }
 
+TEST_F(SaveHitsTest, TestExtendibleSchemasRoundTrip) {
+  std::vector<Hit> hits = generateRandomHits(10);
+
+  for (const auto schema : {HDF5Schema::legacy, HDF5Schema::compact}) {
+    {
+      H5::H5File file(testFileName, H5F_ACC_TRUNC);
+      appendHitsToHDF5Extendible(file, hits, schema);
+      appendHitsToHDF5Extendible(file, hits, schema);
+    }
+
+    std::vector<Hit> loaded = readHitsFromHDF5(testFileName);
+    ASSERT_EQ(loaded.size(), 2 * hits.size());
+    for (size_t i = 0; i < loaded.size(); ++i) {
+      const Hit& expected = hits[i % hits.size()];
+      EXPECT_EQ(loaded[i].getX(), expected.getX());
+      EXPECT_EQ(loaded[i].getTOT(), expected.getTOT());
+      EXPECT_EQ(loaded[i].getFTOA(), expected.getFTOA());
+      EXPECT_EQ(loaded[i].getTOF(), expected.getTOF());
+      EXPECT_EQ(loaded[i].getSPIDERTIME(), expected.getSPIDERTIME());
+    }
+  }
+
+  // compact schema stores native types with their units
+  H5::H5File file(testFileName, H5F_ACC_RDONLY);
+  H5::DataSet tof = file.openGroup("hits").openDataSet("tof");
+  EXPECT_EQ(tof.getDataType().getSize(), sizeof(uint32_t));
+  double scale = 0;
+  tof.openAttribute("scale_to_ns").read(H5::PredType::NATIVE_DOUBLE, &scale);
+  EXPECT_DOUBLE_EQ(scale, 25.0);
+}
+
 class SaveNeutronTest : public ::testing::Test {
  protected:
-  std::string testFileName = "testfile.hdf5";
+  // NOTE: one file per test, ctest -j runs them side by side
+  const ::testing::TestInfo* test_info =
+      ::testing::UnitTest::GetInstance()->current_test_info();
+  std::string testFileName = std::string(test_info->test_suite_name()) + "_" +
+                             test_info->name() + ".hdf5";
 
   // Helper function to generate random neutrons for testing
   std::vector<Neutron> generateRandomNeutrons(size_t numNeutrons) {
@@ -245,6 +536,27 @@ TEST_F(SaveNeutronTest, TestSaveAndAppendToHDF5) {
   file.close();
 }
 
+TEST_F(SaveNeutronTest, TestExtendibleSchemasRoundTrip) {
+  std::vector<Neutron> neutrons = generateRandomNeutrons(10);
+
+  for (const auto schema : {HDF5Schema::legacy, HDF5Schema::compact}) {
+    {
+      H5::H5File file(testFileName, H5F_ACC_TRUNC);
+      appendNeutronsToHDF5Extendible(file, neutrons, schema);
+    }
+
+    std::vector<Neutron> loaded = readNeutronsFromHDF5(testFileName);
+    ASSERT_EQ(loaded.size(), neutrons.size());
+    for (size_t i = 0; i < loaded.size(); ++i) {
+      EXPECT_FLOAT_EQ(loaded[i].getX(), neutrons[i].getX());
+      EXPECT_FLOAT_EQ(loaded[i].getTOF_ns(), neutrons[i].getTOF_ns());
+      EXPECT_EQ(loaded[i].getNHits(), neutrons[i].getNHits());
+    }
+  }
+
+  EXPECT_THROW(parseHDF5Schema("packed"), std::runtime_error);
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
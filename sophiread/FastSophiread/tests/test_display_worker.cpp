@@ -0,0 +1,244 @@
+/**
+ * @file test_display_worker.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief unit test for display_worker.h
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "abs.h"
+#include "disk_io.h"
+#include "display_worker.h"
+
+namespace {
+
+const std::string kRawFile = "../data/suann_socket_background_serval32.tpx3";
+
+/**
+ * @brief Sends the contents to the first client, then keeps the connection
+ * open and idle until destroyed.
+ */
+class IdleSender {
+ public:
+  explicit IdleSender(const std::vector<char>& contents) {
+    m_server = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(m_server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    listen(m_server, 1);
+    socklen_t len = sizeof(addr);
+    getsockname(m_server, reinterpret_cast<sockaddr*>(&addr), &len);
+    m_port = ntohs(addr.sin_port);
+    m_sender = std::thread([this, &contents] {
+      m_client = accept(m_server, nullptr, nullptr);
+      size_t sent = 0;
+      while (sent < contents.size()) {
+        // NOTE: the worker may hang up first, which must not raise SIGPIPE
+        const ssize_t n = send(m_client, contents.data() + sent,
+                               contents.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) break;
+        sent += n;
+      }
+    });
+  }
+
+  ~IdleSender() {
+    m_sender.join();
+    close(m_client);
+    close(m_server);
+  }
+
+  std::string url() const {
+    return "tcp://127.0.0.1:" + std::to_string(m_port);
+  }
+
+ private:
+  int m_server = -1;
+  int m_client = -1;
+  int m_port = 0;
+  std::thread m_sender;
+};
+
+}  // namespace
+
+TEST(DisplayWorkerTest, MatchesSingleThreadedReduction) {
+  // reference: the whole file as one chunk
+  auto raw = readTPX3RawToCharVec(kRawFile);
+  auto batches = findTPX3H(raw);
+  unsigned long tdc_timestamp = 0;
+  ABS abs_alg(5.0, 1, 75);
+  uint64_t hits = 0;
+  std::vector<Neutron> neutrons;
+  std::vector<uint32_t> image(517 * 517, 0);
+  for (auto& batch : batches) {
+    updateTimestamp(batch, raw, tdc_timestamp);
+    extractHitsTDC(batch, raw);
+    hits += batch.hits.size();
+    abs_alg.reset();
+    abs_alg.set_method("centroid");
+    abs_alg.fit(batch.hits);
+    for (const auto& neutron : abs_alg.get_events(batch.hits)) {
+      neutrons.push_back(neutron);
+      const int x = std::round(neutron.getX());
+      const int y = std::round(neutron.getY());
+      if (x >= 0 && x < 517 && y >= 0 && y < 517) ++image[y * 517 + x];
+    }
+  }
+  ASSERT_GT(neutrons.size(), 0u);
+
+  // small chunks and blocks, so batches are cut and handed over many times
+  DisplayWorkerOptions options;
+  options.chunk_size = 100000;
+  options.batches_per_block = 7;
+  options.blocks = 2;
+  options.keep_neutrons = true;
+  DisplayWorker worker(options);
+  EXPECT_FALSE(worker.isRunning());
+  worker.start(kRawFile);
+  EXPECT_THROW(worker.start(kRawFile), std::runtime_error);
+  worker.wait();
+
+  const DisplayProgress progress = worker.getProgress();
+  EXPECT_TRUE(progress.done);
+  EXPECT_EQ(progress.bytes_read, raw.size());
+  EXPECT_EQ(progress.total_bytes, raw.size());
+  EXPECT_EQ(progress.hits, hits);
+  EXPECT_EQ(progress.neutrons, neutrons.size());
+  EXPECT_EQ(worker.getError(), "");
+
+  std::vector<uint32_t> copy;
+  uint64_t version = 0;
+  ASSERT_TRUE(worker.copyImage(copy, version));
+  EXPECT_EQ(copy, image);
+  EXPECT_FALSE(worker.copyImage(copy, version));  // unchanged
+
+  const auto& kept = worker.getNeutrons();
+  ASSERT_EQ(kept.size(), neutrons.size());
+  for (size_t i = 0; i < kept.size(); ++i) {
+    ASSERT_EQ(kept[i].getX(), neutrons[i].getX());
+    ASSERT_EQ(kept[i].getTOF(), neutrons[i].getTOF());
+  }
+
+  // a second run starts from an empty image
+  worker.start(kRawFile);
+  worker.wait();
+  ASSERT_TRUE(worker.copyImage(copy, version));
+  EXPECT_EQ(copy, image);
+}
+
+TEST(DisplayWorkerTest, RotatesEveryNeutronBeforeBinning) {
+  DisplayWorkerOptions options;
+  options.super_resolution = 4.0;
+  options.rotation = -1.0;
+  options.keep_neutrons = true;
+  DisplayWorker worker(options);
+  worker.start(kRawFile);
+  worker.wait();
+  ASSERT_EQ(worker.getError(), "");
+
+  const int size = static_cast<int>(worker.getImageSize());
+  const double c = std::cos(-1.0 * M_PI / 180.0);
+  const double s = std::sin(-1.0 * M_PI / 180.0);
+  std::vector<uint32_t> image(static_cast<size_t>(size) * size, 0);
+  for (const auto& neutron : worker.getNeutrons()) {
+    const double fx = neutron.getX() * 4.0;
+    const double fy = neutron.getY() * 4.0;
+    const int x = std::round(fx * c - fy * s);
+    const int y = std::round(fx * s + fy * c);
+    if (x >= 0 && x < size && y >= 0 && y < size) ++image[y * size + x];
+  }
+  ASSERT_GT(worker.getNeutrons().size(), 0u);
+
+  std::vector<uint32_t> copy;
+  uint64_t version = 0;
+  ASSERT_TRUE(worker.copyImage(copy, version));
+  EXPECT_EQ(copy, image);
+}
+
+TEST(DisplayWorkerTest, StopCancelsAndErrorsAreReported) {
+  DisplayWorkerOptions options;
+  options.chunk_size = 10000;
+  options.batches_per_block = 1;
+  options.blocks = 1;
+  DisplayWorker worker(options);
+  worker.start(kRawFile);
+  worker.stop();
+  EXPECT_FALSE(worker.isRunning());
+  EXPECT_LE(worker.getProgress().bytes_read, 2363680u);
+
+  worker.start("no_such_file.tpx3");
+  worker.wait();
+  EXPECT_FALSE(worker.isRunning());
+  EXPECT_NE(worker.getError(), "");
+}
+
+TEST(DisplayWorkerTest, StopWakesAnIdleStream) {
+  auto contents = readTPX3RawToCharVec(kRawFile);
+  IdleSender sender(contents);
+
+  DisplayWorker worker;
+  worker.start(sender.url());
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  while (worker.getProgress().bytes_read < contents.size() &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(worker.getProgress().bytes_read, contents.size());
+
+  // the parser is now blocked on the idle stream
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  worker.stop();
+  EXPECT_FALSE(worker.isRunning());
+  EXPECT_EQ(worker.getError(), "");
+}
+
+TEST(DisplayWorkerTest, ClusteringFailureWakesAnIdleStream) {
+  // a few batches only, the stream is idle by the time they are clustered
+  auto contents = readTPX3RawToCharVec(kRawFile);
+  contents.resize(256 * 1024);
+  IdleSender sender(contents);
+
+  // the clustering thread throws on the first neutrons, which are handed
+  // over in one block right before the parser waits for more data
+  DisplayWorkerOptions options;
+  options.method = "no_such_method";
+  options.batches_per_block = 1000000;
+  DisplayWorker worker(options);
+  worker.start(sender.url());
+  worker.wait();
+  EXPECT_FALSE(worker.isRunning());
+  EXPECT_NE(worker.getError(), "");
+
+  // the worker can be started again
+  worker.start(kRawFile);
+  worker.wait();
+  EXPECT_NE(worker.getError(), "");
+}
+
+TEST(DisplayWorkerTest, KeepsAtMostMaxKeptNeutrons) {
+  DisplayWorkerOptions options;
+  options.keep_neutrons = true;
+  options.max_kept_neutrons = 100;
+  DisplayWorker worker(options);
+  worker.start(kRawFile);
+  worker.wait();
+  ASSERT_EQ(worker.getError(), "");
+  EXPECT_GT(worker.getProgress().neutrons, 100u);
+  EXPECT_EQ(worker.getNeutrons().size(), 100u);
+}
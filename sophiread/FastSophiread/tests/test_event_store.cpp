@@ -0,0 +1,144 @@
+/**
+ * @file test_event_store.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief unit test for event_store.h
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include <gtest/gtest.h>
+
+#include <filesystem>
+
+#include "event_store.h"
+
+class EventStoreTest : public ::testing::Test {
+ protected:
+  // NOTE: one store per test, ctest -j runs them side by side
+  const ::testing::TestInfo* test_info =
+      ::testing::UnitTest::GetInstance()->current_test_info();
+  std::string testDirectory =
+      std::string("test_event_store_") + test_info->name();
+
+  // spidertime grows by 10 per event
+  std::vector<Neutron> generateNeutrons(size_t first, size_t count) {
+    std::vector<Neutron> neutrons;
+    for (size_t i = first; i < first + count; ++i) {
+      neutrons.emplace_back(i * 0.5, i * 0.25, 1000.0 + i, 20.0, i % 7 + 1,
+                            i * 10);
+    }
+    return neutrons;
+  }
+
+  virtual void TearDown() { std::filesystem::remove_all(testDirectory); }
+};
+
+TEST_F(EventStoreTest, WriteAndReadBack) {
+  const std::vector<Neutron> neutrons = generateNeutrons(0, 1000);
+  {
+    EventStoreWriter writer(testDirectory, false, 64);
+    writer.append(neutrons);
+    EXPECT_EQ(writer.getEvents(), neutrons.size());
+  }
+
+  EventStoreReader reader(testDirectory);
+  ASSERT_EQ(reader.getEvents(), neutrons.size());
+  EXPECT_EQ(reader.getIndex().size(), 16u);
+
+  const std::vector<Neutron> loaded = reader.readNeutrons(0, 2000);
+  ASSERT_EQ(loaded.size(), neutrons.size());
+  for (size_t i = 0; i < loaded.size(); ++i) {
+    EXPECT_FLOAT_EQ(loaded[i].getX(), neutrons[i].getX());
+    EXPECT_FLOAT_EQ(loaded[i].getY(), neutrons[i].getY());
+    EXPECT_FLOAT_EQ(loaded[i].getTOF(), neutrons[i].getTOF());
+    EXPECT_EQ(loaded[i].getNHits(), neutrons[i].getNHits());
+    EXPECT_EQ(loaded[i].getSPIDERTIME(), neutrons[i].getSPIDERTIME());
+  }
+}
+
+TEST_F(EventStoreTest, ClampsClusterSize) {
+  {
+    EventStoreWriter writer(testDirectory);
+    writer.append({Neutron(1.0, 2.0, 3.0, 4.0, 70000, 10)});
+  }
+  EventStoreReader reader(testDirectory);
+  const std::vector<Neutron> loaded = reader.readNeutrons(0, 1);
+  ASSERT_EQ(loaded.size(), 1u);
+  EXPECT_EQ(loaded[0].getNHits(), 65535);
+}
+
+TEST_F(EventStoreTest, TimeWindowUsesIndex) {
+  {
+    EventStoreWriter writer(testDirectory, false, 100);
+    writer.append(generateNeutrons(0, 1000));
+  }
+
+  EventStoreReader reader(testDirectory);
+  // events 250..449 have spidertime in [2500, 4500)
+  const auto ranges = reader.findRows(2500, 4500);
+  ASSERT_EQ(ranges.size(), 1u);
+  EXPECT_EQ(ranges[0].first, 200u);
+  EXPECT_EQ(ranges[0].second, 500u);
+
+  std::vector<uint64_t> rows;
+  reader.forEachEventInWindow(2500, 4500,
+                              [&](uint64_t row) { rows.push_back(row); });
+  ASSERT_EQ(rows.size(), 200u);
+  EXPECT_EQ(rows.front(), 250u);
+  EXPECT_EQ(rows.back(), 449u);
+
+  EXPECT_TRUE(reader.findRows(20000, 30000).empty());
+}
+
+TEST_F(EventStoreTest, AppendToExistingStore) {
+  {
+    EventStoreWriter writer(testDirectory, false, 64);
+    writer.append(generateNeutrons(0, 100));
+  }
+  {
+    // an existing store keeps its own index stride
+    EventStoreWriter writer(testDirectory, true, 1000);
+    writer.append(generateNeutrons(100, 100));
+    EXPECT_EQ(writer.getEvents(), 200u);
+  }
+
+  EventStoreReader reader(testDirectory);
+  ASSERT_EQ(reader.getEvents(), 200u);
+  EXPECT_EQ(reader.getIndexStride(), 64u);
+  EXPECT_EQ(reader.getIndex().size(), 4u);
+  EXPECT_EQ(reader.getIndex()[1].max_spidertime, 1270u);
+  EXPECT_EQ(reader.getSpidertime()[199], 1990u);
+}
+
+TEST_F(EventStoreTest, TruncateToCheckpoint) {
+  {
+    EventStoreWriter writer(testDirectory, false, 64);
+    writer.append(generateNeutrons(0, 100));
+    writer.flush();
+    writer.append(generateNeutrons(100, 100));
+  }
+  {
+    EventStoreWriter writer(testDirectory, true);
+    writer.truncate(90);
+    EXPECT_EQ(writer.getEvents(), 90u);
+    writer.append(generateNeutrons(90, 10));
+  }
+
+  EventStoreReader reader(testDirectory);
+  ASSERT_EQ(reader.getEvents(), 100u);
+  EXPECT_EQ(reader.getIndex().size(), 2u);
+  EXPECT_EQ(reader.getIndex()[1].max_spidertime, 990u);
+  EXPECT_EQ(reader.getSpidertime()[99], 990u);
+  EXPECT_THROW(EventStoreWriter(testDirectory, true).truncate(101),
+               std::out_of_range);
+}
+
+TEST_F(EventStoreTest, EmptyStore) {
+  { EventStoreWriter writer(testDirectory); }
+  EventStoreReader reader(testDirectory);
+  EXPECT_EQ(reader.getEvents(), 0u);
+  EXPECT_TRUE(reader.findRows(0, UINT64_MAX).empty());
+  EXPECT_TRUE(reader.readNeutrons(0, 10).empty());
+}
@@ -0,0 +1,237 @@
+/**
+ * @file test_hdf5_appender.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief unit test for hdf5_appender.h
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <numeric>
+#include <random>
+
+#include "hdf5_appender.h"
+
+class HDF5AppenderTest : public ::testing::Test {
+ protected:
+  // NOTE: one file per test, ctest -j runs them side by side
+  const ::testing::TestInfo* test_info =
+      ::testing::UnitTest::GetInstance()->current_test_info();
+  std::string testFileName =
+      std::string("test_hdf5_appender_") + test_info->name() + ".h5";
+
+  std::vector<Hit> generateRandomHits(size_t numHits) {
+    std::vector<Hit> hits;
+    std::default_random_engine generator;
+    std::uniform_int_distribution<int> distribution(1, 1000);
+
+    for (size_t i = 0; i < numHits; ++i) {
+      hits.emplace_back(distribution(generator), distribution(generator),
+                        distribution(generator), distribution(generator),
+                        distribution(generator) % 16, distribution(generator),
+                        distribution(generator));
+    }
+    return hits;
+  }
+
+  virtual void TearDown() {
+    if (std::filesystem::exists(testFileName)) {
+      std::filesystem::remove(testFileName);
+    }
+  }
+};
+
+TEST_F(HDF5AppenderTest, ColumnsAcrossChunkBoundaries) {
+  HDF5AppenderOptions options;
+  options.chunk_rows = 100;
+
+  std::vector<uint32_t> values(1234);
+  std::iota(values.begin(), values.end(), 0);
+  {
+    H5::H5File file(testFileName, H5F_ACC_TRUNC);
+    HDF5ColumnAppender appender(file.openGroup("/"), options);
+    appender.addColumn("value", H5::PredType::NATIVE_UINT32);
+    // uneven batches, the last chunk is partial
+    for (size_t begin = 0; begin < values.size(); begin += 77) {
+      const size_t rows = std::min<size_t>(77, values.size() - begin);
+      appender.append({values.data() + begin}, rows);
+    }
+    EXPECT_EQ(appender.getRows(), values.size());
+    appender.close();
+  }
+
+  H5::H5File file(testFileName, H5F_ACC_RDONLY);
+  H5::DataSet dataset = file.openDataSet("value");
+  hsize_t dims[1];
+  dataset.getSpace().getSimpleExtentDims(dims);
+  ASSERT_EQ(dims[0], values.size());
+  std::vector<uint32_t> loaded(dims[0]);
+  dataset.read(loaded.data(), H5::PredType::NATIVE_UINT32);
+  EXPECT_EQ(loaded, values);
+}
+
+TEST_F(HDF5AppenderTest, ResumeDropsRowsPastCheckpoint) {
+  HDF5AppenderOptions options;
+  options.chunk_rows = 100;
+
+  std::vector<uint32_t> values(1234);
+  std::iota(values.begin(), values.end(), 0);
+  {
+    // checkpoint after 550 rows, then 250 more rows that must be dropped
+    H5::H5File file(testFileName, H5F_ACC_TRUNC);
+    HDF5ColumnAppender appender(file.openGroup("/"), options);
+    appender.addColumn("value", H5::PredType::NATIVE_UINT32);
+    appender.append({values.data()}, 550);
+    appender.flush();
+    std::vector<uint32_t> stale(250, 0xdead);
+    appender.append({stale.data()}, stale.size());
+    appender.close();
+  }
+  {
+    H5::H5File file(testFileName, H5F_ACC_RDWR);
+    HDF5ColumnAppender appender(file.openGroup("/"), options);
+    appender.openColumn("value", H5::PredType::NATIVE_UINT32, 550);
+    EXPECT_EQ(appender.getRows(), 550u);
+    appender.append({values.data() + 550}, values.size() - 550);
+    appender.close();
+  }
+
+  {
+    H5::H5File file(testFileName, H5F_ACC_RDONLY);
+    H5::DataSet dataset = file.openDataSet("value");
+    hsize_t dims[1];
+    dataset.getSpace().getSimpleExtentDims(dims);
+    ASSERT_EQ(dims[0], values.size());
+    std::vector<uint32_t> loaded(dims[0]);
+    dataset.read(loaded.data(), H5::PredType::NATIVE_UINT32);
+    EXPECT_EQ(loaded, values);
+  }
+
+  // a different chunking cannot be resumed
+  H5::H5File rw(testFileName, H5F_ACC_RDWR);
+  options.chunk_rows = 64;
+  HDF5ColumnAppender other(rw.openGroup("/"), options);
+  EXPECT_THROW(other.openColumn("value", H5::PredType::NATIVE_UINT32, 100),
+               std::runtime_error);
+}
+
+TEST_F(HDF5AppenderTest, HitsRoundTrip) {
+  const std::vector<Hit> hits = generateRandomHits(2500);
+
+  for (const auto schema : {HDF5Schema::legacy, HDF5Schema::compact}) {
+    for (const auto compression : {H5Compression::none,
+                                   H5Compression::deflate}) {
+      HDF5AppenderOptions options;
+      options.chunk_rows = 1000;
+      options.compression = compression;
+      {
+        H5::H5File file(testFileName, H5F_ACC_TRUNC);
+        HitsHDF5Appender appender(file, schema, options);
+        appender.append(hits);
+        appender.append(hits);
+      }  // closed by the destructor
+
+      const std::vector<Hit> loaded = readHitsFromHDF5(testFileName);
+      ASSERT_EQ(loaded.size(), 2 * hits.size());
+      for (size_t i = 0; i < loaded.size(); ++i) {
+        const Hit& expected = hits[i % hits.size()];
+        ASSERT_EQ(loaded[i].getX(), expected.getX());
+        ASSERT_EQ(loaded[i].getTOF(), expected.getTOF());
+        ASSERT_EQ(loaded[i].getSPIDERTIME(), expected.getSPIDERTIME());
+      }
+    }
+  }
+}
+
+TEST_F(HDF5AppenderTest, NeutronsRoundTrip) {
+  std::vector<Neutron> neutrons;
+  for (int i = 0; i < 300; ++i) {
+    neutrons.emplace_back(i * 0.5, i * 0.25, 1000.0 + i, 20.0, i % 7 + 1);
+  }
+
+  HDF5AppenderOptions options;
+  options.chunk_rows = 128;
+  {
+    H5::H5File file(testFileName, H5F_ACC_TRUNC);
+    NeutronsHDF5Appender appender(file, HDF5Schema::compact, options);
+    appender.append(neutrons);
+  }
+
+  const std::vector<Neutron> loaded = readNeutronsFromHDF5(testFileName);
+  ASSERT_EQ(loaded.size(), neutrons.size());
+  for (size_t i = 0; i < loaded.size(); ++i) {
+    EXPECT_DOUBLE_EQ(loaded[i].getX(), neutrons[i].getX());
+    EXPECT_DOUBLE_EQ(loaded[i].getTOF(), neutrons[i].getTOF());
+    EXPECT_EQ(loaded[i].getNHits(), neutrons[i].getNHits());
+  }
+}
+
+TEST_F(HDF5AppenderTest, SWMRReaderSeesFlushedRows) {
+  HDF5AppenderOptions options;
+  options.chunk_rows = 100;
+  std::vector<uint32_t> values(250);
+  std::iota(values.begin(), values.end(), 0);
+
+  // NOTE: the reader is forked before the writer touches the file, so that
+  //       the child does not inherit an open HDF5 handle on it
+  int ready[2];
+  ASSERT_EQ(pipe(ready), 0);
+  const pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    close(ready[1]);
+    char c;
+    if (read(ready[0], &c, 1) != 1) _exit(2);
+    try {
+      H5::H5File file(testFileName, H5F_ACC_RDONLY | H5F_ACC_SWMR_READ);
+      H5::DataSet dataset = file.openDataSet("value");
+      hsize_t dims[1];
+      dataset.getSpace().getSimpleExtentDims(dims);
+      std::vector<uint32_t> loaded(dims[0]);
+      dataset.read(loaded.data(), H5::PredType::NATIVE_UINT32);
+      const bool ok =
+          dims[0] == 150 &&
+          std::equal(loaded.begin(), loaded.end(), values.begin());
+      _exit(ok ? 0 : 1);
+    } catch (...) {
+      _exit(3);
+    }
+  }
+  close(ready[0]);
+
+  H5::H5File file = createHDF5File(testFileName, true);
+  HDF5ColumnAppender appender(file.openGroup("/"), options);
+  appender.addColumn("value", H5::PredType::NATIVE_UINT32);
+  startSWMRWrite(file);
+  // one full chunk and a partial one
+  appender.append({values.data()}, 150);
+  appender.flush();
+
+  ASSERT_EQ(write(ready[1], "x", 1), 1);
+  close(ready[1]);
+  int status = 0;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+
+  // the flushed partial chunk is rewritten as more rows arrive
+  appender.append({values.data() + 150}, 100);
+  appender.close();
+  file.close();
+
+  H5::H5File reopened(testFileName, H5F_ACC_RDONLY);
+  H5::DataSet dataset = reopened.openDataSet("value");
+  hsize_t dims[1];
+  dataset.getSpace().getSimpleExtentDims(dims);
+  ASSERT_EQ(dims[0], values.size());
+  std::vector<uint32_t> loaded(dims[0]);
+  dataset.read(loaded.data(), H5::PredType::NATIVE_UINT32);
+  EXPECT_EQ(loaded, values);
+}
@@ -0,0 +1,108 @@
+/**
+ * @file test_live_image.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief unit test for live_image.h
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "live_image.h"
+
+namespace {
+
+std::string segmentName(const std::string& test) {
+  return "/sophiread_test_" + test + "_" + std::to_string(getpid());
+}
+
+}  // namespace
+
+TEST(LiveImageTest, ViewerSeesPublishedFrames) {
+  const std::string name = segmentName("frames");
+  LiveImagePublisher publisher(name, 4, 3, 5);
+  LiveImageReader reader(name);
+  EXPECT_EQ(reader.getWidth(), 4);
+  EXPECT_EQ(reader.getHeight(), 3);
+  EXPECT_EQ(reader.getTOFBins(), 5);
+
+  LiveImageFrame frame;
+  EXPECT_FALSE(reader.read(frame));  // nothing published yet
+  EXPECT_EQ(reader.getLatestFrame(), 0);
+
+  publisher.image()[1 * 4 + 2] = 7;
+  publisher.spectrum()[3] = 9;
+  publisher.counters().neutrons = 42;
+  publisher.publish();
+  ASSERT_TRUE(reader.read(frame));
+  EXPECT_EQ(frame.counters.frame, 1);
+  EXPECT_EQ(frame.counters.neutrons, 42);
+  EXPECT_EQ(frame.width, 4);
+  EXPECT_EQ(frame.height, 3);
+  EXPECT_EQ(frame.image[1 * 4 + 2], 7);
+  EXPECT_EQ(frame.spectrum[3], 9);
+  EXPECT_FALSE(reader.isFinished());
+
+  publisher.image()[0] = 1;
+  publisher.finish();
+  ASSERT_TRUE(reader.read(frame));
+  EXPECT_EQ(frame.counters.frame, 2);
+  EXPECT_EQ(frame.image[0], 1);
+  EXPECT_TRUE(reader.isFinished());
+}
+
+TEST(LiveImageTest, SegmentIsRemovedWithThePublisher) {
+  const std::string name = segmentName("removed");
+  EXPECT_THROW(LiveImageReader missing(name), std::runtime_error);
+  {
+    LiveImagePublisher publisher(name, 2, 2, 1);
+    publisher.publish();
+    LiveImageReader reader(name);
+    LiveImageFrame frame;
+    EXPECT_TRUE(reader.read(frame));
+  }
+  EXPECT_THROW(LiveImageReader removed(name), std::runtime_error);
+}
+
+TEST(LiveImageTest, ViewersNeverSeeTornFrames) {
+  const std::string name = segmentName("torn");
+  LiveImagePublisher publisher(name, 64, 64, 16);
+  LiveImageReader reader(name);
+
+  // every count of frame n is n, a torn copy mixes two frames
+  std::atomic<bool> done{false};
+  std::thread writer([&]() {
+    for (uint32_t n = 1; n <= 2000; ++n) {
+      std::fill(publisher.image().begin(), publisher.image().end(), n);
+      std::fill(publisher.spectrum().begin(), publisher.spectrum().end(), n);
+      publisher.counters().hits = n;
+      publisher.publish();
+    }
+    done = true;
+  });
+
+  LiveImageFrame frame;
+  uint64_t last_frame = 0;
+  while (!done) {
+    if (!reader.read(frame)) continue;
+    const uint32_t n = static_cast<uint32_t>(frame.counters.hits);
+    ASSERT_EQ(frame.counters.frame, n);
+    ASSERT_GE(frame.counters.frame, last_frame);
+    last_frame = frame.counters.frame;
+    ASSERT_TRUE(std::all_of(frame.image.begin(), frame.image.end(),
+                            [n](uint32_t v) { return v == n; }));
+    ASSERT_TRUE(std::all_of(frame.spectrum.begin(), frame.spectrum.end(),
+                            [n](uint32_t v) { return v == n; }));
+  }
+  writer.join();
+  ASSERT_TRUE(reader.read(frame));
+  EXPECT_EQ(frame.counters.frame, 2000);
+}
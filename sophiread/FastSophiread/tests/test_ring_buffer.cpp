@@ -0,0 +1,189 @@
+/**
+ * @file test_ring_buffer.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief unit test for ring_buffer.h
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ring_buffer.h"
+
+TEST(RingBufferTest, FirstInFirstOut) {
+  RingBuffer<int> ring(3);
+  EXPECT_EQ(ring.capacity(), 4);
+
+  int value = 0;
+  EXPECT_FALSE(ring.tryPop(value));
+  for (int i = 0; i < 4; ++i) EXPECT_TRUE(ring.tryPush(i));
+  EXPECT_FALSE(ring.tryPush(4));  // full
+  EXPECT_EQ(ring.sizeApprox(), 4);
+
+  // wrap around a few laps
+  for (int i = 0; i < 20; ++i) {
+    ASSERT_TRUE(ring.tryPop(value));
+    EXPECT_EQ(value, i);
+    ASSERT_TRUE(ring.tryPush(i + 4));
+  }
+  EXPECT_EQ(ring.sizeApprox(), 4);
+}
+
+TEST(RingBufferTest, FailedPushKeepsTheValue) {
+  RingBuffer<std::unique_ptr<int>> ring(1);
+  EXPECT_EQ(ring.capacity(), 2);
+  EXPECT_TRUE(ring.tryPush(std::make_unique<int>(0)));
+  EXPECT_TRUE(ring.tryPush(std::make_unique<int>(1)));
+  auto value = std::make_unique<int>(2);
+  EXPECT_FALSE(ring.tryPush(std::move(value)));
+  ASSERT_NE(value, nullptr);
+  EXPECT_EQ(*value, 2);
+}
+
+TEST(RingBufferTest, CloseDrainsThenFails) {
+  RingBuffer<int> ring(4);
+  EXPECT_TRUE(ring.push(1));
+  EXPECT_TRUE(ring.push(2));
+  ring.close();
+  EXPECT_FALSE(ring.push(3));
+
+  int value = 0;
+  EXPECT_TRUE(ring.pop(value));
+  EXPECT_EQ(value, 1);
+  EXPECT_TRUE(ring.pop(value));
+  EXPECT_EQ(value, 2);
+  EXPECT_FALSE(ring.pop(value));
+}
+
+TEST(RingBufferTest, CloseWakesBlockedConsumers) {
+  RingBuffer<int> ring(2);
+  std::vector<std::thread> consumers;
+  std::atomic<int> woken{0};
+  for (int i = 0; i < 3; ++i) {
+    consumers.emplace_back([&]() {
+      int value;
+      if (!ring.pop(value)) ++woken;
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ring.close();
+  for (auto& consumer : consumers) consumer.join();
+  EXPECT_EQ(woken, 3);
+}
+
+TEST(RingBufferTest, ManyProducersManyConsumers) {
+  constexpr int kProducers = 4;
+  constexpr int kConsumers = 4;
+  constexpr int kValues = 100000;  // per producer
+  RingBuffer<int> ring(64);
+
+  std::vector<std::vector<int>> seen(kConsumers,
+                                     std::vector<int>(kProducers * kValues));
+  std::vector<std::thread> consumers;
+  for (int c = 0; c < kConsumers; ++c) {
+    consumers.emplace_back([&, c]() {
+      int value;
+      int last[kProducers];
+      std::fill(last, last + kProducers, -1);
+      while (ring.pop(value)) {
+        ++seen[c][value];
+        // each producer's values come out in order
+        const int producer = value / kValues;
+        EXPECT_GT(value, last[producer]);
+        last[producer] = value;
+      }
+    });
+  }
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&, p]() {
+      for (int i = 0; i < kValues; ++i) ASSERT_TRUE(ring.push(p * kValues + i));
+    });
+  }
+  for (auto& producer : producers) producer.join();
+  ring.close();
+  for (auto& consumer : consumers) consumer.join();
+
+  // every value popped exactly once
+  for (int v = 0; v < kProducers * kValues; ++v) {
+    int count = 0;
+    for (int c = 0; c < kConsumers; ++c) count += seen[c][v];
+    ASSERT_EQ(count, 1) << "value " << v;
+  }
+}
+
+TEST(SPSCRingTest, FirstInFirstOut) {
+  SPSCRing<int> ring(3);
+  EXPECT_EQ(ring.capacity(), 4);
+
+  int value = 0;
+  EXPECT_FALSE(ring.tryPop(value));
+  for (int i = 0; i < 4; ++i) EXPECT_TRUE(ring.tryPush(i));
+  EXPECT_FALSE(ring.tryPush(4));  // full
+  EXPECT_EQ(ring.sizeApprox(), 4);
+
+  for (int i = 0; i < 20; ++i) {
+    ASSERT_TRUE(ring.tryPop(value));
+    EXPECT_EQ(value, i);
+    ASSERT_TRUE(ring.tryPush(i + 4));
+  }
+}
+
+TEST(SPSCRingTest, CloseWakesBlockedConsumer) {
+  SPSCRing<std::unique_ptr<int>> ring(2);
+  ASSERT_TRUE(ring.push(std::make_unique<int>(1)));
+  std::atomic<bool> woken{false};
+  std::thread consumer([&]() {
+    std::unique_ptr<int> value;
+    EXPECT_TRUE(ring.pop(value));
+    EXPECT_EQ(*value, 1);
+    EXPECT_FALSE(ring.pop(value));
+    woken = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(woken);
+  ring.close();
+  consumer.join();
+  EXPECT_TRUE(woken);
+  EXPECT_FALSE(ring.push(std::make_unique<int>(2)));
+}
+
+TEST(SPSCRingTest, BlocksAreHandedBackAndForth) {
+  // full blocks one way, emptied blocks back for reuse
+  constexpr int kBlocks = 20000;
+  SPSCRing<std::vector<int>> full(8);
+  SPSCRing<std::vector<int>> empty(8);
+  for (int i = 0; i < 8; ++i) ASSERT_TRUE(empty.tryPush(std::vector<int>()));
+
+  std::thread producer([&]() {
+    std::vector<int> block;
+    for (int i = 0; i < kBlocks; ++i) {
+      ASSERT_TRUE(empty.pop(block));
+      block.assign(1 + i % 13, i);
+      ASSERT_TRUE(full.push(std::move(block)));
+    }
+    full.close();
+  });
+
+  std::vector<int> block;
+  int expected = 0;
+  while (full.pop(block)) {
+    ASSERT_EQ(block.size(), static_cast<size_t>(1 + expected % 13));
+    ASSERT_TRUE(std::all_of(block.begin(), block.end(),
+                            [&](int v) { return v == expected; }));
+    ++expected;
+    block.clear();
+    ASSERT_TRUE(empty.push(std::move(block)));
+  }
+  producer.join();
+  EXPECT_EQ(expected, kBlocks);
+}
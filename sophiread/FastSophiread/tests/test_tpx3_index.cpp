@@ -0,0 +1,274 @@
+/**
+ * @file test_tpx3_index.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief unit test for tpx3_index.h
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <map>
+
+#include "disk_io.h"
+#include "tpx3_index.h"
+
+class TPX3IndexTest : public ::testing::Test {
+ protected:
+  std::string rawFile = "../data/suann_socket_background_serval32.tpx3";
+  std::string indexFile = "test_tpx3_index.idx";
+
+  void TearDown() override { std::filesystem::remove(indexFile); }
+
+  // batches of the whole file with the timestamps of a full reduction
+  std::vector<TPX3> fullScan(const std::vector<char>& rawdata,
+                             bool use_gdc = true) {
+    auto batches = findTPX3H(rawdata);
+    unsigned long tdc_timestamp = 0;
+    unsigned long long int gdc_timestamp = 0;
+    unsigned long timer_lsb32 = 0;
+    for (auto& tpx3 : batches) {
+      if (use_gdc) {
+        updateTimestamp(tpx3, rawdata, tdc_timestamp, gdc_timestamp,
+                        timer_lsb32);
+      } else {
+        updateTimestamp(tpx3, rawdata, tdc_timestamp);
+      }
+    }
+    return batches;
+  }
+};
+
+TEST_F(TPX3IndexTest, BuildMatchesFullScan) {
+  auto rawdata = readTPX3RawToCharVec(rawFile);
+  auto reference = fullScan(rawdata);
+
+  // a chunk size that cuts batches and packets
+  for (size_t chunk_size : {size_t(4099), size_t(1) << 20}) {
+    TPX3Index index = TPX3Index::build(rawFile, true, 16384, chunk_size);
+    EXPECT_TRUE(index.usesGDC());
+    EXPECT_EQ(index.getFileSize(), rawdata.size());
+    ASSERT_GT(index.size(), 100u);
+
+    // blocks follow each other and start from the state of their batch
+    size_t batch = 0;
+    for (size_t i = 0; i < index.size(); ++i) {
+      const TPX3IndexEntry& block = index[i];
+      ASSERT_EQ(block.offset, reference[batch].index);
+      EXPECT_EQ(block.tdc_timestamp, reference[batch].tdc_timestamp);
+      EXPECT_EQ(block.gdc_timestamp, reference[batch].gdc_timestamp);
+      EXPECT_EQ(block.timer_lsb32, reference[batch].timer_lsb32);
+      uint32_t packets = 0;
+      uint32_t chip_mask = 0;
+      for (size_t j = batch; j < batch + block.batches; ++j) {
+        packets += reference[j].num_packets;
+        chip_mask |= 1u << reference[j].chip_layout_type;
+      }
+      EXPECT_EQ(block.packets, packets);
+      EXPECT_EQ(block.chip_mask, chip_mask);
+      batch += block.batches;
+      if (i + 1 < index.size()) {
+        EXPECT_GE(block.size, 16384u);
+        EXPECT_EQ(index.getBlockEnd(i), index[i + 1].offset);
+      }
+    }
+    EXPECT_EQ(batch, reference.size());
+    EXPECT_EQ(index.getBlockEnd(index.size() - 1), rawdata.size());
+    EXPECT_EQ(index.getEndState(index.size() - 1).offset, rawdata.size());
+  }
+}
+
+TEST_F(TPX3IndexTest, RangesChainToFullScan) {
+  auto rawdata = readTPX3RawToCharVec(rawFile);
+  const uint64_t size = rawdata.size();
+
+  for (bool use_gdc : {true, false}) {
+    auto reference = fullScan(rawdata, use_gdc);
+    std::map<uint64_t, const TPX3*> by_offset;
+    for (const auto& tpx3 : reference) by_offset[tpx3.index] = &tpx3;
+
+    // ranges cutting batches, scanned in chunks cutting them too
+    const std::vector<uint64_t> bounds = {0, (size / 3) & ~uint64_t(7),
+                                          (size * 2 / 3) & ~uint64_t(7), size};
+    unsigned long tdc_timestamp = 0;
+    unsigned long long gdc_timestamp = 0;
+    unsigned long timer_lsb32 = 0;
+    TPX3TimestampSummary chained;
+    size_t batches = 0;
+    for (size_t r = 0; r + 1 < bounds.size(); ++r) {
+      TPX3TimestampSummary summary;
+      TPX3Index part = TPX3Index::buildRange(
+          rawFile, use_gdc, bounds[r], bounds[r + 1], summary, 16384, 4099);
+      EXPECT_EQ(part.getEndState(part.size() - 1).offset, bounds[r + 1]);
+      part.rebase(tdc_timestamp, gdc_timestamp, timer_lsb32);
+      summary.apply(use_gdc, tdc_timestamp, gdc_timestamp, timer_lsb32);
+      chained.append(summary);
+
+      for (size_t i = 0; i < part.size(); ++i) {
+        ASSERT_EQ(by_offset.count(part[i].offset), 1u);
+        const TPX3& batch = *by_offset[part[i].offset];
+        EXPECT_EQ(part[i].tdc_timestamp, batch.tdc_timestamp);
+        EXPECT_EQ(part[i].gdc_timestamp, batch.gdc_timestamp);
+        EXPECT_EQ(part[i].timer_lsb32, batch.timer_lsb32);
+        batches += part[i].batches;
+      }
+      const TPX3IndexEntry& end = part.getEndState(part.size() - 1);
+      EXPECT_EQ(end.tdc_timestamp, tdc_timestamp);
+      EXPECT_EQ(end.gdc_timestamp, gdc_timestamp);
+    }
+    EXPECT_EQ(batches, reference.size());
+    EXPECT_LE(chained.num_packets, 8u);
+
+    // the state at the end of the file, in one go from the chained summary
+    TPX3Index full = TPX3Index::build(rawFile, use_gdc, 16384);
+    const TPX3IndexEntry& expected = full.getEndState(full.size() - 1);
+    EXPECT_EQ(tdc_timestamp, expected.tdc_timestamp);
+    EXPECT_EQ(gdc_timestamp, expected.gdc_timestamp);
+    unsigned long tdc = 0;
+    unsigned long long gdc = 0;
+    unsigned long timer = 0;
+    chained.apply(use_gdc, tdc, gdc, timer);
+    EXPECT_EQ(tdc, expected.tdc_timestamp);
+    EXPECT_EQ(gdc, expected.gdc_timestamp);
+    EXPECT_EQ(timer, expected.timer_lsb32);
+  }
+}
+
+TEST_F(TPX3IndexTest, ReadBatchesMatchesFullScan) {
+  auto rawdata = readTPX3RawToCharVec(rawFile);
+  auto reference = fullScan(rawdata);
+  size_t reference_hits = 0;
+  for (auto& tpx3 : reference) {
+    extractHits(tpx3, rawdata);
+    reference_hits += tpx3.hits.size();
+  }
+
+  TPX3Index index = TPX3Index::build(rawFile, true, 16384);
+
+  // every batch in small pieces, then each chip on its own
+  for (int chip_id = -1; chip_id < 4; ++chip_id) {
+    auto reader = openTPX3Reader(rawFile);
+    std::vector<char> chunk;
+    std::vector<TPX3> batches;
+    size_t hits = 0;
+    for (size_t next = 0; next < index.size();) {
+      next = index.readBatches(*reader, next, index.size(), 65536, chunk,
+                               batches, chip_id);
+      EXPECT_LE(chunk.size(), 65536u);
+      for (auto& tpx3 : batches) {
+        extractHits(tpx3, chunk);
+        hits += tpx3.hits.size();
+      }
+    }
+    size_t expected = 0;
+    for (const auto& tpx3 : reference) {
+      if (chip_id < 0 || tpx3.chip_layout_type == chip_id) {
+        expected += tpx3.hits.size();
+      }
+    }
+    EXPECT_EQ(hits, expected) << "chip " << chip_id;
+    if (chip_id < 0) {
+      EXPECT_EQ(hits, reference_hits);
+    }
+  }
+}
+
+TEST_F(TPX3IndexTest, SaveLoadRoundTrip) {
+  TPX3Index index = TPX3Index::build(rawFile, false, 16384);
+  EXPECT_FALSE(index.usesGDC());
+  index.save(indexFile);
+  EXPECT_FALSE(std::filesystem::exists(indexFile + ".tmp"));
+
+  TPX3Index loaded = TPX3Index::load(indexFile);
+  EXPECT_FALSE(loaded.usesGDC());
+  EXPECT_EQ(loaded.getFileSize(), index.getFileSize());
+  ASSERT_EQ(loaded.size(), index.size());
+  for (size_t i = 0; i <= index.size(); ++i) {
+    const TPX3IndexEntry& a =
+        i < index.size() ? index[i] : index.getEndState(i - 1);
+    const TPX3IndexEntry& b =
+        i < loaded.size() ? loaded[i] : loaded.getEndState(i - 1);
+    EXPECT_EQ(a.offset, b.offset);
+    EXPECT_EQ(a.size, b.size);
+    EXPECT_EQ(a.tdc_timestamp, b.tdc_timestamp);
+    EXPECT_EQ(a.batches, b.batches);
+  }
+
+  // a sidecar built for the other timing mode is rebuilt
+  EXPECT_FALSE(TPX3Index::loadOrBuild(rawFile, indexFile, false).usesGDC());
+  TPX3Index rebuilt = TPX3Index::loadOrBuild(rawFile, indexFile, true);
+  EXPECT_TRUE(rebuilt.usesGDC());
+  EXPECT_TRUE(TPX3Index::load(indexFile).usesGDC());
+  EXPECT_EQ(rebuilt.size(), 3u);  // default 1 MiB blocks
+
+  // a truncated sidecar is rejected
+  std::filesystem::resize_file(indexFile,
+                               std::filesystem::file_size(indexFile) - 1);
+  EXPECT_THROW(TPX3Index::load(indexFile), std::runtime_error);
+}
+
+TEST_F(TPX3IndexTest, TimeRangeCoversWindow) {
+  auto rawdata = readTPX3RawToCharVec(rawFile);
+  auto reference = fullScan(rawdata);
+  uint64_t min_time = UINT64_MAX;
+  uint64_t max_time = 0;
+  for (auto& tpx3 : reference) {
+    extractHits(tpx3, rawdata);
+    for (const auto& hit : tpx3.hits) {
+      min_time = std::min<uint64_t>(min_time, hit.getSPIDERTIME());
+      max_time = std::max<uint64_t>(max_time, hit.getSPIDERTIME());
+    }
+  }
+  ASSERT_LT(min_time, max_time);
+
+  TPX3Index index = TPX3Index::build(rawFile, true, 16384);
+  const uint64_t begin = min_time + (max_time - min_time) / 3;
+  const uint64_t end = min_time + (max_time - min_time) / 2;
+  const auto [first, last] = index.findTimeRange(begin, end);
+  EXPECT_LT(first, last);
+  EXPECT_LT(index.getBlockEnd(last - 1) - index[first].offset,
+            index.getFileSize());
+  for (const auto& tpx3 : reference) {
+    for (const auto& hit : tpx3.hits) {
+      if (hit.getSPIDERTIME() >= begin && hit.getSPIDERTIME() < end) {
+        ASSERT_GE(tpx3.index, index[first].offset);
+        ASSERT_LT(tpx3.index, index.getBlockEnd(last - 1));
+      }
+    }
+  }
+
+  // nothing once the last hit of the run is over
+  uint64_t last_clock = 0;
+  for (size_t i = 0; i <= index.size(); ++i) {
+    last_clock = std::max(last_clock, index.getClock(i));
+  }
+  const uint64_t after = last_clock + TPX3Index::kClockSlack;
+  const auto empty = index.findTimeRange(after, after + 1);
+  EXPECT_EQ(empty.first, empty.second);
+}
+
+TEST_F(TPX3IndexTest, SplitIsContiguousAndBalanced) {
+  TPX3Index index = TPX3Index::build(rawFile, true, 16384);
+  const auto ranges = index.split(4, 0, index.size());
+  ASSERT_EQ(ranges.size(), 4u);
+  EXPECT_EQ(ranges.front().first, 0u);
+  EXPECT_EQ(ranges.back().second, index.size());
+  const uint64_t bytes = index.getFileSize() - index[0].offset;
+  for (size_t part = 0; part < ranges.size(); ++part) {
+    if (part > 0) {
+      EXPECT_EQ(ranges[part].first, ranges[part - 1].second);
+    }
+    const uint64_t part_bytes =
+        index.getEndState(ranges[part].second - 1).offset -
+        index[ranges[part].first].offset;
+    EXPECT_NEAR(static_cast<double>(part_bytes), bytes / 4.0, bytes * 0.05);
+  }
+
+  // more parts than blocks leaves some empty
+  const auto many = index.split(index.size() + 3, 0, index.size());
+  EXPECT_EQ(many.back().second, index.size());
+  EXPECT_THROW(index.split(0, 0, index.size()), std::invalid_argument);
+}
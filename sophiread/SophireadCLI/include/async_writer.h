@@ -0,0 +1,75 @@
+/**
+ * @file async_writer.h
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Background writer service for TOF imaging and spectra output
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#pragma once
+
+#include <tbb/concurrent_queue.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sophiread {
+
+using TOFImages = std::vector<std::vector<std::vector<unsigned int>>>;
+
+/**
+ * @brief Runs output tasks on dedicated I/O threads.
+ *
+ * Tasks are taken from a bounded queue, so submit() blocks once the writers
+ * fall behind by more than queue_capacity tasks. The cube is handed over as a
+ * shared snapshot, the caller is free to keep updating its own copy.
+ *
+ * NOTE: tasks are run in submission order by each thread. With more than one
+ *       thread, tasks writing to the same files must be flushed in between.
+ */
+class AsyncWriter {
+ public:
+  using Task = std::function<void()>;
+
+  explicit AsyncWriter(size_t num_threads = 1, size_t queue_capacity = 4);
+  ~AsyncWriter();
+
+  AsyncWriter(const AsyncWriter&) = delete;
+  AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+  void submit(Task task);
+  void submitTOFImagingToTIFF(std::shared_ptr<const TOFImages> tof_images,
+                              const std::string& out_tof_imaging,
+                              const std::vector<double>& tof_bin_edges,
+                              const std::string& tof_filename_base,
+                              bool accumulate = true);
+  void submitSpectralFile(std::shared_ptr<const TOFImages> tof_images,
+                          const std::string& filename,
+                          const std::vector<double>& tof_bin_edges);
+
+  // Wait for all submitted tasks, rethrows the first error of a task
+  void flush();
+  size_t pending() const { return m_pending.load(); }
+
+ private:
+  void run();
+
+  tbb::concurrent_bounded_queue<Task> m_queue;
+  std::vector<std::thread> m_threads;
+  std::atomic<size_t> m_pending{0};
+  std::mutex m_mutex;
+  std::condition_variable m_idle;
+  std::exception_ptr m_error;
+};
+
+}  // namespace sophiread
@@ -0,0 +1,77 @@
+/**
+ * @file checkpoint.h
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Checkpoints to resume interrupted reductions
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#pragma once
+
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+namespace sophiread {
+
+/**
+ * @brief State of a Sophiread run after a fully processed chunk.
+ *
+ * The outputs are flushed before the checkpoint is written, so the rows and
+ * the TOF counts recorded here are on disk; anything written after them is
+ * dropped on resume.
+ */
+struct ReductionCheckpoint {
+  std::string input;
+  uint64_t input_size = 0;
+  uint64_t offset = 0;  // first byte of the input not processed yet
+  unsigned long tdc_timestamp = 0;
+  unsigned long long gdc_timestamp = 0;
+  unsigned long timer_lsb32 = 0;
+  uint64_t hits_rows = 0;
+  uint64_t events_rows = 0;
+  uint64_t event_store_events = 0;
+  uint64_t chunks = 0;
+  uint64_t total_hits = 0;
+  uint64_t total_neutrons = 0;
+  uint64_t tof_counts = 0;    // sum of the saved TOF cube
+  nlohmann::json settings;    // options that must not change on resume
+};
+
+/**
+ * @brief A file venus_auto_reducer was following when checkpointed.
+ */
+struct FollowedFileCheckpoint {
+  std::string path;
+  uint64_t position = 0;  // batch aligned offset of the first byte not reduced
+  unsigned long tdc_timestamp = 0;
+  unsigned long long gdc_timestamp = 0;
+  unsigned long timer_lsb32 = 0;
+};
+
+/**
+ * @brief State of venus_auto_reducer matching its accumulator sidecar.
+ */
+struct ReducerCheckpoint {
+  std::vector<std::string> processed_files;
+  std::vector<FollowedFileCheckpoint> followed_files;
+  uint64_t tof_counts = 0;  // sum of the accumulator
+};
+
+void saveCheckpoint(const std::string& filename,
+                    const ReductionCheckpoint& checkpoint);
+bool loadCheckpoint(const std::string& filename,
+                    ReductionCheckpoint& checkpoint);
+void saveCheckpoint(const std::string& filename,
+                    const ReducerCheckpoint& checkpoint);
+bool loadCheckpoint(const std::string& filename,
+                    ReducerCheckpoint& checkpoint);
+
+// total of a TOF cube, ties a checkpoint to the cube saved with it
+uint64_t countTOFImages(
+    const std::vector<std::vector<std::vector<unsigned int>>>& tof_images);
+
+}  // namespace sophiread
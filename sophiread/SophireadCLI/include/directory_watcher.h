@@ -0,0 +1,63 @@
+/**
+ * @file directory_watcher.h
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief inotify based watcher for files completed in a directory
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace sophiread {
+
+/**
+ * @brief Files reported by one DirectoryWatcher::wait() call.
+ *
+ * rescan is set when the watcher may have missed files (polling mode, an
+ * inotify queue overflow, or the periodic safety rescan); the caller should
+ * then list the directory.
+ */
+struct WatchResult {
+  std::vector<std::filesystem::path> files;
+  bool rescan = false;
+};
+
+/**
+ * @brief Reports files as soon as they are closed after writing
+ * (IN_CLOSE_WRITE) or moved into the directory (IN_MOVED_TO).
+ *
+ * Falls back to polling when inotify is unavailable or disabled, e.g. for
+ * network file systems where writes from other hosts raise no events. As a
+ * watched NFS mount still misses those writes, a rescan is also asked for
+ * every rescan_interval while notifying.
+ */
+class DirectoryWatcher {
+ public:
+  explicit DirectoryWatcher(
+      const std::string& directory, bool use_inotify = true,
+      std::chrono::milliseconds rescan_interval = std::chrono::minutes(1));
+  ~DirectoryWatcher();
+
+  DirectoryWatcher(const DirectoryWatcher&) = delete;
+  DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+  // Block until files arrive or the timeout expires
+  WatchResult wait(std::chrono::milliseconds timeout);
+  bool isNotifying() const { return m_fd != -1; }
+
+ private:
+  std::filesystem::path m_directory;
+  int m_fd = -1;
+  int m_wd = -1;
+  std::chrono::milliseconds m_rescan_interval;  // 0 disables safety rescans
+  std::chrono::steady_clock::time_point m_last_rescan;
+};
+
+}  // namespace sophiread
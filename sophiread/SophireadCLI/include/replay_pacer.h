@@ -0,0 +1,46 @@
+/**
+ * @file replay_pacer.h
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Schedule for replaying recorded runs at a target rate
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#pragma once
+
+#include <cstdint>
+
+namespace sophiread {
+
+struct ReplayRate {
+  double bytes_per_second = 0;  // 0: unlimited
+  double hits_per_second = 0;   // 0: unlimited
+  double speed = 0;  // multiple of the recorded acquisition clock, 0: ignored
+  double burst_on = 0;   // seconds of sending per burst, 0: continuous
+  double burst_off = 0;  // seconds of silence after each burst
+};
+
+/**
+ * @brief When each piece of a replayed run is due.
+ *
+ * Every limit caps the replay on its own and the slowest one sets the pace,
+ * which gives the active time needed for the data sent so far. With a burst
+ * pattern the replay is only active for burst_on seconds out of every
+ * burst_on + burst_off, data due at the end of a burst waits for the next one.
+ */
+class ReplayPacer {
+ public:
+  explicit ReplayPacer(const ReplayRate& rate);
+
+  // seconds from the start of the replay at which the data following bytes,
+  // hits and clock_ticks (25 ns) of the run may be sent
+  double due(uint64_t bytes, uint64_t hits, uint64_t clock_ticks) const;
+  bool isUnlimited() const;
+
+ private:
+  ReplayRate m_rate;
+};
+
+}  // namespace sophiread
@@ -10,11 +10,14 @@
  */
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
 #include "abs.h"
+#include "event_store.h"
 #include "iconfig.h"
+#include "live_image.h"
 #include "tpx3_fast.h"
 
 namespace sophiread {
@@ -44,13 +47,57 @@ void timedSaveTOFImagingToTIFF(
     const std::string& out_tof_imaging,
     const std::vector<std::vector<std::vector<unsigned int>>>& tof_images,
     const std::vector<double>& tof_bin_edges,
-    const std::string& tof_filename_base);
+    const std::string& tof_filename_base, bool accumulate = true);
+bool loadTOFImagingFromTIFF(
+    const std::string& out_tof_imaging, const std::string& tof_filename_base,
+    std::vector<std::vector<std::vector<unsigned int>>>& tof_images);
+// Raw sidecar holding the running TOF cube between flushes and restarts
+void saveTOFImagingAccumulator(
+    const std::string& filename,
+    const std::vector<std::vector<std::vector<unsigned int>>>& tof_images);
+bool loadTOFImagingAccumulator(
+    const std::string& filename,
+    std::vector<std::vector<std::vector<unsigned int>>>& tof_images);
+// Single-file TOF stack outputs (one multipage BigTIFF or one HDF5 dataset)
+void timedSaveTOFImagingToBigTIFF(
+    const std::string& out_tof_imaging,
+    const std::vector<std::vector<std::vector<unsigned int>>>& tof_images,
+    const std::vector<double>& tof_bin_edges,
+    const std::string& tof_filename_base,
+    const std::string& compression = "deflate", bool accumulate = true);
+void timedSaveTOFImagingToHDF5(
+    const std::string& out_tof_imaging,
+    const std::vector<std::vector<std::vector<unsigned int>>>& tof_images,
+    const std::vector<double>& tof_bin_edges,
+    const std::string& tof_filename_base,
+    const std::string& compression = "deflate", bool accumulate = true);
 std::vector<std::vector<std::vector<unsigned int>>> initializeTOFImages(
     double super_resolution, const std::vector<double>& tof_bin_edges);
 void updateTOFImages(
     std::vector<std::vector<std::vector<unsigned int>>>& tof_images,
     const TPX3& batch, double super_resolution,
     const std::vector<double>& tof_bin_edges, const std::string& mode);
+// Re-binning of saved neutron events without re-clustering
+std::vector<std::vector<std::vector<unsigned int>>> rebinNeutrons(
+    const std::vector<Neutron>& neutrons, double super_resolution,
+    const std::vector<double>& tof_bin_edges);
+std::vector<std::vector<std::vector<unsigned int>>> rebinEventStore(
+    const EventStoreReader& store, double super_resolution,
+    const std::vector<double>& tof_bin_edges, uint64_t begin_spidertime = 0,
+    uint64_t end_spidertime = UINT64_MAX);
+// Sparse per-file counts: flat (bin, y, x) indices merged into a cube later
+void collectTOFImageIndices(std::vector<uint64_t>& indices, const TPX3& batch,
+                            double super_resolution,
+                            const std::vector<double>& tof_bin_edges,
+                            const std::string& mode);
+void addTOFImageIndices(
+    std::vector<std::vector<std::vector<unsigned int>>>& tof_images,
+    const std::vector<uint64_t>& indices);
+// Running image (TOF bins summed) and spectrum of a live image publisher
+void updateLiveImage(LiveImagePublisher& live, const TPX3& batch,
+                     double super_resolution,
+                     const std::vector<double>& tof_bin_edges,
+                     const std::string& mode);
 std::vector<uint64_t> calculateSpectralCounts(
     const std::vector<std::vector<std::vector<unsigned int>>>& tof_images);
 void writeSpectralFile(const std::string& filename,
@@ -0,0 +1,141 @@
+/**
+ * @file async_writer.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Background writer service for TOF imaging and spectra output
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include "async_writer.h"
+
+#include <spdlog/spdlog.h>
+
+#include "sophiread_core.h"
+
+namespace sophiread {
+
+/**
+ * @brief Construct a new AsyncWriter and start the I/O threads.
+ *
+ * @param[in] num_threads
+ * @param[in] queue_capacity: maximum number of queued tasks
+ */
+AsyncWriter::AsyncWriter(size_t num_threads, size_t queue_capacity) {
+  if (num_threads == 0 || queue_capacity == 0) {
+    throw std::invalid_argument(
+        "AsyncWriter needs at least one thread and one queue slot");
+  }
+  m_queue.set_capacity(static_cast<std::ptrdiff_t>(queue_capacity));
+  for (size_t i = 0; i < num_threads; ++i) {
+    m_threads.emplace_back(&AsyncWriter::run, this);
+  }
+}
+
+/**
+ * @brief Drain the queue and stop the I/O threads.
+ */
+AsyncWriter::~AsyncWriter() {
+  // an empty task is the stop signal, one per thread
+  for (size_t i = 0; i < m_threads.size(); ++i) {
+    m_queue.push(Task());
+  }
+  for (auto& thread : m_threads) {
+    thread.join();
+  }
+  if (m_error) {
+    spdlog::error("AsyncWriter stopped with an unhandled write error");
+  }
+}
+
+/**
+ * @brief Queue a task, blocks while the queue is full.
+ *
+ * @param[in] task
+ */
+void AsyncWriter::submit(Task task) {
+  if (!task) return;
+  ++m_pending;
+  m_queue.push(std::move(task));
+}
+
+/**
+ * @brief Queue writing a snapshot of the cube to per-bin TIFF files.
+ *
+ * @param[in] tof_images
+ * @param[in] out_tof_imaging
+ * @param[in] tof_bin_edges
+ * @param[in] tof_filename_base
+ * @param[in] accumulate
+ */
+void AsyncWriter::submitTOFImagingToTIFF(
+    std::shared_ptr<const TOFImages> tof_images,
+    const std::string& out_tof_imaging,
+    const std::vector<double>& tof_bin_edges,
+    const std::string& tof_filename_base, bool accumulate) {
+  submit([=]() {
+    timedSaveTOFImagingToTIFF(out_tof_imaging, *tof_images, tof_bin_edges,
+                              tof_filename_base, accumulate);
+  });
+}
+
+/**
+ * @brief Queue writing the spectra of a snapshot of the cube.
+ *
+ * @param[in] tof_images
+ * @param[in] filename
+ * @param[in] tof_bin_edges
+ */
+void AsyncWriter::submitSpectralFile(
+    std::shared_ptr<const TOFImages> tof_images, const std::string& filename,
+    const std::vector<double>& tof_bin_edges) {
+  submit([=]() {
+    writeSpectralFile(filename, calculateSpectralCounts(*tof_images),
+                      tof_bin_edges);
+  });
+}
+
+/**
+ * @brief Block until every submitted task has completed.
+ */
+void AsyncWriter::flush() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_idle.wait(lock, [this]() { return m_pending.load() == 0; });
+  if (m_error) {
+    std::exception_ptr error = nullptr;
+    std::swap(error, m_error);
+    std::rethrow_exception(error);
+  }
+}
+
+/**
+ * @brief I/O thread loop.
+ */
+void AsyncWriter::run() {
+  while (true) {
+    Task task;
+    m_queue.pop(task);
+    if (!task) break;
+
+    try {
+      task();
+    } catch (const std::exception& e) {
+      spdlog::error("AsyncWriter task failed: {}", e.what());
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_error) m_error = std::current_exception();
+    } catch (...) {
+      spdlog::error("AsyncWriter task failed");
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_error) m_error = std::current_exception();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      --m_pending;
+    }
+    m_idle.notify_all();
+  }
+}
+
+}  // namespace sophiread
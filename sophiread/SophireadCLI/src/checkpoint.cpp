@@ -0,0 +1,206 @@
+/**
+ * @file checkpoint.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Checkpoints to resume interrupted reductions
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include "checkpoint.h"
+
+#include <spdlog/spdlog.h>
+
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+
+namespace sophiread {
+
+namespace {
+
+const char* const kReductionFormat = "sophiread-checkpoint";
+const char* const kReducerFormat = "venus-auto-reducer-checkpoint";
+const int kFormatVersion = 1;
+
+/**
+ * @brief Write the checkpoint under a temporary name and rename it in place.
+ *
+ * @param[in] filename
+ * @param[in] json
+ */
+void writeJSONAtomically(const std::string& filename,
+                         const nlohmann::json& json) {
+  const std::string tmp_filename = filename + ".tmp";
+  {
+    std::ofstream out(tmp_filename, std::ios::trunc);
+    if (!out.is_open()) {
+      throw std::runtime_error("Failed to open checkpoint for writing: " +
+                               tmp_filename);
+    }
+    out << json.dump(2);
+    if (!out) {
+      throw std::runtime_error("Failed to write checkpoint: " + tmp_filename);
+    }
+  }
+  std::filesystem::rename(tmp_filename, filename);
+  spdlog::debug("Wrote checkpoint: {}", filename);
+}
+
+/**
+ * @brief Read a checkpoint and check its format.
+ *
+ * @param[in] filename
+ * @param[in] format
+ * @param[out] json
+ * @return false if there is no checkpoint
+ */
+bool readJSON(const std::string& filename, const char* format,
+              nlohmann::json& json) {
+  std::ifstream in(filename);
+  if (!in.is_open()) return false;
+
+  json = nlohmann::json::parse(in);
+  if (json.value("format", "") != format ||
+      json.value("version", 0) != kFormatVersion) {
+    throw std::runtime_error("Unsupported checkpoint format: " + filename);
+  }
+  return true;
+}
+
+}  // namespace
+
+/**
+ * @brief Save the state of a Sophiread run.
+ *
+ * @param[in] filename
+ * @param[in] checkpoint
+ */
+void saveCheckpoint(const std::string& filename,
+                    const ReductionCheckpoint& checkpoint) {
+  nlohmann::json json;
+  json["format"] = kReductionFormat;
+  json["version"] = kFormatVersion;
+  json["input"] = checkpoint.input;
+  json["input_size"] = checkpoint.input_size;
+  json["offset"] = checkpoint.offset;
+  json["tdc_timestamp"] = checkpoint.tdc_timestamp;
+  json["gdc_timestamp"] = checkpoint.gdc_timestamp;
+  json["timer_lsb32"] = checkpoint.timer_lsb32;
+  json["hits_rows"] = checkpoint.hits_rows;
+  json["events_rows"] = checkpoint.events_rows;
+  json["event_store_events"] = checkpoint.event_store_events;
+  json["chunks"] = checkpoint.chunks;
+  json["total_hits"] = checkpoint.total_hits;
+  json["total_neutrons"] = checkpoint.total_neutrons;
+  json["tof_counts"] = checkpoint.tof_counts;
+  json["settings"] = checkpoint.settings;
+  writeJSONAtomically(filename, json);
+}
+
+/**
+ * @brief Load the state of an interrupted Sophiread run.
+ *
+ * @param[in] filename
+ * @param[out] checkpoint
+ * @return false if there is no checkpoint
+ */
+bool loadCheckpoint(const std::string& filename,
+                    ReductionCheckpoint& checkpoint) {
+  nlohmann::json json;
+  if (!readJSON(filename, kReductionFormat, json)) return false;
+
+  checkpoint.input = json.at("input").get<std::string>();
+  checkpoint.input_size = json.at("input_size").get<uint64_t>();
+  checkpoint.offset = json.at("offset").get<uint64_t>();
+  checkpoint.tdc_timestamp = json.at("tdc_timestamp").get<unsigned long>();
+  checkpoint.gdc_timestamp =
+      json.at("gdc_timestamp").get<unsigned long long>();
+  checkpoint.timer_lsb32 = json.at("timer_lsb32").get<unsigned long>();
+  checkpoint.hits_rows = json.at("hits_rows").get<uint64_t>();
+  checkpoint.events_rows = json.at("events_rows").get<uint64_t>();
+  checkpoint.event_store_events =
+      json.at("event_store_events").get<uint64_t>();
+  checkpoint.chunks = json.at("chunks").get<uint64_t>();
+  checkpoint.total_hits = json.at("total_hits").get<uint64_t>();
+  checkpoint.total_neutrons = json.at("total_neutrons").get<uint64_t>();
+  checkpoint.tof_counts = json.at("tof_counts").get<uint64_t>();
+  checkpoint.settings = json.at("settings");
+  spdlog::info("Loaded checkpoint: {}", filename);
+  return true;
+}
+
+/**
+ * @brief Save the state of venus_auto_reducer.
+ *
+ * @param[in] filename
+ * @param[in] checkpoint
+ */
+void saveCheckpoint(const std::string& filename,
+                    const ReducerCheckpoint& checkpoint) {
+  nlohmann::json json;
+  json["format"] = kReducerFormat;
+  json["version"] = kFormatVersion;
+  json["processed_files"] = checkpoint.processed_files;
+  json["followed_files"] = nlohmann::json::array();
+  for (const auto& file : checkpoint.followed_files) {
+    json["followed_files"].push_back(
+        {{"path", file.path},
+         {"position", file.position},
+         {"tdc_timestamp", file.tdc_timestamp},
+         {"gdc_timestamp", file.gdc_timestamp},
+         {"timer_lsb32", file.timer_lsb32}});
+  }
+  json["tof_counts"] = checkpoint.tof_counts;
+  writeJSONAtomically(filename, json);
+}
+
+/**
+ * @brief Load the state of venus_auto_reducer.
+ *
+ * @param[in] filename
+ * @param[out] checkpoint
+ * @return false if there is no checkpoint
+ */
+bool loadCheckpoint(const std::string& filename,
+                    ReducerCheckpoint& checkpoint) {
+  nlohmann::json json;
+  if (!readJSON(filename, kReducerFormat, json)) return false;
+
+  checkpoint.processed_files =
+      json.at("processed_files").get<std::vector<std::string>>();
+  checkpoint.followed_files.clear();
+  for (const auto& entry : json.at("followed_files")) {
+    FollowedFileCheckpoint file;
+    file.path = entry.at("path").get<std::string>();
+    file.position = entry.at("position").get<uint64_t>();
+    file.tdc_timestamp = entry.at("tdc_timestamp").get<unsigned long>();
+    file.gdc_timestamp = entry.at("gdc_timestamp").get<unsigned long long>();
+    file.timer_lsb32 = entry.at("timer_lsb32").get<unsigned long>();
+    checkpoint.followed_files.push_back(file);
+  }
+  checkpoint.tof_counts = json.at("tof_counts").get<uint64_t>();
+  spdlog::info("Loaded checkpoint: {}", filename);
+  return true;
+}
+
+/**
+ * @brief Sum of every pixel of every bin.
+ *
+ * @param[in] tof_images
+ * @return uint64_t
+ */
+uint64_t countTOFImages(
+    const std::vector<std::vector<std::vector<unsigned int>>>& tof_images) {
+  uint64_t total = 0;
+  for (const auto& image : tof_images) {
+    for (const auto& row : image) {
+      total = std::accumulate(row.begin(), row.end(), total);
+    }
+  }
+  return total;
+}
+
+}  // namespace sophiread
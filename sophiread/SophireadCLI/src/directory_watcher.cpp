@@ -0,0 +1,132 @@
+/**
+ * @file directory_watcher.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief inotify based watcher for files completed in a directory
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include "directory_watcher.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <spdlog/spdlog.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <thread>
+
+namespace sophiread {
+
+/**
+ * @brief Start watching a directory.
+ *
+ * @param[in] directory
+ * @param[in] use_inotify: false to poll
+ * @param[in] rescan_interval: time between safety rescans while notifying,
+ *                             0 to rely on inotify alone
+ */
+DirectoryWatcher::DirectoryWatcher(const std::string& directory,
+                                   bool use_inotify,
+                                   std::chrono::milliseconds rescan_interval)
+    : m_directory(directory),
+      m_rescan_interval(rescan_interval),
+      m_last_rescan(std::chrono::steady_clock::now()) {
+  if (!use_inotify) {
+    spdlog::info("Polling {} for new files", directory);
+    return;
+  }
+
+  m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_fd == -1) {
+    spdlog::warn("inotify unavailable ({}), polling {} instead",
+                 strerror(errno), directory);
+    return;
+  }
+  m_wd = inotify_add_watch(m_fd, directory.c_str(),
+                           IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE_SELF);
+  if (m_wd == -1) {
+    spdlog::warn("Cannot watch {} ({}), polling instead", directory,
+                 strerror(errno));
+    close(m_fd);
+    m_fd = -1;
+    return;
+  }
+  spdlog::info("Watching {} with inotify", directory);
+}
+
+DirectoryWatcher::~DirectoryWatcher() {
+  if (m_fd != -1) close(m_fd);
+}
+
+/**
+ * @brief Wait for completed files.
+ *
+ * @param[in] timeout
+ * @return WatchResult: the new files in event order, rescan when polling or
+ *         when the safety rescan is due
+ */
+WatchResult DirectoryWatcher::wait(std::chrono::milliseconds timeout) {
+  WatchResult result;
+  if (m_fd == -1) {
+    std::this_thread::sleep_for(timeout);
+    result.rescan = true;
+    return result;
+  }
+
+  pollfd pfd = {m_fd, POLLIN, 0};
+  const int ready = poll(&pfd, 1, static_cast<int>(timeout.count()));
+
+  // NOTE: inotify misses files written by other hosts on network file
+  //       systems, a listing now and then catches them
+  const auto now = std::chrono::steady_clock::now();
+  if (m_rescan_interval.count() > 0 &&
+      now - m_last_rescan >= m_rescan_interval) {
+    spdlog::debug("Safety rescan of {}", m_directory.string());
+    result.rescan = true;
+  }
+
+  if (ready <= 0) {
+    if (ready == -1 && errno != EINTR) {
+      spdlog::error("poll on inotify failed: {}", strerror(errno));
+      result.rescan = true;
+    }
+    if (result.rescan) m_last_rescan = now;
+    return result;
+  }
+
+  // drain every queued event
+  alignas(inotify_event) char buffer[64 * 1024];
+  while (true) {
+    const ssize_t length = read(m_fd, buffer, sizeof(buffer));
+    if (length <= 0) break;  // EAGAIN once the queue is empty
+
+    for (ssize_t offset = 0; offset < length;) {
+      const auto* event =
+          reinterpret_cast<const inotify_event*>(buffer + offset);
+      offset += sizeof(inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        spdlog::warn("inotify queue overflow on {}, rescanning",
+                     m_directory.string());
+        result.rescan = true;
+      } else if (event->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+        spdlog::warn("{} is no longer watched, polling instead",
+                     m_directory.string());
+        close(m_fd);
+        m_fd = -1;
+        result.rescan = true;
+        return result;
+      } else if (event->len > 0 && !(event->mask & IN_ISDIR)) {
+        result.files.push_back(m_directory / event->name);
+      }
+    }
+  }
+  if (result.rescan) m_last_rescan = now;
+  return result;
+}
+
+}  // namespace sophiread
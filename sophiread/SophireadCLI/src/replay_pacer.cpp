@@ -0,0 +1,67 @@
+/**
+ * @file replay_pacer.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Schedule for replaying recorded runs at a target rate
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include "replay_pacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace sophiread {
+
+namespace {
+constexpr double kClockTick = 25e-9;  // seconds
+}
+
+ReplayPacer::ReplayPacer(const ReplayRate& rate) : m_rate(rate) {
+  if (rate.bytes_per_second < 0 || rate.hits_per_second < 0 ||
+      rate.speed < 0) {
+    throw std::invalid_argument("Replay rates must not be negative");
+  }
+  if (rate.burst_on < 0 || rate.burst_off < 0 ||
+      (rate.burst_on == 0 && rate.burst_off > 0)) {
+    throw std::invalid_argument(
+        "Burst pattern needs a positive on time and a non-negative off time");
+  }
+}
+
+bool ReplayPacer::isUnlimited() const {
+  return m_rate.bytes_per_second == 0 && m_rate.hits_per_second == 0 &&
+         m_rate.speed == 0;
+}
+
+/**
+ * @brief Time at which the replay may go past the given amount of data.
+ *
+ * @param[in] bytes: bytes sent so far
+ * @param[in] hits: hits sent so far
+ * @param[in] clock_ticks: recorded acquisition time sent so far
+ * @return double: seconds from the start of the replay
+ */
+double ReplayPacer::due(uint64_t bytes, uint64_t hits,
+                        uint64_t clock_ticks) const {
+  double active = 0;
+  if (m_rate.bytes_per_second > 0) {
+    active = std::max(active, bytes / m_rate.bytes_per_second);
+  }
+  if (m_rate.hits_per_second > 0) {
+    active = std::max(active, hits / m_rate.hits_per_second);
+  }
+  if (m_rate.speed > 0) {
+    active = std::max(active, clock_ticks * kClockTick / m_rate.speed);
+  }
+  if (m_rate.burst_on == 0 || m_rate.burst_off == 0) return active;
+
+  const double bursts = std::floor(active / m_rate.burst_on);
+  return bursts * (m_rate.burst_on + m_rate.burst_off) +
+         (active - bursts * m_rate.burst_on);
+}
+
+}  // namespace sophiread
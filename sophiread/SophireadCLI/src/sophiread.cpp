@@ -10,36 +10,62 @@
  * SPDX - License - Identifier: GPL - 3.0 +
  */
 #include <H5Epublic.h>
+#include <getopt.h>
 #include <spdlog/spdlog.h>
 #include <tbb/tbb.h>
 #include <tiffio.h>
 #include <unistd.h>
 
 #include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <tuple>
 #include <vector>
 
 #include "abs.h"
+#include "async_writer.h"
+#include "checkpoint.h"
 #include "disk_io.h"
+#include "event_store.h"
+#include "hdf5_appender.h"
 #include "json_config_parser.h"
 #include "sophiread_core.h"
 #include "tpx3_fast.h"
+#include "tpx3_index.h"
 #include "user_config.h"
 
 struct ProgramOptions {
   std::string input_tpx3;
   std::string output_hits;
   std::string output_events;
+  std::string output_event_store;  // columnar event store directory
   std::string config_file;
   std::string output_tof_imaging;
   std::string tof_filename_base = "tof_image";
   std::string tof_mode = "neutron";
   std::string spectra_filen = "Spectra";
   std::string timing_mode = "tdc";                // Default is TDC mode
+  std::string tof_format = "tiff";  // tiff, bigtiff or hdf5
+  std::string compression = "deflate";
+  std::string hdf5_schema = "legacy";  // legacy or compact
+  size_t chunk_rows = 1 << 20;         // rows per HDF5 chunk for hits/events
+  double swmr_flush_interval = 0;      // seconds, 0 disables SWMR output
+  double checkpoint_interval = 0;      // seconds, 0 disables checkpoints
+  std::string checkpoint_file;  // default: <input file name>.checkpoint.json
+  bool resume = false;
   size_t chunk_size = 5ULL * 1024 * 1024 * 1024;  // Default 5GB
+  std::string reader = "mmap";                    // mmap or pread
+  bool direct_io = false;                         // O_DIRECT for pread
+  std::string index_file;  // batch index sidecar, default: <input>.idx
+  double window_begin = 0;  // seconds, needs the batch index
+  double window_end = -1;   // negative means until the end of the run
+  int chip_id = -1;         // only reduce this chip, needs the batch index
   bool debug_logging = false;
   bool verbose = false;
 };
@@ -53,12 +79,21 @@ void print_usage(const char* program_name) {
   spdlog::info(
       "Usage: {} -i <input_tpx3> -H <output_hits> -E <output_events> [-u "
       "<config_file>] [-T <tof_imaging_folder>] [-f <tof_filename_base>] [-m "
-      "<tof_mode>] [-t <timing_mode>] [-d] [-v]",
+      "<tof_mode>] [-t <timing_mode>] [-F <tof_format>] [-z <compression>] "
+      "[-S <hdf5_schema>] [-R <chunk_rows>] [-W <flush_interval>] "
+      "[-e <event_store>] [-B <reader>] [--direct-io] [-x <index_file>] "
+      "[-w <begin_s>,<end_s>] [--chip <chip_id>] "
+      "[-K <checkpoint_interval>] [--checkpoint <file>] [--resume] [-d] [-v]",
       program_name);
   spdlog::info("Options:");
-  spdlog::info("  -i <input_tpx3>          Input TPX3 file");
+  spdlog::info(
+      "  -i <input_tpx3>          Input TPX3 file, or a stream: '-' (stdin), "
+      "a FIFO, tcp://[listen@]host:port or unix://[listen@]path");
   spdlog::info("  -H <output_hits>         Output hits HDF5 file");
   spdlog::info("  -E <output_events>       Output events HDF5 file");
+  spdlog::info(
+      "  -e <event_store>         Output columnar event store directory "
+      "(optional, for fast re-binning)");
   spdlog::info(
       "  -u <config_file>         User configuration JSON file (optional)");
   spdlog::info(
@@ -73,7 +108,47 @@ void print_usage(const char* program_name) {
   spdlog::info(
       "  -t <timing_mode>         Timing mode: 'gdc' or 'tdc' (default: tdc)");
   spdlog::info("  -s <spectra_filename>    Output filename for spectra");
+  spdlog::info(
+      "  -F <tof_format>          TOF imaging format: 'tiff' (one file per "
+      "bin), 'bigtiff' or 'hdf5' (single file stack) (default: tiff)");
+  spdlog::info(
+      "  -z <compression>         Compression of the single file stack and "
+      "the hits/events HDF5: 'none', 'deflate', 'lz4' or 'zstd' (default: "
+      "deflate)");
+  spdlog::info(
+      "  -S <hdf5_schema>         Hits/events HDF5 schema: 'legacy' (all "
+      "double) or 'compact' (native types) (default: legacy)");
+  spdlog::info(
+      "  -R <chunk_rows>          Rows per hits/events HDF5 chunk (default: "
+      "1048576)");
+  spdlog::info(
+      "  -W <flush_interval>      Write the hits/events HDF5 in SWMR mode and "
+      "flush them every <flush_interval> seconds for live readers "
+      "(default: off)");
   spdlog::info("  -c <chunk_size>          Chunk size in MB (default: 5120)");
+  spdlog::info(
+      "  -B <reader>              Raw file reader: 'mmap' or 'pread' "
+      "(prefetches the next chunk on I/O threads) (default: mmap)");
+  spdlog::info(
+      "  --direct-io              Read with O_DIRECT, bypassing the page "
+      "cache (pread reader only)");
+  spdlog::info(
+      "  -x <index_file>          Read whole batches through a batch index "
+      "sidecar, built if missing (default with -w/--chip: <input>.idx)");
+  spdlog::info(
+      "  -w <begin_s>,<end_s>     Only reduce the batches in the time window, "
+      "in seconds of spidertime (gdc) or TDC (tdc)");
+  spdlog::info(
+      "  --chip <chip_id>         Only reduce the batches of this chip");
+  spdlog::info(
+      "  -K <checkpoint_interval> Write a checkpoint every "
+      "<checkpoint_interval> seconds (default: off)");
+  spdlog::info(
+      "  --checkpoint <file>      Checkpoint file (default: "
+      "<input file name>.checkpoint.json)");
+  spdlog::info(
+      "  --resume                 Continue an interrupted run from its "
+      "checkpoint");
   spdlog::info("  -d                       Enable debug logging");
   spdlog::info("  -v                       Enable verbose logging");
 }
@@ -88,7 +163,17 @@ ProgramOptions parse_arguments(int argc, char* argv[]) {
   ProgramOptions options;
   int opt;
 
-  while ((opt = getopt(argc, argv, "i:H:E:u:T:f:m:t:s:c:dv")) != -1) {
+  enum { kOptCheckpoint = 256, kOptResume, kOptDirectIO, kOptChip };
+  const option long_options[] = {
+      {"checkpoint", required_argument, nullptr, kOptCheckpoint},
+      {"resume", no_argument, nullptr, kOptResume},
+      {"direct-io", no_argument, nullptr, kOptDirectIO},
+      {"chip", required_argument, nullptr, kOptChip},
+      {nullptr, 0, nullptr, 0}};
+
+  while ((opt = getopt_long(argc, argv,
+                            "i:H:E:e:u:T:f:m:t:s:c:B:x:w:F:z:S:R:W:K:dv",
+                            long_options, nullptr)) != -1) {
     switch (opt) {
       case 'i':
         options.input_tpx3 = optarg;
@@ -99,6 +184,9 @@ ProgramOptions parse_arguments(int argc, char* argv[]) {
       case 'E':
         options.output_events = optarg;
         break;
+      case 'e':
+        options.output_event_store = optarg;
+        break;
       case 'u':
         options.config_file = optarg;
         break;
@@ -121,6 +209,53 @@ ProgramOptions parse_arguments(int argc, char* argv[]) {
         options.chunk_size = static_cast<size_t>(std::stoull(optarg)) * 1024 *
                              1024;  // Convert MB to bytes
         break;
+      case 'B':
+        options.reader = optarg;
+        break;
+      case kOptDirectIO:
+        options.direct_io = true;
+        break;
+      case 'x':
+        options.index_file = optarg;
+        break;
+      case 'w': {
+        const std::string window = optarg;
+        const size_t comma = window.find(',');
+        if (comma == std::string::npos) {
+          throw std::runtime_error(
+              "Invalid time window, use <begin_s>,<end_s>");
+        }
+        options.window_begin = std::stod(window.substr(0, comma));
+        options.window_end = std::stod(window.substr(comma + 1));
+        break;
+      }
+      case kOptChip:
+        options.chip_id = std::stoi(optarg);
+        break;
+      case 'F':
+        options.tof_format = optarg;
+        break;
+      case 'z':
+        options.compression = optarg;
+        break;
+      case 'S':
+        options.hdf5_schema = optarg;
+        break;
+      case 'R':
+        options.chunk_rows = static_cast<size_t>(std::stoull(optarg));
+        break;
+      case 'W':
+        options.swmr_flush_interval = std::stod(optarg);
+        break;
+      case 'K':
+        options.checkpoint_interval = std::stod(optarg);
+        break;
+      case kOptCheckpoint:
+        options.checkpoint_file = optarg;
+        break;
+      case kOptResume:
+        options.resume = true;
+        break;
       case 'd':
         options.debug_logging = true;
         break;
@@ -150,9 +285,96 @@ ProgramOptions parse_arguments(int argc, char* argv[]) {
     throw std::runtime_error("Invalid timing mode. Use 'gdc' or 'tdc'.");
   }
 
+  // Validate TOF imaging format
+  if (options.tof_format != "tiff" && options.tof_format != "bigtiff" &&
+      options.tof_format != "hdf5") {
+    throw std::runtime_error(
+        "Invalid TOF imaging format. Use 'tiff', 'bigtiff' or 'hdf5'.");
+  }
+
+  // Validate compression (throws on unknown names)
+  parseH5Compression(options.compression);
+
+  // Validate HDF5 schema (throws on unknown names)
+  parseHDF5Schema(options.hdf5_schema);
+
+  // Validate raw file reader (throws on unknown names)
+  if (parseTPX3ReaderBackend(options.reader) != TPX3ReaderBackend::pread &&
+      options.direct_io) {
+    throw std::runtime_error("--direct-io needs the pread reader (-B pread).");
+  }
+
+  // Validate time window and chip, both select batches through the index
+  if (options.window_begin < 0 ||
+      (options.window_end >= 0 && options.window_end <= options.window_begin)) {
+    throw std::runtime_error("Invalid time window.");
+  }
+  if (options.chip_id < -1 || options.chip_id > 255) {
+    throw std::runtime_error("Invalid chip id.");
+  }
+  const bool has_window = options.window_begin > 0 || options.window_end >= 0;
+  if (options.index_file.empty() && (has_window || options.chip_id >= 0)) {
+    options.index_file = options.input_tpx3 + ".idx";
+  }
+
+  // Validate stream input, nothing that seeks in the input applies to it
+  if (isTPX3Stream(options.input_tpx3) &&
+      (!options.index_file.empty() || options.checkpoint_interval > 0 ||
+       options.resume)) {
+    throw std::runtime_error(
+        "A stream input cannot be used with an index, a time window, a chip "
+        "selection or checkpoints.");
+  }
+
+  // Validate chunk rows
+  if (options.chunk_rows == 0) {
+    throw std::runtime_error("HDF5 chunk rows must be a positive integer.");
+  }
+
+  // Validate SWMR flush interval
+  if (options.swmr_flush_interval < 0) {
+    throw std::runtime_error("SWMR flush interval must not be negative.");
+  }
+
+  // Validate checkpoint interval
+  if (options.checkpoint_interval < 0) {
+    throw std::runtime_error("Checkpoint interval must not be negative.");
+  }
+  if (options.checkpoint_file.empty()) {
+    options.checkpoint_file =
+        std::filesystem::path(options.input_tpx3).filename().string() +
+        ".checkpoint.json";
+  }
+
   return options;
 }
 
+/**
+ * @brief Options a run can only be resumed with.
+ *
+ * @param[in] options
+ * @param[in] config
+ * @return nlohmann::json
+ */
+nlohmann::json checkpoint_settings(const ProgramOptions& options,
+                                   const IConfig& config) {
+  return {{"input_tpx3", options.input_tpx3},
+          {"output_hits", options.output_hits},
+          {"output_events", options.output_events},
+          {"output_event_store", options.output_event_store},
+          {"tof_mode", options.tof_mode},
+          {"timing_mode", options.timing_mode},
+          {"compression", options.compression},
+          {"hdf5_schema", options.hdf5_schema},
+          {"chunk_rows", options.chunk_rows},
+          {"swmr", options.swmr_flush_interval > 0},
+          {"chunk_size", options.chunk_size},
+          {"index", !options.index_file.empty()},
+          {"window", {options.window_begin, options.window_end}},
+          {"chip", options.chip_id},
+          {"config", config.toString()}};
+}
+
 /**
  * @brief Main function.
  *
@@ -186,7 +408,11 @@ int main(int argc, char* argv[]) {
     spdlog::info("TOF filename base: {}", options.tof_filename_base);
     spdlog::info("TOF mode: {}", options.tof_mode);
     spdlog::info("Timing mode: {}", options.timing_mode);
+    spdlog::info("TOF imaging format: {}", options.tof_format);
+    spdlog::info("HDF5 schema: {}", options.hdf5_schema);
     spdlog::info("Chunk size: {} MB", options.chunk_size / (1024 * 1024));
+    spdlog::info("Reader: {}{}", options.reader,
+                 options.direct_io ? " (O_DIRECT)" : "");
 
     // Load configuration
     std::unique_ptr<IConfig> config;
@@ -212,18 +438,115 @@ int main(int argc, char* argv[]) {
 
     spdlog::info("Configuration: {}", config->toString());
 
-    TPX3FileReader fileReader(options.input_tpx3);
+    TPX3ReaderOptions reader_options;
+    reader_options.backend = parseTPX3ReaderBackend(options.reader);
+    reader_options.direct_io = options.direct_io;
+    auto fileReader = openTPX3Reader(options.input_tpx3, reader_options);
+    const HDF5Schema hdf5_schema = parseHDF5Schema(options.hdf5_schema);
+
+    // Batch index: read blocks of whole batches from their recorded
+    // timestamps, only the blocks in the time window when there is one
+    std::optional<TPX3Index> index;
+    size_t next_block = 0;
+    size_t last_block = 0;
+    if (!options.index_file.empty()) {
+      index = TPX3Index::loadOrBuild(options.input_tpx3, options.index_file,
+                                     options.timing_mode == "gdc");
+      last_block = index->size();
+      if (options.window_begin > 0 || options.window_end >= 0) {
+        // the window is in 25 ns ticks of the timing mode clock
+        const uint64_t begin =
+            static_cast<uint64_t>(std::llround(options.window_begin * 4e7));
+        const uint64_t end =
+            options.window_end < 0
+                ? UINT64_MAX
+                : static_cast<uint64_t>(std::llround(options.window_end * 4e7));
+        std::tie(next_block, last_block) = index->findTimeRange(begin, end);
+      }
+      spdlog::info("Reducing index blocks {} to {} of {}", next_block,
+                   last_block, index->size());
+    }
+
+    // bytes to reduce, the selected batches with an index
+    size_t workBegin = 0;
+    size_t workSize = fileReader->getTotalSize();
+    if (index) {
+      workBegin = next_block < last_block ? (*index)[next_block].offset : 0;
+      workSize = next_block < last_block
+                     ? index->getBlockEnd(last_block - 1) - workBegin
+                     : 0;
+    }
+    const auto has_more = [&]() {
+      return index ? next_block < last_block : !fileReader->isEOF();
+    };
+
+    // Load the checkpoint of the interrupted run
+    // NOTE: chunks are not batch aligned, the same chunk size gives the same
+    //       chunk boundaries after the checkpointed offset
+    sophiread::ReductionCheckpoint checkpoint;
+    const std::string tof_checkpoint_file = options.checkpoint_file + ".tof";
+    const nlohmann::json settings = checkpoint_settings(options, *config);
+    if (options.resume) {
+      if (!sophiread::loadCheckpoint(options.checkpoint_file, checkpoint)) {
+        throw std::runtime_error("No checkpoint to resume from: " +
+                                 options.checkpoint_file);
+      }
+      if (checkpoint.settings != settings) {
+        spdlog::error("Checkpointed settings: {}", checkpoint.settings.dump());
+        throw std::runtime_error(
+            "Options differ from the checkpointed run, cannot resume.");
+      }
+      if (checkpoint.input_size != fileReader->getTotalSize()) {
+        throw std::runtime_error("Input file changed since the checkpoint.");
+      }
+      fileReader->seek(checkpoint.offset);
+      while (index && next_block < last_block &&
+             (*index)[next_block].offset < checkpoint.offset) {
+        ++next_block;
+      }
+      spdlog::info("Resuming {} at byte {}", options.input_tpx3,
+                   checkpoint.offset);
+    }
+    const auto resume_rows = [&](uint64_t rows) {
+      return options.resume ? std::optional<size_t>(rows) : std::nullopt;
+    };
 
     auto start = std::chrono::high_resolution_clock::now();
 
     // Initialize HDF5 files for hits and events (if needed)
+    // NOTE: the appenders keep the datasets open and write whole chunks
+    HDF5AppenderOptions appender_options;
+    appender_options.chunk_rows = options.chunk_rows;
+    appender_options.compression = parseH5Compression(options.compression);
+    // NOTE: in SWMR mode every dataset and attribute must exist before the
+    //       file is switched over, the appenders create them on construction
+    const bool swmr = options.swmr_flush_interval > 0;
     H5::H5File hitsFile, eventsFile;
+    std::unique_ptr<HitsHDF5Appender> hitsAppender;
+    std::unique_ptr<NeutronsHDF5Appender> neutronsAppender;
     if (!options.output_hits.empty()) {
-      hitsFile = H5::H5File(options.output_hits, H5F_ACC_TRUNC);
+      hitsFile = options.resume ? openHDF5File(options.output_hits, swmr)
+                                : createHDF5File(options.output_hits, swmr);
+      hitsAppender = std::make_unique<HitsHDF5Appender>(
+          hitsFile, hdf5_schema, appender_options,
+          resume_rows(checkpoint.hits_rows));
+      if (swmr) startSWMRWrite(hitsFile);
     }
     if (!options.output_events.empty()) {
-      eventsFile = H5::H5File(options.output_events, H5F_ACC_TRUNC);
+      eventsFile = options.resume ? openHDF5File(options.output_events, swmr)
+                                  : createHDF5File(options.output_events, swmr);
+      neutronsAppender = std::make_unique<NeutronsHDF5Appender>(
+          eventsFile, hdf5_schema, appender_options,
+          resume_rows(checkpoint.events_rows));
+      if (swmr) startSWMRWrite(eventsFile);
+    }
+    std::unique_ptr<EventStoreWriter> eventStore;
+    if (!options.output_event_store.empty()) {
+      eventStore = std::make_unique<EventStoreWriter>(
+          options.output_event_store, options.resume);
+      if (options.resume) eventStore->truncate(checkpoint.event_store_events);
     }
+    auto last_flush = std::chrono::steady_clock::now();
 
     // Initialize TOF images if needed
     std::vector<std::vector<std::vector<unsigned int>>> tof_images;
@@ -232,46 +555,105 @@ int main(int argc, char* argv[]) {
     if (needs_tof_images) {
       tof_images = sophiread::initializeTOFImages(config->getSuperResolution(),
                                                   config->getTOFBinEdges());
+      if (options.resume &&
+          (!sophiread::loadTOFImagingAccumulator(tof_checkpoint_file,
+                                                 tof_images) ||
+           sophiread::countTOFImages(tof_images) != checkpoint.tof_counts)) {
+        throw std::runtime_error("TOF cube does not match the checkpoint: " +
+                                 tof_checkpoint_file);
+      }
     }
 
-    unsigned long tdc_timestamp = 0;
-    unsigned long long gdc_timestamp = 0;
-    unsigned long timer_lsb32 = 0;
+    unsigned long tdc_timestamp = checkpoint.tdc_timestamp;
+    unsigned long long gdc_timestamp = checkpoint.gdc_timestamp;
+    unsigned long timer_lsb32 = checkpoint.timer_lsb32;
 
-    const size_t totalSize = fileReader.getTotalSize();
-    size_t processedSize = 0;
+    const size_t totalSize = fileReader->getTotalSize();
+    size_t processedSize =
+        checkpoint.offset > workBegin ? checkpoint.offset - workBegin : 0;
 
     spdlog::info("Starting chunk-based processing of file: {}",
                  options.input_tpx3);
     spdlog::info("Chunk size: {} MB", options.chunk_size / (1024 * 1024));
 
-    int chunkCounter = 0;
-    uint64_t totalHits = 0;
-    uint64_t totalNeutrons = 0;
-
-    while (!fileReader.isEOF()) {
+    int chunkCounter = static_cast<int>(checkpoint.chunks);
+    uint64_t totalHits = checkpoint.total_hits;
+    uint64_t totalNeutrons = checkpoint.total_neutrons;
+
+    // Flush every output, then record how far they go
+    // NOTE: the checkpoint file is written last, it is what commits the state
+    auto last_checkpoint = std::chrono::steady_clock::now();
+    auto write_checkpoint = [&]() {
+      spdlog::info("Writing checkpoint at byte {}", fileReader->getPosition());
+      checkpoint.settings = settings;
+      checkpoint.input = options.input_tpx3;
+      checkpoint.input_size = totalSize;
+      checkpoint.offset = fileReader->getPosition();
+      checkpoint.tdc_timestamp = tdc_timestamp;
+      checkpoint.gdc_timestamp = gdc_timestamp;
+      checkpoint.timer_lsb32 = timer_lsb32;
+      if (hitsAppender) {
+        hitsAppender->flush();
+        hitsFile.flush(H5F_SCOPE_GLOBAL);
+        checkpoint.hits_rows = hitsAppender->getRows();
+      }
+      if (neutronsAppender) {
+        neutronsAppender->flush();
+        eventsFile.flush(H5F_SCOPE_GLOBAL);
+        checkpoint.events_rows = neutronsAppender->getRows();
+      }
+      if (eventStore) {
+        eventStore->flush();
+        checkpoint.event_store_events = eventStore->getEvents();
+      }
+      if (needs_tof_images) {
+        sophiread::saveTOFImagingAccumulator(tof_checkpoint_file, tof_images);
+        checkpoint.tof_counts = sophiread::countTOFImages(tof_images);
+      }
+      checkpoint.chunks = chunkCounter;
+      checkpoint.total_hits = totalHits;
+      checkpoint.total_neutrons = totalNeutrons;
+      sophiread::saveCheckpoint(options.checkpoint_file, checkpoint);
+    };
+
+    while (has_more()) {
+      // NOTE: a batch index that does not match the file stops the run
+      std::vector<char> chunk;
+      std::vector<TPX3> batches;
+      if (index) {
+        next_block =
+            index->readBatches(*fileReader, next_block, last_block,
+                               options.chunk_size, chunk, batches,
+                               options.chip_id);
+      }
       try {
-        auto chunk = fileReader.readChunk(options.chunk_size);
-        if (chunk.empty()) break;
+        if (!index) {
+          chunk = fileReader->readChunk(options.chunk_size);
+          if (chunk.empty()) break;
 
-        // report timing info
-        spdlog::info("TDC timestamp: {}", tdc_timestamp);
-        spdlog::info("GDC timestamp: {}", gdc_timestamp);
-        spdlog::info("Timer LSB32: {}", timer_lsb32);
+          // report timing info
+          spdlog::info("TDC timestamp: {}", tdc_timestamp);
+          spdlog::info("GDC timestamp: {}", gdc_timestamp);
+          spdlog::info("Timer LSB32: {}", timer_lsb32);
 
-        auto batches = sophiread::timedFindTPX3H(chunk);
+          batches = sophiread::timedFindTPX3H(chunk);
+        }
         // GDC route
         if (options.timing_mode == "gdc") {
           spdlog::info("Using GDC mode for timestamp processing");
-          // update timestamp
-          sophiread::timedLocateTimeStamp(batches, chunk, tdc_timestamp,
-                                          gdc_timestamp, timer_lsb32);
+          // update timestamp, indexed batches already have theirs
+          if (!index) {
+            sophiread::timedLocateTimeStamp(batches, chunk, tdc_timestamp,
+                                            gdc_timestamp, timer_lsb32);
+          }
           // extract hits and neutrons
           sophiread::timedProcessing(batches, chunk, *config, true);
         } else if (options.timing_mode == "tdc") {
           // TDC route
           spdlog::info("Using TDC mode for timestamp processing");
-          sophiread::timedLocateTimeStamp(batches, chunk, tdc_timestamp);
+          if (!index) {
+            sophiread::timedLocateTimeStamp(batches, chunk, tdc_timestamp);
+          }
           sophiread::timedProcessing(batches, chunk, *config, false);
         } else {
           throw std::runtime_error("Invalid timing mode. Use 'gdc' or 'tdc'.");
@@ -285,13 +667,18 @@ int main(int argc, char* argv[]) {
           // Append hits to HDF5 file
           if (!options.output_hits.empty()) {
             spdlog::debug("Appending hits to HDF5 file");
-            appendHitsToHDF5Extendible(hitsFile, batch.hits);
+            hitsAppender->append(batch.hits);
           }
 
           // Append neutrons to HDF5 file
           if (!options.output_events.empty()) {
             spdlog::debug("Appending neutrons to HDF5 file");
-            appendNeutronsToHDF5Extendible(eventsFile, batch.neutrons);
+            neutronsAppender->append(batch.neutrons);
+          }
+
+          // Append neutrons to the columnar event store
+          if (eventStore) {
+            eventStore->append(batch.neutrons);
           }
 
           // Update TOF images
@@ -311,14 +698,34 @@ int main(int argc, char* argv[]) {
                         batch.hits.size(), batch.neutrons.size());
           spdlog::debug("Total Hits: {}, Total Neutrons: {}", totalHits,
                         totalNeutrons);
+
+          // Publish the new rows to SWMR readers
+          // NOTE: checked per batch, a chunk can take much longer than the
+          //       flush interval to append
+          if (swmr) {
+            auto now = std::chrono::steady_clock::now();
+            if (std::chrono::duration<double>(now - last_flush).count() >=
+                options.swmr_flush_interval) {
+              spdlog::debug("Flushing hits/events for SWMR readers");
+              if (hitsAppender) hitsAppender->flush();
+              if (neutronsAppender) neutronsAppender->flush();
+              if (eventStore) eventStore->flush();
+              last_flush = now;
+            }
+          }
         }
 
         // Update progress
         spdlog::debug("Processed chunk {}: {} bytes", chunkCounter,
                       chunk.size());
         processedSize += chunk.size();
-        float progress = static_cast<float>(processedSize) / totalSize * 100.0f;
-        spdlog::info("Progress: {:.2f}%", progress);
+        if (fileReader->isSeekable()) {
+          float progress =
+              static_cast<float>(processedSize) / workSize * 100.0f;
+          spdlog::info("Progress: {:.2f}%", progress);
+        } else {
+          spdlog::info("Progress: {:.2f} MB", processedSize / 1048576.0);
+        }
 
         // Update counters
         chunkCounter++;
@@ -326,6 +733,16 @@ int main(int argc, char* argv[]) {
         // Clear memory
         std::vector<TPX3>().swap(batches);
         std::vector<char>().swap(chunk);
+
+        // Checkpoint for a later --resume
+        if (options.checkpoint_interval > 0 && has_more()) {
+          auto now = std::chrono::steady_clock::now();
+          if (std::chrono::duration<double>(now - last_checkpoint).count() >=
+              options.checkpoint_interval) {
+            write_checkpoint();
+            last_checkpoint = now;
+          }
+        }
       } catch (const std::exception& e) {
         spdlog::error("Error processing chunk: {}", e.what());
       }
@@ -333,11 +750,24 @@ int main(int argc, char* argv[]) {
 
     // Close HDF5 files
     if (!options.output_hits.empty()) {
+      hitsAppender->close();
       hitsFile.close();
     }
     if (!options.output_events.empty()) {
+      neutronsAppender->close();
       eventsFile.close();
     }
+    if (eventStore) {
+      eventStore->close();
+      spdlog::info("Wrote {} events to {}", eventStore->getEvents(),
+                   options.output_event_store);
+    }
+
+    // The run is complete, its checkpoint is no longer needed
+    if (options.checkpoint_interval > 0 || options.resume) {
+      std::filesystem::remove(options.checkpoint_file);
+      std::filesystem::remove(tof_checkpoint_file);
+    }
 
     auto end = std::chrono::high_resolution_clock::now();
     auto elapsed =
@@ -348,24 +778,45 @@ int main(int argc, char* argv[]) {
     spdlog::info("Total hits: {}", totalHits);
     spdlog::info("Total neutrons: {}", totalNeutrons);
 
-    // Save TOF images if needed
+    // Save TOF images and spectra on background I/O threads
+    // NOTE: the cube is no longer updated, so it is moved into the snapshot
+    auto snapshot =
+        std::make_shared<const sophiread::TOFImages>(std::move(tof_images));
+    const std::vector<double> tof_bin_edges = config->getTOFBinEdges();
+    sophiread::AsyncWriter writer(2);
     if (!options.output_tof_imaging.empty()) {
-      spdlog::info("Saving TOF imaging to TIFF: {}",
-                   options.output_tof_imaging);
-      sophiread::timedSaveTOFImagingToTIFF(options.output_tof_imaging,
-                                           tof_images, config->getTOFBinEdges(),
-                                           options.tof_filename_base);
+      if (options.tof_format == "bigtiff") {
+        spdlog::info("Saving TOF imaging to BigTIFF stack: {}",
+                     options.output_tof_imaging);
+        writer.submit([&options, snapshot, tof_bin_edges]() {
+          sophiread::timedSaveTOFImagingToBigTIFF(
+              options.output_tof_imaging, *snapshot, tof_bin_edges,
+              options.tof_filename_base, options.compression);
+        });
+      } else if (options.tof_format == "hdf5") {
+        spdlog::info("Saving TOF imaging to HDF5 stack: {}",
+                     options.output_tof_imaging);
+        writer.submit([&options, snapshot, tof_bin_edges]() {
+          sophiread::timedSaveTOFImagingToHDF5(
+              options.output_tof_imaging, *snapshot, tof_bin_edges,
+              options.tof_filename_base, options.compression);
+        });
+      } else {
+        spdlog::info("Saving TOF imaging to TIFF: {}",
+                     options.output_tof_imaging);
+        writer.submitTOFImagingToTIFF(snapshot, options.output_tof_imaging,
+                                      tof_bin_edges,
+                                      options.tof_filename_base);
+      }
     }
 
     // Save spectra if needed
     if (!options.spectra_filen.empty()) {
       spdlog::info("Saving spectra to file: {}", options.spectra_filen);
-      std::string spectral_filename = options.spectra_filen + ".txt";
-      std::vector<uint64_t> spectral_counts =
-          sophiread::calculateSpectralCounts(tof_images);
-      sophiread::writeSpectralFile(spectral_filename, spectral_counts,
-                                   config->getTOFBinEdges());
+      writer.submitSpectralFile(snapshot, options.spectra_filen + ".txt",
+                                tof_bin_edges);
     }
+    writer.flush();
 
   } catch (const std::exception& e) {
     spdlog::error("Error: {}", e.what());
@@ -0,0 +1,178 @@
+/**
+ * @file sophiread_compress.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief CLI for compressing raw .tpx3 files into seekable zstd or lz4
+ * archives that Sophiread reads directly.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include <spdlog/spdlog.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#include "tpx3_reader.h"
+
+struct ProgramOptions {
+  std::string input_tpx3;
+  std::string output_archive;  // default: input + .zst or .lz4
+  std::string codec = "zstd";
+  int level = 3;
+  size_t frame_size_mb = 4;
+  bool debug_logging = false;
+  bool verbose = false;
+};
+
+/**
+ * @brief Print usage information.
+ *
+ * @param[in] program_name
+ */
+void print_usage(const char* program_name) {
+  spdlog::info(
+      "Usage: {} -i <input_tpx3> [-o <output_archive>] [-a <codec>] [-l "
+      "<level>] [-b <frame_size_MB>] [-d] [-v]",
+      program_name);
+  spdlog::info("Options:");
+  spdlog::info("  -i <input_tpx3>          Raw Timepix3 file");
+  spdlog::info(
+      "  -o <output_archive>      Output archive (default: input with .zst or "
+      ".lz4 appended)");
+  spdlog::info(
+      "  -a <codec>               Codec: 'zstd' or 'lz4' (default: zstd)");
+  spdlog::info(
+      "  -l <level>               Compression level (default: 3, lz4 uses "
+      "0 for the fast mode)");
+  spdlog::info(
+      "  -b <frame_size_MB>       Raw MB per independent frame, the seek "
+      "granularity (default: 4)");
+  spdlog::info("  -d                       Enable debug logging");
+  spdlog::info("  -v                       Enable verbose logging");
+}
+
+/**
+ * @brief Parse command line arguments.
+ *
+ * @param[in] argc
+ * @param[in] argv
+ */
+ProgramOptions parse_arguments(int argc, char* argv[]) {
+  ProgramOptions options;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "i:o:a:l:b:dv")) != -1) {
+    switch (opt) {
+      case 'i':
+        options.input_tpx3 = optarg;
+        break;
+      case 'o':
+        options.output_archive = optarg;
+        break;
+      case 'a':
+        options.codec = optarg;
+        break;
+      case 'l':
+        options.level = std::stoi(optarg);
+        break;
+      case 'b':
+        options.frame_size_mb = std::stoul(optarg);
+        break;
+      case 'd':
+        options.debug_logging = true;
+        break;
+      case 'v':
+        options.verbose = true;
+        break;
+      default:
+        print_usage(argv[0]);
+        throw std::runtime_error(std::string("Invalid argument: ") +
+                                 static_cast<char>(optopt));
+    }
+  }
+
+  // Validate required arguments
+  if (options.input_tpx3.empty()) {
+    print_usage(argv[0]);
+    throw std::runtime_error("Missing required arguments");
+  }
+
+  // Validate codec (throws on unknown names)
+  const TPX3Codec codec = parseTPX3Codec(options.codec);
+  if (!isTPX3CodecAvailable(codec)) {
+    throw std::runtime_error("Sophiread was built without " + options.codec +
+                             " support.");
+  }
+
+  // Validate frame size
+  if (options.frame_size_mb == 0 || options.frame_size_mb > 1024) {
+    throw std::runtime_error("Frame size must be between 1 and 1024 MB.");
+  }
+
+  if (options.output_archive.empty()) {
+    options.output_archive =
+        options.input_tpx3 + (codec == TPX3Codec::zstd ? ".zst" : ".lz4");
+  }
+  if (std::filesystem::exists(options.output_archive) &&
+      std::filesystem::equivalent(options.input_tpx3,
+                                  options.output_archive)) {
+    throw std::runtime_error("Output archive would overwrite the input.");
+  }
+
+  return options;
+}
+
+/**
+ * @brief Main function.
+ *
+ * @param[in] argc
+ * @param[in] argv
+ * @return int
+ */
+int main(int argc, char* argv[]) {
+  try {
+    ProgramOptions options = parse_arguments(argc, argv);
+
+    // Set logging level based on debug and verbose flags
+    if (options.debug_logging) {
+      spdlog::set_level(spdlog::level::debug);
+      spdlog::debug("Debug logging enabled");
+    } else if (options.verbose) {
+      spdlog::set_level(spdlog::level::info);
+    } else {
+      spdlog::set_level(spdlog::level::warn);
+    }
+
+    spdlog::info("Input file: {}", options.input_tpx3);
+    spdlog::info("Output archive: {}", options.output_archive);
+    spdlog::info("Codec: {} (level {}, {} MB frames)", options.codec,
+                 options.level, options.frame_size_mb);
+
+    TPX3CompressOptions compress_options;
+    compress_options.codec = parseTPX3Codec(options.codec);
+    compress_options.level = options.level;
+    compress_options.frame_size = options.frame_size_mb * 1024 * 1024;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    const uint64_t compressed_size = compressTPX3File(
+        options.input_tpx3, options.output_archive, compress_options);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    const double elapsed = std::chrono::duration<double>(end - start).count();
+    const double raw_size =
+        static_cast<double>(std::filesystem::file_size(options.input_tpx3));
+    spdlog::info("Compressed {} to {} bytes (ratio {:.2f}) in {:.2f} s",
+                 options.input_tpx3, compressed_size,
+                 compressed_size > 0 ? raw_size / compressed_size : 0.0,
+                 elapsed);
+  } catch (const std::exception& e) {
+    spdlog::error("Error: {}", e.what());
+    return 1;
+  }
+  return 0;
+}
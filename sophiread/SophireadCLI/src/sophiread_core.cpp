@@ -15,6 +15,8 @@
 #include <tbb/tbb.h>
 #include <tiffio.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>  // For std::isnan, std::isinf
 #include <filesystem>
@@ -235,16 +237,21 @@ std::vector<std::vector<std::vector<unsigned int>>> initializeTOFImages(
   return tof_images;
 }
 
-void updateTOFImages(
-    std::vector<std::vector<std::vector<unsigned int>>> &tof_images,
-    const TPX3 &batch, double super_resolution,
-    const std::vector<double> &tof_bin_edges, const std::string &mode) {
-  // Safety check for empty or invalid inputs
-  if (tof_images.empty() || tof_bin_edges.size() < 2) {
-    spdlog::error("Invalid TOF images or bin edges");
-    return;
-  }
-
+/**
+ * @brief Locate the TOF image pixel of every hit or neutron in a batch.
+ *
+ * @param[in] batch
+ * @param[in] n_bins: number of TOF images
+ * @param[in] super_resolution
+ * @param[in] tof_bin_edges
+ * @param[in] mode: "hit" or "neutron"
+ * @param[in] func: func(bin_index, y, x) for every entry inside the cube
+ */
+template <typename Func>
+static void forEachTOFImagePixel(const TPX3 &batch, size_t n_bins,
+                                 double super_resolution,
+                                 const std::vector<double> &tof_bin_edges,
+                                 const std::string &mode, Func &&func) {
   int dim_x = static_cast<int>(517 * super_resolution);
   int dim_y = static_cast<int>(517 * super_resolution);
 
@@ -295,7 +302,7 @@ void updateTOFImages(
         size_t bin_index = std::distance(tof_bin_edges.begin(), it) - 1;
 
         // Safety check for bin index
-        if (bin_index >= tof_images.size()) {
+        if (bin_index >= n_bins) {
           spdlog::debug("Bin index out of range: {}", bin_index);
           continue;
         }
@@ -314,7 +321,7 @@ void updateTOFImages(
         int y = std::round(raw_y * super_resolution);
 
         if (x >= 0 && x < dim_x && y >= 0 && y < dim_y) {
-          tof_images[bin_index][y][x]++;
+          func(bin_index, y, x);
         }
       }
     } catch (const std::exception &e) {
@@ -323,6 +330,103 @@ void updateTOFImages(
   }
 }
 
+void updateTOFImages(
+    std::vector<std::vector<std::vector<unsigned int>>> &tof_images,
+    const TPX3 &batch, double super_resolution,
+    const std::vector<double> &tof_bin_edges, const std::string &mode) {
+  // Safety check for empty or invalid inputs
+  if (tof_images.empty() || tof_bin_edges.size() < 2) {
+    spdlog::error("Invalid TOF images or bin edges");
+    return;
+  }
+
+  forEachTOFImagePixel(batch, tof_images.size(), super_resolution,
+                       tof_bin_edges, mode, [&](size_t bin, int y, int x) {
+                         tof_images[bin][y][x]++;
+                       });
+}
+
+/**
+ * @brief Collect the flat TOF image indices (bin, y, x) of a batch.
+ *
+ * This is the sparse counterpart of updateTOFImages: a file reduced on its
+ * own thread keeps one index per entry instead of a full partial cube, and
+ * the indices are added to the shared cube with addTOFImageIndices.
+ *
+ * @param[in, out] indices
+ * @param[in] batch
+ * @param[in] super_resolution
+ * @param[in] tof_bin_edges
+ * @param[in] mode: "hit" or "neutron"
+ */
+void collectTOFImageIndices(std::vector<uint64_t> &indices, const TPX3 &batch,
+                            double super_resolution,
+                            const std::vector<double> &tof_bin_edges,
+                            const std::string &mode) {
+  if (tof_bin_edges.size() < 2) {
+    spdlog::error("Invalid TOF bin edges");
+    return;
+  }
+
+  const uint64_t dim = static_cast<uint64_t>(517 * super_resolution);
+  forEachTOFImagePixel(batch, tof_bin_edges.size() - 1, super_resolution,
+                       tof_bin_edges, mode, [&](size_t bin, int y, int x) {
+                         indices.push_back((bin * dim + y) * dim + x);
+                       });
+}
+
+/**
+ * @brief Add the counts collected by collectTOFImageIndices to a cube.
+ *
+ * @param[in, out] tof_images
+ * @param[in] indices
+ */
+void addTOFImageIndices(
+    std::vector<std::vector<std::vector<unsigned int>>> &tof_images,
+    const std::vector<uint64_t> &indices) {
+  if (tof_images.empty() || tof_images[0].empty()) return;
+
+  const uint64_t height = tof_images[0].size();
+  const uint64_t width = tof_images[0][0].size();
+  for (const uint64_t index : indices) {
+    const uint64_t bin = index / (height * width);
+    if (bin >= tof_images.size()) continue;
+    tof_images[bin][(index / width) % height][index % width]++;
+  }
+}
+
+/**
+ * @brief Add a batch to the running image and spectrum of a live image
+ * publisher; binning follows updateTOFImages.
+ *
+ * @param[in, out] live: image of 517 * super_resolution pixels a side, one
+ *                       spectrum bin per TOF bin
+ * @param[in] batch
+ * @param[in] super_resolution
+ * @param[in] tof_bin_edges
+ * @param[in] mode: "hit" or "neutron"
+ */
+void updateLiveImage(LiveImagePublisher &live, const TPX3 &batch,
+                     double super_resolution,
+                     const std::vector<double> &tof_bin_edges,
+                     const std::string &mode) {
+  const auto dim = static_cast<uint32_t>(517 * super_resolution);
+  if (tof_bin_edges.size() < 2 || live.getWidth() != dim ||
+      live.getHeight() != dim) {
+    spdlog::error("Live image does not match the TOF binning");
+    return;
+  }
+
+  auto &image = live.image();
+  auto &spectrum = live.spectrum();
+  const size_t width = live.getWidth();
+  forEachTOFImagePixel(batch, spectrum.size(), super_resolution,
+                       tof_bin_edges, mode, [&](size_t bin, int y, int x) {
+                         image[y * width + x]++;
+                         spectrum[bin]++;
+                       });
+}
+
 /**
  * @brief Timed create TOF images.
  *
@@ -491,12 +595,14 @@ std::vector<std::vector<std::vector<unsigned int>>> timedCreateTOFImages(
  * @param[in] batches
  * @param[in] tof_bin_edges
  * @param[in] tof_filename_base
+ * @param[in] accumulate: add the counts of existing TIFF files, set to false
+ *                        when tof_images already holds the running total
  */
 void timedSaveTOFImagingToTIFF(
     const std::string &out_tof_imaging,
     const std::vector<std::vector<std::vector<TIFF32Bit>>> &tof_images,
     const std::vector<double> &tof_bin_edges,
-    const std::string &tof_filename_base) {
+    const std::string &tof_filename_base, bool accumulate) {
   auto start = std::chrono::high_resolution_clock::now();
 
   // 1. Create output directory if it doesn't exist
@@ -518,11 +624,13 @@ void timedSaveTOFImagingToTIFF(
           // prepare container and fill with current hist2d
           const uint32_t width = tof_images[bin][0].size();
           const uint32_t height = tof_images[bin].size();
-          std::vector<std::vector<TIFF32Bit>> accumulated_image =
-              tof_images[bin];
+          std::vector<std::vector<TIFF32Bit>> accumulated_image;
+          const std::vector<std::vector<TIFF32Bit>> *image = &tof_images[bin];
 
           // check if file already exist
-          if (std::filesystem::exists(filename)) {
+          if (accumulate && std::filesystem::exists(filename)) {
+            accumulated_image = tof_images[bin];
+            image = &accumulated_image;
             TIFF *existing_tif = TIFFOpen(filename.c_str(), "r");
             if (existing_tif) {
               uint32_t existing_width, existing_height;
@@ -568,7 +676,8 @@ void timedSaveTOFImagingToTIFF(
             TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
 
             for (uint32_t row = 0; row < height; ++row) {
-              TIFFWriteScanline(tif, accumulated_image[row].data(), row);
+              TIFFWriteScanline(
+                  tif, const_cast<TIFF32Bit *>((*image)[row].data()), row);
             }
 
             TIFFClose(tif);
@@ -593,6 +702,640 @@ void timedSaveTOFImagingToTIFF(
                duration.count());
 }
 
+/**
+ * @brief Load TOF imaging from the per-bin TIFF files.
+ *
+ * Used to seed a running cube on restart, the counts are added to tof_images.
+ *
+ * @param[in] out_tof_imaging
+ * @param[in] tof_filename_base
+ * @param[in, out] tof_images: initialized cube
+ * @return true if every bin was found with matching dimensions
+ */
+bool loadTOFImagingFromTIFF(
+    const std::string &out_tof_imaging, const std::string &tof_filename_base,
+    std::vector<std::vector<std::vector<TIFF32Bit>>> &tof_images) {
+  std::atomic<size_t> loaded_bins{0};
+
+  tbb::parallel_for(size_t(0), tof_images.size(), [&](size_t bin) {
+    std::string filename = fmt::format("{}/{}_bin_{:04d}.tiff", out_tof_imaging,
+                                       tof_filename_base, bin + 1);
+    if (!std::filesystem::exists(filename)) return;
+
+    TIFF *tif = TIFFOpen(filename.c_str(), "r");
+    if (!tif) {
+      spdlog::error("Failed to open existing TIFF file for reading: {}",
+                    filename);
+      return;
+    }
+
+    uint32_t width = 0, height = 0;
+    TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width);
+    TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height);
+    if (height == tof_images[bin].size() &&
+        width == tof_images[bin][0].size()) {
+      std::vector<TIFF32Bit> scanline(width);
+      for (uint32_t row = 0; row < height; ++row) {
+        TIFFReadScanline(tif, scanline.data(), row);
+        for (uint32_t col = 0; col < width; ++col) {
+          tof_images[bin][row][col] += scanline[col];
+        }
+      }
+      ++loaded_bins;
+    } else {
+      spdlog::error("Dimension mismatch for file: {}. Skipping.", filename);
+    }
+    TIFFClose(tif);
+  });
+
+  spdlog::info("Loaded {} of {} TOF bins from {}", loaded_bins.load(),
+               tof_images.size(), out_tof_imaging);
+  return loaded_bins == tof_images.size();
+}
+
+// Raw accumulator sidecar: magic, n_bins, height, width, then the counts
+static constexpr char kAccumulatorMagic[8] = {'S', 'P', 'H', 'A',
+                                              'C', 'C', '0', '1'};
+
+/**
+ * @brief Save the running TOF cube to a raw sidecar file.
+ *
+ * The file is written under a temporary name and renamed into place, so a
+ * crash during the save never leaves a truncated accumulator behind.
+ *
+ * @param[in] filename
+ * @param[in] tof_images
+ */
+void saveTOFImagingAccumulator(
+    const std::string &filename,
+    const std::vector<std::vector<std::vector<TIFF32Bit>>> &tof_images) {
+  const std::string tmp_filename = filename + ".tmp";
+  {
+    std::ofstream out(tmp_filename, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+      throw std::runtime_error("Failed to open accumulator for writing: " +
+                               tmp_filename);
+    }
+
+    const uint64_t header[3] = {
+        tof_images.size(), tof_images.empty() ? 0 : tof_images[0].size(),
+        tof_images.empty() || tof_images[0].empty() ? 0
+                                                    : tof_images[0][0].size()};
+    out.write(kAccumulatorMagic, sizeof(kAccumulatorMagic));
+    out.write(reinterpret_cast<const char *>(header), sizeof(header));
+    for (const auto &image : tof_images) {
+      for (const auto &row : image) {
+        out.write(reinterpret_cast<const char *>(row.data()),
+                  row.size() * sizeof(TIFF32Bit));
+      }
+    }
+    if (!out) {
+      throw std::runtime_error("Failed to write accumulator: " +
+                               tmp_filename);
+    }
+  }
+  std::filesystem::rename(tmp_filename, filename);
+  spdlog::debug("Wrote accumulator: {}", filename);
+}
+
+/**
+ * @brief Load the running TOF cube from a raw sidecar file.
+ *
+ * @param[in] filename
+ * @param[in, out] tof_images: initialized cube, overwritten on success
+ * @return true if the sidecar exists and matches the cube dimensions
+ */
+bool loadTOFImagingAccumulator(
+    const std::string &filename,
+    std::vector<std::vector<std::vector<TIFF32Bit>>> &tof_images) {
+  std::ifstream in(filename, std::ios::binary);
+  if (!in.is_open() || tof_images.empty() || tof_images[0].empty()) {
+    return false;
+  }
+
+  char magic[sizeof(kAccumulatorMagic)];
+  uint64_t header[3];
+  in.read(magic, sizeof(magic));
+  in.read(reinterpret_cast<char *>(header), sizeof(header));
+  if (!in || !std::equal(magic, magic + sizeof(magic), kAccumulatorMagic)) {
+    spdlog::error("Invalid accumulator file: {}", filename);
+    return false;
+  }
+  if (header[0] != tof_images.size() || header[1] != tof_images[0].size() ||
+      header[2] != tof_images[0][0].size()) {
+    spdlog::error(
+        "Accumulator {} has dimensions {}x{}x{}, expected {}x{}x{}. Ignoring.",
+        filename, header[0], header[1], header[2], tof_images.size(),
+        tof_images[0].size(), tof_images[0][0].size());
+    return false;
+  }
+
+  for (auto &image : tof_images) {
+    for (auto &row : image) {
+      in.read(reinterpret_cast<char *>(row.data()),
+              row.size() * sizeof(TIFF32Bit));
+    }
+  }
+  if (!in) {
+    spdlog::error("Truncated accumulator file: {}", filename);
+    return false;
+  }
+
+  spdlog::info("Loaded accumulator: {}", filename);
+  return true;
+}
+
+/**
+ * @brief Flatten the TOF cube into a contiguous [bin][y][x] buffer.
+ *
+ * @param[in] tof_images
+ * @return std::vector<TIFF32Bit>
+ */
+static std::vector<TIFF32Bit> flattenTOFImages(
+    const std::vector<std::vector<std::vector<TIFF32Bit>>> &tof_images) {
+  const size_t height = tof_images[0].size();
+  const size_t width = tof_images[0][0].size();
+  std::vector<TIFF32Bit> cube(tof_images.size() * height * width);
+
+  tbb::parallel_for(size_t(0), tof_images.size(), [&](size_t bin) {
+    auto dst = cube.begin() + bin * height * width;
+    for (const auto &row : tof_images[bin]) {
+      dst = std::copy(row.cbegin(), row.cend(), dst);
+    }
+  });
+
+  return cube;
+}
+
+/**
+ * @brief Spectral counts from the contiguous cube.
+ *
+ * @param[in] cube
+ * @param[in] n_bins
+ * @return std::vector<uint64_t>
+ */
+static std::vector<uint64_t> calculateSpectralCounts(
+    const std::vector<TIFF32Bit> &cube, const size_t n_bins) {
+  const size_t n_pixels = cube.size() / n_bins;
+  std::vector<uint64_t> spectral_counts(n_bins, 0);
+  for (size_t bin = 0; bin < n_bins; ++bin) {
+    spectral_counts[bin] =
+        std::accumulate(cube.cbegin() + bin * n_pixels,
+                        cube.cbegin() + (bin + 1) * n_pixels, 0ULL);
+  }
+  return spectral_counts;
+}
+
+/**
+ * @brief Read every page of a BigTIFF stack written by
+ * timedSaveTOFImagingToBigTIFF.
+ *
+ * @param[in] filename
+ * @param[in] n_bins: expected number of pages
+ * @param[in] width: expected page width
+ * @param[in] height: expected page height
+ * @param[out] cube: pages one after the other, only valid on success
+ * @return true if the stack has the expected shape and every strip was read
+ */
+static bool readBigTIFFStack(const std::string &filename, uint32_t n_bins,
+                             uint32_t width, uint32_t height,
+                             std::vector<TIFF32Bit> &cube) {
+  TIFF *tif = TIFFOpen(filename.c_str(), "r");
+  if (!tif) return false;
+  if (TIFFNumberOfDirectories(tif) != n_bins) {
+    spdlog::error("Expected {} pages in {}", n_bins, filename);
+    TIFFClose(tif);
+    return false;
+  }
+
+  // check the shape of every page before reading any
+  for (uint32_t bin = 0; bin < n_bins; ++bin) {
+    uint32_t page_width = 0, page_height = 0;
+    if (!TIFFSetDirectory(tif, bin) ||
+        !TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &page_width) ||
+        !TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &page_height) ||
+        page_width != width || page_height != height) {
+      spdlog::error("Dimension mismatch in page {} of {}", bin, filename);
+      TIFFClose(tif);
+      return false;
+    }
+  }
+
+  const size_t page_bytes =
+      static_cast<size_t>(width) * height * sizeof(TIFF32Bit);
+  cube.assign(static_cast<size_t>(n_bins) * width * height, 0);
+  bool ok = true;
+  for (uint32_t bin = 0; bin < n_bins && ok; ++bin) {
+    TIFFSetDirectory(tif, bin);
+    auto *page = reinterpret_cast<char *>(cube.data()) + bin * page_bytes;
+    size_t read = 0;
+    for (tstrip_t strip = 0; strip < TIFFNumberOfStrips(tif); ++strip) {
+      const tmsize_t nbytes = TIFFReadEncodedStrip(
+          tif, strip, page + read, static_cast<tmsize_t>(page_bytes - read));
+      if (nbytes < 0) {
+        spdlog::error("Failed to read strip {} of page {} in {}", strip, bin,
+                      filename);
+        ok = false;
+        break;
+      }
+      read += nbytes;
+    }
+    if (ok && read != page_bytes) {
+      spdlog::error("Short page {} in {}", bin, filename);
+      ok = false;
+    }
+  }
+  TIFFClose(tif);
+  return ok;
+}
+
+/**
+ * @brief Timed save TOF imaging to a single multipage BigTIFF file.
+ *
+ * The whole stack goes to {out_tof_imaging}/{tof_filename_base}.tiff with one
+ * page per TOF bin, written strip by strip from the contiguous cube.  If the
+ * file already exists, its counts are accumulated in a single pass.
+ *
+ * @param[in] out_tof_imaging
+ * @param[in] tof_images
+ * @param[in] tof_bin_edges
+ * @param[in] tof_filename_base
+ * @param[in] compression: "none", "deflate", "lz4" or "zstd"
+ * @param[in] accumulate: add the counts of an existing stack, set to false
+ *                        to overwrite it
+ */
+void timedSaveTOFImagingToBigTIFF(
+    const std::string &out_tof_imaging,
+    const std::vector<std::vector<std::vector<TIFF32Bit>>> &tof_images,
+    const std::vector<double> &tof_bin_edges,
+    const std::string &tof_filename_base, const std::string &compression,
+    bool accumulate) {
+  auto start = std::chrono::high_resolution_clock::now();
+
+  if (tof_images.empty() || tof_images[0].empty()) {
+    spdlog::warn("No TOF images to save.");
+    return;
+  }
+
+  // 1. Pick the codec, libtiff has no LZ4 so deflate is used instead
+  uint16_t tiff_compression = COMPRESSION_ADOBE_DEFLATE;
+  switch (parseH5Compression(compression)) {
+    case H5Compression::none:
+      tiff_compression = COMPRESSION_NONE;
+      break;
+    case H5Compression::zstd:
+      if (TIFFIsCODECConfigured(COMPRESSION_ZSTD)) {
+        tiff_compression = COMPRESSION_ZSTD;
+      } else {
+        spdlog::warn("libtiff built without zstd, using deflate");
+      }
+      break;
+    case H5Compression::lz4:
+      spdlog::warn("TIFF does not support lz4, using deflate");
+      break;
+    default:
+      break;
+  }
+
+  // 2. Create output directory if it doesn't exist
+  if (!std::filesystem::exists(out_tof_imaging)) {
+    std::filesystem::create_directories(out_tof_imaging);
+    spdlog::info("Created output directory: {}", out_tof_imaging);
+  }
+
+  const uint32_t n_bins = tof_images.size();
+  const uint32_t height = tof_images[0].size();
+  const uint32_t width = tof_images[0][0].size();
+  const size_t n_pixels = static_cast<size_t>(width) * height;
+  std::vector<TIFF32Bit> cube = flattenTOFImages(tof_images);
+
+  // 3. Accumulate counts from the existing stack
+  const std::string filename =
+      fmt::format("{}/{}.tiff", out_tof_imaging, tof_filename_base);
+  if (accumulate && std::filesystem::exists(filename)) {
+    // NOTE: read into a scratch cube, added only once every page was read, so
+    //       a damaged stack is overwritten as a whole, never half added
+    std::vector<TIFF32Bit> existing;
+    if (readBigTIFFStack(filename, n_bins, width, height, existing)) {
+      std::transform(existing.cbegin(), existing.cend(), cube.cbegin(),
+                     cube.begin(), std::plus<TIFF32Bit>());
+      spdlog::debug("Accumulated counts from existing stack: {}", filename);
+    } else {
+      spdlog::error("Cannot accumulate into existing stack: {}. Overwriting.",
+                    filename);
+    }
+  }
+
+  // 4. Write every page to a temporary file, then swap it in
+  const std::string tmp_filename = filename + ".tmp";
+  TIFF *tif = TIFFOpen(tmp_filename.c_str(), "w8");
+  if (!tif) {
+    throw std::runtime_error("Failed to open BigTIFF file for writing: " +
+                             tmp_filename);
+  }
+
+  // ~256 KiB strips
+  const uint32_t rows_per_strip =
+      std::clamp<uint32_t>((256 * 1024) / (width * sizeof(TIFF32Bit)), 1,
+                           height);
+  for (uint32_t bin = 0; bin < n_bins; ++bin) {
+    TIFFSetField(tif, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
+    TIFFSetField(tif, TIFFTAG_PAGENUMBER, bin, n_bins);
+    TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
+    TIFFSetField(tif, TIFFTAG_IMAGELENGTH, height);
+    TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+    TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 32);
+    TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
+    TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+    TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+    TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, rows_per_strip);
+    TIFFSetField(tif, TIFFTAG_COMPRESSION, tiff_compression);
+    if (tiff_compression != COMPRESSION_NONE) {
+      TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+    }
+
+    const TIFF32Bit *page = cube.data() + bin * n_pixels;
+    for (uint32_t row = 0; row < height; row += rows_per_strip) {
+      const uint32_t nrows = std::min(rows_per_strip, height - row);
+      // libtiff may apply the predictor in place, hence the copy
+      std::vector<TIFF32Bit> strip(page + static_cast<size_t>(row) * width,
+                                   page + static_cast<size_t>(row + nrows) *
+                                              width);
+      if (TIFFWriteEncodedStrip(tif, TIFFComputeStrip(tif, row, 0),
+                                strip.data(),
+                                strip.size() * sizeof(TIFF32Bit)) < 0) {
+        TIFFClose(tif);
+        throw std::runtime_error("Failed to write strip to " + tmp_filename);
+      }
+    }
+    TIFFWriteDirectory(tif);
+  }
+  TIFFClose(tif);
+  std::filesystem::rename(tmp_filename, filename);
+  spdlog::debug("Wrote BigTIFF stack: {}", filename);
+
+  // 5. Write spectral file
+  std::string spectral_filename =
+      fmt::format("{}/{}_Spectra.txt", out_tof_imaging, tof_filename_base);
+  writeSpectralFile(spectral_filename, calculateSpectralCounts(cube, n_bins),
+                    tof_bin_edges);
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto duration =
+      std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+  spdlog::info("BigTIFF stack and spectra file writing completed in {} ms",
+               duration.count());
+}
+
+/**
+ * @brief Timed save TOF imaging to a single chunked HDF5 file.
+ *
+ * The stack goes to {out_tof_imaging}/{tof_filename_base}.h5 as the dataset
+ * "tof_images" with shape [bin, y, x] and one chunk per TOF bin, together with
+ * "tof_bin_edges" and "spectra".  If the file already exists, its counts are
+ * accumulated with a single read.
+ *
+ * @param[in] out_tof_imaging
+ * @param[in] tof_images
+ * @param[in] tof_bin_edges
+ * @param[in] tof_filename_base
+ * @param[in] compression: "none", "deflate", "lz4" or "zstd"
+ * @param[in] accumulate: add the counts of an existing stack, set to false
+ *                        to overwrite it
+ */
+void timedSaveTOFImagingToHDF5(
+    const std::string &out_tof_imaging,
+    const std::vector<std::vector<std::vector<TIFF32Bit>>> &tof_images,
+    const std::vector<double> &tof_bin_edges,
+    const std::string &tof_filename_base, const std::string &compression,
+    bool accumulate) {
+  auto start = std::chrono::high_resolution_clock::now();
+
+  if (tof_images.empty() || tof_images[0].empty()) {
+    spdlog::warn("No TOF images to save.");
+    return;
+  }
+  const H5Compression h5_compression = parseH5Compression(compression);
+
+  // 1. Create output directory if it doesn't exist
+  if (!std::filesystem::exists(out_tof_imaging)) {
+    std::filesystem::create_directories(out_tof_imaging);
+    spdlog::info("Created output directory: {}", out_tof_imaging);
+  }
+
+  const hsize_t dims[3] = {tof_images.size(), tof_images[0].size(),
+                           tof_images[0][0].size()};
+  std::vector<TIFF32Bit> cube = flattenTOFImages(tof_images);
+
+  // 2. Accumulate counts from the existing stack
+  const std::string filename =
+      fmt::format("{}/{}.h5", out_tof_imaging, tof_filename_base);
+  if (accumulate && std::filesystem::exists(filename)) {
+    try {
+      H5::H5File existing(filename, H5F_ACC_RDONLY);
+      H5::DataSet dataset = existing.openDataSet("tof_images");
+      H5::DataSpace dataspace = dataset.getSpace();
+      hsize_t existing_dims[3] = {0, 0, 0};
+      if (dataspace.getSimpleExtentNdims() == 3) {
+        dataspace.getSimpleExtentDims(existing_dims);
+      }
+      if (std::equal(dims, dims + 3, existing_dims)) {
+        std::vector<TIFF32Bit> existing_cube(cube.size());
+        dataset.read(existing_cube.data(), H5::PredType::NATIVE_UINT32);
+        std::transform(existing_cube.cbegin(), existing_cube.cend(),
+                       cube.cbegin(), cube.begin(), std::plus<TIFF32Bit>());
+        spdlog::debug("Accumulated counts from existing stack: {}", filename);
+      } else {
+        spdlog::error("Dimension mismatch for file: {}. Overwriting.",
+                      filename);
+      }
+    } catch (const H5::Exception &e) {
+      spdlog::error("Failed to read existing stack {}: {}. Overwriting.",
+                    filename, e.getDetailMsg());
+    }
+  }
+  const std::vector<uint64_t> spectral_counts =
+      calculateSpectralCounts(cube, dims[0]);
+
+  // 3. Write the stack to a temporary file, then swap it in
+  const std::string tmp_filename = filename + ".tmp";
+  {
+    H5::H5File out_file(tmp_filename, H5F_ACC_TRUNC);
+
+    H5::DSetCreatPropList prop_list;
+    const hsize_t chunk_dims[3] = {1, dims[1], dims[2]};
+    prop_list.setChunk(3, chunk_dims);
+    setH5Compression(prop_list, h5_compression);
+
+    H5::DataSpace cube_space(3, dims);
+    H5::DataSet cube_dataset = out_file.createDataSet(
+        "tof_images", H5::PredType::NATIVE_UINT32, cube_space, prop_list);
+    cube_dataset.write(cube.data(), H5::PredType::NATIVE_UINT32);
+
+    const hsize_t edges_dims[1] = {tof_bin_edges.size()};
+    H5::DataSpace edges_space(1, edges_dims);
+    out_file
+        .createDataSet("tof_bin_edges", H5::PredType::NATIVE_DOUBLE,
+                       edges_space)
+        .write(tof_bin_edges.data(), H5::PredType::NATIVE_DOUBLE);
+
+    const hsize_t spectra_dims[1] = {spectral_counts.size()};
+    H5::DataSpace spectra_space(1, spectra_dims);
+    out_file
+        .createDataSet("spectra", H5::PredType::NATIVE_UINT64, spectra_space)
+        .write(spectral_counts.data(), H5::PredType::NATIVE_UINT64);
+  }
+  std::filesystem::rename(tmp_filename, filename);
+  spdlog::debug("Wrote HDF5 stack: {}", filename);
+
+  // 4. Write spectral file
+  std::string spectral_filename =
+      fmt::format("{}/{}_Spectra.txt", out_tof_imaging, tof_filename_base);
+  writeSpectralFile(spectral_filename, spectral_counts, tof_bin_edges);
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto duration =
+      std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+  spdlog::info("HDF5 stack and spectra file writing completed in {} ms",
+               duration.count());
+}
+
+/**
+ * @brief Bin events into a TOF cube on the TBB worker threads.
+ *
+ * The bins are updated with relaxed atomic increments, so every thread works
+ * on the shared cube directly. Binning follows updateTOFImages.
+ *
+ * @param[in,out] tof_images
+ * @param[in] first: first row
+ * @param[in] last: one past the last row
+ * @param[in] super_resolution
+ * @param[in] tof_bin_edges
+ * @param[in] get_event: get_event(row, x, y, tof_ns), false to skip the row
+ */
+template <typename GetEvent>
+static void binEventsParallel(
+    std::vector<std::vector<std::vector<unsigned int>>> &tof_images,
+    size_t first, size_t last, double super_resolution,
+    const std::vector<double> &tof_bin_edges, GetEvent &&get_event) {
+  if (tof_images.empty() || tof_bin_edges.size() < 2 || first >= last) {
+    return;
+  }
+  const int dim_x = static_cast<int>(517 * super_resolution);
+  const int dim_y = static_cast<int>(517 * super_resolution);
+
+  tbb::parallel_for(
+      tbb::blocked_range<size_t>(first, last, 1 << 16),
+      [&](const tbb::blocked_range<size_t> &range) {
+        for (size_t row = range.begin(); row != range.end(); ++row) {
+          double raw_x, raw_y, tof_ns;
+          if (!get_event(row, raw_x, raw_y, tof_ns)) continue;
+          if (!std::isfinite(tof_ns) || !std::isfinite(raw_x) ||
+              !std::isfinite(raw_y) || tof_ns < 0) {
+            continue;
+          }
+
+          const double tof_s = tof_ns / 1e9;
+          if (tof_s < tof_bin_edges.front() || tof_s >= tof_bin_edges.back()) {
+            continue;
+          }
+          auto it = std::lower_bound(tof_bin_edges.begin(),
+                                     tof_bin_edges.end(), tof_s);
+          if (it == tof_bin_edges.begin()) continue;
+          const size_t bin_index = std::distance(tof_bin_edges.begin(), it) - 1;
+          if (bin_index >= tof_images.size()) continue;
+
+          const int x = std::round(raw_x * super_resolution);
+          const int y = std::round(raw_y * super_resolution);
+          if (x >= 0 && x < dim_x && y >= 0 && y < dim_y) {
+            std::atomic_ref<unsigned int>(tof_images[bin_index][y][x])
+                .fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+      });
+}
+
+/**
+ * @brief Re-bin saved neutron events into a new TOF cube.
+ *
+ * @param[in] neutrons: events with pixel coordinates and TOF in 25 ns ticks
+ * @param[in] super_resolution
+ * @param[in] tof_bin_edges
+ * @return std::vector<std::vector<std::vector<unsigned int>>>
+ */
+std::vector<std::vector<std::vector<unsigned int>>> rebinNeutrons(
+    const std::vector<Neutron> &neutrons, double super_resolution,
+    const std::vector<double> &tof_bin_edges) {
+  auto start = std::chrono::high_resolution_clock::now();
+  auto tof_images = initializeTOFImages(super_resolution, tof_bin_edges);
+  binEventsParallel(tof_images, 0, neutrons.size(), super_resolution,
+                    tof_bin_edges,
+                    [&](size_t row, double &x, double &y, double &tof_ns) {
+                      x = neutrons[row].getX();
+                      y = neutrons[row].getY();
+                      tof_ns = neutrons[row].getTOF_ns();
+                      return true;
+                    });
+  auto end = std::chrono::high_resolution_clock::now();
+  auto duration =
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+  spdlog::info("Re-binned {} events in {} s", neutrons.size(),
+               duration.count() / 1e6);
+  return tof_images;
+}
+
+/**
+ * @brief Re-bin the events of a columnar event store into a new TOF cube.
+ *
+ * Only the index blocks overlapping the spidertime window are read from the
+ * memory-mapped columns.
+ *
+ * @param[in] store
+ * @param[in] super_resolution
+ * @param[in] tof_bin_edges
+ * @param[in] begin_spidertime: inclusive, in 25 ns ticks
+ * @param[in] end_spidertime: exclusive, in 25 ns ticks
+ * @return std::vector<std::vector<std::vector<unsigned int>>>
+ */
+std::vector<std::vector<std::vector<unsigned int>>> rebinEventStore(
+    const EventStoreReader &store, double super_resolution,
+    const std::vector<double> &tof_bin_edges, uint64_t begin_spidertime,
+    uint64_t end_spidertime) {
+  auto start = std::chrono::high_resolution_clock::now();
+  auto tof_images = initializeTOFImages(super_resolution, tof_bin_edges);
+
+  const float *x = store.getX();
+  const float *y = store.getY();
+  const float *tof = store.getTOF();
+  const uint64_t *spidertime = store.getSpidertime();
+  const bool whole_run = begin_spidertime == 0 && end_spidertime == UINT64_MAX;
+  uint64_t n_rows = 0;
+  for (const auto &[first, last] :
+       store.findRows(begin_spidertime, end_spidertime)) {
+    binEventsParallel(
+        tof_images, first, last, super_resolution, tof_bin_edges,
+        [&](size_t row, double &event_x, double &event_y, double &tof_ns) {
+          if (!whole_run && (spidertime[row] < begin_spidertime ||
+                             spidertime[row] >= end_spidertime)) {
+            return false;
+          }
+          event_x = x[row];
+          event_y = y[row];
+          tof_ns = tof[row] * 25.0;
+          return true;
+        });
+    n_rows += last - first;
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto duration =
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+  spdlog::info("Re-binned {} of {} stored events in {} s", n_rows,
+               store.getEvents(), duration.count() / 1e6);
+  return tof_images;
+}
+
 std::vector<uint64_t> calculateSpectralCounts(
     const std::vector<std::vector<std::vector<unsigned int>>> &tof_images) {
   std::vector<uint64_t> spectral_counts(tof_images.size(), 0);
@@ -0,0 +1,554 @@
+/**
+ * @file sophiread_mpi.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief MPI driver reducing a single large .tpx3 run over several processes,
+ * each clustering its own batch-aligned share of the file.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include <getopt.h>
+#include <mpi.h>
+#include <spdlog/spdlog.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "disk_io.h"
+#include "hdf5_appender.h"
+#include "json_config_parser.h"
+#include "sophiread_core.h"
+#include "tpx3_index.h"
+#include "user_config.h"
+
+struct ProgramOptions {
+  std::string input_tpx3;
+  std::string output_events;  // one file per rank: <name>_rank<N>.<ext>
+  std::string config_file;
+  std::string output_tof_imaging;
+  std::string tof_filename_base = "tof_image";
+  std::string tof_mode = "neutron";
+  std::string spectra_filen = "Spectra";
+  std::string timing_mode = "tdc";  // Default is TDC mode
+  std::string tof_format = "tiff";  // tiff, bigtiff or hdf5
+  std::string compression = "deflate";
+  std::string hdf5_schema = "legacy";     // legacy or compact
+  size_t chunk_size = 512 * 1024 * 1024;  // per rank, default 512MB
+  std::string index_file;                 // default: <input>.idx
+  bool debug_logging = false;
+  bool verbose = false;
+};
+
+/**
+ * @brief Print usage information.
+ *
+ * @param[in] program_name
+ */
+void print_usage(const char* program_name) {
+  spdlog::info(
+      "Usage: mpirun -np <ranks> {} -i <input_tpx3> [-E <output_events>] [-u "
+      "<config_file>] [-T <tof_imaging_folder>] [-f <tof_filename_base>] [-m "
+      "<tof_mode>] [-t <timing_mode>] [-s <spectra_filename>] [-F "
+      "<tof_format>] [-z <compression>] [-S <hdf5_schema>] [-c <chunk_size>] "
+      "[-x <index_file>] [-d] [-v]",
+      program_name);
+  spdlog::info("Options:");
+  spdlog::info("  -i <input_tpx3>          Input TPX3 file");
+  spdlog::info(
+      "  -E <output_events>       Output events HDF5 file, one per rank with "
+      "_rank<N> added to the name (optional)");
+  spdlog::info(
+      "  -u <config_file>         User configuration JSON file (optional)");
+  spdlog::info(
+      "  -T <tof_imaging_folder>  Output folder for TIFF TOF images "
+      "(optional)");
+  spdlog::info(
+      "  -f <tof_filename_base>   Base name for TIFF files (default: "
+      "tof_image)");
+  spdlog::info(
+      "  -m <tof_mode>            TOF mode: 'hit' or 'neutron' (default: "
+      "neutron)");
+  spdlog::info(
+      "  -t <timing_mode>         Timing mode: 'gdc' or 'tdc' (default: tdc)");
+  spdlog::info("  -s <spectra_filename>    Output filename for spectra");
+  spdlog::info(
+      "  -F <tof_format>          TOF imaging format: 'tiff' (one file per "
+      "bin), 'bigtiff' or 'hdf5' (single file stack) (default: tiff)");
+  spdlog::info(
+      "  -z <compression>         Compression of the single file stack and "
+      "the events HDF5: 'none', 'deflate', 'lz4' or 'zstd' (default: "
+      "deflate)");
+  spdlog::info(
+      "  -S <hdf5_schema>         Events HDF5 schema: 'legacy' (all double) "
+      "or 'compact' (native types) (default: legacy)");
+  spdlog::info(
+      "  -c <chunk_size>          Chunk size in MB per rank (default: 512)");
+  spdlog::info(
+      "  -x <index_file>          Batch index sidecar, built by the ranks "
+      "together if missing (default: <input>.idx)");
+  spdlog::info("  -d                       Enable debug logging");
+  spdlog::info("  -v                       Enable verbose logging");
+}
+
+/**
+ * @brief Parse command line arguments.
+ *
+ * @param[in] argc
+ * @param[in] argv
+ */
+ProgramOptions parse_arguments(int argc, char* argv[]) {
+  ProgramOptions options;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "i:E:u:T:f:m:t:s:F:z:S:c:x:dv")) != -1) {
+    switch (opt) {
+      case 'i':
+        options.input_tpx3 = optarg;
+        break;
+      case 'E':
+        options.output_events = optarg;
+        break;
+      case 'u':
+        options.config_file = optarg;
+        break;
+      case 'T':
+        options.output_tof_imaging = optarg;
+        break;
+      case 'f':
+        options.tof_filename_base = optarg;
+        break;
+      case 'm':
+        options.tof_mode = optarg;
+        break;
+      case 't':
+        options.timing_mode = optarg;
+        break;
+      case 's':
+        options.spectra_filen = optarg;
+        break;
+      case 'F':
+        options.tof_format = optarg;
+        break;
+      case 'z':
+        options.compression = optarg;
+        break;
+      case 'S':
+        options.hdf5_schema = optarg;
+        break;
+      case 'c':
+        options.chunk_size = static_cast<size_t>(std::stoull(optarg)) * 1024 *
+                             1024;  // Convert MB to bytes
+        break;
+      case 'x':
+        options.index_file = optarg;
+        break;
+      case 'd':
+        options.debug_logging = true;
+        break;
+      case 'v':
+        options.verbose = true;
+        break;
+      default:
+        print_usage(argv[0]);
+        throw std::runtime_error(std::string("Invalid argument: ") +
+                                 static_cast<char>(optopt));
+    }
+  }
+
+  // Validate required arguments
+  if (options.input_tpx3.empty()) {
+    print_usage(argv[0]);
+    throw std::runtime_error("Missing required arguments");
+  }
+
+  // Validate TOF mode
+  if (options.tof_mode != "hit" && options.tof_mode != "neutron") {
+    throw std::runtime_error("Invalid TOF mode. Use 'hit' or 'neutron'.");
+  }
+
+  // Validate timing mode
+  if (options.timing_mode != "gdc" && options.timing_mode != "tdc") {
+    throw std::runtime_error("Invalid timing mode. Use 'gdc' or 'tdc'.");
+  }
+
+  // Validate TOF imaging format
+  if (options.tof_format != "tiff" && options.tof_format != "bigtiff" &&
+      options.tof_format != "hdf5") {
+    throw std::runtime_error(
+        "Invalid TOF imaging format. Use 'tiff', 'bigtiff' or 'hdf5'.");
+  }
+
+  // Validate compression and HDF5 schema (throw on unknown names)
+  parseH5Compression(options.compression);
+  parseHDF5Schema(options.hdf5_schema);
+
+  // Validate chunk size
+  if (options.chunk_size == 0) {
+    throw std::runtime_error("Chunk size must be a positive integer.");
+  }
+
+  if (options.index_file.empty()) {
+    options.index_file = options.input_tpx3 + ".idx";
+  }
+
+  return options;
+}
+
+/**
+ * @brief Name of the file a rank writes, e.g. events_rank0003.h5.
+ *
+ * @param[in] filename
+ * @param[in] rank
+ * @return std::string
+ */
+std::string rankFileName(const std::string& filename, int rank) {
+  const std::filesystem::path path(filename);
+  return (path.parent_path() /
+          fmt::format("{}_rank{:04d}{}", path.stem().string(), rank,
+                      path.extension().string()))
+      .string();
+}
+
+/**
+ * @brief MPI_Exscan operator chaining the timestamp summaries of the ranks.
+ *
+ * @note Not commutative, MPI hands the lower ranks in invec.
+ */
+void chainTimestampSummaries(void* invec, void* inoutvec, int* len,
+                             MPI_Datatype*) {
+  auto* earlier = static_cast<const TPX3TimestampSummary*>(invec);
+  auto* later = static_cast<TPX3TimestampSummary*>(inoutvec);
+  try {
+    for (int i = 0; i < *len; ++i) {
+      TPX3TimestampSummary chained = earlier[i];
+      chained.append(later[i]);
+      later[i] = chained;
+    }
+  } catch (const std::exception& e) {
+    // NOTE: exceptions must not unwind through the MPI library
+    spdlog::error("Error: {}", e.what());
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+}
+
+/**
+ * @brief Index the share of the file this rank reduces.
+ *
+ * With a sidecar matching the file, its blocks are split into byte-balanced
+ * ranges. Otherwise each rank indexes a byte range of its own, an exclusive
+ * scan of the timestamp summaries gives the state every range starts from,
+ * and rank 0 gathers the blocks into the sidecar for the next run.
+ *
+ * @param[in] options
+ * @param[in] rank
+ * @param[in] nranks
+ * @param[out] first: first block of the rank
+ * @param[out] last: end of the blocks of the rank
+ * @return TPX3Index
+ */
+TPX3Index indexRankShare(const ProgramOptions& options, int rank, int nranks,
+                         size_t& first, size_t& last) {
+  const bool use_gdc = options.timing_mode == "gdc";
+  const uint64_t file_size =
+      openTPX3Reader(options.input_tpx3)->getTotalSize();
+
+  // rank 0 decides, so that every rank takes the same path
+  int has_sidecar = 0;
+  if (rank == 0 && std::filesystem::exists(options.index_file)) {
+    try {
+      TPX3Index index = TPX3Index::load(options.index_file);
+      has_sidecar =
+          index.usesGDC() == use_gdc && index.getFileSize() == file_size;
+    } catch (const std::exception& e) {
+      spdlog::warn("{}, rebuilding it", e.what());
+    }
+  }
+  MPI_Bcast(&has_sidecar, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  if (has_sidecar) {
+    TPX3Index index = TPX3Index::load(options.index_file);
+    std::tie(first, last) = index.split(nranks, 0, index.size())[rank];
+    return index;
+  }
+
+  // the byte range of the rank, batches belong to the range of their header
+  const auto bound = [&](int r) {
+    return r == nranks ? file_size : (file_size * r / nranks) & ~uint64_t(7);
+  };
+  auto start = std::chrono::high_resolution_clock::now();
+  TPX3TimestampSummary summary;
+  TPX3Index part = TPX3Index::buildRange(
+      options.input_tpx3, use_gdc, bound(rank), bound(rank + 1), summary,
+      TPX3Index::kDefaultBlockSize, options.chunk_size);
+
+  // state at the start of the range, chained from the ranges before it
+  MPI_Datatype summary_type;
+  MPI_Type_contiguous(sizeof(TPX3TimestampSummary), MPI_BYTE, &summary_type);
+  MPI_Type_commit(&summary_type);
+  MPI_Op chain;
+  MPI_Op_create(chainTimestampSummaries, 0, &chain);
+  TPX3TimestampSummary before;
+  MPI_Exscan(&summary, &before, 1, summary_type, chain, MPI_COMM_WORLD);
+  MPI_Op_free(&chain);
+  MPI_Type_free(&summary_type);
+
+  unsigned long tdc_timestamp = 0;
+  unsigned long long gdc_timestamp = 0;
+  unsigned long timer_lsb32 = 0;
+  if (rank > 0) {
+    before.apply(use_gdc, tdc_timestamp, gdc_timestamp, timer_lsb32);
+  }
+  part.rebase(tdc_timestamp, gdc_timestamp, timer_lsb32);
+  first = 0;
+  last = part.size();
+  auto end = std::chrono::high_resolution_clock::now();
+  spdlog::info("Indexed {} blocks in {} s", part.size(),
+               std::chrono::duration<double>(end - start).count());
+
+  // gather the blocks, with the end of file entry of the last rank
+  const auto& entries = part.getEntries();
+  const int bytes = static_cast<int>(
+      (rank + 1 == nranks ? entries.size() : part.size()) *
+      sizeof(TPX3IndexEntry));
+  std::vector<int> counts(rank == 0 ? nranks : 0);
+  MPI_Gather(&bytes, 1, MPI_INT, counts.data(), 1, MPI_INT, 0,
+             MPI_COMM_WORLD);
+  std::vector<int> displs(counts.size());
+  std::vector<TPX3IndexEntry> all;
+  if (rank == 0) {
+    size_t total = 0;
+    for (int r = 0; r < nranks; ++r) {
+      displs[r] = static_cast<int>(total);
+      total += counts[r];
+    }
+    all.resize(total / sizeof(TPX3IndexEntry));
+  }
+  MPI_Gatherv(entries.data(), bytes, MPI_BYTE, all.data(), counts.data(),
+              displs.data(), MPI_BYTE, 0, MPI_COMM_WORLD);
+  if (rank == 0) {
+    try {
+      TPX3Index(use_gdc, file_size, std::move(all)).save(options.index_file);
+      spdlog::info("Saved batch index to {}", options.index_file);
+    } catch (const std::exception& e) {
+      spdlog::warn("Cannot save batch index: {}", e.what());
+    }
+  }
+  return part;
+}
+
+/**
+ * @brief Sum the TOF cubes of the ranks into the one of rank 0, a bin at a
+ * time to keep the buffers and MPI counts small.
+ *
+ * @param[in, out] tof_images
+ * @param[in] rank
+ */
+void reduceTOFImages(
+    std::vector<std::vector<std::vector<unsigned int>>>& tof_images,
+    int rank) {
+  std::vector<unsigned int> local;
+  std::vector<unsigned int> total;
+  for (auto& image : tof_images) {
+    local.clear();
+    for (const auto& row : image) {
+      local.insert(local.end(), row.begin(), row.end());
+    }
+    total.resize(rank == 0 ? local.size() : 0);
+    MPI_Reduce(local.data(), total.data(), static_cast<int>(local.size()),
+               MPI_UNSIGNED, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+      auto it = total.cbegin();
+      for (auto& row : image) {
+        std::copy(it, it + row.size(), row.begin());
+        it += row.size();
+      }
+    }
+  }
+}
+
+/**
+ * @brief Main function.
+ *
+ * @param[in] argc
+ * @param[in] argv
+ * @return int
+ */
+int main(int argc, char* argv[]) {
+  MPI_Init(&argc, &argv);
+  int rank = 0;
+  int nranks = 1;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+  spdlog::set_pattern(
+      fmt::format("[%Y-%m-%d %H:%M:%S.%e] [rank {}] [%^%l%$] %v", rank));
+  if (rank != 0) spdlog::set_level(spdlog::level::warn);
+
+  try {
+    ProgramOptions options = parse_arguments(argc, argv);
+
+    // Set logging level based on debug and verbose flags, the other ranks
+    // only report warnings unless debugging
+    if (options.debug_logging) {
+      spdlog::set_level(spdlog::level::debug);
+      spdlog::debug("Debug logging enabled");
+    } else if (options.verbose && rank == 0) {
+      spdlog::set_level(spdlog::level::info);
+    } else {
+      spdlog::set_level(spdlog::level::warn);
+    }
+
+    spdlog::info("Input file: {}", options.input_tpx3);
+    spdlog::info("Ranks: {}", nranks);
+    spdlog::info("Output events files: {}", options.output_events);
+    spdlog::info("Configuration file: {}", options.config_file);
+    spdlog::info("TOF imaging folder: {}", options.output_tof_imaging);
+    spdlog::info("TOF mode: {}", options.tof_mode);
+    spdlog::info("Timing mode: {}", options.timing_mode);
+    spdlog::info("Batch index: {}", options.index_file);
+
+    // Load configuration
+    std::unique_ptr<IConfig> config;
+    if (!options.config_file.empty()) {
+      std::string extension =
+          std::filesystem::path(options.config_file).extension().string();
+      if (extension == ".json") {
+        config = std::make_unique<JSONConfigParser>(
+            JSONConfigParser::fromFile(options.config_file));
+      } else {
+        spdlog::warn(
+            "Deprecated configuration format detected. Please switch to JSON "
+            "format.");
+        config = std::make_unique<UserConfig>(
+            parseUserDefinedConfigurationFile(options.config_file));
+      }
+    } else {
+      spdlog::info(
+          "No configuration file provided. Using default JSON configuration.");
+      config =
+          std::make_unique<JSONConfigParser>(JSONConfigParser::createDefault());
+    }
+    spdlog::info("Configuration: {}", config->toString());
+
+    auto start = std::chrono::high_resolution_clock::now();
+    const bool use_gdc = options.timing_mode == "gdc";
+    size_t next_block = 0;
+    size_t last_block = 0;
+    const TPX3Index index =
+        indexRankShare(options, rank, nranks, next_block, last_block);
+    spdlog::debug("Reducing blocks {} to {}", next_block, last_block);
+
+    // Each rank writes its own events file
+    // NOTE: HDF5 is built without MPI-IO, so there is no shared file
+    H5::H5File eventsFile;
+    std::unique_ptr<NeutronsHDF5Appender> neutronsAppender;
+    if (!options.output_events.empty()) {
+      HDF5AppenderOptions appender_options;
+      appender_options.compression = parseH5Compression(options.compression);
+      eventsFile =
+          createHDF5File(rankFileName(options.output_events, rank));
+      neutronsAppender = std::make_unique<NeutronsHDF5Appender>(
+          eventsFile, parseHDF5Schema(options.hdf5_schema), appender_options);
+    }
+
+    std::vector<std::vector<std::vector<unsigned int>>> tof_images;
+    const bool needs_tof_images =
+        !options.output_tof_imaging.empty() || !options.spectra_filen.empty();
+    if (needs_tof_images) {
+      tof_images = sophiread::initializeTOFImages(config->getSuperResolution(),
+                                                  config->getTOFBinEdges());
+    }
+
+    // Reduce the blocks of the rank, with the timestamps of the index
+    auto fileReader = openTPX3Reader(options.input_tpx3);
+    uint64_t counts[2] = {0, 0};  // hits, neutrons
+    std::vector<char> chunk;
+    std::vector<TPX3> batches;
+    while (next_block < last_block) {
+      next_block = index.readBatches(*fileReader, next_block, last_block,
+                                     options.chunk_size, chunk, batches);
+      sophiread::timedProcessing(batches, chunk, *config, use_gdc);
+      for (const auto& batch : batches) {
+        if (neutronsAppender) neutronsAppender->append(batch.neutrons);
+        if (needs_tof_images) {
+          sophiread::updateTOFImages(tof_images, batch,
+                                     config->getSuperResolution(),
+                                     config->getTOFBinEdges(),
+                                     options.tof_mode);
+        }
+        counts[0] += batch.hits.size();
+        counts[1] += batch.neutrons.size();
+      }
+    }
+    std::vector<TPX3>().swap(batches);
+    std::vector<char>().swap(chunk);
+    if (neutronsAppender) {
+      neutronsAppender->close();
+      eventsFile.close();
+    }
+    spdlog::debug("Hits: {}, Neutrons: {}", counts[0], counts[1]);
+
+    // Sum the counts, the TOF cube when it is saved, else only the spectra
+    uint64_t totals[2] = {0, 0};
+    MPI_Reduce(counts, totals, 2, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    std::vector<uint64_t> spectral_counts;
+    if (!options.output_tof_imaging.empty()) {
+      reduceTOFImages(tof_images, rank);
+      if (rank == 0) {
+        spectral_counts = sophiread::calculateSpectralCounts(tof_images);
+      }
+    } else if (needs_tof_images) {
+      const auto local = sophiread::calculateSpectralCounts(tof_images);
+      spectral_counts.resize(rank == 0 ? local.size() : 0);
+      MPI_Reduce(local.data(), spectral_counts.data(),
+                 static_cast<int>(local.size()), MPI_UINT64_T, MPI_SUM, 0,
+                 MPI_COMM_WORLD);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    spdlog::info("Total processing time: {} s",
+                 std::chrono::duration<double>(end - start).count());
+    spdlog::info("Total hits: {}", totals[0]);
+    spdlog::info("Total neutrons: {}", totals[1]);
+
+    // Rank 0 saves the TOF images and spectra
+    if (rank == 0) {
+      const std::vector<double> tof_bin_edges = config->getTOFBinEdges();
+      if (!options.output_tof_imaging.empty()) {
+        spdlog::info("Saving TOF imaging to: {}", options.output_tof_imaging);
+        if (options.tof_format == "bigtiff") {
+          sophiread::timedSaveTOFImagingToBigTIFF(
+              options.output_tof_imaging, tof_images, tof_bin_edges,
+              options.tof_filename_base, options.compression);
+        } else if (options.tof_format == "hdf5") {
+          sophiread::timedSaveTOFImagingToHDF5(
+              options.output_tof_imaging, tof_images, tof_bin_edges,
+              options.tof_filename_base, options.compression);
+        } else {
+          sophiread::timedSaveTOFImagingToTIFF(options.output_tof_imaging,
+                                               tof_images, tof_bin_edges,
+                                               options.tof_filename_base);
+        }
+      }
+      if (!options.spectra_filen.empty()) {
+        spdlog::info("Saving spectra to file: {}", options.spectra_filen);
+        sophiread::writeSpectralFile(options.spectra_filen + ".txt",
+                                     spectral_counts, tof_bin_edges);
+      }
+    }
+  } catch (const std::exception& e) {
+    // NOTE: the other ranks may be waiting in a collective call
+    spdlog::error("Error: {}", e.what());
+    MPI_Abort(MPI_COMM_WORLD, 1);
+    return 1;
+  }
+  MPI_Finalize();
+  return 0;
+}
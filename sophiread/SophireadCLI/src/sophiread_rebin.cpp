@@ -0,0 +1,275 @@
+/**
+ * @file sophiread_rebin.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief CLI for rebuilding TOF images and spectra from saved neutron events
+ * without re-reading the raw Timepix3 data.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include <H5Epublic.h>
+#include <spdlog/spdlog.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "disk_io.h"
+#include "event_store.h"
+#include "json_config_parser.h"
+#include "sophiread_core.h"
+#include "user_config.h"
+
+struct ProgramOptions {
+  std::string input_events;  // events HDF5 file or event store directory
+  std::string config_file;
+  std::string output_tof_imaging;
+  std::string tof_filename_base = "tof_image";
+  std::string spectra_filen = "Spectra";
+  std::string tof_format = "tiff";  // tiff, bigtiff or hdf5
+  std::string compression = "deflate";
+  double window_begin = 0;   // seconds of spidertime, event store only
+  double window_end = -1;    // negative means until the end of the run
+  bool debug_logging = false;
+  bool verbose = false;
+};
+
+/**
+ * @brief Print usage information.
+ *
+ * @param[in] program_name
+ */
+void print_usage(const char* program_name) {
+  spdlog::info(
+      "Usage: {} -i <input_events> [-u <config_file>] [-T "
+      "<tof_imaging_folder>] [-f <tof_filename_base>] [-s <spectra_filename>] "
+      "[-F <tof_format>] [-z <compression>] [-w <begin_s>,<end_s>] [-d] [-v]",
+      program_name);
+  spdlog::info("Options:");
+  spdlog::info(
+      "  -i <input_events>        Events HDF5 file (Sophiread -E) or event "
+      "store directory (Sophiread -e)");
+  spdlog::info(
+      "  -u <config_file>         User configuration JSON file with the new "
+      "TOF binning and super resolution (optional)");
+  spdlog::info(
+      "  -T <tof_imaging_folder>  Output folder for TOF images (optional)");
+  spdlog::info(
+      "  -f <tof_filename_base>   Base name for TIFF files (default: "
+      "tof_image)");
+  spdlog::info("  -s <spectra_filename>    Output filename for spectra");
+  spdlog::info(
+      "  -F <tof_format>          TOF imaging format: 'tiff', 'bigtiff' or "
+      "'hdf5' (default: tiff)");
+  spdlog::info(
+      "  -z <compression>         Compression of the single file stack: "
+      "'none', 'deflate', 'lz4' or 'zstd' (default: deflate)");
+  spdlog::info(
+      "  -w <begin_s>,<end_s>     Only use events whose spidertime is in the "
+      "window, in seconds (event store only)");
+  spdlog::info("  -d                       Enable debug logging");
+  spdlog::info("  -v                       Enable verbose logging");
+}
+
+/**
+ * @brief Parse command line arguments.
+ *
+ * @param[in] argc
+ * @param[in] argv
+ */
+ProgramOptions parse_arguments(int argc, char* argv[]) {
+  ProgramOptions options;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "i:u:T:f:s:F:z:w:dv")) != -1) {
+    switch (opt) {
+      case 'i':
+        options.input_events = optarg;
+        break;
+      case 'u':
+        options.config_file = optarg;
+        break;
+      case 'T':
+        options.output_tof_imaging = optarg;
+        break;
+      case 'f':
+        options.tof_filename_base = optarg;
+        break;
+      case 's':
+        options.spectra_filen = optarg;
+        break;
+      case 'F':
+        options.tof_format = optarg;
+        break;
+      case 'z':
+        options.compression = optarg;
+        break;
+      case 'w': {
+        const std::string window = optarg;
+        const size_t comma = window.find(',');
+        if (comma == std::string::npos) {
+          throw std::runtime_error("Invalid time window, use <begin_s>,<end_s>");
+        }
+        options.window_begin = std::stod(window.substr(0, comma));
+        options.window_end = std::stod(window.substr(comma + 1));
+        break;
+      }
+      case 'd':
+        options.debug_logging = true;
+        break;
+      case 'v':
+        options.verbose = true;
+        break;
+      default:
+        print_usage(argv[0]);
+        throw std::runtime_error(std::string("Invalid argument: ") +
+                                 static_cast<char>(optopt));
+    }
+  }
+
+  // Validate required arguments
+  if (options.input_events.empty()) {
+    print_usage(argv[0]);
+    throw std::runtime_error("Missing required arguments");
+  }
+
+  // Validate TOF imaging format
+  if (options.tof_format != "tiff" && options.tof_format != "bigtiff" &&
+      options.tof_format != "hdf5") {
+    throw std::runtime_error(
+        "Invalid TOF imaging format. Use 'tiff', 'bigtiff' or 'hdf5'.");
+  }
+
+  // Validate compression (throws on unknown names)
+  parseH5Compression(options.compression);
+
+  // Validate time window
+  if (options.window_begin < 0 ||
+      (options.window_end >= 0 && options.window_end <= options.window_begin)) {
+    throw std::runtime_error("Invalid time window.");
+  }
+
+  return options;
+}
+
+/**
+ * @brief Main function.
+ *
+ * @param[in] argc
+ * @param[in] argv
+ * @return int
+ */
+int main(int argc, char* argv[]) {
+  try {
+    // Turn off HDF5 error printing
+    // NOTE: we handle the errors ourselves
+    H5Eset_auto(H5E_DEFAULT, NULL, NULL);
+
+    ProgramOptions options = parse_arguments(argc, argv);
+
+    // Set logging level based on debug and verbose flags
+    if (options.debug_logging) {
+      spdlog::set_level(spdlog::level::debug);
+      spdlog::debug("Debug logging enabled");
+    } else if (options.verbose) {
+      spdlog::set_level(spdlog::level::info);
+    } else {
+      spdlog::set_level(spdlog::level::warn);
+    }
+
+    spdlog::info("Input events: {}", options.input_events);
+    spdlog::info("Configuration file: {}", options.config_file);
+    spdlog::info("TOF imaging folder: {}", options.output_tof_imaging);
+    spdlog::info("TOF imaging format: {}", options.tof_format);
+
+    // Load configuration
+    std::unique_ptr<IConfig> config;
+    if (!options.config_file.empty()) {
+      std::string extension =
+          std::filesystem::path(options.config_file).extension().string();
+      if (extension == ".json") {
+        config = std::make_unique<JSONConfigParser>(
+            JSONConfigParser::fromFile(options.config_file));
+      } else {
+        spdlog::warn(
+            "Deprecated configuration format detected. Please switch to JSON "
+            "format.");
+        config = std::make_unique<UserConfig>(
+            parseUserDefinedConfigurationFile(options.config_file));
+      }
+    } else {
+      spdlog::info(
+          "No configuration file provided. Using default JSON configuration.");
+      config =
+          std::make_unique<JSONConfigParser>(JSONConfigParser::createDefault());
+    }
+    spdlog::info("Configuration: {}", config->toString());
+
+    const double super_resolution = config->getSuperResolution();
+    const std::vector<double> tof_bin_edges = config->getTOFBinEdges();
+
+    // Re-bin, the event store is mapped, HDF5 events are loaded
+    std::vector<std::vector<std::vector<unsigned int>>> tof_images;
+    if (std::filesystem::is_directory(options.input_events)) {
+      EventStoreReader store(options.input_events);
+      // spidertime is in 25 ns ticks
+      const uint64_t begin =
+          static_cast<uint64_t>(std::llround(options.window_begin * 4e7));
+      const uint64_t end =
+          options.window_end < 0
+              ? UINT64_MAX
+              : static_cast<uint64_t>(std::llround(options.window_end * 4e7));
+      tof_images = sophiread::rebinEventStore(store, super_resolution,
+                                              tof_bin_edges, begin, end);
+    } else {
+      if (options.window_begin > 0 || options.window_end >= 0) {
+        throw std::runtime_error(
+            "The time window needs an event store input (Sophiread -e).");
+      }
+      auto start = std::chrono::high_resolution_clock::now();
+      const std::vector<Neutron> neutrons =
+          readNeutronsFromHDF5(options.input_events);
+      auto end = std::chrono::high_resolution_clock::now();
+      spdlog::info(
+          "Read {} events in {} s", neutrons.size(),
+          std::chrono::duration<double>(end - start).count());
+      tof_images =
+          sophiread::rebinNeutrons(neutrons, super_resolution, tof_bin_edges);
+    }
+
+    // Save TOF images, replacing any previous binning
+    if (!options.output_tof_imaging.empty()) {
+      if (options.tof_format == "bigtiff") {
+        sophiread::timedSaveTOFImagingToBigTIFF(
+            options.output_tof_imaging, tof_images, tof_bin_edges,
+            options.tof_filename_base, options.compression, false);
+      } else if (options.tof_format == "hdf5") {
+        sophiread::timedSaveTOFImagingToHDF5(
+            options.output_tof_imaging, tof_images, tof_bin_edges,
+            options.tof_filename_base, options.compression, false);
+      } else {
+        sophiread::timedSaveTOFImagingToTIFF(options.output_tof_imaging,
+                                             tof_images, tof_bin_edges,
+                                             options.tof_filename_base, false);
+      }
+    }
+
+    // Save spectra if needed
+    if (!options.spectra_filen.empty()) {
+      sophiread::writeSpectralFile(
+          options.spectra_filen + ".txt",
+          sophiread::calculateSpectralCounts(tof_images), tof_bin_edges);
+    }
+  } catch (const std::exception& e) {
+    spdlog::error("Error: {}", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,409 @@
+/**
+ * @file sophiread_replay.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief CLI for replaying recorded .tpx3 runs into the live reduction paths
+ * at a controlled rate.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include <fcntl.h>
+#include <linux/sockios.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "replay_pacer.h"
+#include "tpx3_fast.h"
+#include "tpx3_reader.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kChunkSize = 64 * 1024 * 1024;
+constexpr size_t kPieceSize = 64 * 1024;  // pacing granularity, whole batches
+
+std::atomic<bool> g_stop{false};
+
+void handleSignal(int) { g_stop = true; }
+
+/**
+ * @brief Where the replay goes: stdout, a FIFO, a socket or a growing file.
+ */
+class ReplayTarget {
+ public:
+  explicit ReplayTarget(const std::string& target);
+  ~ReplayTarget();
+  ReplayTarget(const ReplayTarget&) = delete;
+  ReplayTarget& operator=(const ReplayTarget&) = delete;
+
+  void write(const char* data, size_t size);
+  // bytes sent but not read by the consumer yet, -1 when unknown
+  long queued() const;
+
+ private:
+  int m_fd = -1;
+  bool m_owns_fd = true;
+  bool m_is_socket = false;
+  bool m_is_pipe = false;
+  std::string m_socket_path;
+};
+
+ReplayTarget::ReplayTarget(const std::string& target) {
+  if (target == "-") {
+    m_fd = STDOUT_FILENO;
+    m_owns_fd = false;
+  } else if (target.rfind("tcp://", 0) == 0 ||
+             target.rfind("unix://", 0) == 0) {
+    m_fd = openTPX3StreamSocket(target, &m_socket_path);
+  } else {
+    // NOTE: opening a FIFO blocks until the consumer opens it too, anything
+    // else is written as a file growing at the replay rate
+    struct stat sb;
+    const bool exists = stat(target.c_str(), &sb) == 0;
+    const int flags = exists && (S_ISFIFO(sb.st_mode) || S_ISCHR(sb.st_mode))
+                          ? O_WRONLY
+                          : O_WRONLY | O_CREAT | O_TRUNC;
+    m_fd = open(target.c_str(), flags, 0644);
+    if (m_fd == -1) {
+      spdlog::error("Failed to open {}: {}", target, strerror(errno));
+      throw std::runtime_error("Failed to open replay target");
+    }
+  }
+
+  struct stat sb;
+  if (fstat(m_fd, &sb) == 0) {
+    m_is_socket = S_ISSOCK(sb.st_mode);
+    m_is_pipe = S_ISFIFO(sb.st_mode);
+  }
+  spdlog::info("Replaying into {}", target);
+}
+
+ReplayTarget::~ReplayTarget() {
+  if (m_fd != -1 && m_owns_fd) close(m_fd);
+  if (!m_socket_path.empty()) unlink(m_socket_path.c_str());
+}
+
+/**
+ * @brief Write everything, blocking while the consumer lags behind.
+ *
+ * @param[in] data
+ * @param[in] size
+ */
+void ReplayTarget::write(const char* data, size_t size) {
+  while (size > 0) {
+    const ssize_t written = ::write(m_fd, data, size);
+    if (written == -1) {
+      if (errno == EINTR) continue;
+      if (errno == EPIPE || errno == ECONNRESET) {
+        throw std::runtime_error("Consumer closed the stream");
+      }
+      spdlog::error("Failed to write replay: {}", strerror(errno));
+      throw std::runtime_error("Failed to write replay");
+    }
+    data += written;
+    size -= written;
+  }
+}
+
+long ReplayTarget::queued() const {
+  int bytes = 0;
+  if (m_is_socket && ioctl(m_fd, SIOCOUTQ, &bytes) == 0) return bytes;
+  // the write end of a pipe reports what is left in the pipe
+  if (m_is_pipe && ioctl(m_fd, FIONREAD, &bytes) == 0) return bytes;
+  return -1;
+}
+
+}  // namespace
+
+struct ProgramOptions {
+  std::string input_tpx3;
+  std::string output_target = "-";
+  sophiread::ReplayRate rate;
+  size_t repeats = 1;
+  double report_interval = 1.0;  // seconds
+  bool debug_logging = false;
+  bool quiet = false;
+};
+
+/**
+ * @brief Print usage information.
+ *
+ * @param[in] program_name
+ */
+void print_usage(const char* program_name) {
+  spdlog::info(
+      "Usage: {} -i <input_tpx3> [-o <target>] [-r <MB/s>] [-H <hits/s>] [-s "
+      "<speed>] [-b <on_s>,<off_s>] [-n <repeats>] [-p <seconds>] [-d] [-q]",
+      program_name);
+  spdlog::info("Options:");
+  spdlog::info("  -i <input_tpx3>     Recorded .tpx3 file or archive");
+  spdlog::info(
+      "  -o <target>         Where to replay: '-' (stdout, default), a FIFO, "
+      "tcp://[listen@]host:port, unix://[listen@]path, or a file to grow");
+  spdlog::info("  -r <MB/s>           Target byte rate");
+  spdlog::info("  -H <hits/s>         Target hit rate");
+  spdlog::info(
+      "  -s <speed>          Multiple of the recorded acquisition rate (TDC "
+      "clock), 1 for real time");
+  spdlog::info(
+      "  -b <on_s>,<off_s>   Burst pattern: send for on_s seconds, then pause "
+      "off_s seconds");
+  spdlog::info(
+      "  -n <repeats>        Replay the run this many times (default: 1)");
+  spdlog::info(
+      "  -p <seconds>        Interval of the rate and lag reports (default: "
+      "1)");
+  spdlog::info("  -d                  Enable debug logging");
+  spdlog::info("  -q                  Only log warnings and errors");
+  spdlog::info("Without a rate the run is replayed as fast as it is consumed.");
+}
+
+/**
+ * @brief Parse command line arguments.
+ *
+ * @param[in] argc
+ * @param[in] argv
+ */
+ProgramOptions parse_arguments(int argc, char* argv[]) {
+  ProgramOptions options;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "i:o:r:H:s:b:n:p:dq")) != -1) {
+    switch (opt) {
+      case 'i':
+        options.input_tpx3 = optarg;
+        break;
+      case 'o':
+        options.output_target = optarg;
+        break;
+      case 'r':
+        options.rate.bytes_per_second = std::stod(optarg) * 1024 * 1024;
+        break;
+      case 'H':
+        options.rate.hits_per_second = std::stod(optarg);
+        break;
+      case 's':
+        options.rate.speed = std::stod(optarg);
+        break;
+      case 'b': {
+        const std::string pattern = optarg;
+        const size_t comma = pattern.find(',');
+        if (comma == std::string::npos) {
+          throw std::runtime_error("Burst pattern must be <on_s>,<off_s>");
+        }
+        options.rate.burst_on = std::stod(pattern.substr(0, comma));
+        options.rate.burst_off = std::stod(pattern.substr(comma + 1));
+        break;
+      }
+      case 'n':
+        options.repeats = std::stoul(optarg);
+        break;
+      case 'p':
+        options.report_interval = std::stod(optarg);
+        break;
+      case 'd':
+        options.debug_logging = true;
+        break;
+      case 'q':
+        options.quiet = true;
+        break;
+      default:
+        print_usage(argv[0]);
+        throw std::runtime_error(std::string("Invalid argument: ") +
+                                 static_cast<char>(optopt));
+    }
+  }
+
+  // Validate required arguments
+  if (options.input_tpx3.empty()) {
+    print_usage(argv[0]);
+    throw std::runtime_error("Missing required arguments");
+  }
+
+  // Validate the replay settings
+  if (options.repeats == 0) {
+    throw std::runtime_error("Number of repeats must be at least 1.");
+  }
+  if (options.report_interval <= 0) {
+    throw std::runtime_error("Report interval must be positive.");
+  }
+  if (std::filesystem::exists(options.output_target) &&
+      std::filesystem::equivalent(options.input_tpx3,
+                                  options.output_target)) {
+    throw std::runtime_error("Replay target would overwrite the input.");
+  }
+
+  return options;
+}
+
+/**
+ * @brief Main function.
+ *
+ * @param[in] argc
+ * @param[in] argv
+ * @return int
+ */
+int main(int argc, char* argv[]) {
+  // stdout may carry the replay itself
+  spdlog::set_default_logger(spdlog::stderr_color_mt("replay"));
+
+  try {
+    ProgramOptions options = parse_arguments(argc, argv);
+
+    // Set logging level based on debug and quiet flags
+    if (options.debug_logging) {
+      spdlog::set_level(spdlog::level::debug);
+      spdlog::debug("Debug logging enabled");
+    } else if (options.quiet) {
+      spdlog::set_level(spdlog::level::warn);
+    } else {
+      spdlog::set_level(spdlog::level::info);
+    }
+
+    const sophiread::ReplayPacer pacer(options.rate);
+    std::signal(SIGPIPE, SIG_IGN);  // a closed consumer fails the write
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    spdlog::info("Input file: {}", options.input_tpx3);
+    ReplayTarget target(options.output_target);
+
+    uint64_t sent_bytes = 0;
+    uint64_t sent_hits = 0;
+    uint64_t clock_base = 0;  // recorded time of the previous repeats
+    double lag = 0;  // seconds behind schedule at the last piece
+    double max_lag = 0;
+    const auto start = Clock::now();
+    auto last_report = start;
+    uint64_t reported_bytes = 0;
+    uint64_t reported_hits = 0;
+
+    const auto report = [&](Clock::time_point now) {
+      const double interval =
+          std::chrono::duration<double>(now - last_report).count();
+      std::string lag_info;
+      const long queued = target.queued();
+      if (queued >= 0) lag_info += fmt::format(", {} KB queued", queued / 1024);
+      if (!pacer.isUnlimited()) {
+        lag_info += fmt::format(", {:.3f} s behind schedule", lag);
+      }
+      spdlog::info("Replayed {:.1f} MB: {:.1f} MB/s, {:.0f} hits/s{}",
+                   sent_bytes / 1048576.0,
+                   (sent_bytes - reported_bytes) / 1048576.0 / interval,
+                   (sent_hits - reported_hits) / interval, lag_info);
+      last_report = now;
+      reported_bytes = sent_bytes;
+      reported_hits = sent_hits;
+    };
+
+    // Send [begin, end) of a chunk once the data before it is due, the clock
+    // being the recorded time at its first batch
+    const auto send = [&](const char* begin, const char* end, uint64_t hits,
+                          uint64_t clock_ticks) {
+      if (begin == end) return;
+      if (!pacer.isUnlimited()) {
+        const auto due =
+            start + std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(
+                            pacer.due(sent_bytes, sent_hits, clock_ticks)));
+        // short naps to stay responsive to signals during long pauses
+        while (!g_stop && Clock::now() < due) {
+          std::this_thread::sleep_until(
+              std::min(due, Clock::now() + std::chrono::milliseconds(100)));
+        }
+        // the consumer holds the replay back when writes block
+        lag = std::max(
+            0.0, std::chrono::duration<double>(Clock::now() - due).count());
+        max_lag = std::max(max_lag, lag);
+      }
+      if (g_stop) return;
+      target.write(begin, end - begin);
+      sent_bytes += end - begin;
+      sent_hits += hits;
+
+      const auto now = Clock::now();
+      if (std::chrono::duration<double>(now - last_report).count() >=
+          options.report_interval) {
+        report(now);
+      }
+    };
+
+    for (size_t repeat = 0; repeat < options.repeats && !g_stop; ++repeat) {
+      auto reader = openTPX3Reader(options.input_tpx3);
+      // TDC mode clock, the same as the reduction without GDC
+      unsigned long tdc_timestamp = 0;
+      unsigned long first_tdc = 0;
+      uint64_t run_ticks = 0;
+
+      while (!reader->isEOF() && !g_stop) {
+        std::vector<char> chunk = reader->readChunk(kChunkSize);
+        if (chunk.empty()) break;
+        std::vector<TPX3> batches = findTPX3H(chunk);
+
+        // pieces of whole batches, anything between batches goes along
+        const char* piece_begin = chunk.data();
+        uint64_t piece_hits = 0;
+        uint64_t piece_ticks = clock_base + run_ticks;
+        for (auto& batch : batches) {
+          if (g_stop) break;
+          updateTimestamp(batch, chunk, tdc_timestamp);
+          if (first_tdc == 0) first_tdc = tdc_timestamp;
+          if (tdc_timestamp > first_tdc) run_ticks = tdc_timestamp - first_tdc;
+
+          const char* batch_end =
+              chunk.data() +
+              std::min(chunk.size(), batch.index + 8 * (batch.num_packets + 1));
+          for (const char* packet = chunk.data() + batch.index + 8;
+               packet + 8 <= batch_end; packet += 8) {
+            if ((packet[7] & 0xF0) == 0xb0) ++piece_hits;
+          }
+          if (batch_end - piece_begin >= static_cast<ptrdiff_t>(kPieceSize)) {
+            send(piece_begin, batch_end, piece_hits, piece_ticks);
+            piece_begin = batch_end;
+            piece_hits = 0;
+            piece_ticks = clock_base + run_ticks;
+          }
+        }
+        send(piece_begin, chunk.data() + chunk.size(), piece_hits,
+             piece_ticks);
+      }
+      clock_base += run_ticks;
+    }
+
+    const double elapsed =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    spdlog::info(
+        "Replayed {} bytes and {} hits in {:.2f} s ({:.1f} MB/s, {:.0f} "
+        "hits/s){}",
+        sent_bytes, sent_hits, elapsed,
+        elapsed > 0 ? sent_bytes / 1048576.0 / elapsed : 0.0,
+        elapsed > 0 ? sent_hits / elapsed : 0.0,
+        g_stop ? ", interrupted" : "");
+    if (!pacer.isUnlimited()) {
+      spdlog::info("At most {:.3f} s behind schedule", max_lag);
+    }
+  } catch (const std::exception& e) {
+    spdlog::error("Error: {}", e.what());
+    return 1;
+  }
+  return 0;
+}
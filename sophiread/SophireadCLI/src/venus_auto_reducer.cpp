@@ -8,19 +8,30 @@
  * @copyright Copyright (c) 2024
  * SPDX - License - Identifier: GPL - 3.0 +
  */
+#include <getopt.h>
 #include <spdlog/spdlog.h>
 #include <tbb/tbb.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <filesystem>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <thread>
 #include <unordered_set>
 #include <vector>
 
+#include "async_writer.h"
+#include "checkpoint.h"
+#include "directory_watcher.h"
+#include "disk_io.h"
 #include "json_config_parser.h"
 #include "sophiread_core.h"
 namespace fs = std::filesystem;
@@ -32,6 +43,12 @@ struct ProgramOptions {
   std::string tiff_base = "tof_image";
   std::string tof_mode = "neutron";
   int check_interval = 5;
+  bool poll_only = false;  // list the directory instead of using inotify
+  bool follow = false;     // reduce files while they are being written
+  bool resume = false;     // skip the files of the checkpoint
+  int flush_every = 1;  // flush TIFFs after this many reduced files
+  int jobs = 2;         // files reduced concurrently
+  size_t memory_budget = 8ULL * 1024 * 1024 * 1024;  // Default 8GB
   bool verbose = false;
   bool debug = false;
 };
@@ -39,7 +56,9 @@ struct ProgramOptions {
 void print_usage(const char* program_name) {
   spdlog::info(
       "Usage: {} -i <input_dir> -o <output_dir> [-u <user_config_json>] [-f "
-      "<tiff_file_name_base>] [-m <tof_mode>] [-c <check_interval>] [-v] [-d]",
+      "<tiff_file_name_base>] [-m <tof_mode>] [-c <check_interval>] [-n "
+      "<flush_every>] [-j <jobs>] [-M <memory_budget>] [-p] [-t] [--resume] "
+      "[-v] [-d]",
       program_name);
   spdlog::info("Options:");
   spdlog::info("  -i <input_dir>    Input directory with TPX3 files");
@@ -49,7 +68,24 @@ void print_usage(const char* program_name) {
       "  -f <tiff_base>    Base name for TIFF files (default: tof_image)");
   spdlog::info(
       "  -m <tof_mode>     TOF mode: 'hit' or 'neutron' (default: neutron)");
-  spdlog::info("  -c <interval>     Check interval in seconds (default: 5)");
+  spdlog::info(
+      "  -c <interval>     Check interval in seconds when polling, with "
+      "inotify the directory is still listed every 12 intervals (default: "
+      "5)");
+  spdlog::info(
+      "  -p                Poll the input directory instead of using inotify");
+  spdlog::info(
+      "  -t                Follow growing files, reducing new data every "
+      "check interval");
+  spdlog::info(
+      "  -n <flush_every>  Write TIFFs every N reduced files (default: 1)");
+  spdlog::info("  -j <jobs>         Files reduced concurrently (default: 2)");
+  spdlog::info(
+      "  -M <memory_budget> Memory for files in flight in MB (default: "
+      "8192)");
+  spdlog::info(
+      "  --resume          Continue from the checkpoint in the output "
+      "directory");
   spdlog::info("  -d                Debug output");
   spdlog::info("  -v                Verbose output");
 }
@@ -58,7 +94,12 @@ ProgramOptions parse_arguments(int argc, char* argv[]) {
   ProgramOptions options;
   int opt;
 
-  while ((opt = getopt(argc, argv, "i:o:u:f:m:c:dv")) != -1) {
+  enum { kOptResume = 256 };
+  const option long_options[] = {{"resume", no_argument, nullptr, kOptResume},
+                                 {nullptr, 0, nullptr, 0}};
+
+  while ((opt = getopt_long(argc, argv, "i:o:u:f:m:c:n:j:M:ptdv", long_options,
+                            nullptr)) != -1) {
     switch (opt) {
       case 'i':
         options.input_dir = optarg;
@@ -78,6 +119,24 @@ ProgramOptions parse_arguments(int argc, char* argv[]) {
       case 'c':
         options.check_interval = std::stoi(optarg);
         break;
+      case 'n':
+        options.flush_every = std::stoi(optarg);
+        break;
+      case 'j':
+        options.jobs = std::stoi(optarg);
+        break;
+      case 'M':
+        options.memory_budget = std::stoull(optarg) * 1024 * 1024;
+        break;
+      case 'p':
+        options.poll_only = true;
+        break;
+      case 't':
+        options.follow = true;
+        break;
+      case kOptResume:
+        options.resume = true;
+        break;
       case 'd':
         options.debug = true;
         break;
@@ -106,80 +165,481 @@ ProgramOptions parse_arguments(int argc, char* argv[]) {
     throw std::runtime_error("Check interval must be a positive integer.");
   }
 
+  // Validate flush_every
+  if (options.flush_every <= 0) {
+    throw std::runtime_error("Flush interval must be a positive integer.");
+  }
+
+  // Validate jobs and memory budget
+  if (options.jobs <= 0) {
+    throw std::runtime_error("Number of jobs must be a positive integer.");
+  }
+  if (options.memory_budget == 0) {
+    throw std::runtime_error("Memory budget must be a positive integer.");
+  }
+
   return options;
 }
 
 /**
- * @brief Process all existing tpx3 files
+ * @brief Running TOF cube of the whole run.
+ *
+ * The counts live in memory and the TIFFs are rewritten from it, so the cost
+ * of a flush does not grow with the number of files reduced so far. Flushes
+ * requested while a write is queued are coalesced: the writer copies the cube
+ * once when it starts, along with the latest checkpoint.
+ */
+struct TOFAccumulator {
+  std::vector<std::vector<std::vector<unsigned int>>> tof_images;
+  int unflushed_files = 0;
+  // checkpoint matching the cube, until the writer takes it
+  std::optional<sophiread::ReducerCheckpoint> pending;
+  bool write_queued = false;
+  std::mutex mutex;  // guards the members above
+  // copy of the cube being written, reused between flushes
+  // NOTE: only touched by the writer thread
+  std::vector<std::vector<std::vector<unsigned int>>> snapshot;
+};
+
+std::string accumulator_filename(const std::string& output_dir,
+                                 const std::string& tiff_base) {
+  return fs::path(output_dir) / (tiff_base + "_accumulator.bin");
+}
+
+std::string checkpoint_filename(const std::string& output_dir,
+                                const std::string& tiff_base) {
+  return fs::path(output_dir) / (tiff_base + "_checkpoint.json");
+}
+
+/**
+ * @brief Initialize the running cube, resuming from a previous run if any.
+ *
+ * @param[in] output_dir
+ * @param[in] tiff_base
+ * @param[in] config
+ * @param[out] accumulator
+ */
+void init_accumulator(const std::string& output_dir,
+                      const std::string& tiff_base, const IConfig& config,
+                      TOFAccumulator& accumulator) {
+  accumulator.tof_images = sophiread::initializeTOFImages(
+      config.getSuperResolution(), config.getTOFBinEdges());
+
+  // the sidecar is written atomically, prefer it over the TIFFs
+  if (sophiread::loadTOFImagingAccumulator(
+          accumulator_filename(output_dir, tiff_base),
+          accumulator.tof_images)) {
+    return;
+  }
+  if (fs::exists(fs::path(output_dir) / (tiff_base + "_bin_0001.tiff"))) {
+    sophiread::loadTOFImagingFromTIFF(output_dir, tiff_base,
+                                      accumulator.tof_images);
+  }
+}
+
+/**
+ * @brief Request writing the cube along with the checkpoint matching it.
+ *
+ * @note Called under the accumulator lock.
+ *
+ * @param[in, out] accumulator
+ * @param[in] checkpoint: state matching the cube
+ * @return true if the caller has to queue a write, none being queued yet
+ */
+bool request_flush(TOFAccumulator& accumulator,
+                   sophiread::ReducerCheckpoint checkpoint) {
+  accumulator.unflushed_files = 0;
+  accumulator.pending = std::move(checkpoint);
+  if (accumulator.write_queued) return false;
+  accumulator.write_queued = true;
+  return true;
+}
+
+/**
+ * @brief Queue writing the cube to TIFFs and to the accumulator sidecar.
+ *
+ * The writer copies the cube with the pending checkpoint once it starts, so
+ * the memory held for writing is a single cube no matter how many flushes are
+ * requested meanwhile. The checkpoint is written after the sidecar and
+ * records the files whose counts it holds.
+ *
+ * @param[in] output_dir
+ * @param[in] tiff_base
+ * @param[in] config
+ * @param[in] accumulator
+ * @param[in] writer
+ */
+void queue_write(const std::string& output_dir, const std::string& tiff_base,
+                 const IConfig& config, TOFAccumulator& accumulator,
+                 sophiread::AsyncWriter& writer) {
+  if (!fs::exists(output_dir)) {
+    fs::create_directories(output_dir);
+  }
+  const std::vector<double> tof_bin_edges = config.getTOFBinEdges();
+  writer.submit([=, &accumulator]() {
+    sophiread::ReducerCheckpoint checkpoint;
+    {
+      std::lock_guard<std::mutex> lock(accumulator.mutex);
+      accumulator.write_queued = false;
+      // NOTE: a merge without checkpoint cleared it, the next flush has both
+      if (!accumulator.pending) return;
+      checkpoint = std::move(*accumulator.pending);
+      accumulator.pending.reset();
+      accumulator.snapshot = accumulator.tof_images;
+    }
+    const sophiread::TOFImages& tof_images = accumulator.snapshot;
+    sophiread::saveTOFImagingAccumulator(
+        accumulator_filename(output_dir, tiff_base), tof_images);
+    checkpoint.tof_counts = sophiread::countTOFImages(tof_images);
+    sophiread::saveCheckpoint(checkpoint_filename(output_dir, tiff_base),
+                              checkpoint);
+    sophiread::timedSaveTOFImagingToTIFF(output_dir, tof_images,
+                                         tof_bin_edges, tiff_base, false);
+  });
+}
+
+/**
+ * @brief Queue writing the running cube if files were added since the last
+ * flush.
  *
- * @param[in] input_dir
  * @param[in] output_dir
  * @param[in] tiff_base
+ * @param[in] config
+ * @param[in, out] accumulator
+ * @param[in] writer
+ * @param[in] checkpoint: state matching the cube
+ */
+void flush_accumulator(const std::string& output_dir,
+                       const std::string& tiff_base, const IConfig& config,
+                       TOFAccumulator& accumulator,
+                       sophiread::AsyncWriter& writer,
+                       sophiread::ReducerCheckpoint checkpoint) {
+  {
+    std::lock_guard<std::mutex> lock(accumulator.mutex);
+    if (accumulator.unflushed_files == 0) return;
+    if (!request_flush(accumulator, std::move(checkpoint))) return;
+  }
+  queue_write(output_dir, tiff_base, config, accumulator, writer);
+}
+
+/**
+ * @brief Admits files while their estimated footprint fits a memory budget.
+ *
+ * A file larger than the whole budget is still admitted once nothing else is
+ * in flight.
+ */
+class MemoryBudget {
+ public:
+  explicit MemoryBudget(size_t bytes) : m_bytes(bytes) {}
+
+  void acquire(size_t bytes) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [&] { return m_used == 0 || m_used + bytes <= m_bytes; });
+    m_used += bytes;
+  }
+
+  void release(size_t bytes) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_used -= bytes;
+    }
+    m_cv.notify_all();
+  }
+
+ private:
+  size_t m_bytes;
+  size_t m_used = 0;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+};
+
+// raw bytes plus the hits and neutrons extracted from them
+constexpr size_t kMemoryPerRawByte = 6;
+
+// check intervals between listings of the directory while inotify is used
+constexpr int kSafetyRescanIntervals = 12;
+
+/**
+ * @brief Reduce one tpx3 file to sparse TOF image counts.
+ *
+ * NOTE: every file starts with its own timestamp state, so files can be
+ *       reduced in any order; each file carries its own TDC/GDC packets.
+ *
+ * @param[in] path
  * @param[in] tof_mode
  * @param[in] config
- * @param[in, out] processed_files
+ * @return std::vector<uint64_t>: flat (bin, y, x) index of every entry
  */
-void process_existing_files(const std::string& input_dir,
-                            const std::string& output_dir,
-                            const std::string& tiff_base,
-                            const std::string& tof_mode, const IConfig& config,
-                            std::unordered_set<std::string>& processed_files) {
-  spdlog::info("Processing existing files in {}", input_dir);
+std::vector<uint64_t> reduce_file(const fs::path& path,
+                                  const std::string& tof_mode,
+                                  const IConfig& config) {
+  unsigned long tdc_timestamp = 0;
+  unsigned long long gdc_timestamp = 0;
+  unsigned long timer_lsb32 = 0;
+
+  // Read the TPX3 file
+  auto raw_data = sophiread::timedReadDataToCharVec(path.string());
+
+  // Find TPX3 headers
+  auto batches = sophiread::timedFindTPX3H(raw_data);
+
+  // Process the data
+  sophiread::timedLocateTimeStamp(batches, raw_data, tdc_timestamp,
+                                  gdc_timestamp, timer_lsb32);
+  sophiread::timedProcessing(batches, raw_data, config, true);  // GDC mode
 
+  std::vector<uint64_t> indices;
+  for (const auto& batch : batches) {
+    sophiread::collectTOFImageIndices(indices, batch,
+                                      config.getSuperResolution(),
+                                      config.getTOFBinEdges(), tof_mode);
+  }
+  return indices;
+}
+
+/**
+ * @brief A tpx3 file reduced while it grows.
+ *
+ * The timestamp state is carried from one increment to the next, so the TOF
+ * of an increment starting without its own TDC/GDC packet is still correct.
+ */
+struct FollowedFile {
+  std::unique_ptr<TPX3FileFollower> follower;
   unsigned long tdc_timestamp = 0;
   unsigned long long gdc_timestamp = 0;
   unsigned long timer_lsb32 = 0;
+};
+
+/**
+ * @brief State to checkpoint along with the running cube.
+ *
+ * @param[in] processed_files
+ * @param[in] followed: files being followed, at the last reduced batch
+ * @return sophiread::ReducerCheckpoint
+ */
+sophiread::ReducerCheckpoint make_checkpoint(
+    const std::unordered_set<std::string>& processed_files,
+    const std::map<fs::path, FollowedFile>& followed = {}) {
+  sophiread::ReducerCheckpoint checkpoint;
+  checkpoint.processed_files.assign(processed_files.begin(),
+                                    processed_files.end());
+  std::sort(checkpoint.processed_files.begin(),
+            checkpoint.processed_files.end());
+  for (const auto& [path, file] : followed) {
+    checkpoint.followed_files.push_back(
+        {path.string(), file.follower->getConsumedPosition(),
+         file.tdc_timestamp, file.gdc_timestamp, file.timer_lsb32});
+  }
+  return checkpoint;
+}
+
+/**
+ * @brief Restore the processed and followed files of a checkpoint.
+ *
+ * @param[in] output_dir
+ * @param[in] tiff_base
+ * @param[in] follow
+ * @param[in] accumulator: cube loaded from the sidecar
+ * @param[out] processed_files
+ * @param[out] followed
+ */
+void resume_from_checkpoint(const std::string& output_dir,
+                            const std::string& tiff_base, bool follow,
+                            const TOFAccumulator& accumulator,
+                            std::unordered_set<std::string>& processed_files,
+                            std::map<fs::path, FollowedFile>& followed) {
+  const std::string filename = checkpoint_filename(output_dir, tiff_base);
+  sophiread::ReducerCheckpoint checkpoint;
+  if (!sophiread::loadCheckpoint(filename, checkpoint)) {
+    throw std::runtime_error("No checkpoint to resume from: " + filename);
+  }
+  // NOTE: a crash between saving the sidecar and the checkpoint leaves them
+  //       out of step, the files cannot be told apart then
+  if (sophiread::countTOFImages(accumulator.tof_images) !=
+      checkpoint.tof_counts) {
+    throw std::runtime_error(
+        "Accumulator does not match the checkpoint, remove both to start "
+        "over: " +
+        filename);
+  }
+  if (!follow && !checkpoint.followed_files.empty()) {
+    throw std::runtime_error(
+        "The checkpointed run was following files, resume it with -t.");
+  }
 
-  // NOTE: we need to process files sequentially as we are accumulating the
-  // counts to the
-  //       same set of tiff files in the output folder
-  for (const auto& entry : fs::directory_iterator(input_dir)) {
-    if (entry.is_regular_file() && entry.path().extension() == ".tpx3") {
-      std::string filename = entry.path().stem().string();
+  processed_files.insert(checkpoint.processed_files.begin(),
+                         checkpoint.processed_files.end());
+  for (const auto& state : checkpoint.followed_files) {
+    FollowedFile file;
+    file.follower =
+        std::make_unique<TPX3FileFollower>(state.path, state.position);
+    file.tdc_timestamp = state.tdc_timestamp;
+    file.gdc_timestamp = state.gdc_timestamp;
+    file.timer_lsb32 = state.timer_lsb32;
+    followed.emplace(state.path, std::move(file));
+  }
+  spdlog::info("Resuming with {} processed and {} followed files",
+               processed_files.size(), followed.size());
+}
+
+/**
+ * @brief Reduce the complete batches appended to a followed file.
+ *
+ * NOTE: clustering works within a batch and only complete batches are read,
+ *       so the neutrons do not depend on how the file is split.
+ *
+ * @param[in, out] file
+ * @param[in] tof_mode
+ * @param[in] config
+ * @param[in] max_bytes: largest increment to read at once
+ * @param[in, out] accumulator
+ * @return size_t: number of raw bytes reduced
+ */
+size_t reduce_appended(FollowedFile& file, const std::string& tof_mode,
+                       const IConfig& config, size_t max_bytes,
+                       TOFAccumulator& accumulator) {
+  size_t reduced = 0;
+  while (true) {
+    auto raw_data = file.follower->readAppended(max_bytes);
+    if (raw_data.empty()) break;
+
+    auto batches = sophiread::timedFindTPX3H(raw_data);
+    sophiread::timedLocateTimeStamp(batches, raw_data, file.tdc_timestamp,
+                                    file.gdc_timestamp, file.timer_lsb32);
+    sophiread::timedProcessing(batches, raw_data, config, true);  // GDC mode
+
+    std::vector<uint64_t> indices;
+    for (const auto& batch : batches) {
+      sophiread::collectTOFImageIndices(indices, batch,
+                                        config.getSuperResolution(),
+                                        config.getTOFBinEdges(), tof_mode);
+    }
+    std::lock_guard<std::mutex> lock(accumulator.mutex);
+    sophiread::addTOFImageIndices(accumulator.tof_images, indices);
+    // the followed positions have moved on from the pending checkpoint
+    accumulator.pending.reset();
+    reduced += raw_data.size();
+  }
+  return reduced;
+}
+
+/**
+ * @brief Check for the NeXus file that marks the end of a run.
+ *
+ * @param[in] path
+ * @return true for *.nxs.h5
+ */
+bool is_run_finished(const fs::path& path) {
+  return path.extension() == ".h5" && path.stem().extension() == ".nxs";
+}
+
+/**
+ * @brief Process tpx3 files that have not been processed yet
+ *
+ * Up to jobs files are reduced at the same time, as long as their estimated
+ * footprint fits the memory budget. Each file is reduced to sparse counts on
+ * its own thread and merged into the running cube under the accumulator
+ * lock.
+ *
+ * @param[in] files: candidate files, others than .tpx3 are ignored
+ * @param[in] output_dir
+ * @param[in] tiff_base
+ * @param[in] tof_mode
+ * @param[in] config
+ * @param[in] flush_every
+ * @param[in] jobs
+ * @param[in] budget
+ * @param[in, out] accumulator
+ * @param[in] writer
+ * @param[in, out] processed_files
+ */
+void process_files(const std::vector<fs::path>& files,
+                   const std::string& output_dir, const std::string& tiff_base,
+                   const std::string& tof_mode, const IConfig& config,
+                   int flush_every, int jobs, MemoryBudget& budget,
+                   TOFAccumulator& accumulator, sophiread::AsyncWriter& writer,
+                   std::unordered_set<std::string>& processed_files) {
+  // Collect the new files, oldest name first
+  std::vector<fs::path> new_files;
+  for (const auto& path : files) {
+    if (path.extension() == ".tpx3") {
+      std::string filename = path.stem().string();
 
       if (processed_files.find(filename) != processed_files.end()) {
         spdlog::debug("Skipping already processed file: {}", filename);
         continue;
       }
-
-      spdlog::info("Processing file: {}", entry.path().string());
-
+      new_files.push_back(path);
+    }
+  }
+  if (new_files.empty()) return;
+  std::sort(new_files.begin(), new_files.end());
+  new_files.erase(std::unique(new_files.begin(), new_files.end()),
+                  new_files.end());
+
+  std::atomic<size_t> next_file{0};
+  auto worker = [&]() {
+    for (size_t i = next_file++; i < new_files.size(); i = next_file++) {
+      const fs::path& path = new_files[i];
+      std::error_code ec;
+      const size_t file_size = fs::file_size(path, ec);
+      const size_t footprint = ec ? 0 : file_size * kMemoryPerRawByte;
+
+      budget.acquire(footprint);
+      spdlog::info("Processing file: {}", path.string());
       try {
-        // Read the TPX3 file
-        auto raw_data =
-            sophiread::timedReadDataToCharVec(entry.path().string());
-
-        // Find TPX3 headers
-        auto batches = sophiread::timedFindTPX3H(raw_data);
-
-        // Process the data
-        sophiread::timedLocateTimeStamp(batches, raw_data, tdc_timestamp,
-                                        gdc_timestamp, timer_lsb32);
-        sophiread::timedProcessing(batches, raw_data, config,
-                                   true);  // GDC mode
+        const std::vector<uint64_t> indices =
+            reduce_file(path, tof_mode, config);
 
         // Generate output file name
         std::string output_file =
             fs::path(output_dir) / (tiff_base + "_bin_xxxx.tiff");
 
-        // Create TOF images
-        auto tof_images = sophiread::timedCreateTOFImages(
-            batches, config.getSuperResolution(), config.getTOFBinEdges(),
-            tof_mode);
+        // Add to the running TOF images
+        bool flush = false;
+        bool queue = false;
+        {
+          std::lock_guard<std::mutex> lock(accumulator.mutex);
+          sophiread::addTOFImageIndices(accumulator.tof_images, indices);
+
+          // record processed file
+          processed_files.insert(path.stem().string());
+
+          // NOTE: a queued write has to pick up the file with the cube
+          if (++accumulator.unflushed_files >= flush_every ||
+              accumulator.pending) {
+            flush = true;
+            queue =
+                request_flush(accumulator, make_checkpoint(processed_files));
+          }
+        }
 
         // Save TOF images
-        sophiread::timedSaveTOFImagingToTIFF(
-            output_dir, tof_images, config.getTOFBinEdges(), tiff_base);
-
-        spdlog::info("Processed and saved: {}", output_file);
-
-        // record processed file
-        processed_files.insert(entry.path().stem().string());
+        if (queue) {
+          queue_write(output_dir, tiff_base, config, accumulator, writer);
+        }
+        if (flush) {
+          spdlog::info("Processed and queued for saving: {}", output_file);
+        } else {
+          spdlog::info("Processed: {}", path.string());
+        }
       } catch (const std::exception& e) {
-        spdlog::error("Error processing file {}: {}", entry.path().string(),
+        spdlog::error("Error processing file {}: {}", path.string(),
                       e.what());
       }
+      budget.release(footprint);
     }
+  };
+
+  const size_t n_workers =
+      std::min<size_t>(static_cast<size_t>(jobs), new_files.size());
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < n_workers; ++i) {
+    workers.emplace_back(worker);
+  }
+  if (n_workers > 0) worker();
+  for (auto& thread : workers) {
+    thread.join();
   }
 
   // Create a string to hold the formatted output
@@ -197,31 +657,151 @@ void process_existing_files(const std::string& input_dir,
   spdlog::info(oss.str());
 }
 
+/**
+ * @brief Reduce the new data of the tpx3 files being written.
+ *
+ * New files are followed from their first listing on. A file is only done
+ * once the run is finished: a close reported by inotify does not mean the
+ * writer will not append to the file again.
+ *
+ * @param[in] candidates: files in the directory, others than .tpx3 are ignored
+ * @param[in] finished: the run is over, every followed file is done
+ * @param[in] tof_mode
+ * @param[in] config
+ * @param[in] memory_budget
+ * @param[in, out] followed
+ * @param[in, out] accumulator
+ * @param[in, out] processed_files
+ */
+void follow_files(const std::vector<fs::path>& candidates, bool finished,
+                  const std::string& tof_mode, const IConfig& config,
+                  size_t memory_budget,
+                  std::map<fs::path, FollowedFile>& followed,
+                  TOFAccumulator& accumulator,
+                  std::unordered_set<std::string>& processed_files) {
+  for (const auto& path : candidates) {
+    if (path.extension() != ".tpx3") continue;
+    if (processed_files.count(path.stem().string())) continue;
+    if (followed.count(path)) continue;
+    try {
+      followed[path].follower =
+          std::make_unique<TPX3FileFollower>(path.string());
+    } catch (const std::exception& e) {
+      spdlog::error("Error following file {}: {}", path.string(), e.what());
+      followed.erase(path);
+    }
+  }
+  const size_t max_bytes = std::max<size_t>(
+      memory_budget / kMemoryPerRawByte, 1024 * 1024);
+
+  for (auto it = followed.begin(); it != followed.end();) {
+    const fs::path& path = it->first;
+    FollowedFile& file = it->second;
+    try {
+      const size_t reduced =
+          reduce_appended(file, tof_mode, config, max_bytes, accumulator);
+      if (reduced > 0) {
+        ++accumulator.unflushed_files;
+        spdlog::info("Reduced {} new bytes of {}", reduced, path.string());
+      }
+    } catch (const std::exception& e) {
+      spdlog::error("Error processing file {}: {}", path.string(), e.what());
+    }
+
+    if (!finished) {
+      ++it;
+      continue;
+    }
+    if (file.follower->getPendingBytes() > 0) {
+      spdlog::warn("{} ends with an incomplete batch of {} bytes",
+                   path.string(), file.follower->getPendingBytes());
+    }
+    processed_files.insert(path.stem().string());
+    spdlog::info("Processed: {}", path.string());
+    it = followed.erase(it);
+  }
+}
+
+/**
+ * @brief Reduce the files of a run as they are completed.
+ *
+ * Completed files are reported by inotify right away. The directory is
+ * listed on start-up, after an inotify queue overflow, every
+ * check_interval seconds when polling, and every kSafetyRescanIntervals
+ * check intervals with inotify, which misses writes from other NFS clients.
+ * In follow mode the directory is listed and the growing files are read
+ * every check_interval seconds, or as soon as inotify reports a closed file.
+ */
 void monitor_directory(const std::string& input_dir,
                        const std::string& output_dir,
                        const std::string& tiff_base,
                        const std::string& tof_mode, const IConfig& config,
                        std::unordered_set<std::string>& processed_files,
-                       int check_interval) {
+                       int check_interval, int flush_every, int jobs,
+                       size_t memory_budget, bool poll_only, bool follow,
+                       bool resume) {
   spdlog::info("Starting directory monitoring: {}", input_dir);
-  spdlog::info("Check interval: {} seconds", check_interval);
 
+  TOFAccumulator accumulator;
+  init_accumulator(output_dir, tiff_base, config, accumulator);
+  std::map<fs::path, FollowedFile> followed;
+  if (resume) {
+    resume_from_checkpoint(output_dir, tiff_base, follow, accumulator,
+                           processed_files, followed);
+  }
+  MemoryBudget budget(memory_budget);
+  // one I/O thread keeps the flushes of the same files in order
+  sophiread::AsyncWriter writer(1, 1);
+
+  // NOTE: the watch is set up before the first listing so that no file
+  //       completed in between is missed
+  sophiread::DirectoryWatcher watcher(
+      input_dir, !poll_only,
+      std::chrono::seconds(check_interval) * kSafetyRescanIntervals);
+  if (!watcher.isNotifying()) {
+    spdlog::info("Check interval: {} seconds", check_interval);
+  }
+
+  sophiread::WatchResult changes;
+  changes.rescan = true;
   while (true) {
-    // Check for *.nxs.h5 file
-    for (const auto& entry : fs::directory_iterator(input_dir)) {
-      if (entry.is_regular_file() && entry.path().extension() == ".h5" &&
-          entry.path().stem().extension() == ".nxs") {
-        spdlog::info("Found *.nxs.h5 file. Stopping monitoring.");
-        return;
+    std::vector<fs::path> candidates = std::move(changes.files);
+    if (changes.rescan || follow) {
+      spdlog::info("Listing files in {}", input_dir);
+      for (const auto& entry : fs::directory_iterator(input_dir)) {
+        if (entry.is_regular_file()) candidates.push_back(entry.path());
       }
     }
 
+    // Check for *.nxs.h5 file
+    // NOTE: the tpx3 files that came with it are reduced before stopping
+    const bool finished =
+        std::any_of(candidates.begin(), candidates.end(), is_run_finished);
+
     // Process any new files
-    process_existing_files(input_dir, output_dir, tiff_base, tof_mode, config,
-                           processed_files);
+    if (follow) {
+      follow_files(candidates, finished, tof_mode, config, memory_budget,
+                   followed, accumulator, processed_files);
+    } else {
+      process_files(candidates, output_dir, tiff_base, tof_mode, config,
+                    flush_every, jobs, budget, accumulator, writer,
+                    processed_files);
+    }
+
+    if (finished) {
+      spdlog::info("Found *.nxs.h5 file. Stopping monitoring.");
+      flush_accumulator(output_dir, tiff_base, config, accumulator, writer,
+                        make_checkpoint(processed_files, followed));
+      writer.flush();
+      return;
+    }
+
+    // Flush the remainder while idle
+    flush_accumulator(output_dir, tiff_base, config, accumulator, writer,
+                      make_checkpoint(processed_files, followed));
 
-    // Wait before next check
-    std::this_thread::sleep_for(std::chrono::seconds(check_interval));
+    // Wait for new files
+    changes = watcher.wait(std::chrono::seconds(check_interval));
   }
 }
 
@@ -244,6 +824,9 @@ int main(int argc, char* argv[]) {
     spdlog::info("Config file: {}", options.config_file);
     spdlog::info("TIFF base name: {}", options.tiff_base);
     spdlog::info("TOF mode: {}", options.tof_mode);
+    spdlog::info("Flush every: {} files", options.flush_every);
+    spdlog::info("Jobs: {}", options.jobs);
+    spdlog::info("Memory budget: {} MB", options.memory_budget / (1024 * 1024));
 
     // Load configuration
     std::unique_ptr<IConfig> config;
@@ -263,7 +846,9 @@ int main(int argc, char* argv[]) {
     std::unordered_set<std::string> processed_files;
     monitor_directory(options.input_dir, options.output_dir, options.tiff_base,
                       options.tof_mode, *config, processed_files,
-                      options.check_interval);
+                      options.check_interval, options.flush_every,
+                      options.jobs, options.memory_budget, options.poll_only,
+                      options.follow, options.resume);
 
   } catch (const std::exception& e) {
     spdlog::error("Error: {}", e.what());
@@ -0,0 +1,76 @@
+/**
+ * @file: test_async_writer.cpp
+ * @author: Chen Zhang (zhangc@orn.gov)
+ * @brief: Unit tests for the background writer service.
+ * @date: 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include "async_writer.h"
+
+using namespace sophiread;
+
+TEST(AsyncWriterTest, RunsTasksInOrder) {
+  AsyncWriter writer(1, 2);
+  std::vector<int> order;
+  for (int i = 0; i < 10; ++i) {
+    writer.submit([&order, i]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      order.push_back(i);
+    });
+  }
+  writer.flush();
+  EXPECT_EQ(writer.pending(), 0);
+  ASSERT_EQ(order.size(), 10);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+TEST(AsyncWriterTest, FlushRethrowsTaskError) {
+  AsyncWriter writer(2, 4);
+  std::atomic<int> done{0};
+  writer.submit([]() { throw std::runtime_error("disk full"); });
+  writer.submit([&done]() { ++done; });
+  EXPECT_THROW(writer.flush(), std::runtime_error);
+  EXPECT_EQ(done.load(), 1);
+  // the error is reported once
+  EXPECT_NO_THROW(writer.flush());
+}
+
+TEST(AsyncWriterTest, WritesSnapshotOfCube) {
+  TOFImages tof_images(3, std::vector<std::vector<unsigned int>>(
+                              10, std::vector<unsigned int>(10, 1)));
+  const std::vector<double> tof_bin_edges = {0.0, 0.1, 0.2, 0.3};
+
+  AsyncWriter writer(2, 4);
+  auto snapshot = std::make_shared<const TOFImages>(tof_images);
+  writer.submitTOFImagingToTIFF(snapshot, "test_async_tof", tof_bin_edges,
+                                "test", false);
+  writer.submitSpectralFile(snapshot, "test_async_spectra.txt", tof_bin_edges);
+
+  // the caller keeps updating its own cube
+  tof_images[0][0][0] = 100;
+  writer.flush();
+
+  EXPECT_TRUE(std::filesystem::exists("test_async_tof/test_bin_0001.tiff"));
+  EXPECT_TRUE(std::filesystem::exists("test_async_tof/test_bin_0003.tiff"));
+  std::ifstream spectra_file("test_async_spectra.txt");
+  std::string line;
+  std::getline(spectra_file, line);
+  std::getline(spectra_file, line);
+  EXPECT_EQ(line, "0.1,100");
+  spectra_file.close();
+
+  std::filesystem::remove_all("test_async_tof");
+  std::filesystem::remove("test_async_spectra.txt");
+}
@@ -0,0 +1,97 @@
+/**
+ * @file: test_checkpoint.cpp
+ * @author: Chen Zhang (zhangc@orn.gov)
+ * @brief: Unit tests for the reduction checkpoints.
+ * @date: 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+
+#include "checkpoint.h"
+
+using namespace sophiread;
+namespace fs = std::filesystem;
+
+class CheckpointTest : public ::testing::Test {
+ protected:
+  std::string filename = "test_checkpoint.json";
+
+  void TearDown() override { fs::remove(filename); }
+};
+
+TEST_F(CheckpointTest, ReductionRoundTrip) {
+  ReductionCheckpoint checkpoint;
+  checkpoint.input = "run.tpx3";
+  checkpoint.input_size = 1ULL << 40;
+  checkpoint.offset = 5ULL << 30;
+  checkpoint.tdc_timestamp = 123456789;
+  checkpoint.gdc_timestamp = 0xFFFFFFFFFFFFULL;
+  checkpoint.timer_lsb32 = 42;
+  checkpoint.hits_rows = 1000;
+  checkpoint.events_rows = 100;
+  checkpoint.event_store_events = 99;
+  checkpoint.chunks = 3;
+  checkpoint.total_hits = 1001;
+  checkpoint.total_neutrons = 101;
+  checkpoint.tof_counts = 77;
+  checkpoint.settings = {{"tof_mode", "neutron"}, {"chunk_rows", 1024}};
+  saveCheckpoint(filename, checkpoint);
+  EXPECT_FALSE(fs::exists(filename + ".tmp"));
+
+  ReductionCheckpoint loaded;
+  ASSERT_TRUE(loadCheckpoint(filename, loaded));
+  EXPECT_EQ(loaded.input, checkpoint.input);
+  EXPECT_EQ(loaded.input_size, checkpoint.input_size);
+  EXPECT_EQ(loaded.offset, checkpoint.offset);
+  EXPECT_EQ(loaded.tdc_timestamp, checkpoint.tdc_timestamp);
+  EXPECT_EQ(loaded.gdc_timestamp, checkpoint.gdc_timestamp);
+  EXPECT_EQ(loaded.timer_lsb32, checkpoint.timer_lsb32);
+  EXPECT_EQ(loaded.hits_rows, checkpoint.hits_rows);
+  EXPECT_EQ(loaded.events_rows, checkpoint.events_rows);
+  EXPECT_EQ(loaded.event_store_events, checkpoint.event_store_events);
+  EXPECT_EQ(loaded.chunks, checkpoint.chunks);
+  EXPECT_EQ(loaded.total_hits, checkpoint.total_hits);
+  EXPECT_EQ(loaded.total_neutrons, checkpoint.total_neutrons);
+  EXPECT_EQ(loaded.tof_counts, checkpoint.tof_counts);
+  EXPECT_EQ(loaded.settings, checkpoint.settings);
+
+  // the reducer does not accept a Sophiread checkpoint
+  ReducerCheckpoint reducer;
+  EXPECT_THROW(loadCheckpoint(filename, reducer), std::runtime_error);
+}
+
+TEST_F(CheckpointTest, ReducerRoundTrip) {
+  ReducerCheckpoint checkpoint;
+  checkpoint.processed_files = {"run_000001", "run_000002"};
+  checkpoint.followed_files.push_back({"in/run_000003.tpx3", 4096, 1, 2, 3});
+  checkpoint.tof_counts = 12345;
+  saveCheckpoint(filename, checkpoint);
+
+  ReducerCheckpoint loaded;
+  ASSERT_TRUE(loadCheckpoint(filename, loaded));
+  EXPECT_EQ(loaded.processed_files, checkpoint.processed_files);
+  ASSERT_EQ(loaded.followed_files.size(), 1u);
+  EXPECT_EQ(loaded.followed_files[0].path, "in/run_000003.tpx3");
+  EXPECT_EQ(loaded.followed_files[0].position, 4096u);
+  EXPECT_EQ(loaded.followed_files[0].tdc_timestamp, 1u);
+  EXPECT_EQ(loaded.followed_files[0].gdc_timestamp, 2u);
+  EXPECT_EQ(loaded.followed_files[0].timer_lsb32, 3u);
+  EXPECT_EQ(loaded.tof_counts, checkpoint.tof_counts);
+}
+
+TEST_F(CheckpointTest, MissingCheckpoint) {
+  ReducerCheckpoint checkpoint;
+  EXPECT_FALSE(loadCheckpoint("no_such_checkpoint.json", checkpoint));
+}
+
+TEST_F(CheckpointTest, CountTOFImages) {
+  std::vector<std::vector<std::vector<unsigned int>>> tof_images(
+      3, std::vector<std::vector<unsigned int>>(
+             4, std::vector<unsigned int>(5, 0xFFFFFFFFu)));
+  EXPECT_EQ(countTOFImages(tof_images), 60ULL * 0xFFFFFFFFULL);
+}
@@ -0,0 +1,86 @@
+/**
+ * @file: test_directory_watcher.cpp
+ * @author: Chen Zhang (zhangc@orn.gov)
+ * @brief: Unit tests for the inotify directory watcher.
+ * @date: 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+#include "directory_watcher.h"
+
+using namespace sophiread;
+namespace fs = std::filesystem;
+
+class DirectoryWatcherTest : public ::testing::Test {
+ protected:
+  fs::path test_dir;
+
+  // NOTE: one directory per test, ctest -j runs them side by side and a
+  //       removed directory is no longer watched
+  void SetUp() override {
+    test_dir = std::string("test_directory_watcher_") +
+               ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    fs::create_directories(test_dir / "staging");
+  }
+  void TearDown() override { fs::remove_all(test_dir); }
+};
+
+TEST_F(DirectoryWatcherTest, ReportsClosedAndMovedFiles) {
+  DirectoryWatcher watcher(test_dir.string());
+  if (!watcher.isNotifying()) {
+    GTEST_SKIP() << "inotify is not available";
+  }
+
+  // nothing happened yet
+  WatchResult result = watcher.wait(std::chrono::milliseconds(10));
+  EXPECT_TRUE(result.files.empty());
+  EXPECT_FALSE(result.rescan);
+
+  { std::ofstream(test_dir / "a.tpx3") << "data"; }
+  { std::ofstream(test_dir / "staging" / "b.tpx3") << "data"; }
+  fs::rename(test_dir / "staging" / "b.tpx3", test_dir / "b.tpx3");
+
+  result = watcher.wait(std::chrono::milliseconds(1000));
+  ASSERT_EQ(result.files.size(), 2u);
+  EXPECT_EQ(result.files[0], test_dir / "a.tpx3");
+  EXPECT_EQ(result.files[1], test_dir / "b.tpx3");
+  EXPECT_FALSE(result.rescan);
+}
+
+TEST_F(DirectoryWatcherTest, RescansPeriodicallyWhileNotifying) {
+  DirectoryWatcher watcher(test_dir.string(), true,
+                           std::chrono::milliseconds(500));
+  if (!watcher.isNotifying()) {
+    GTEST_SKIP() << "inotify is not available";
+  }
+
+  // files inotify cannot see, e.g. written by another NFS client, are found
+  // by the next listing
+  // NOTE: the waits end well inside or well past the interval, so a loaded
+  //       machine does not change the outcome
+  EXPECT_FALSE(watcher.wait(std::chrono::milliseconds(10)).rescan);
+  EXPECT_TRUE(watcher.wait(std::chrono::milliseconds(1000)).rescan);
+  EXPECT_FALSE(watcher.wait(std::chrono::milliseconds(10)).rescan);
+}
+
+TEST_F(DirectoryWatcherTest, PollingAsksForRescan) {
+  DirectoryWatcher watcher(test_dir.string(), false);
+  EXPECT_FALSE(watcher.isNotifying());
+
+  WatchResult result = watcher.wait(std::chrono::milliseconds(10));
+  EXPECT_TRUE(result.files.empty());
+  EXPECT_TRUE(result.rescan);
+}
+
+TEST_F(DirectoryWatcherTest, MissingDirectoryFallsBackToPolling) {
+  DirectoryWatcher watcher((test_dir / "missing").string());
+  EXPECT_FALSE(watcher.isNotifying());
+  EXPECT_TRUE(watcher.wait(std::chrono::milliseconds(10)).rescan);
+}
@@ -0,0 +1,61 @@
+/**
+ * @file: test_replay_pacer.cpp
+ * @author: Chen Zhang (zhangc@orn.gov)
+ * @brief: Unit tests for the replay schedule.
+ * @date: 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+#include "replay_pacer.h"
+
+using namespace sophiread;
+
+TEST(ReplayPacerTest, UnlimitedIsAlwaysDue) {
+  ReplayPacer pacer{ReplayRate{}};
+  EXPECT_TRUE(pacer.isUnlimited());
+  EXPECT_EQ(pacer.due(1ULL << 40, 1ULL << 30, 1ULL << 40), 0.0);
+}
+
+TEST(ReplayPacerTest, SlowestLimitSetsThePace) {
+  ReplayRate rate;
+  rate.bytes_per_second = 1e6;
+  rate.hits_per_second = 1e5;
+  ReplayPacer pacer(rate);
+  EXPECT_FALSE(pacer.isUnlimited());
+  EXPECT_DOUBLE_EQ(pacer.due(2000000, 100000, 0), 2.0);  // bytes
+  EXPECT_DOUBLE_EQ(pacer.due(1000000, 300000, 0), 3.0);  // hits
+}
+
+TEST(ReplayPacerTest, SpeedScalesTheRecordedClock) {
+  ReplayRate rate;
+  rate.speed = 1;
+  EXPECT_DOUBLE_EQ(ReplayPacer(rate).due(0, 0, 40000000), 1.0);
+  rate.speed = 4;
+  EXPECT_DOUBLE_EQ(ReplayPacer(rate).due(1ULL << 30, 0, 40000000), 0.25);
+}
+
+TEST(ReplayPacerTest, BurstsPauseBetweenActivePeriods) {
+  ReplayRate rate;
+  rate.bytes_per_second = 100;
+  rate.burst_on = 1;
+  rate.burst_off = 3;
+  ReplayPacer pacer(rate);
+  EXPECT_DOUBLE_EQ(pacer.due(50, 0, 0), 0.5);
+  // data due at the end of a burst waits for the next one
+  EXPECT_DOUBLE_EQ(pacer.due(100, 0, 0), 4.0);
+  EXPECT_DOUBLE_EQ(pacer.due(250, 0, 0), 8.5);
+}
+
+TEST(ReplayPacerTest, RejectsInvalidRates) {
+  ReplayRate rate;
+  rate.bytes_per_second = -1;
+  EXPECT_THROW(ReplayPacer{rate}, std::invalid_argument);
+  rate = ReplayRate{};
+  rate.burst_off = 1;
+  EXPECT_THROW(ReplayPacer{rate}, std::invalid_argument);
+}
@@ -7,10 +7,13 @@
  * @copyright Copyright (c) 2024
  * SPDX - License - Identifier: GPL - 3.0 +
  */
+#include <H5Cpp.h>
 #include <gtest/gtest.h>
+#include <tiffio.h>
 
 #include <filesystem>
 #include <fstream>
+#include <numeric>
 
 #include "json_config_parser.h"
 #include "sophiread_core.h"
@@ -170,6 +173,169 @@ TEST_F(SophireadCoreTest, TimedSaveTOFImagingToTIFF) {
   std::filesystem::remove_all("test_tof");
 }
 
+TEST_F(SophireadCoreTest, TOFImagingAccumulator) {
+  std::vector<std::vector<std::vector<TIFF32Bit>>> tof_images(
+      3,
+      std::vector<std::vector<TIFF32Bit>>(10, std::vector<TIFF32Bit>(12, 1)));
+  tof_images[1][4][5] = 42;
+  std::vector<double> tof_bin_edges = {0.0, 0.1, 0.2, 0.3};
+  std::filesystem::create_directories("test_tof_acc");
+
+  // raw sidecar round trip
+  sophiread::saveTOFImagingAccumulator("test_tof_acc/acc.bin", tof_images);
+  auto loaded = sophiread::initializeTOFImages(1.0, tof_bin_edges);
+  EXPECT_FALSE(sophiread::loadTOFImagingAccumulator("test_tof_acc/acc.bin",
+                                                    loaded));  // 517x517
+  std::vector<std::vector<std::vector<TIFF32Bit>>> matching(
+      3,
+      std::vector<std::vector<TIFF32Bit>>(10, std::vector<TIFF32Bit>(12, 0)));
+  EXPECT_TRUE(sophiread::loadTOFImagingAccumulator("test_tof_acc/acc.bin",
+                                                   matching));
+  EXPECT_EQ(matching, tof_images);
+
+  // running total is written as is, without reading the existing files
+  sophiread::timedSaveTOFImagingToTIFF("test_tof_acc", tof_images,
+                                       tof_bin_edges, "test", false);
+  sophiread::timedSaveTOFImagingToTIFF("test_tof_acc", tof_images,
+                                       tof_bin_edges, "test", false);
+  std::vector<std::vector<std::vector<TIFF32Bit>>> from_tiff(
+      3,
+      std::vector<std::vector<TIFF32Bit>>(10, std::vector<TIFF32Bit>(12, 0)));
+  EXPECT_TRUE(
+      sophiread::loadTOFImagingFromTIFF("test_tof_acc", "test", from_tiff));
+  EXPECT_EQ(from_tiff, tof_images);
+
+  std::filesystem::remove_all("test_tof_acc");
+}
+
+TEST_F(SophireadCoreTest, TimedSaveTOFImagingToBigTIFF) {
+  std::vector<std::vector<std::vector<TIFF32Bit>>> tof_images(
+      3,
+      std::vector<std::vector<TIFF32Bit>>(10, std::vector<TIFF32Bit>(12, 1)));
+  tof_images[1][4][5] = 42;
+  std::vector<double> tof_bin_edges = {0.0, 0.1, 0.2, 0.3};
+
+  // write twice to check accumulation
+  sophiread::timedSaveTOFImagingToBigTIFF("test_tof_stack", tof_images,
+                                          tof_bin_edges, "test", "deflate");
+  sophiread::timedSaveTOFImagingToBigTIFF("test_tof_stack", tof_images,
+                                          tof_bin_edges, "test", "deflate");
+  ASSERT_TRUE(std::filesystem::exists("test_tof_stack/test.tiff"));
+  EXPECT_FALSE(std::filesystem::exists("test_tof_stack/test_bin_0001.tiff"));
+
+  TIFF* tif = TIFFOpen("test_tof_stack/test.tiff", "r");
+  ASSERT_NE(tif, nullptr);
+  EXPECT_EQ(TIFFNumberOfDirectories(tif), 3);
+  TIFFSetDirectory(tif, 1);
+  uint32_t width = 0, height = 0;
+  TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width);
+  TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height);
+  EXPECT_EQ(width, 12);
+  EXPECT_EQ(height, 10);
+  std::vector<TIFF32Bit> scanline(width);
+  // compressed strips have to be read sequentially
+  for (uint32_t row = 0; row <= 4; ++row) {
+    TIFFReadScanline(tif, scanline.data(), row);
+  }
+  EXPECT_EQ(scanline[0], 2);
+  EXPECT_EQ(scanline[5], 84);
+  TIFFClose(tif);
+
+  std::ifstream spectra_file("test_tof_stack/test_Spectra.txt");
+  std::string line;
+  std::getline(spectra_file, line);
+  std::getline(spectra_file, line);
+  EXPECT_EQ(line, "0.1,240");
+
+  std::filesystem::remove_all("test_tof_stack");
+}
+
+TEST_F(SophireadCoreTest, BigTIFFWithMismatchedPageIsNotHalfAdded) {
+  std::vector<std::vector<std::vector<TIFF32Bit>>> tof_images(
+      3,
+      std::vector<std::vector<TIFF32Bit>>(10, std::vector<TIFF32Bit>(12, 1)));
+  std::vector<double> tof_bin_edges = {0.0, 0.1, 0.2, 0.3};
+
+  // an existing stack whose last page has another shape
+  std::filesystem::create_directories("test_tof_bad_stack");
+  TIFF* bad = TIFFOpen("test_tof_bad_stack/test.tiff", "w8");
+  ASSERT_NE(bad, nullptr);
+  for (uint32_t bin = 0; bin < 3; ++bin) {
+    const uint32_t width = bin < 2 ? 12 : 5;
+    const uint32_t height = bin < 2 ? 10 : 5;
+    TIFFSetField(bad, TIFFTAG_IMAGEWIDTH, width);
+    TIFFSetField(bad, TIFFTAG_IMAGELENGTH, height);
+    TIFFSetField(bad, TIFFTAG_SAMPLESPERPIXEL, 1);
+    TIFFSetField(bad, TIFFTAG_BITSPERSAMPLE, 32);
+    TIFFSetField(bad, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
+    TIFFSetField(bad, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(bad, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+    TIFFSetField(bad, TIFFTAG_ROWSPERSTRIP, height);
+    std::vector<TIFF32Bit> page(static_cast<size_t>(width) * height, 5);
+    TIFFWriteEncodedStrip(bad, 0, page.data(),
+                          page.size() * sizeof(TIFF32Bit));
+    TIFFWriteDirectory(bad);
+  }
+  TIFFClose(bad);
+
+  // the stack is overwritten as a whole, no page of it is added
+  sophiread::timedSaveTOFImagingToBigTIFF("test_tof_bad_stack", tof_images,
+                                          tof_bin_edges, "test", "none");
+  TIFF* tif = TIFFOpen("test_tof_bad_stack/test.tiff", "r");
+  ASSERT_NE(tif, nullptr);
+  EXPECT_EQ(TIFFNumberOfDirectories(tif), 3);
+  std::vector<TIFF32Bit> scanline(12);
+  for (uint32_t bin = 0; bin < 3; ++bin) {
+    TIFFSetDirectory(tif, bin);
+    TIFFReadScanline(tif, scanline.data(), 0);
+    EXPECT_EQ(scanline[0], 1) << "page " << bin;
+  }
+  TIFFClose(tif);
+
+  std::filesystem::remove_all("test_tof_bad_stack");
+}
+
+TEST_F(SophireadCoreTest, TimedSaveTOFImagingToHDF5) {
+  std::vector<std::vector<std::vector<TIFF32Bit>>> tof_images(
+      3,
+      std::vector<std::vector<TIFF32Bit>>(10, std::vector<TIFF32Bit>(12, 1)));
+  tof_images[2][9][11] = 7;
+  std::vector<double> tof_bin_edges = {0.0, 0.1, 0.2, 0.3};
+
+  // write twice to check accumulation
+  sophiread::timedSaveTOFImagingToHDF5("test_tof_stack", tof_images,
+                                       tof_bin_edges, "test", "deflate");
+  sophiread::timedSaveTOFImagingToHDF5("test_tof_stack", tof_images,
+                                       tof_bin_edges, "test", "deflate");
+  ASSERT_TRUE(std::filesystem::exists("test_tof_stack/test.h5"));
+
+  H5::H5File file("test_tof_stack/test.h5", H5F_ACC_RDONLY);
+  H5::DataSet dataset = file.openDataSet("tof_images");
+  hsize_t dims[3];
+  dataset.getSpace().getSimpleExtentDims(dims);
+  EXPECT_EQ(dims[0], 3);
+  EXPECT_EQ(dims[1], 10);
+  EXPECT_EQ(dims[2], 12);
+
+  std::vector<TIFF32Bit> cube(dims[0] * dims[1] * dims[2]);
+  dataset.read(cube.data(), H5::PredType::NATIVE_UINT32);
+  EXPECT_EQ(cube[0], 2);
+  EXPECT_EQ(cube.back(), 14);
+
+  std::vector<uint64_t> spectra(3);
+  file.openDataSet("spectra").read(spectra.data(),
+                                   H5::PredType::NATIVE_UINT64);
+  EXPECT_EQ(spectra[0], 240);
+  EXPECT_EQ(spectra[2], 252);
+  file.close();
+
+  EXPECT_THROW(sophiread::timedSaveTOFImagingToHDF5(
+                   "test_tof_stack", tof_images, tof_bin_edges, "test", "foo"),
+               std::runtime_error);
+
+  std::filesystem::remove_all("test_tof_stack");
+}
+
 TEST_F(SophireadCoreTest, UpdateTOFImages) {
   std::vector<std::vector<std::vector<unsigned int>>> tof_images(
       3, std::vector<std::vector<unsigned int>>(
@@ -197,6 +363,72 @@ TEST_F(SophireadCoreTest, UpdateTOFImages) {
   EXPECT_TRUE(updated);
 }
 
+TEST_F(SophireadCoreTest, TOFImageIndicesMatchUpdate) {
+  auto batches = generateMockTPX3Batches(3, 20);
+  std::vector<double> tof_bin_edges = {0.0, 1e-5, 1e-4, 1e-3, 1e-2};
+  const double super_resolution = 2.0;
+
+  auto expected =
+      sophiread::initializeTOFImages(super_resolution, tof_bin_edges);
+  std::vector<uint64_t> indices;
+  for (const auto& batch : batches) {
+    sophiread::updateTOFImages(expected, batch, super_resolution,
+                               tof_bin_edges, "hit");
+    sophiread::collectTOFImageIndices(indices, batch, super_resolution,
+                                      tof_bin_edges, "hit");
+  }
+
+  ASSERT_FALSE(indices.empty());
+
+  auto merged = sophiread::initializeTOFImages(super_resolution, tof_bin_edges);
+  sophiread::addTOFImageIndices(merged, indices);
+  EXPECT_EQ(merged, expected);
+}
+
+TEST_F(SophireadCoreTest, RebinNeutrons) {
+  // TOF of neutron i is 500 + 1000 * i ticks, i.e. 12.5 us + 25 us * i
+  TPX3 batch(0, 0, 0);
+  for (int i = 0; i < 400; ++i) {
+    batch.neutrons.emplace_back(i % 512, (i * 7) % 512, 500.0 + 1000.0 * i,
+                                10.0, 2, i * 100);
+  }
+  std::vector<double> tof_bin_edges;
+  for (int i = 0; i <= 100; ++i) tof_bin_edges.push_back(i * 1e-4);
+  const double super_resolution = 2.0;
+
+  auto expected =
+      sophiread::initializeTOFImages(super_resolution, tof_bin_edges);
+  sophiread::updateTOFImages(expected, batch, super_resolution, tof_bin_edges,
+                             "neutron");
+  EXPECT_EQ(sophiread::rebinNeutrons(batch.neutrons, super_resolution,
+                                     tof_bin_edges),
+            expected);
+
+  // the same events through a columnar event store and a time window
+  const std::string store_dir = "test_rebin_store";
+  {
+    EventStoreWriter writer(store_dir, false, 64);
+    writer.append(batch.neutrons);
+  }
+  EventStoreReader store(store_dir);
+  EXPECT_EQ(sophiread::rebinEventStore(store, super_resolution, tof_bin_edges),
+            expected);
+
+  // events 100..199 have spidertime in [10000, 20000)
+  const auto window = sophiread::rebinEventStore(store, super_resolution,
+                                                 tof_bin_edges, 10000, 20000);
+  const auto spectrum = sophiread::calculateSpectralCounts(window);
+  EXPECT_EQ(std::accumulate(spectrum.begin(), spectrum.end(), uint64_t{0}),
+            100u);
+  // 2.5 ms to 5 ms
+  EXPECT_EQ(spectrum[24], 0u);
+  EXPECT_EQ(spectrum[25], 4u);
+  EXPECT_EQ(spectrum[49], 4u);
+  EXPECT_EQ(spectrum[50], 0u);
+
+  std::filesystem::remove_all(store_dir);
+}
+
 TEST_F(SophireadCoreTest, CalculateSpectralCounts) {
   std::vector<std::vector<std::vector<unsigned int>>> tof_images(
       3, std::vector<std::vector<unsigned int>>(
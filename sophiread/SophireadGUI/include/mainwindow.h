@@ -10,12 +10,13 @@
 #include <QLabel>
 #include <QMainWindow>
 #include <QTimer>
+#include <cstdint>
+#include <memory>
+#include <vector>
 
-#include "clustering.h"
-#include "tpx3.h"
+#include "display_worker.h"
+#include "live_image.h"
 
-#define HSIZEM1 4095
-// #define DSCALE 8.0
 #define ROTANGLE -1.0
 
 namespace Ui {
@@ -25,6 +26,12 @@ class MainWindow;
 /**
  * @brief The UI for SophireadDisplay.
  *
+ * The data is reduced by a DisplayWorker on its own threads; the UI thread
+ * only polls it on a timer and replots the image whenever it changed, so the
+ * window stays responsive and the image builds up while the file is read.
+ * Alternatively, the window attaches to the live image a running reduction
+ * publishes (SophireadStream -P) and shows its frames without reducing the
+ * data a second time.
  */
 class MainWindow : public QMainWindow {
   Q_OBJECT
@@ -45,16 +52,24 @@ class MainWindow : public QMainWindow {
   void handlereadfile();
   void handlespinbox();
   void handlesavedata();
+  void handleattachlive();
 
  private:
+  void resizeplot(int size);
+  void updatehisto(const std::vector<uint32_t> &image);
+  void updatelive();
+
   Ui::MainWindow *ui;
   QTimer *mytimer;
   double range_max;
   double range_min;
-  std::vector<NeutronEvent> m_events;
-  int m_total_hits;
-  int m_total_events;
-  ClusteringAlgorithm *clustering_alg;
+  DisplayWorkerOptions m_options;
+  std::unique_ptr<DisplayWorker> m_worker;
+  std::vector<uint32_t> m_image;  // latest snapshot of the worker's image
+  uint64_t m_image_version = 0;
+  int m_plot_size = 0;  // pixels a side of the plotted image
+  std::unique_ptr<LiveImageReader> m_live;  // attached live image, if any
+  LiveImageFrame m_frame;                   // latest frame of the live image
 };
 
 #endif  // MAINWINDOW_H
@@ -1,18 +1,17 @@
 #include "mainwindow.h"
 
-#include <H5Cpp.h>
-#include <QtConcurrent/qtconcurrentrun.h>
-#include <math.h>
-#include <omp.h>
 #include <qwt_color_map.h>
 #include <qwt_plot.h>
 #include <qwt_scale_engine.h>
 
 #include <QFile>
 #include <QFileDialog>
+#include <QInputDialog>
+#include <algorithm>
+#include <exception>
 #include <iostream>
 
-#include "abs.h"
+#include "disk_io.h"
 #include "ui_mainwindow.h"
 
 // Custom class of color map
@@ -34,24 +33,28 @@ MainWindow::MainWindow(QWidget *parent)
   // Set color map range (num of Neutron counts)
   range_max = 100.0;
   range_min = 0.0;
-  m_total_hits = 0;
 
   // Set up the timer
   mytimer = new QTimer(this);
 
-  // Set up the plot
-  const int ii = (int)(DSCALE * 512);
-  const int jj = (int)(DSCALE * 500);
-
-  //
-  vhisto.resize(ii * ii);
-  my2dhisto = vhisto.data();
+  // Init the reduction
+  // NOTE: use adaptive search box with a feature of 5.0 pixels
+  //       use weighted centroid for approximating neutron event
+  m_options.radius = 5.0;
+  m_options.min_cluster_size = 1;
+  m_options.spider_time_range = 75;
+  // correction for detector mounting angle
+  // NOTE: this rotation correction is still being investigated
+  //       might not be needed in the future.
+  m_options.rotation = ROTANGLE;
+  // NOTE: the neutrons are only kept for saving when Keep Events is checked
+  m_options.keep_neutrons = false;
+  m_worker = std::make_unique<DisplayWorker>(m_options);
 
+  // Set up the plot
   histo_data = new QwtMatrixRasterData();
-  histo_data->setInterval(Qt::XAxis, QwtInterval(0, jj));
-  histo_data->setInterval(Qt::YAxis, QwtInterval(0, jj));
   histo_data->setInterval(Qt::ZAxis, QwtInterval(range_min, range_max));
-  histo_data->setValueMatrix(vhisto, ii);
+  resizeplot((int)m_worker->getImageSize());
   //
   histo = new QwtPlotSpectrogram();
   histo->setDisplayMode(QwtPlotSpectrogram::DisplayMode::ImageMode, true);
@@ -60,56 +63,74 @@ MainWindow::MainWindow(QWidget *parent)
   histo->attach(ui->qwthistoPlot);
   ui->qwthistoPlot->replot();
 
-  // Init the clustering algorithm
-  // NOTE: use adaptive search box with a feature of 5.0 pixels
-  //       use weighted centroid for approximating neutron event
-  double radius = 5.0;
-  unsigned long int min_cluster_size = 1;
-  unsigned long int spider_time_range = 75;
-
-  clustering_alg = new ABS(radius, min_cluster_size, spider_time_range);
-  clustering_alg->set_method("centroid");
-  // clustering_alg->set_method("fast_gaussian");
-
   // Connect signals and slots
   connect(mytimer, SIGNAL(timeout()), this, SLOT(handletimer()));
   connect(ui->selectfile, SIGNAL(clicked()), this, SLOT(handlereadfile()));
   connect(ui->updaterange, SIGNAL(clicked()), this, SLOT(handlespinbox()));
   connect(ui->savedata, SIGNAL(clicked()), this, SLOT(handlesavedata()));
+  connect(ui->attachlive, SIGNAL(clicked()), this, SLOT(handleattachlive()));
 }
 
-MainWindow::~MainWindow() { delete ui; }
+MainWindow::~MainWindow() {
+  m_worker->stop();
+  delete ui;
+}
 
 /**
  * @brief Periodically update triggered by internal timer
  *
+ * @note The worker reduces the data on its own threads, this only copies its
+ *       progress and image, and replots when the image changed.
  */
 void MainWindow::handletimer() {
+  if (m_live) {
+    updatelive();
+    return;
+  }
+
+  const DisplayProgress progress = m_worker->getProgress();
   // update percentage of data processed
-  // TODO: need to find a way to adapt the percentage number
-  //
+  // NOTE: a stream only knows the bytes received so far
+  const double percent =
+      progress.total_bytes > 0
+          ? 100.0 * progress.bytes_read / progress.total_bytes
+          : 0.0;
+  ui->percent_complete->setText(QString::number(percent, 'f', 1));
   // update time used to process data
   auto elapsed = myelapsedtime.elapsed();
   ui->elapsed_time->setText(QString::number(elapsed));
   // update total number of hits
-  ui->totalhits->setText(QString::number(m_total_hits));
+  ui->totalhits->setText(QString::number(progress.hits));
   // update number of clusters (neutron events) found
-  ui->totalclusters->setText(QString::number(m_total_events));
+  ui->totalclusters->setText(QString::number(progress.neutrons));
+
+  // Update the histogram plot with what was reduced so far
+  if (m_worker->copyImage(m_image, m_image_version)) {
+    updatehisto(m_image);
+    ui->qwthistoPlot->replot();
+  }
+
+  if (progress.done) {
+    mytimer->stop();
+    const std::string error = m_worker->getError();
+    ui->infobox->setText(error.empty()
+                             ? QString("Done")
+                             : QString::fromStdString("Error: " + error));
+    std::cout << "Total hits: " << progress.hits << std::endl;
+    std::cout << "Total events: " << progress.neutrons << std::endl;
+  }
 }
 
 /**
- * @brief Read data from file and process hits to events
+ * @brief Start reducing a file in the background
  *
- * @note This function does more than just reading file as it also process the
- *       data and update the histogram plot.
+ * @note The file is read and clustered chunk by chunk on the worker threads,
+ *       the timer replots the image as it builds up.
  */
 void MainWindow::handlereadfile() {
-  QString qs;
   // Check if data processing in progress
-  // NOTE: active timer means data processing is in progress
-  if (mytimer->isActive()) {
-    qs.asprintf("File read already in progress");
-    ui->infobox->setText(qs);
+  if (m_worker->isRunning()) {
+    ui->infobox->setText("File read already in progress");
     return;
   }
 
@@ -117,67 +138,128 @@ void MainWindow::handlereadfile() {
   QString filename = QFileDialog::getOpenFileName(
       this, "Timepix File to open", QDir::currentPath(),
       "All files (*.*) ;; Timepix raw (*.tpx3)");
+  if (filename.isNull()) {
+    ui->infobox->setText("No file selected");
+    return;
+  }
 
-  // DEVNOTE:
-  // The original QtConcurrent::run() function is not safe guarding content of
-  // `myhits`, which could leads to racing conditions.
-  // A safer and better multi-threading solution is needed here.
+  // Keep the neutrons for saving only when asked for
+  if (ui->keepevents->isChecked() != m_options.keep_neutrons) {
+    m_options.keep_neutrons = ui->keepevents->isChecked();
+    m_worker = std::make_unique<DisplayWorker>(m_options);
+    m_image_version = 0;
+  }
 
-  // Start the timer
-  mytimer->start(2000);
+  try {
+    m_worker->start(filename.toStdString());
+  } catch (const std::exception &e) {
+    ui->infobox->setText(QString("Error: ") + e.what());
+    return;
+  }
+  m_live.reset();
+  resizeplot((int)m_worker->getImageSize());
+  ui->infobox->setText("Reading " + filename);
+  myelapsedtime.start();
+  mytimer->start(500);
+}
 
-  // Read raw data from file
-  if (filename.isNull()) {
-    qs.asprintf("No file selected");
-    ui->infobox->setText(qs);
+/**
+ * @brief Attach to the live image published by a running reduction
+ *
+ * @note The frames are polled on the timer like the worker's image, nothing
+ *       is reduced in this process.
+ */
+void MainWindow::handleattachlive() {
+  // Check if data processing in progress
+  if (m_worker->isRunning()) {
+    ui->infobox->setText("File read already in progress");
     return;
   }
 
-  auto hits = readTimepix3RawData(filename.toStdString());
-  m_total_hits = hits.size();
-  ui->totalhits->setText(QString::number(m_total_hits));
-  std::cout << "Total hits: " << m_total_hits << std::endl;
-
-  // Perform clustering
-  clustering_alg->fit(hits);
-
-  // Generate neutron events from clustering results
-  m_events = clustering_alg->get_events(hits);
-  m_total_events = m_events.size();
-  ui->totalclusters->setText(QString::number(m_total_events));
-  std::cout << "Total events: " << m_total_events << std::endl;
-
-  // Convert neutron events to 2D histogram data
-  const double mycos = cos(ROTANGLE * M_PI / 180.0);
-  const double mysin = sin(ROTANGLE * M_PI / 180.0);
-  const int isize = (int)(DSCALE * 512);
-#pragma omp parallel for
-  for (auto e : m_events) {
-    auto x = e.getX();
-    auto y = e.getY();
-    // correction for detector mounting angle
-    // NOTE: this rotation correction is still being investigated
-    //       might not be needed in the future.
-    if (ROTANGLE != 0.0) {
-      auto x1 = x * mycos - y * mysin;
-      auto y1 = x * mysin + y * mycos;
-      x = x1;
-      y = y1;
-    }
-    if (x >= 0 && x < isize && y >= 0 && y < isize) {
-      // std::cout << "(x, y) = (" << int(x) << "," << int(y)<< ")\n";
-#pragma omp atomic
-      my2dhisto[isize * int(x) + int(y)] += 1;
-    }
+  bool ok = false;
+  const QString name = QInputDialog::getText(
+      this, "Attach to live image", "Shared memory name (SophireadStream -P)",
+      QLineEdit::Normal, "/sophiread", &ok);
+  if (!ok || name.isEmpty()) {
+    ui->infobox->setText("No live image selected");
+    return;
   }
 
-  // Update the histogram plot
+  std::unique_ptr<LiveImageReader> live;
+  try {
+    live = std::make_unique<LiveImageReader>(name.toStdString());
+  } catch (const std::exception &e) {
+    ui->infobox->setText(QString("Error: ") + e.what());
+    return;
+  }
+  if (live->getWidth() != live->getHeight()) {
+    ui->infobox->setText("Error: the live image is not square");
+    return;
+  }
+  m_live = std::move(live);
+  m_frame.counters.frame = 0;
+  resizeplot((int)m_live->getWidth());
   ui->qwthistoPlot->replot();
+  ui->infobox->setText("Attached to live image " + name);
+  mytimer->start(500);
+}
 
-  // Stop the timer
-  mytimer->stop();
+/**
+ * @brief Show the newest frame of the live image, if it changed
+ *
+ */
+void MainWindow::updatelive() {
+  if (m_live->getLatestFrame() != m_frame.counters.frame &&
+      m_live->read(m_frame)) {
+    const LiveImageCounters &counters = m_frame.counters;
+    // NOTE: a live run has no known end, percent complete does not apply
+    ui->percent_complete->setText("-");
+    ui->elapsed_time->setText(QString::number(counters.elapsed * 1000, 'f', 0));
+    ui->totalhits->setText(QString::number(counters.hits));
+    ui->totalclusters->setText(QString::number(counters.neutrons));
+    updatehisto(m_frame.image);
+    ui->qwthistoPlot->replot();
+  }
 
-  std::cout << "Done" << std::endl;
+  if (m_live->isFinished()) {
+    mytimer->stop();
+    ui->infobox->setText("Live run finished");
+  }
+}
+
+/**
+ * @brief Size the plot data for an image of size pixels a side
+ *
+ * @param[in] size
+ */
+void MainWindow::resizeplot(int size) {
+  if (size == m_plot_size) return;
+  m_plot_size = size;
+  vhisto = QVector<double>(size * size, 0.0);
+  // NOTE: taken before the raster data shares vhisto
+  my2dhisto = vhisto.data();
+  histo_data->setInterval(Qt::XAxis, QwtInterval(0, size));
+  histo_data->setInterval(Qt::YAxis, QwtInterval(0, size));
+  histo_data->setValueMatrix(vhisto, size);
+}
+
+/**
+ * @brief Copy an image, of the worker or the live image, to the plot data
+ *
+ * @note The image is row major (y, x); the plot is indexed [x][y].
+ *       The plot data is written through my2dhisto, which shares its storage
+ *       with the raster data; a non-const access to vhisto would detach it.
+ *
+ * @param[in] image: m_plot_size pixels a side
+ */
+void MainWindow::updatehisto(const std::vector<uint32_t> &image) {
+  const int isize = m_plot_size;
+  std::fill(my2dhisto, my2dhisto + isize * isize, 0.0);
+  for (int y = 0; y < isize; ++y) {
+    for (int x = 0; x < isize; ++x) {
+      my2dhisto[isize * x + y] = image[(size_t)y * isize + x];
+    }
+  }
 }
 
 /**
@@ -188,9 +270,7 @@ void MainWindow::handlespinbox() {
   range_max = (double)ui->spinmaxrange->value();
   range_min = (double)ui->spinminrange->value();
   histo_data->setInterval(Qt::ZAxis, QwtInterval(range_min, range_max));
-  if (!mytimer->isActive()) {
-    ui->qwthistoPlot->replot();
-  };
+  ui->qwthistoPlot->replot();
 }
 
 /**
@@ -198,12 +278,9 @@ void MainWindow::handlespinbox() {
  *
  */
 void MainWindow::handlesavedata() {
-  QString qs;
   // Check if data processing in progress
-  // NOTE: active timer means data processing is in progress
-  if (mytimer->isActive()) {
-    qs.asprintf("File read already in progress");
-    ui->infobox->setText(qs);
+  if (m_worker->isRunning()) {
+    ui->infobox->setText("File read already in progress");
     return;
   }
 
@@ -216,7 +293,7 @@ void MainWindow::handlesavedata() {
     FILE *outfile;
     int ii;
     int i, j;
-    ii = (int)(DSCALE * 512);
+    ii = m_plot_size;
     swaphisto = new double[ii * ii];
     // swap axis of  data
     for (i = 0; i < ii; i++)  // x
@@ -232,11 +309,23 @@ void MainWindow::handlesavedata() {
   }
 
   // Save neutron events to HDF5 archive
+  // NOTE: the live image comes without its neutrons
+  if (m_live) return;
+  if (!m_options.keep_neutrons) {
+    ui->infobox->setText("Events not kept, check Keep Events before reading");
+    return;
+  }
   filename = QFileDialog::getSaveFileName(this, "Save events to HDF5",
                                           QDir::currentPath(),
                                           "All files (*.*) ;; HDF5 (*.hdf5)");
   if (!filename.isNull()) {
-    saveEventsToHDF5(filename.toStdString(), m_events);
+    const auto &neutrons = m_worker->getNeutrons();
+    saveNeutronToHDF5(filename.toStdString(), neutrons);
     std::cout << "Saved events to " << filename.toStdString() << std::endl;
+    // the worker keeps the first max_kept_neutrons only
+    if (neutrons.size() < m_worker->getProgress().neutrons) {
+      ui->infobox->setText("Saved the first " +
+                           QString::number(neutrons.size()) + " events");
+    }
   }
-}
\ No newline at end of file
+}
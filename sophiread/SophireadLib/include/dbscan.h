@@ -1,6 +1,7 @@
 #pragma once
 
 #include "clustering.h"
+#include "tpx3.h"
 
 class DBSCAN : public ClusteringAlgorithm {
  public:
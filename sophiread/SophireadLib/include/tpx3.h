@@ -1,128 +1,18 @@
 #pragma once
 
-#include <condition_variable>
-#include <fstream>
-#include <mutex>
-#include <queue>
+#include <cstddef>
 #include <string>
 #include <vector>
 
+#include "hit.h"
+#include "neutron.h"
+
 // scale factor used for super-pixeling (1 pixel -> 8x8 pixels)
 #define DSCALE 1.0
 
-/**
- * @brief Class to store the data of a single hit of a charged particle
- *        hitting the timepix3 sensor.
- *
- */
-class Hit {
- public:
-  // default constructor
-  Hit()
-      : m_x(0),
-        m_y(0),
-        m_tot(0),
-        m_toa(0),
-        m_ftoa(0),
-        m_tof(0),
-        m_spidertime(0){};
-  // copy constructor
-  Hit(const Hit& hit)
-      : m_x(hit.m_x),
-        m_y(hit.m_y),
-        m_tot(hit.m_tot),
-        m_toa(hit.m_toa),
-        m_ftoa(hit.m_ftoa),
-        m_tof(hit.m_tof),
-        m_spidertime(hit.m_spidertime){};
-
-  Hit(int x, int y, int tot, int toa, int ftoa, unsigned int tof,
-      unsigned long long spidertime)
-      : m_x(x),
-        m_y(y),
-        m_tot(tot),
-        m_toa(toa),
-        m_ftoa(ftoa),
-        m_tof(tof),
-        m_spidertime(spidertime){};
-
-  // special constructor that directly parse the raw packet from tpx3
-  // into a hit
-  Hit(const char* packet, const unsigned long long tdc,
-      const unsigned long long gdc, const int chip_layout_type);
-
-  Hit& operator=(const Hit& hit) {
-    m_x = hit.m_x;
-    m_y = hit.m_y;
-    m_tot = hit.m_tot;
-    m_toa = hit.m_toa;
-    m_ftoa = hit.m_ftoa;
-    m_tof = hit.m_tof;
-    m_spidertime = hit.m_spidertime;
-    return *this;
-  }
-
-  int getX() const { return m_x; };
-  int getY() const { return m_y; };
-  int getTOT() const { return m_tot; };
-  int getTOA() const { return m_toa; };
-  int getFTOA() const { return m_ftoa; };
-  unsigned long long getSPIDERTIME() const { return m_spidertime; };
-  unsigned int getTOF() const { return m_tof; };
-
-  double getTOF_ns() const { return m_tof * m_scale_to_ns_40mhz; };
-  double getTOA_ns() const { return m_toa * m_scale_to_ns_40mhz; };
-  double getTOT_ns() const { return m_tot * m_scale_to_ns_40mhz; };
-  double getSPIDERTIME_ns() const {
-    return m_spidertime * m_scale_to_ns_40mhz;
-  };
-  double getFTOA_ns() const { return m_ftoa * m_scale_to_ns_640mhz; };
-
-  std::string toString() const;
-
- private:
-  // raw packet directly read from tpx3.
-  int m_x, m_y;  // pixel coordinates
-  int m_tot;     // time over threshold
-  int m_toa;     // time of arrival (40MHz clock, 14 bit)
-  int m_ftoa;    // fine time of arrival (640MHz clock, 4 bit)
-  unsigned int m_tof;
-  unsigned long long
-      m_spidertime;  // time from the spider board (in the unit of 25ns)
-
-  // scale factor that converts time to ns
-  const double m_scale_to_ns_40mhz =
-      25.0;  // 40 MHz clock is used for the coarse time of arrival.
-  const double m_scale_to_ns_640mhz =
-      25.0 / 16.0;  // 640 MHz clock is used for the fine time of arrival.
-};
-
-/**
- * @brief Class to store the data of a single neutron event.
- *
- */
-class NeutronEvent {
- public:
-  NeutronEvent(const double x, const double y, const double tof,
-               const double tot, const int nHits)
-      : m_x(x), m_y(y), m_tof(tof), m_tot(tot), m_nHits(nHits){};
-  double getX() const { return m_x; };
-  double getY() const { return m_y; };
-  double getTOT() const { return m_tot; }
-  double getTOF() const { return m_tof; };
-  double getTOF_ns() const { return m_tof * m_scale_to_ns_40mhz; };
-  int getNHits() const { return m_nHits; };
-
-  std::string toString() const;
-
- private:
-  const double m_x, m_y;  // pixel coordinates
-  const double m_tof;     // time of flight
-  const double m_tot;     // time-over-threshold
-  const int m_nHits;      // number of hits in the event (cluster size)
-  const double m_scale_to_ns_40mhz =
-      25.0;  // 40 MHz clock is used for the coarse time of arrival.
-};
+// NOTE: the legacy API is kept as thin adapters over the FastSophiread core,
+//       hits and neutron events are the FastSophiread types.
+using NeutronEvent = Neutron;
 
 /**
  *  @brief Class to store user-defined parameters for clustering algorithms
@@ -187,4 +77,4 @@ struct TPX3H {
         chip_layout_type(chip_layout_type){};
 };
 std::vector<Hit> fastParseTPX3Raw(const std::vector<char>& raw_bytes);
-std::vector<Hit> processBatch(TPX3H batch, const std::vector<char>& raw_bytes);
\ No newline at end of file
+std::vector<Hit> processBatch(TPX3H batch, const std::vector<char>& raw_bytes);
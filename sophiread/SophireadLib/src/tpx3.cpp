@@ -3,31 +3,16 @@
 #include <H5Cpp.h>
 
 #include <algorithm>
-#include <future>
+#include <fstream>
 #include <iostream>
 #include <numeric>
 #include <sstream>
+#include <stdexcept>
 #include <vector>
 
-#include "abs.h"
-#include "dbscan.h"
+#include "disk_io.h"
 #include "tbb/parallel_for.h"
-#include "tbb/tbb.h"
-
-std::string Hit::toString() const {
-  std::stringstream ss;
-  ss << "Hit: x=" << m_x << ", y=" << m_y << ", tot=" << m_tot
-     << ", toa=" << m_toa << ", ftoa=" << m_ftoa << ", tof=" << m_tof
-     << ", spidertime=" << m_spidertime;
-  return ss.str();
-}
-
-std::string NeutronEvent::toString() const {
-  std::stringstream ss;
-  ss << "NeutronEvent: x=" << m_x << ", y=" << m_y << ", tof=" << m_tof
-     << ", nHits=" << m_nHits;
-  return ss.str();
-}
+#include "tpx3_fast.h"
 
 std::string Params::toString() const {
   std::stringstream ss;
@@ -38,168 +23,149 @@ std::string Params::toString() const {
   return ss.str();
 }
 
-/**
- * @brief Special constructor that construct a Hit from raw bytes.
- *
- * @param packet
- * @param tdc
- * @param gdc
- * @param chip_layout_type
- */
-Hit::Hit(const char *packet, const unsigned long long tdc,
-         const unsigned long long gdc, const int chip_layout_type) {
-  unsigned short pixaddr, dcol, spix, pix;
-  unsigned short *spider_time;
-  unsigned short *nTOT;    // bytes 2,3, raw time over threshold
-  unsigned int *nTOA;      // bytes 3,4,5,6, raw time of arrival
-  unsigned int *npixaddr;  // bytes 4,5,6,7
-  unsigned int spidertime = 0;
-  // timing information
-  spider_time = (unsigned short *)(&packet[0]);  // Spider time  (16 bits)
-  nTOT = (unsigned short *)(&packet[2]);         // ToT          (10 bits)
-  nTOA = (unsigned int *)(&packet[3]);           // ToA          (14 bits)
-  m_ftoa = *nTOT & 0xF;                          // fine ToA     (4 bits)
-  m_tot = (*nTOT >> 4) & 0x3FF;
-  m_toa = (*nTOA >> 6) & 0x3FFF;
-  spidertime = 16384 * (*spider_time) + m_toa;
-
-  // rename variables for clarity
-  unsigned long long int GDC_timestamp = gdc;
-  unsigned long long TDC_timestamp = tdc;
-
-  // convert spidertime to global timestamp
-  unsigned long SPDR_LSB30 = 0;
-  unsigned long SPDR_MSB18 = 0;
-  //   unsigned long long SPDR_timestamp = 0;
-
-  SPDR_LSB30 = GDC_timestamp & 0x3FFFFFFF;
-  SPDR_MSB18 = (GDC_timestamp >> 30) & 0x3FFFF;
-  if (spidertime < SPDR_LSB30) {
-    SPDR_MSB18++;
-  }
-  m_spidertime = (SPDR_MSB18 << 30) & 0xFFFFC0000000;
-  m_spidertime = m_spidertime | spidertime;
-
-  // tof calculation
-  // TDC packets not always arrive before corresponding data packets
-  if (m_spidertime < TDC_timestamp) {
-    m_tof = m_spidertime - TDC_timestamp +
-            16666667;  // 1E9 / 60.0 is approximately 16666667
-  } else {
-    m_tof = m_spidertime - TDC_timestamp;
-  }
-
-  // pixel address
-  npixaddr = (unsigned int *)(&packet[4]);  // Pixel address (14 bits)
-  pixaddr = (*npixaddr >> 12) & 0xFFFF;
-  dcol = ((pixaddr & 0xFE00) >> 8);
-  spix = ((pixaddr & 0x1F8) >> 1);
-  pix = pixaddr & 0x7;
-  m_x = dcol + (pix >> 2);   // x coordinate
-  m_y = spix + (pix & 0x3);  // y coordinate
-  // adjustment for chip layout
-  if (chip_layout_type == 0) {  // single
-    m_x += 260;
-    // m_y = m_y;
-  } else if (chip_layout_type == 1) {  // double
-    m_x = 255 - m_x + 260;
-    m_y = 255 - m_y + 260;
-  } else if (chip_layout_type == 2) {  // triple
-    m_x = 255 - m_x;
-    m_y = 255 - m_y + 260;
-  }
-}
+namespace {
 
 /**
- * @brief Alternative way to parse data packet where timing is assumed.
+ * @brief Re-time a hit assuming the timing, with the spidertime rollover
+ *        tracked from hit to hit.
  *
- * @param packet
+ * @param hit: hit parsed by the FastSophiread core.
  * @param rollover_counter
  * @param previous_time
- * @param chip_layout_type
  * @return Hit
- *
- * @note As of 2023-02-24, timing packet (gdc, tdc) are not reliable, therefore
- * this function is used as a temporary solution with assumed timing, until
- * timing packet is fixed on the hardware side.
  */
-Hit packetToHitAlt(const std::vector<char> &packet,
-                   unsigned long long *rollover_counter,
-                   unsigned long long *previous_time,
-                   const int chip_layout_type) {
-  unsigned short pixaddr, dcol, spix, pix;
-  unsigned short *spider_time;
-  unsigned short *nTOT;    // bytes 2,3, raw time over threshold
-  unsigned int *nTOA;      // bytes 3,4,5,6, raw time of arrival
-  unsigned int *npixaddr;  // bytes 4,5,6,7
-  int x, y, tot, toa, ftoa;
-  unsigned int spidertime, tof;
-  // timing information
-  spider_time = (unsigned short *)(&packet[0]);  // Spider time  (16 bits)
-  nTOT = (unsigned short *)(&packet[2]);         // ToT          (10 bits)
-  nTOA = (unsigned int *)(&packet[3]);           // ToA          (14 bits)
-  ftoa = *nTOT & 0xF;                            // fine ToA     (4 bits)
-  tot = (*nTOT >> 4) & 0x3FF;
-  toa = (*nTOA >> 6) & 0x3FFF;
-  spidertime = 16384 * (*spider_time) + toa;
-
-  // time calculation
-  // Compute SPDR_timestamp
-  unsigned long long SPDR_timestamp = 0;
+Hit assumeTiming(const Hit &hit, unsigned long long &rollover_counter,
+                 unsigned long long &previous_time) {
+  // the 30 bit spidertime of the packet, without any GDC
+  const unsigned long long spidertime = hit.getSPIDERTIME() & 0x3FFFFFFF;
   const unsigned long long time_range = 1 << 30;
 
   // if curr hit arrives earlier than previous hit (out of order)
   // if it is a lot earlier, it belongs to the next rollover
-
-  if (spidertime < *previous_time) {
-    if (*previous_time - spidertime > time_range / 2) {
-      *rollover_counter += 1;
+  if (spidertime < previous_time) {
+    if (previous_time - spidertime > time_range / 2) {
+      rollover_counter += 1;
     }
 
     // if the curr hit arrives later than previous hit (in order)
     // if it is a lot later, it belongs to the previous rollover
   } else {
-    if (spidertime - *previous_time > time_range / 2) {
-      if (*rollover_counter > 0) {
-        *rollover_counter -= 1;
+    if (spidertime - previous_time > time_range / 2) {
+      if (rollover_counter > 0) {
+        rollover_counter -= 1;
       }
     }
   }
 
-  *previous_time = spidertime;
+  previous_time = spidertime;
 
-  SPDR_timestamp = spidertime + (*rollover_counter) * time_range;
+  const unsigned long long SPDR_timestamp =
+      spidertime + rollover_counter * time_range;
   // compute tof = mod(SPDR_timestamp, 666667)
   // 666667 = 1E9/60.0/25.0
   // a consistent round off error of 10ns due to using integer for modulus
   // which is way below the 100ns time resolution needed
-  tof = SPDR_timestamp % 666667;
-
-  // pixel address
-  npixaddr = (unsigned int *)(&packet[4]);  // Pixel address (14 bits)
-  pixaddr = (*npixaddr >> 12) & 0xFFFF;
-  dcol = ((pixaddr & 0xFE00) >> 8);
-  spix = ((pixaddr & 0x1F8) >> 1);
-  pix = pixaddr & 0x7;
-  x = dcol + (pix >> 2);   // x coordinate
-  y = spix + (pix & 0x3);  // y coordinate
-  // adjustment for chip layout
-  if (chip_layout_type == 0) {  // single
-    x += 260;
-    y = y;
-  } else if (chip_layout_type == 1) {  // double
-    x = 255 - x + 260;
-    y = 255 - y + 260;
-  } else if (chip_layout_type == 2) {  // triple
-    x = 255 - x;
-    y = 255 - y + 260;
-  } else {  // quad
-    x = x;
-    y = y;
+  const unsigned int tof = SPDR_timestamp % 666667;
+
+  return Hit(hit.getX(), hit.getY(), hit.getTOT(), hit.getTOA(),
+             hit.getFTOA(), tof, SPDR_timestamp);
+}
+
+/**
+ * @brief Call func on each batch header, with the same scan as findTPX3H but
+ *        without a TPX3 (and its hit vector) per batch.
+ *
+ * @param raw_bytes
+ * @param func: called with the header position, number of packets and chip
+ */
+template <typename Func>
+void forEachBatch(const std::vector<char> &raw_bytes, Func &&func) {
+  for (std::size_t i = 0; i + 8 <= raw_bytes.size(); i += 8) {
+    const char *char_array = raw_bytes.data() + i;
+    if (char_array[0] == 'T' && char_array[1] == 'P' && char_array[2] == 'X') {
+      const int data_packet_size =
+          ((0xff & char_array[7]) << 8) | (0xff & char_array[6]);
+      func(i, data_packet_size >> 3, static_cast<int>(char_array[4]));
+    }
+  }
+}
+
+/**
+ * @brief Call func on each packet of a batch, stopping at the end of the data.
+ *
+ * @param raw_bytes
+ * @param index: position of the batch header
+ * @param num_packets
+ * @param func
+ */
+template <typename Func>
+void forEachPacket(const std::vector<char> &raw_bytes, std::size_t index,
+                   int num_packets, Func &&func) {
+  const char *bytes_end = raw_bytes.data() + raw_bytes.size();
+  const char *packet = raw_bytes.data() + index;
+  for (int j = 0; j < num_packets; ++j) {
+    packet += 8;
+    if (packet + 8 > bytes_end) {
+      std::cout << "EOF, insufficient bytes left." << std::endl;
+      break;
+    }
+    func(packet);
   }
+}
 
-  // return the hit
-  return Hit(x, y, tot, toa, ftoa, tof, SPDR_timestamp);
+/**
+ * @brief Evolve the timestamps with a timing packet, or add the hit of a data
+ *        packet, with the packet helpers of the FastSophiread core.
+ *
+ * @param packet
+ * @param chip_layout_type
+ * @param tdc_timestamp
+ * @param gdc_timestamp
+ * @param timer_lsb32
+ * @param need_timestamps: skip hits until both TDC and GDC are known, as the
+ * FastSophiread core does
+ * @param hits
+ */
+void processPacket(const char *packet, int chip_layout_type,
+                   unsigned long &tdc_timestamp,
+                   unsigned long long &gdc_timestamp,
+                   unsigned long &timer_lsb32, bool need_timestamps,
+                   std::vector<Hit> &hits) {
+  if (packet[7] == 0x6F) {
+    // TDC data packets
+    update_tdc_timestamp(packet, gdc_timestamp, tdc_timestamp);
+  } else if ((packet[7] & 0xF0) == 0x40) {
+    // GDC data packet
+    update_gdc_timestamp_and_timer_lsb32(packet, timer_lsb32, gdc_timestamp);
+  } else if ((packet[7] & 0xF0) == 0xb0) {
+    if (!need_timestamps || (tdc_timestamp != 0 && gdc_timestamp != 0)) {
+      hits.emplace_back(packet, tdc_timestamp, gdc_timestamp,
+                        chip_layout_type);
+    }
+  }
+}
+
+}  // namespace
+
+/**
+ * @brief Alternative way to parse data packet where timing is assumed.
+ *
+ * @param packet
+ * @param rollover_counter
+ * @param previous_time
+ * @param chip_layout_type
+ * @return Hit
+ *
+ * @note As of 2023-02-24, timing packet (gdc, tdc) are not reliable, therefore
+ * this function is used as a temporary solution with assumed timing, until
+ * timing packet is fixed on the hardware side.
+ */
+Hit packetToHitAlt(const std::vector<char> &packet,
+                   unsigned long long *rollover_counter,
+                   unsigned long long *previous_time,
+                   const int chip_layout_type) {
+  return assumeTiming(Hit(packet.data(), 0, 0, chip_layout_type),
+                      *rollover_counter, *previous_time);
 }
 
 /**
@@ -212,72 +178,7 @@ Hit packetToHitAlt(const std::vector<char> &packet,
  */
 Hit packetToHit(const std::vector<char> &packet, const unsigned long long tdc,
                 const unsigned long long gdc, const int chip_layout_type) {
-  unsigned short pixaddr, dcol, spix, pix;
-  unsigned short *spider_time;
-  unsigned short *nTOT;    // bytes 2,3, raw time over threshold
-  unsigned int *nTOA;      // bytes 3,4,5,6, raw time of arrival
-  unsigned int *npixaddr;  // bytes 4,5,6,7
-  int x, y, tot, toa, ftoa;
-  unsigned int spidertime = 0, tof = 0;
-  // timing information
-  spider_time = (unsigned short *)(&packet[0]);  // Spider time  (16 bits)
-  nTOT = (unsigned short *)(&packet[2]);         // ToT          (10 bits)
-  nTOA = (unsigned int *)(&packet[3]);           // ToA          (14 bits)
-  ftoa = *nTOT & 0xF;                            // fine ToA     (4 bits)
-  tot = (*nTOT >> 4) & 0x3FF;
-  toa = (*nTOA >> 6) & 0x3FFF;
-  spidertime = 16384 * (*spider_time) + toa;
-
-  // rename variables for clarity
-  unsigned long long int GDC_timestamp = gdc;
-  unsigned long long TDC_timestamp = tdc;
-
-  // convert spidertime to global timestamp
-  unsigned long SPDR_LSB30 = 0;
-  unsigned long SPDR_MSB18 = 0;
-  unsigned long long SPDR_timestamp = 0;
-
-  SPDR_LSB30 = GDC_timestamp & 0x3FFFFFFF;
-  SPDR_MSB18 = (GDC_timestamp >> 30) & 0x3FFFF;
-  if (spidertime < SPDR_LSB30) {
-    SPDR_MSB18++;
-  }
-  SPDR_timestamp = (SPDR_MSB18 << 30) & 0xFFFFC0000000;
-  SPDR_timestamp = SPDR_timestamp | spidertime;
-
-  // tof calculation
-  // TDC packets not always arrive before corresponding data packets
-  if (SPDR_timestamp < TDC_timestamp) {
-    tof = SPDR_timestamp - TDC_timestamp + 1E9 / 60.0;
-  } else {
-    tof = SPDR_timestamp - TDC_timestamp;
-  }
-
-  // pixel address
-  npixaddr = (unsigned int *)(&packet[4]);  // Pixel address (14 bits)
-  pixaddr = (*npixaddr >> 12) & 0xFFFF;
-  dcol = ((pixaddr & 0xFE00) >> 8);
-  spix = ((pixaddr & 0x1F8) >> 1);
-  pix = pixaddr & 0x7;
-  x = dcol + (pix >> 2);   // x coordinate
-  y = spix + (pix & 0x3);  // y coordinate
-  // adjustment for chip layout
-  if (chip_layout_type == 0) {  // single
-    x += 260;
-    y = y;
-  } else if (chip_layout_type == 1) {  // double
-    x = 255 - x + 260;
-    y = 255 - y + 260;
-  } else if (chip_layout_type == 2) {  // triple
-    x = 255 - x;
-    y = 255 - y + 260;
-  } else {  // quad
-    x = x;
-    y = y;
-  }
-
-  // return the hit
-  return Hit(x, y, tot, toa, ftoa, tof, SPDR_timestamp);
+  return Hit(packet.data(), tdc, gdc, chip_layout_type);
 }
 
 /**
@@ -285,125 +186,33 @@ Hit packetToHit(const std::vector<char> &packet, const unsigned long long tdc,
  *
  * @param filepath: path to the raw data file.
  * @return std::vector<Hit>: vector of hits.
+ *
+ * @note The timing packets are ignored and the timing is assumed as in
+ * packetToHitAlt, so every data packet gives a hit.
  */
 std::vector<Hit> readTimepix3RawData(const std::string &filepath) {
-  int chip_layout_type = 0;
-  int data_packet_size = 0;
-  int data_packet_num = 0;
-
-  // Open the file
-  std::ifstream file(filepath, std::ios::binary);
-  if (!file.is_open()) {
+  // NOTE: readTPX3RawToCharVec exits on a missing file, the legacy API throws
+  if (!std::ifstream(filepath, std::ios::binary).is_open()) {
     throw std::runtime_error("Error opening file");
   }
-  // Read the data from the file into a buffer
-  std::vector<unsigned char> buffer((std::istreambuf_iterator<char>(file)),
-                                    std::istreambuf_iterator<char>());
-  file.close();
-
-  // Process the buffer to extract the raw data
-  // (implementation of this will depend on the specific format of the TimePix3
-  // data)
-  std::vector<Hit> hits;
-  std::cout << "File size: " << buffer.size() << std::endl;
-
-  // for Alternative timing handler
-  unsigned long long *rollover_counter = new unsigned long long(0);
-  unsigned long long *previous_time = new unsigned long long(0);
-
-  // for TDC information
-  unsigned long *tdclast;
-  unsigned long long mytdc = 0;
-  unsigned long TDC_MSB16 = 0;
-  unsigned long TDC_LSB32 = 0;
-  unsigned long TDC_timestamp = 0;
-
-  // for GDC information
-  unsigned long *gdclast;
-  unsigned long long mygdc = 0;
-  unsigned long Timer_LSB32 = 0;
-  unsigned long Timer_MSB16 = 0;
-  unsigned long long int GDC_timestamp = 0;  // 48-bit
-
-  for (auto i = buffer.begin(); i != buffer.end(); i += 8) {
-    std::vector<char> char_array(i, std::next(i, 8));
-    if (char_array.size() != 8) {
-      std::cout << "EOF, insufficient bytes left." << std::endl;
-      break;
-    }
+  const auto raw_bytes = readTPX3RawToCharVec(filepath);
 
-    // locate the data packet header
-    if (char_array[0] == 'T' && char_array[1] == 'P' && char_array[2] == 'X') {
-      // get the size of the data packet
-      // NOTE:
-      // Sophiread_v1 is using a method that leads to negative data_packet_size
-      // and data_packet_num, therefore we are using the code from manufacture
-      // example, tpx3cam.cpp to get the data_packet_size.
-      data_packet_size = ((0xff & char_array[7]) << 8) | (0xff & char_array[6]);
-      data_packet_num =
-          data_packet_size >> 3;  // every 8 (2^3) bytes is a data packet
-
-      // get chip layout type
-      chip_layout_type = (int)char_array[4];
-
-      // processing each data packet
-      for (auto j = 0; j < data_packet_num; j++) {
-        i = std::next(i, 8);  // move the iterator to the next data packet
-        std::vector<char> data_packet(i, std::next(i, 8));
-        if (data_packet.size() != 8) {
-          std::cout << "EOF, insufficient bytes left." << std::endl;
-          break;
-        }
-        // extract the data from the data packet
-        if (data_packet[7] == 0x6F) {
-          // TDC data packets
-          tdclast = (unsigned long *)(&data_packet[0]);
-          mytdc = (((*tdclast) >> 12) &
-                   0xFFFFFFFF);  // rick: 0x3fffffff, get 32-bit tdc
-          TDC_LSB32 = GDC_timestamp & 0xFFFFFFFF;
-          TDC_MSB16 = (GDC_timestamp >> 32) & 0xFFFF;
-          if (mytdc < TDC_LSB32) {
-            TDC_MSB16++;
-          }
-          TDC_timestamp = (TDC_MSB16 << 32) & 0xFFFF00000000;
-          TDC_timestamp = TDC_timestamp | mytdc;
-          // std::cout << "TDC_timestamp: " << std::setprecision(15) <<
-          // TDC_timestamp*25E-9 <<std::endl;
-        } else if ((data_packet[7] & 0xF0) == 0x40) {
-          // GDC data packet
-          gdclast = (unsigned long *)(&data_packet[0]);
-          mygdc = (((*gdclast) >> 16) & 0xFFFFFFFFFFFF);
-          if (((mygdc >> 40) & 0xF) == 0x4) {
-            Timer_LSB32 = mygdc & 0xFFFFFFFF;  // 32-bit
-          } else if (((mygdc >> 40) & 0xF) == 0x5) {
-            Timer_MSB16 = mygdc & 0xFFFF;  // 16-bit
-            GDC_timestamp = Timer_MSB16;
-            GDC_timestamp = (GDC_timestamp << 32) & 0xFFFF00000000;
-            GDC_timestamp = GDC_timestamp | Timer_LSB32;
-            // std::cout << "GDC_timestamp: " << std::setprecision(15) <<
-            // GDC_timestamp*25E-9 << std::endl;
-          }
-        } else if ((data_packet[7] & 0xF0) == 0xb0) {
-          // NOTE: as of 2023-02-24, timing data packet cannot be used, using
-          // alternative method to get the timing information
-          auto hit = packetToHitAlt(data_packet, rollover_counter,
-                                    previous_time, chip_layout_type);
-          // std::cout << hit.toString() << std::endl;
-          // Process the data into hit
-          // auto hit = packetToHit(data_packet, TDC_timestamp, GDC_timestamp,
-          //                        chip_layout_type);
-          // std::cout << "Hits: " << hit.getX() << " " << hit.getY() << " " <<
-          // hit.getTOF_ns()*1E-6 << " " << hit.getSPIDERTIME_ns()*1E-9 <<
-          // std::endl;
-          // std::cout << std::setprecision(15) << hit.getSPIDERTIME_ns()*1E-9
-          // << std::endl;
-          hits.push_back(hit);
-        }
+  // NOTE: as of 2023-02-24, timing data packet cannot be used, using
+  // alternative method to get the timing information
+  unsigned long long rollover_counter = 0;
+  unsigned long long previous_time = 0;
+  std::vector<Hit> hits;
+  hits.reserve(raw_bytes.size() / 16);  // guess: a hit every other packet
+  forEachBatch(raw_bytes, [&](std::size_t index, int num_packets,
+                               int chip_layout_type) {
+    forEachPacket(raw_bytes, index, num_packets, [&](const char *packet) {
+      if ((packet[7] & 0xF0) == 0xb0) {
+        hits.push_back(assumeTiming(Hit(packet, 0, 0, chip_layout_type),
+                                    rollover_counter, previous_time));
       }
-    }
-  }
+    });
+  });
 
-  // Return the hits
   return hits;
 }
 
@@ -416,123 +225,55 @@ std::vector<Hit> readTimepix3RawData(const std::string &filepath) {
  * @return std::vector<Hit>
  */
 std::vector<Hit> fastParseTPX3Raw(const std::vector<char> &raw_bytes) {
-  std::vector<TPX3H> batches;
-  batches.reserve(raw_bytes.size() / 64);  // just a guess here, need more work
-
-  // local variables
-  int chip_layout_type = 0;
-  int data_packet_size = 0;
-  int data_packet_num = 0;
-
-  // find all batches
-  const auto iter_begin = raw_bytes.cbegin();
-  const auto iter_end = raw_bytes.cend();
-  for (auto iter = raw_bytes.cbegin(); iter + 8 < iter_end; iter += 8) {
-    const char *char_array = &(*iter);
-
-    // locate the data packet header
-    if (char_array[0] == 'T' && char_array[1] == 'P' && char_array[2] == 'X') {
-      data_packet_size = ((0xff & char_array[7]) << 8) | (0xff & char_array[6]);
-      data_packet_num =
-          data_packet_size >> 3;  // every 8 (2^3) bytes is a data packet
-      chip_layout_type = static_cast<int>(char_array[4]);
-      batches.emplace_back(static_cast<size_t>(std::distance(iter_begin, iter)),
-                           data_packet_size, data_packet_num, chip_layout_type);
-    }
+  auto batches = findTPX3H(raw_bytes);
+
+  // the timestamps evolve from batch to batch, so this pass is sequential
+  unsigned long tdc_timestamp = 0;
+  unsigned long long gdc_timestamp = 0;
+  unsigned long timer_lsb32 = 0;
+  for (auto &tpx3 : batches) {
+    updateTimestamp(tpx3, raw_bytes, tdc_timestamp, gdc_timestamp,
+                    timer_lsb32);
   }
 
-  // get upper estimate of total num_packets using std::accumulate
-  const auto total_num_packets =
-      std::accumulate(batches.cbegin(), batches.cend(), 0,
-                      [](const int &sum, const TPX3H &batch) {
-                        return sum + batch.num_packets;
-                      });
-  std::vector<Hit> hits(total_num_packets);
-
-  // // process each batch
-  // // tbb::parallel_for_each(batches.cbegin(), batches.cend(), [&](const TPX3H
-  // &batch) {
-  // //   const auto batch_hits = processBatch(batch, raw_bytes);
-  // //   std::copy(batch_hits.cbegin(), batch_hits.cend(), hits.begin() +
-  // batch.index);
-  // // });
-
-  // tbb::parallel_for(tbb::blocked_range<size_t>(0, hits.size()), [&](const
-  // tbb::blocked_range<size_t> &r) {
-  //   for (auto i = r.begin(); i != r.end(); ++i) {
-  //     if (hits[i].getX() == 0 && hits[i].getY() == 0) {
-  //       hits[i] = Hit();
-  //     }
-  //   }
-  // }
-
-  // remove empty Hit
-  // hits.erase(
-  //     std::remove_if(hits.begin(), hits.end(), [](const Hit &hit) { return
-  //     hit.getX() == 0 && hit.getY() == 0; }), hits.end());
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, batches.size()),
+                    [&](const tbb::blocked_range<size_t> &r) {
+                      for (size_t i = r.begin(); i != r.end(); ++i) {
+                        extractHits(batches[i], raw_bytes);
+                      }
+                    });
 
+  const size_t total_hits = std::accumulate(
+      batches.cbegin(), batches.cend(), size_t(0),
+      [](size_t sum, const TPX3 &tpx3) { return sum + tpx3.hits.size(); });
+  std::vector<Hit> hits;
+  hits.reserve(total_hits);
+  for (const auto &tpx3 : batches) {
+    hits.insert(hits.end(), tpx3.hits.cbegin(), tpx3.hits.cend());
+  }
   return hits;
 }
 
+/**
+ * @brief Process a single batch of packets into hits, with the timestamps
+ *        starting from zero.
+ *
+ * @param batch
+ * @param raw_bytes
+ * @return std::vector<Hit>
+ */
 std::vector<Hit> processBatch(TPX3H batch, const std::vector<char> &raw_bytes) {
-  //
   std::vector<Hit> hits;
   hits.reserve(batch.num_packets);
 
-  // -- TDC
-  unsigned long *tdclast;
-  unsigned long long mytdc = 0;
-  unsigned long TDC_MSB16 = 0;
-  unsigned long TDC_LSB32 = 0;
-  unsigned long TDC_timestamp = 0;
-  // -- GDC
-  unsigned long *gdclast;
-  unsigned long long mygdc = 0;
-  unsigned long Timer_LSB32 = 0;
-  unsigned long Timer_MSB16 = 0;
-  unsigned long long int GDC_timestamp = 0;  // 48-bit
-
-  //
-  auto bytes_iter = raw_bytes.cbegin() + batch.index;
-  for (auto j = 0; j < batch.num_packets; ++j) {
-    if (bytes_iter + 8 >= raw_bytes.cend()) {
-      continue;
-    }
-
-    bytes_iter = std::next(bytes_iter, 8);
-    const char *char_array = &(*bytes_iter);
-
-    // extract the data from the data packet
-    if (char_array[7] == 0x6F) {
-      // TDC data packets
-      tdclast = (unsigned long *)(&char_array[0]);
-      mytdc = (((*tdclast) >> 12) &
-               0xFFFFFFFF);  // rick: 0x3fffffff, get 32-bit tdc
-      TDC_LSB32 = GDC_timestamp & 0xFFFFFFFF;
-      TDC_MSB16 = (GDC_timestamp >> 32) & 0xFFFF;
-      if (mytdc < TDC_LSB32) {
-        TDC_MSB16++;
-      }
-      TDC_timestamp = (TDC_MSB16 << 32) & 0xFFFF00000000;
-      TDC_timestamp = TDC_timestamp | mytdc;
-    } else if ((char_array[7] & 0xF0) == 0x40) {
-      // GDC data packet
-      gdclast = (unsigned long *)(&char_array[0]);
-      mygdc = (((*gdclast) >> 16) & 0xFFFFFFFFFFF);
-      if (((mygdc >> 40) & 0xF) == 0x4) {
-        Timer_LSB32 = mygdc & 0xFFFFFFFF;  // 32-bit
-      } else if (((mygdc >> 40) & 0xF) == 0x5) {
-        Timer_MSB16 = mygdc & 0xFFFF;  // 16-bit
-        GDC_timestamp = Timer_MSB16;
-        GDC_timestamp = (GDC_timestamp << 32) & 0xFFFF00000000;
-        GDC_timestamp = GDC_timestamp | Timer_LSB32;
-      }
-    } else if ((char_array[7] & 0xF0) == 0xb0) {
-      // record the packet info
-      hits.emplace_back(char_array, TDC_timestamp, GDC_timestamp,
-                        batch.chip_layout_type);
-    }
-  }
+  unsigned long tdc_timestamp = 0;
+  unsigned long long gdc_timestamp = 0;
+  unsigned long timer_lsb32 = 0;
+  forEachPacket(raw_bytes, batch.index, batch.num_packets,
+                [&](const char *packet) {
+                  processPacket(packet, batch.chip_layout_type, tdc_timestamp,
+                                gdc_timestamp, timer_lsb32, false, hits);
+                });
 
   return hits;
 }
@@ -540,89 +281,27 @@ std::vector<Hit> processBatch(TPX3H batch, const std::vector<char> &raw_bytes) {
 /**
  * @brief Iterate through the raw char array and convert it to hits.
  *
+ * @note Gives the same hits as findTPX3H, updateTimestamp and extractHits of
+ * the FastSophiread core, in a single pass without a TPX3 per batch.
+ *
  * @param raw_bytes
  * @return std::vector<Hit>
  */
 std::vector<Hit> parseRawBytesToHits(const std::vector<char> &raw_bytes) {
-  // assume every 64 char will result in 1 hit (this needs to be verified via
-  // experiments).
   std::vector<Hit> hits;
-  hits.reserve(raw_bytes.size());
-
-  // local variables
-  // -- packet information
-  int chip_layout_type = 0;
-  int data_packet_size = 0;
-  int data_packet_num = 0;
-  // -- TDC
-  unsigned long *tdclast;
-  unsigned long long mytdc = 0;
-  unsigned long TDC_MSB16 = 0;
-  unsigned long TDC_LSB32 = 0;
-  unsigned long TDC_timestamp = 0;
-  // -- GDC
-  unsigned long *gdclast;
-  unsigned long long mygdc = 0;
-  unsigned long Timer_LSB32 = 0;
-  unsigned long Timer_MSB16 = 0;
-  unsigned long long int GDC_timestamp = 0;  // 48-bit
-
-  // main loop
-  for (auto i = raw_bytes.begin(); i + 8 < raw_bytes.end(); i += 8) {
-    const char *char_array = &(*i);
-
-    // locate the data packet header
-    if (char_array[0] == 'T' && char_array[1] == 'P' && char_array[2] == 'X') {
-      // get the size of the data packet
-      data_packet_size = ((0xff & char_array[7]) << 8) | (0xff & char_array[6]);
-      data_packet_num =
-          data_packet_size >> 3;  // every 8 (2^3) bytes is a data packet
-      // get chip layout type
-      chip_layout_type = static_cast<int>(char_array[4]);
-
-      // processing each data packet
-      for (auto j = 0; j < data_packet_num; ++j) {
-        if (i + 8 > raw_bytes.end()) {
-          continue;
-        }
-
-        i = std::next(i, 8);  // move the iterator to the next data packet
-        char_array = &(*i);
-
-        // extract the data from the data packet
-        if (char_array[7] == 0x6F) {
-          // TDC data packets
-          tdclast = (unsigned long *)(&char_array[0]);
-          mytdc = (((*tdclast) >> 12) &
-                   0xFFFFFFFF);  // rick: 0x3fffffff, get 32-bit tdc
-          TDC_LSB32 = GDC_timestamp & 0xFFFFFFFF;
-          TDC_MSB16 = (GDC_timestamp >> 32) & 0xFFFF;
-          if (mytdc < TDC_LSB32) {
-            TDC_MSB16++;
-          }
-          TDC_timestamp = (TDC_MSB16 << 32) & 0xFFFF00000000;
-          TDC_timestamp = TDC_timestamp | mytdc;
-        } else if ((char_array[7] & 0xF0) == 0x40) {
-          // GDC data packet
-          gdclast = (unsigned long *)(&char_array[0]);
-          mygdc = (((*gdclast) >> 16) & 0xFFFFFFFFFFF);
-          if (((mygdc >> 40) & 0xF) == 0x4) {
-            Timer_LSB32 = mygdc & 0xFFFFFFFF;  // 32-bit
-          } else if (((mygdc >> 40) & 0xF) == 0x5) {
-            Timer_MSB16 = mygdc & 0xFFFF;  // 16-bit
-            GDC_timestamp = Timer_MSB16;
-            GDC_timestamp = (GDC_timestamp << 32) & 0xFFFF00000000;
-            GDC_timestamp = GDC_timestamp | Timer_LSB32;
-          }
-        } else if ((char_array[7] & 0xF0) == 0xb0) {
-          // Process the data into hit
-          hits.emplace_back(char_array, TDC_timestamp, GDC_timestamp,
-                            chip_layout_type);
-        }
-      }
-    }
-  }
-  // Return the hits
+  hits.reserve(raw_bytes.size() / 16);  // guess: a hit every other packet
+
+  unsigned long tdc_timestamp = 0;
+  unsigned long long gdc_timestamp = 0;
+  unsigned long timer_lsb32 = 0;
+  forEachBatch(raw_bytes, [&](std::size_t index, int num_packets,
+                               int chip_layout_type) {
+    forEachPacket(raw_bytes, index, num_packets, [&](const char *packet) {
+      processPacket(packet, chip_layout_type, tdc_timestamp, gdc_timestamp,
+                    timer_lsb32, true, hits);
+    });
+  });
+
   return hits;
 }
 
@@ -5,6 +5,7 @@
 
 #include "centroid.h"
 #include "fastgaussian.h"
+#include "tpx3.h"
 
 std::random_device rd;
 std::mt19937 gen(rd());
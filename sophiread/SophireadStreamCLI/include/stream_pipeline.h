@@ -0,0 +1,173 @@
+/**
+ * @file stream_pipeline.h
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief Slabs, chip queues and reordering of the SophireadStream pipeline
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+#include "ring_buffer.h"
+#include "tpx3_fast.h"
+
+// Hits of different chips never belong to the same neutron, so each chip of
+// the quad is clustered on its own; chip ids past the quad share the queues
+constexpr size_t kChipQueues = 4;
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief A block of whole batches on its way through the pipeline.
+ *
+ * The slabs are allocated once and recycled, the buffers keep their capacity
+ * from one block to the next.
+ */
+struct StreamSlab {
+  uint64_t sequence = 0;  // position of the block in the input
+  std::vector<char> raw;
+  std::vector<TPX3> batches;
+  // indices of the batches of each chip queue, in input order
+  std::array<std::vector<size_t>, kChipQueues> chip_batches;
+  std::atomic<size_t> pending_chips{0};  // chip parts still being clustered
+  // when the slab was read, queued for clustering and fully clustered
+  Clock::time_point read_at, queued_at, clustered_at;
+};
+
+/**
+ * @brief The slabs and the rings handing them from stage to stage.
+ *
+ * free -> reader (batches and timestamps) -> one part per chip queue ->
+ * clustering workers -> done -> writer (outputs, in input order) -> free.
+ * Each worker takes the parts of its own chip first and steals from the
+ * other queues when its own is empty; the semaphore counts the parts waiting
+ * in all the queues, so an idle worker sleeps until any of them has work.
+ * The worker finishing the last part of a slab hands it to the writer.
+ *
+ * A failing stage closes every ring so that the others stop.
+ */
+struct StreamPipeline {
+  StreamPipeline(size_t num_slabs, size_t num_workers)
+      : slabs(num_slabs),
+        free_slabs(num_slabs),
+        done_slabs(num_slabs),
+        num_workers(num_workers) {
+    for (size_t i = 0; i < num_slabs; ++i) free_slabs.tryPush(i);
+    // a slab has at most one part per queue, pushes never block
+    for (auto& queue : chip_queues) {
+      queue = std::make_unique<RingBuffer<size_t>>(num_slabs);
+    }
+  }
+
+  // Queue the chip parts of a slab, false once the pipeline stopped
+  bool pushParts(size_t index) {
+    StreamSlab& slab = slabs[index];
+    size_t parts = 0;
+    for (const auto& batches : slab.chip_batches) parts += !batches.empty();
+    slab.queued_at = Clock::now();
+    if (parts == 0) {
+      slab.clustered_at = slab.queued_at;
+      return done_slabs.push(index);
+    }
+
+    slab.pending_chips = parts;
+    for (size_t chip = 0; chip < kChipQueues; ++chip) {
+      if (slab.chip_batches[chip].empty()) continue;
+      if (!chip_queues[chip]->push(index)) return false;
+      queued_parts.release();
+    }
+    return true;
+  }
+
+  // Wait for a part, home queue first; false when there is no more work
+  bool takePart(size_t home, size_t& index, size_t& chip) {
+    while (true) {
+      queued_parts.acquire();
+      if (stopped) return false;
+      // NOTE: read before the scan, every part is queued once this is set
+      const bool finished = reading_done;
+      for (size_t i = 0; i < kChipQueues; ++i) {
+        chip = (home + i) % kChipQueues;
+        if (chip_queues[chip]->tryPop(index)) {
+          if (i > 0) ++stolen_parts;
+          return true;
+        }
+      }
+      // the permits left once the reader is done are one per worker
+      if (finished) return false;
+      queued_parts.release();
+      std::this_thread::yield();
+    }
+  }
+
+  void finishReading() {
+    reading_done = true;
+    queued_parts.release(num_workers);
+  }
+
+  void fail(std::exception_ptr error) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!first_error) first_error = error;
+    }
+    stopped = true;
+    free_slabs.close();
+    for (auto& queue : chip_queues) queue->close();
+    done_slabs.close();
+    queued_parts.release(num_workers);
+  }
+  void rethrow() {
+    if (first_error) std::rethrow_exception(first_error);
+  }
+
+  std::vector<StreamSlab> slabs;
+  RingBuffer<size_t> free_slabs;
+  std::array<std::unique_ptr<RingBuffer<size_t>>, kChipQueues> chip_queues;
+  RingBuffer<size_t> done_slabs;
+  std::counting_semaphore<> queued_parts{0};
+  const size_t num_workers;
+  std::atomic<bool> reading_done{false};
+  std::atomic<bool> stopped{false};
+  std::atomic<uint64_t> stolen_parts{0};
+  std::mutex mutex;
+  std::exception_ptr first_error;
+};
+
+/**
+ * @brief Puts the slabs finished out of order back in input order for the
+ * writer.
+ */
+class SlabReorder {
+ public:
+  // Hold a finished slab until the slabs before it are out
+  void add(uint64_t sequence, size_t index) {
+    m_ready.emplace(sequence, index);
+  }
+  // The next slab in input order, false while it is not finished
+  bool next(size_t& index) {
+    if (m_ready.empty() || m_ready.begin()->first != m_next) return false;
+    index = m_ready.begin()->second;
+    m_ready.erase(m_ready.begin());
+    ++m_next;
+    return true;
+  }
+  size_t held() const { return m_ready.size(); }
+
+ private:
+  std::map<uint64_t, size_t> m_ready;  // sequence -> slab
+  uint64_t m_next = 0;
+};
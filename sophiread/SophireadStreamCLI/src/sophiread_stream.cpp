@@ -1,191 +1,675 @@
 /**
- * @brief CLI demo case for using the streaming API to process raw data.
+ * @file sophiread_stream.cpp
+ * @author Chen Zhang (zhangc@ornl.gov)
+ * @brief CLI for reducing raw data as it streams in, on a pipeline of
+ * preallocated slabs handed between threads through lock-free rings.
+ * @version 0.1
+ * @date 2026-10-18
  *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
  */
-#include <readerwriterqueue.h>
+#include <H5Epublic.h>
+#include <spdlog/spdlog.h>
+#include <unistd.h>
 
-#include <fstream>
-#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <string>
 #include <thread>
 #include <vector>
 
 #include "abs.h"
-#include "dbscan.h"
-#include "tpx3.h"
+#include "async_writer.h"
+#include "disk_io.h"
+#include "event_store.h"
+#include "hdf5_appender.h"
+#include "json_config_parser.h"
+#include "live_image.h"
+#include "sophiread_core.h"
+#include "stream_pipeline.h"
+#include "tpx3_fast.h"
+#include "tpx3_reader.h"
+#include "user_config.h"
 
-moodycamel::BlockingReaderWriterQueue<Hit> q_hits;
-bool done = false;
-const int batch_size = 10000;
-std::vector<NeutronEvent> neutron_events;
+namespace {
+
+// Live image frames are published at most this often, or once per latency
+// bound in live mode when that is shorter
+constexpr std::chrono::milliseconds kPublishInterval(100);
 
 /**
- * @brief Cluster the batch of hits into neutron events
- *
- * @param batch
+ * @brief Running latency of one pipeline stage.
  */
-void process_batch(const std::vector<Hit> &batch) {
-  ClusteringAlgorithm *alg;
-  alg = new ABS(5.0, 1, 75);         // select clustering algorithm
-  alg->set_method("fast_gaussian");  // select peak fitting method
-  alg->fit(batch);
-  std::vector<NeutronEvent> events = alg->get_events(batch);
-  for (auto event : events) {
-    neutron_events.push_back(event);
+struct StageLatency {
+  void add(Clock::duration latency) {
+    const double ms =
+        std::chrono::duration<double, std::milli>(latency).count();
+    ++count;
+    total_ms += ms;
+    max_ms = std::max(max_ms, ms);
   }
-}
+  double meanMs() const { return count > 0 ? total_ms / count : 0; }
+
+  uint64_t count = 0;
+  double total_ms = 0;
+  double max_ms = 0;
+};
 
 /**
- * @brief Read the raw data from tpx3 file, convert to hit and enqueue to queue
+ * @brief Cut the input into slabs of whole batches, time-stamp them and
+ * split them by chip.
+ *
+ * @note The timestamps carry over from batch to batch, so this stage is
+ *       sequential; the partial batch at the end of a read is moved to the
+ *       front of the next slab.
  *
- * @param filename
+ * @param[in] reader
+ * @param[in] block_size: bytes read per slab
+ * @param[in] use_gdc
+ * @param[in,out] pipeline
  */
-void reader(std::string filename) {
-  // local vars
-  int chip_layout_type = 0;
-  int data_packet_size = 0;
-  int data_packet_num = 0;
-
-  // for TDC information
-  unsigned long *tdclast;
-  unsigned long long mytdc = 0;
-  unsigned long TDC_MSB16 = 0;
-  unsigned long TDC_LSB32 = 0;
-  unsigned long TDC_timestamp = 0;
-
-  // for GDC information
-  unsigned long *gdclast;
-  unsigned long long mygdc = 0;
-  unsigned long Timer_LSB32 = 0;
-  unsigned long Timer_MSB16 = 0;
-  unsigned long long int GDC_timestamp = 0;  // 48-bit
-
-  // sanity check
-  std::ifstream file(filename, std::ios::binary);
-  if (!file.is_open()) {
-    std::cerr << "Failed to open file: " << filename << std::endl;
-    return;
-  }
+void readSlabs(ITPX3Reader& reader, size_t block_size, bool use_gdc,
+               StreamPipeline& pipeline) {
+  unsigned long tdc_timestamp = 0;
+  unsigned long long gdc_timestamp = 0;
+  unsigned long timer_lsb32 = 0;
+  std::vector<char> pending;
+  uint64_t sequence = 0;
 
-  std::cout << "Reading file: " << filename << std::endl;
-
-  while (!file.eof()) {
-    unsigned char buffer[8];
-    file.read(reinterpret_cast<char *>(buffer), 8);
-
-    // locate the data packet header
-    if (buffer[0] == 'T' && buffer[1] == 'P' && buffer[2] == 'X') {
-      // chip type
-      chip_layout_type = (int)buffer[4];
-      // read the data packet size
-      data_packet_size = ((0xff & buffer[7]) << 8) | (0xff & buffer[6]);
-      data_packet_num = data_packet_size >> 3;
-
-      // process each data section
-      for (auto j = 0; j < data_packet_num; j++) {
-        // read the data packet
-        unsigned char char_array[8];
-        file.read(reinterpret_cast<char *>(char_array), 8);
-        // extract the data from the data packet
-        if (char_array[7] == 0x6F) {
-          // TDC data packets
-          tdclast = (unsigned long *)(&char_array[0]);
-          mytdc = (((*tdclast) >> 12) &
-                   0xFFFFFFFF);  // rick: 0x3fffffff, get 32-bit tdc
-          TDC_LSB32 = GDC_timestamp & 0xFFFFFFFF;
-          TDC_MSB16 = (GDC_timestamp >> 32) & 0xFFFF;
-          if (mytdc < TDC_LSB32) {
-            TDC_MSB16++;
-          }
-          TDC_timestamp = (TDC_MSB16 << 32) & 0xFFFF00000000;
-          TDC_timestamp = TDC_timestamp | mytdc;
-          // std::cout << "TDC_timestamp: " << std::setprecision(15) <<
-          // TDC_timestamp*25E-9 <<std::endl;
-
-        } else if ((char_array[7] & 0xF0) == 0x40) {
-          // GDC data packet
-          gdclast = (unsigned long *)(&char_array[0]);
-          mygdc = (((*gdclast) >> 16) & 0xFFFFFFFFFFF);
-          if (((mygdc >> 40) & 0xF) == 0x4) {
-            Timer_LSB32 = mygdc & 0xFFFFFFFF;  // 32-bit
-          } else if (((mygdc >> 40) & 0xF) == 0x5) {
-            Timer_MSB16 = mygdc & 0xFFFF;  // 16-bit
-            GDC_timestamp = Timer_MSB16;
-            GDC_timestamp = (GDC_timestamp << 32) & 0xFFFF00000000;
-            GDC_timestamp = GDC_timestamp | Timer_LSB32;
-            // std::cout << "GDC_timestamp: " << std::setprecision(15) <<
-            // GDC_timestamp*25E-9 << std::endl;
-          }
-        } else if ((char_array[7] & 0xF0) == 0xb0) {
-          // Process the data into hit
-          auto data_packet = std::vector<char>(
-              char_array, char_array + sizeof(char_array) / sizeof(char));
-          auto hit = packetToHit(data_packet, TDC_timestamp, GDC_timestamp,
-                                 chip_layout_type);
-          // std::cout << "Hits: " << hit.getX() << " " << hit.getY() << " " <<
-          // hit.getTOF_ns()*1E-6 << " " << hit.getSPIDERTIME_ns()*1E-9 <<
-          // std::endl;
-          q_hits.enqueue(hit);
-        }
-        //
+  bool done = false;
+  size_t index;
+  while (!done && pipeline.free_slabs.pop(index)) {
+    StreamSlab& slab = pipeline.slabs[index];
+    slab.raw.assign(pending.begin(), pending.end());
+    const size_t appended = reader.readChunkInto(block_size, slab.raw);
+    slab.read_at = Clock::now();
+    done = appended == 0 || reader.isEOF();
+
+    const size_t complete =
+        done ? slab.raw.size()
+             : findLastCompleteTPX3Batch(slab.raw.data(), slab.raw.size());
+    pending.assign(slab.raw.begin() + complete, slab.raw.end());
+    slab.raw.resize(complete);
+
+    slab.batches = findTPX3H(slab.raw);
+    for (auto& batches : slab.chip_batches) batches.clear();
+    for (size_t i = 0; i < slab.batches.size(); ++i) {
+      auto& batch = slab.batches[i];
+      if (use_gdc) {
+        updateTimestamp(batch, slab.raw, tdc_timestamp, gdc_timestamp,
+                        timer_lsb32);
+      } else {
+        updateTimestamp(batch, slab.raw, tdc_timestamp);
       }
-      // END OF PROCESS DATA SECTION
+      slab.chip_batches[batch.chip_layout_type % kChipQueues].push_back(i);
     }
+    slab.sequence = sequence++;
+    if (!pipeline.pushParts(index)) break;
   }
-  done = true;
+  pipeline.finishReading();
 }
 
 /**
- * @brief Process the data from queue in batches (concurrently)
+ * @brief Extract the hits of chip parts and cluster them into neutrons.
  *
+ * @param[in] config
+ * @param[in] use_gdc
+ * @param[in] home: chip queue served first
+ * @param[in,out] pipeline
  */
-void processor() {
-  std::vector<Hit> batch;
-  while (!done) {
-    Hit hit(0, 0, 0, 0, 0, 0, 0);
-    if (q_hits.try_dequeue(hit)) {
-      batch.push_back(hit);
-      if (batch.size() >= batch_size) {
-        // process data
-        process_batch(batch);
-        batch.clear();
+void clusterChips(const IConfig& config, bool use_gdc, size_t home,
+                  StreamPipeline& pipeline) {
+  auto abs_alg = std::make_unique<ABS>(config.getABSRadius(),
+                                       config.getABSMinClusterSize(),
+                                       config.getABSSpiderTimeRange());
+  size_t index, chip;
+  while (pipeline.takePart(home, index, chip)) {
+    StreamSlab& slab = pipeline.slabs[index];
+    for (const size_t i : slab.chip_batches[chip]) {
+      auto& batch = slab.batches[i];
+      if (use_gdc) {
+        extractHits(batch, slab.raw);
+      } else {
+        extractHitsTDC(batch, slab.raw);
       }
+      abs_alg->reset();
+      abs_alg->set_method("centroid");
+      abs_alg->fit(batch.hits);
+      batch.neutrons = abs_alg->get_events(batch.hits);
+    }
+    if (--slab.pending_chips > 0) continue;
+    slab.clustered_at = Clock::now();
+    if (!pipeline.done_slabs.push(index)) break;
+  }
+}
+
+}  // namespace
+
+struct ProgramOptions {
+  std::string input_tpx3;
+  std::string output_hits;
+  std::string output_events;
+  std::string output_event_store;  // columnar event store directory
+  std::string config_file;
+  std::string output_tof_imaging;
+  std::string tof_filename_base = "tof_image";
+  std::string tof_mode = "neutron";
+  std::string spectra_filen = "Spectra";
+  std::string timing_mode = "tdc";  // Default is TDC mode
+  std::string tof_format = "tiff";  // tiff, bigtiff or hdf5
+  std::string compression = "deflate";
+  std::string hdf5_schema = "legacy";  // legacy or compact
+  size_t chunk_rows = 0;  // rows per HDF5 chunk, default: 1M, 64K when live
+  size_t block_size = 16 * 1024 * 1024;  // bytes per slab
+  size_t num_workers = std::max(1u, std::thread::hardware_concurrency());
+  size_t num_slabs = 0;  // default: 2 per worker + 2
+  unsigned max_latency_ms = 0;  // 0: throughput mode, no latency bound
+  std::string live_image;       // shared memory name, empty: not published
+  bool debug_logging = false;
+  bool verbose = false;
+};
+
+/**
+ * @brief Print usage information.
+ *
+ * @param[in] program_name
+ */
+void print_usage(const char* program_name) {
+  spdlog::info(
+      "Usage: {} -i <input_tpx3> [-H <output_hits>] [-E <output_events>] [-e "
+      "<event_store>] [-u <config_file>] [-T <tof_imaging_folder>] [-f "
+      "<tof_filename_base>] [-m <tof_mode>] [-t <timing_mode>] [-s "
+      "<spectra_filename>] [-F <tof_format>] [-z <compression>] [-S "
+      "<hdf5_schema>] [-R <chunk_rows>] [-b <block_size>] [-j <workers>] [-n "
+      "<slabs>] [-L <max_latency>] [-P <shm_name>] [-d] [-v]",
+      program_name);
+  spdlog::info("Options:");
+  spdlog::info(
+      "  -i <input_tpx3>          Input TPX3 file, or a stream: '-' (stdin), "
+      "a FIFO, tcp://[listen@]host:port or unix://[listen@]path");
+  spdlog::info("  -H <output_hits>         Output hits HDF5 file");
+  spdlog::info("  -E <output_events>       Output events HDF5 file");
+  spdlog::info(
+      "  -e <event_store>         Output columnar event store directory");
+  spdlog::info(
+      "  -u <config_file>         User configuration JSON file (optional)");
+  spdlog::info(
+      "  -T <tof_imaging_folder>  Output folder for TOF images (optional)");
+  spdlog::info(
+      "  -f <tof_filename_base>   Base name for TOF files (default: "
+      "tof_image)");
+  spdlog::info(
+      "  -m <tof_mode>            TOF mode: 'hit' or 'neutron' (default: "
+      "neutron)");
+  spdlog::info(
+      "  -t <timing_mode>         Timing mode: 'gdc' or 'tdc' (default: tdc)");
+  spdlog::info(
+      "  -s <spectra_filename>    Output filename for spectra (default: "
+      "Spectra)");
+  spdlog::info(
+      "  -F <tof_format>          TOF imaging format: 'tiff', 'bigtiff' or "
+      "'hdf5' (default: tiff)");
+  spdlog::info(
+      "  -z <compression>         Compression: 'none', 'deflate', 'lz4' or "
+      "'zstd' (default: deflate)");
+  spdlog::info(
+      "  -S <hdf5_schema>         Hits/events HDF5 schema: 'legacy' or "
+      "'compact' (default: legacy)");
+  spdlog::info(
+      "  -R <chunk_rows>          Rows per hits/events HDF5 chunk (default: "
+      "1048576, 65536 in live mode)");
+  spdlog::info(
+      "  -b <block_size>          MB read into each slab (default: 16)");
+  spdlog::info(
+      "  -j <workers>             Clustering threads, spread over the chips "
+      "(default: number of cores)");
+  spdlog::info(
+      "  -n <slabs>               Slabs in flight (default: 2 per worker + "
+      "2)");
+  spdlog::info(
+      "  -L <max_latency>         Live mode: hand out partial slabs and flush "
+      "the outputs within this many ms (default: 0, off)");
+  spdlog::info(
+      "  -P <shm_name>            Publish the running image, spectrum and "
+      "counters to this POSIX shared memory for viewers, e.g. /sophiread");
+  spdlog::info("  -d                       Enable debug logging");
+  spdlog::info("  -v                       Enable verbose logging");
+}
+
+/**
+ * @brief Parse command line arguments.
+ *
+ * @param[in] argc
+ * @param[in] argv
+ */
+ProgramOptions parse_arguments(int argc, char* argv[]) {
+  ProgramOptions options;
+  int opt;
+
+  while ((opt = getopt(argc, argv,
+                       "i:H:E:e:u:T:f:m:t:s:F:z:S:R:b:j:n:L:P:dv")) != -1) {
+    switch (opt) {
+      case 'i':
+        options.input_tpx3 = optarg;
+        break;
+      case 'H':
+        options.output_hits = optarg;
+        break;
+      case 'E':
+        options.output_events = optarg;
+        break;
+      case 'e':
+        options.output_event_store = optarg;
+        break;
+      case 'u':
+        options.config_file = optarg;
+        break;
+      case 'T':
+        options.output_tof_imaging = optarg;
+        break;
+      case 'f':
+        options.tof_filename_base = optarg;
+        break;
+      case 'm':
+        options.tof_mode = optarg;
+        break;
+      case 't':
+        options.timing_mode = optarg;
+        break;
+      case 's':
+        options.spectra_filen = optarg;
+        break;
+      case 'F':
+        options.tof_format = optarg;
+        break;
+      case 'z':
+        options.compression = optarg;
+        break;
+      case 'S':
+        options.hdf5_schema = optarg;
+        break;
+      case 'R':
+        options.chunk_rows = static_cast<size_t>(std::stoull(optarg));
+        break;
+      case 'b':
+        options.block_size = static_cast<size_t>(std::stoull(optarg)) * 1024 *
+                             1024;  // Convert MB to bytes
+        break;
+      case 'j':
+        options.num_workers = std::stoul(optarg);
+        break;
+      case 'n':
+        options.num_slabs = std::stoul(optarg);
+        break;
+      case 'L':
+        options.max_latency_ms = std::stoul(optarg);
+        break;
+      case 'P':
+        options.live_image = optarg;
+        break;
+      case 'd':
+        options.debug_logging = true;
+        break;
+      case 'v':
+        options.verbose = true;
+        break;
+      default:
+        print_usage(argv[0]);
+        throw std::runtime_error(std::string("Invalid argument: ") +
+                                 static_cast<char>(optopt));
     }
   }
 
-  // process remaining data
-  batch.clear();
-  while (q_hits.size_approx() > 0) {
-    Hit hit(0, 0, 0, 0, 0, 0, 0);
-    q_hits.wait_dequeue(hit);
-    batch.push_back(hit);
+  // Validate required arguments
+  if (options.input_tpx3.empty()) {
+    print_usage(argv[0]);
+    throw std::runtime_error("Missing required arguments");
   }
-  if (batch.size() > 0) {
-    process_batch(batch);
+
+  // Validate TOF mode
+  if (options.tof_mode != "hit" && options.tof_mode != "neutron") {
+    throw std::runtime_error("Invalid TOF mode. Use 'hit' or 'neutron'.");
   }
-}
 
-int main(int argc, char *argv[]) {
-  if (argc != 2) {
-    std::cerr << "Usage: ./SophireadStream <filename>" << std::endl;
-    return 1;
+  // Validate timing mode
+  if (options.timing_mode != "gdc" && options.timing_mode != "tdc") {
+    throw std::runtime_error("Invalid timing mode. Use 'gdc' or 'tdc'.");
+  }
+
+  // Validate TOF imaging format
+  if (options.tof_format != "tiff" && options.tof_format != "bigtiff" &&
+      options.tof_format != "hdf5") {
+    throw std::runtime_error(
+        "Invalid TOF imaging format. Use 'tiff', 'bigtiff' or 'hdf5'.");
+  }
+
+  // Validate compression and HDF5 schema (throw on unknown names)
+  parseH5Compression(options.compression);
+  parseHDF5Schema(options.hdf5_schema);
+
+  // Validate the pipeline
+  if (options.block_size == 0) {
+    throw std::runtime_error("Block size must be at least 1 MB.");
+  }
+  if (options.num_workers == 0) {
+    throw std::runtime_error("Number of workers must be at least 1.");
   }
+  if (options.num_slabs == 0) options.num_slabs = 2 * options.num_workers + 2;
+  if (options.num_slabs < 2) {
+    throw std::runtime_error("Number of slabs must be at least 2.");
+  }
+
+  // NOTE: live mode flushes a partial chunk per slab, and a flush compresses
+  //       the whole chunk
+  if (options.chunk_rows == 0) {
+    options.chunk_rows = options.max_latency_ms > 0 ? 1 << 16 : 1 << 20;
+  }
+
+  return options;
+}
 
-  std::string filename = argv[1];
+/**
+ * @brief Main function.
+ *
+ * @param[in] argc
+ * @param[in] argv
+ * @return int
+ */
+int main(int argc, char* argv[]) {
+  try {
+    // Turn off HDF5 error printing
+    // NOTE: we handle the errors ourselves
+    H5Eset_auto(H5E_DEFAULT, NULL, NULL);
+
+    ProgramOptions options = parse_arguments(argc, argv);
+
+    // Set logging level based on debug and verbose flags
+    if (options.debug_logging) {
+      spdlog::set_level(spdlog::level::debug);
+      spdlog::debug("Debug logging enabled");
+    } else if (options.verbose) {
+      spdlog::set_level(spdlog::level::info);
+    } else {
+      spdlog::set_level(spdlog::level::warn);
+    }
+
+    spdlog::info("Input: {}", options.input_tpx3);
+    spdlog::info("Timing mode: {}", options.timing_mode);
+    spdlog::info("Pipeline: {} MB slabs, {} slabs, {} workers",
+                 options.block_size / (1024 * 1024), options.num_slabs,
+                 options.num_workers);
+    if (options.max_latency_ms > 0) {
+      spdlog::info("Live mode: at most {} ms from read to output",
+                   options.max_latency_ms);
+    }
+
+    // Load configuration
+    std::unique_ptr<IConfig> config;
+    if (!options.config_file.empty()) {
+      std::string extension =
+          std::filesystem::path(options.config_file).extension().string();
+      if (extension == ".json") {
+        config = std::make_unique<JSONConfigParser>(
+            JSONConfigParser::fromFile(options.config_file));
+      } else {
+        spdlog::warn(
+            "Deprecated configuration format detected. Please switch to JSON "
+            "format.");
+        config = std::make_unique<UserConfig>(
+            parseUserDefinedConfigurationFile(options.config_file));
+      }
+    } else {
+      config =
+          std::make_unique<JSONConfigParser>(JSONConfigParser::createDefault());
+    }
+    spdlog::info("Configuration: {}", config->toString());
+
+    // Outputs, written by the main thread in input order
+    HDF5AppenderOptions appender_options;
+    appender_options.chunk_rows = options.chunk_rows;
+    appender_options.compression = parseH5Compression(options.compression);
+    const HDF5Schema hdf5_schema = parseHDF5Schema(options.hdf5_schema);
+    // NOTE: the files are constructed in place, H5File has no assignment
+    std::unique_ptr<H5::H5File> hitsFile, eventsFile;
+    std::unique_ptr<HitsHDF5Appender> hitsAppender;
+    std::unique_ptr<NeutronsHDF5Appender> neutronsAppender;
+    if (!options.output_hits.empty()) {
+      hitsFile =
+          std::make_unique<H5::H5File>(createHDF5File(options.output_hits));
+      hitsAppender = std::make_unique<HitsHDF5Appender>(
+          *hitsFile, hdf5_schema, appender_options);
+    }
+    if (!options.output_events.empty()) {
+      eventsFile =
+          std::make_unique<H5::H5File>(createHDF5File(options.output_events));
+      neutronsAppender = std::make_unique<NeutronsHDF5Appender>(
+          *eventsFile, hdf5_schema, appender_options);
+    }
+    std::unique_ptr<EventStoreWriter> eventStore;
+    if (!options.output_event_store.empty()) {
+      eventStore = std::make_unique<EventStoreWriter>(
+          options.output_event_store);
+    }
+    std::vector<std::vector<std::vector<unsigned int>>> tof_images;
+    const bool needs_tof_images =
+        !options.output_tof_imaging.empty() || !options.spectra_filen.empty();
+    if (needs_tof_images) {
+      tof_images = sophiread::initializeTOFImages(config->getSuperResolution(),
+                                                  config->getTOFBinEdges());
+    }
+    std::unique_ptr<LiveImagePublisher> liveImage;
+    if (!options.live_image.empty()) {
+      const auto dim =
+          static_cast<uint32_t>(517 * config->getSuperResolution());
+      liveImage = std::make_unique<LiveImagePublisher>(
+          options.live_image, dim, dim, config->getTOFBinEdges().size() - 1);
+    }
+
+    auto reader = openTPX3Reader(options.input_tpx3);
+    const std::chrono::milliseconds max_latency(options.max_latency_ms);
+    reader->setMaxLatency(max_latency);
+    const bool use_gdc = options.timing_mode == "gdc";
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Reader and clustering stages
+    StreamPipeline pipeline(options.num_slabs, options.num_workers);
+    const auto guarded = [&pipeline](auto&& stage) {
+      try {
+        stage();
+      } catch (...) {
+        pipeline.fail(std::current_exception());
+      }
+    };
+    std::thread reader_thread([&]() {
+      guarded([&]() {
+        readSlabs(*reader, options.block_size, use_gdc, pipeline);
+      });
+    });
+    std::atomic<size_t> active_workers{options.num_workers};
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < options.num_workers; ++i) {
+      workers.emplace_back([&, i]() {
+        guarded([&]() {
+          clusterChips(*config, use_gdc, i % kChipQueues, pipeline);
+        });
+        // the last worker out tells the writer there is nothing more
+        if (--active_workers == 0) pipeline.done_slabs.close();
+      });
+    }
+
+    // Writer stage, slabs are put back in input order
+    uint64_t totalHits = 0;
+    uint64_t totalNeutrons = 0;
+    uint64_t totalBytes = 0;
+    StageLatency split_latency, cluster_latency, write_latency, total_latency;
+    uint64_t late_slabs = 0;
+    const auto publish_interval =
+        max_latency.count() > 0 ? std::min(max_latency, kPublishInterval)
+                                : kPublishInterval;
+    const auto setLiveCounters = [&]() {
+      auto& counters = liveImage->counters();
+      counters.hits = totalHits;
+      counters.neutrons = totalNeutrons;
+      counters.bytes = totalBytes;
+      counters.elapsed = std::chrono::duration<double>(
+                             std::chrono::high_resolution_clock::now() - start)
+                             .count();
+    };
+    guarded([&]() {
+      auto flushed_at = Clock::now();
+      auto published_at = Clock::now();
+      SlabReorder reorder;
+      size_t index;
+      while (pipeline.done_slabs.pop(index)) {
+        reorder.add(pipeline.slabs[index].sequence, index);
+        size_t next;
+        while (reorder.next(next)) {
+          StreamSlab& slab = pipeline.slabs[next];
+          for (const auto& batch : slab.batches) {
+            if (hitsAppender) hitsAppender->append(batch.hits);
+            if (neutronsAppender) neutronsAppender->append(batch.neutrons);
+            if (eventStore) eventStore->append(batch.neutrons);
+            if (needs_tof_images) {
+              sophiread::updateTOFImages(
+                  tof_images, batch, config->getSuperResolution(),
+                  config->getTOFBinEdges(), options.tof_mode);
+            }
+            if (liveImage) {
+              sophiread::updateLiveImage(*liveImage, batch,
+                                         config->getSuperResolution(),
+                                         config->getTOFBinEdges(),
+                                         options.tof_mode);
+            }
+            totalHits += batch.hits.size();
+            totalNeutrons += batch.neutrons.size();
+          }
+          totalBytes += slab.raw.size();
+          // in live mode the outputs are flushed once the writer caught up,
+          // or when a backlog builds up, once per latency bound
+          if (max_latency.count() > 0 &&
+              (pipeline.done_slabs.sizeApprox() == 0 ||
+               Clock::now() - flushed_at >= max_latency)) {
+            if (hitsAppender) hitsAppender->flush();
+            if (neutronsAppender) neutronsAppender->flush();
+            if (eventStore) eventStore->flush();
+            flushed_at = Clock::now();
+          }
+
+          if (liveImage && Clock::now() - published_at >= publish_interval) {
+            setLiveCounters();
+            liveImage->publish();
+            published_at = Clock::now();
+          }
 
-  std::thread reader_thread(reader, filename);
-  std::thread processor_thread(processor);
+          const auto written_at = Clock::now();
+          split_latency.add(slab.queued_at - slab.read_at);
+          cluster_latency.add(slab.clustered_at - slab.queued_at);
+          write_latency.add(written_at - slab.clustered_at);
+          total_latency.add(written_at - slab.read_at);
+          if (max_latency.count() > 0 &&
+              written_at - slab.read_at > max_latency) {
+            ++late_slabs;
+          }
+          spdlog::info(
+              "Slab {}: {:.2f} MB reduced, {} hits, {} neutrons, {:.1f} ms",
+              slab.sequence, totalBytes / 1048576.0, totalHits, totalNeutrons,
+              std::chrono::duration<double, std::milli>(written_at -
+                                                        slab.read_at)
+                  .count());
+          slab.batches.clear();
+          pipeline.free_slabs.push(next);
+        }
+      }
+    });
+    // NOTE: the reader may be blocked on a free slab once the writer is done
+    pipeline.free_slabs.close();
+    reader_thread.join();
+    for (auto& worker : workers) worker.join();
+    pipeline.rethrow();
 
-  reader_thread.join();
-  processor_thread.join();
+    // Close HDF5 files
+    if (hitsAppender) {
+      hitsAppender->close();
+      hitsFile->close();
+    }
+    if (neutronsAppender) {
+      neutronsAppender->close();
+      eventsFile->close();
+    }
+    if (eventStore) {
+      eventStore->close();
+      spdlog::info("Wrote {} events to {}", eventStore->getEvents(),
+                   options.output_event_store);
+    }
 
-  // print out events
-  // for (auto event : neutron_events) {
-  //   std::cout << event.toString() << std::endl;
-  // }
-  std::cout << "Number of events: " << neutron_events.size() << std::endl;
+    auto end = std::chrono::high_resolution_clock::now();
+    const double elapsed = std::chrono::duration<double>(end - start).count();
+    if (liveImage) {
+      setLiveCounters();
+      liveImage->finish();
+      spdlog::info("Published {} live image frames",
+                   liveImage->counters().frame);
+    }
+    spdlog::info("Total processing time: {} s", elapsed);
+    spdlog::info("Throughput: {:.1f} MB/s",
+                 elapsed > 0 ? totalBytes / 1048576.0 / elapsed : 0.0);
+    spdlog::info("Total hits: {}", totalHits);
+    spdlog::info("Total neutrons: {}", totalNeutrons);
+    spdlog::info("Chip parts stolen by idle workers: {}",
+                 pipeline.stolen_parts.load());
+    // from the end of the read to the outputs, per slab
+    for (const auto& [stage, latency] :
+         {std::pair{"split by chip", &split_latency},
+          {"clustering", &cluster_latency},
+          {"writing", &write_latency},
+          {"total", &total_latency}}) {
+      spdlog::info("Latency of {}: mean {:.1f} ms, max {:.1f} ms", stage,
+                   latency->meanMs(), latency->max_ms);
+    }
+    if (late_slabs > 0) {
+      spdlog::warn("{} of {} slabs took longer than {} ms to reach the outputs",
+                   late_slabs, total_latency.count, options.max_latency_ms);
+    }
 
-  // save events to file
-  saveEventsToHDF5("events_streamed.h5", neutron_events);
+    // Save TOF images and spectra on background I/O threads
+    auto snapshot =
+        std::make_shared<const sophiread::TOFImages>(std::move(tof_images));
+    const std::vector<double> tof_bin_edges = config->getTOFBinEdges();
+    sophiread::AsyncWriter writer(2);
+    if (!options.output_tof_imaging.empty()) {
+      if (options.tof_format == "bigtiff") {
+        writer.submit([&options, snapshot, tof_bin_edges]() {
+          sophiread::timedSaveTOFImagingToBigTIFF(
+              options.output_tof_imaging, *snapshot, tof_bin_edges,
+              options.tof_filename_base, options.compression);
+        });
+      } else if (options.tof_format == "hdf5") {
+        writer.submit([&options, snapshot, tof_bin_edges]() {
+          sophiread::timedSaveTOFImagingToHDF5(
+              options.output_tof_imaging, *snapshot, tof_bin_edges,
+              options.tof_filename_base, options.compression);
+        });
+      } else {
+        writer.submitTOFImagingToTIFF(snapshot, options.output_tof_imaging,
+                                      tof_bin_edges,
+                                      options.tof_filename_base);
+      }
+    }
+    if (!options.spectra_filen.empty()) {
+      writer.submitSpectralFile(snapshot, options.spectra_filen + ".txt",
+                                tof_bin_edges);
+    }
+    writer.flush();
 
+  } catch (const std::exception& e) {
+    spdlog::error("Error: {}", e.what());
+    return 1;
+  }
   return 0;
 }
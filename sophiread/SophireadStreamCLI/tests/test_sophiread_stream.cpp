@@ -0,0 +1,64 @@
+/**
+ * @file: test_sophiread_stream.cpp
+ * @author: Chen Zhang (zhangc@orn.gov)
+ * @brief: End to end test of SophireadStream against Sophiread.
+ * @date: 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "disk_io.h"
+
+namespace fs = std::filesystem;
+
+class SophireadStreamTest : public ::testing::Test {
+ protected:
+  const std::string input = "../data/suann_socket_background_serval32.tpx3";
+  fs::path test_dir = "test_sophiread_stream";
+
+  void SetUp() override { fs::create_directories(test_dir); }
+  void TearDown() override { fs::remove_all(test_dir); }
+
+  static int run(const std::string& command) {
+    return std::system((command + " > /dev/null 2>&1").c_str());
+  }
+};
+
+TEST_F(SophireadStreamTest, MatchesSophireadWithManyWorkersAndSlabs) {
+  // the spectra both CLIs write by default go to the test directory too
+  const std::string spectra = (test_dir / "Spectra").string();
+  const std::string reference = (test_dir / "reference.h5").string();
+  ASSERT_EQ(run(std::string(SOPHIREAD_BIN) + " -i " + input + " -E " +
+                reference + " -s " + spectra),
+            0);
+  const std::vector<Neutron> expected = readNeutronsFromHDF5(reference);
+  ASSERT_GT(expected.size(), 0u);
+
+  // 1 MB slabs cut the file in several, split over more workers than chips
+  for (const char* workers : {"1", "4", "6"}) {
+    SCOPED_TRACE(std::string("workers: ") + workers);
+    const std::string events = (test_dir / "events.h5").string();
+    fs::remove(events);
+    ASSERT_EQ(run(std::string(SOPHIREAD_STREAM_BIN) + " -i " + input +
+                  " -E " + events + " -s " + spectra + " -j " + workers +
+                  " -b 1"),
+              0);
+
+    const std::vector<Neutron> neutrons = readNeutronsFromHDF5(events);
+    ASSERT_EQ(neutrons.size(), expected.size());
+    for (size_t i = 0; i < neutrons.size(); ++i) {
+      ASSERT_EQ(neutrons[i].getX(), expected[i].getX()) << "row " << i;
+      ASSERT_EQ(neutrons[i].getY(), expected[i].getY()) << "row " << i;
+      ASSERT_EQ(neutrons[i].getTOF(), expected[i].getTOF()) << "row " << i;
+      ASSERT_EQ(neutrons[i].getTOT(), expected[i].getTOT()) << "row " << i;
+      ASSERT_EQ(neutrons[i].getNHits(), expected[i].getNHits()) << "row " << i;
+    }
+  }
+}
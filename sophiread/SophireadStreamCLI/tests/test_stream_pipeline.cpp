@@ -0,0 +1,154 @@
+/**
+ * @file: test_stream_pipeline.cpp
+ * @author: Chen Zhang (zhangc@orn.gov)
+ * @brief: Unit tests for the chip queues and reordering of SophireadStream.
+ * @date: 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ * SPDX - License - Identifier: GPL - 3.0 +
+ */
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "stream_pipeline.h"
+
+namespace {
+
+// Queue a slab with the given number of batches per chip queue
+void queueSlab(StreamPipeline& pipeline, uint64_t sequence,
+               const std::array<size_t, kChipQueues>& batches) {
+  size_t index;
+  ASSERT_TRUE(pipeline.free_slabs.pop(index));
+  StreamSlab& slab = pipeline.slabs[index];
+  slab.sequence = sequence;
+  size_t batch = 0;
+  for (size_t chip = 0; chip < kChipQueues; ++chip) {
+    slab.chip_batches[chip].clear();
+    for (size_t i = 0; i < batches[chip]; ++i) {
+      slab.chip_batches[chip].push_back(batch++);
+    }
+  }
+  ASSERT_TRUE(pipeline.pushParts(index));
+}
+
+// Take parts until there is no more work, handing finished slabs on
+size_t serveParts(StreamPipeline& pipeline, size_t home) {
+  size_t parts = 0, index, chip;
+  while (pipeline.takePart(home, index, chip)) {
+    StreamSlab& slab = pipeline.slabs[index];
+    EXPECT_FALSE(slab.chip_batches[chip].empty());
+    // chip 0 is the busy one, its parts are the slow ones
+    if (chip == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+    ++parts;
+    if (--slab.pending_chips == 0) pipeline.done_slabs.push(index);
+  }
+  return parts;
+}
+
+}  // namespace
+
+TEST(StreamPipelineTest, IdleWorkerStealsPartsOfOtherChips) {
+  StreamPipeline pipeline(4, 1);
+  for (uint64_t i = 0; i < 4; ++i) queueSlab(pipeline, i, {3, 0, 0, 0});
+  pipeline.finishReading();
+
+  // the only worker serves chip 2, every part is taken from chip 0
+  EXPECT_EQ(serveParts(pipeline, 2), 4u);
+  EXPECT_EQ(pipeline.stolen_parts, 4u);
+  EXPECT_EQ(pipeline.done_slabs.sizeApprox(), 4u);
+}
+
+TEST(StreamPipelineTest, SlabsWithoutPartsGoStraightToTheWriter) {
+  StreamPipeline pipeline(2, 1);
+  queueSlab(pipeline, 0, {0, 0, 0, 0});
+  size_t index;
+  ASSERT_TRUE(pipeline.done_slabs.tryPop(index));
+  EXPECT_EQ(pipeline.slabs[index].sequence, 0u);
+}
+
+TEST(StreamPipelineTest, UnevenChipsComeOutInInputOrder) {
+  const size_t num_slabs = 6, num_workers = 3, total = 60;
+  StreamPipeline pipeline(num_slabs, num_workers);
+
+  // every slab has chip 0, the other chips only now and then
+  size_t queued_parts = 0;
+  std::thread reader([&]() {
+    for (uint64_t i = 0; i < total; ++i) {
+      const std::array<size_t, kChipQueues> batches = {
+          5, i % 5 == 0 ? 1u : 0u, 0, i % 3 == 0 ? 2u : 0u};
+      for (const size_t n : batches) queued_parts += n > 0;
+      queueSlab(pipeline, i, batches);
+    }
+    pipeline.finishReading();
+  });
+  std::atomic<size_t> served_parts{0};
+  std::atomic<size_t> active_workers{num_workers};
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < num_workers; ++i) {
+    workers.emplace_back([&, i]() {
+      served_parts += serveParts(pipeline, i % kChipQueues);
+      if (--active_workers == 0) pipeline.done_slabs.close();
+    });
+  }
+
+  // the writer gets every slab once, in input order
+  SlabReorder reorder;
+  std::vector<uint64_t> written;
+  size_t index;
+  while (pipeline.done_slabs.pop(index)) {
+    EXPECT_EQ(pipeline.slabs[index].pending_chips, 0u);
+    reorder.add(pipeline.slabs[index].sequence, index);
+    size_t next;
+    while (reorder.next(next)) {
+      written.push_back(pipeline.slabs[next].sequence);
+      pipeline.free_slabs.push(next);
+    }
+  }
+  reader.join();
+  for (auto& worker : workers) worker.join();
+
+  ASSERT_EQ(written.size(), total);
+  for (uint64_t i = 0; i < total; ++i) EXPECT_EQ(written[i], i);
+  EXPECT_EQ(reorder.held(), 0u);
+  EXPECT_EQ(served_parts, queued_parts);
+}
+
+TEST(StreamPipelineTest, ReorderHoldsSlabsUntilTheGapIsFilled) {
+  SlabReorder reorder;
+  size_t index;
+  reorder.add(2, 20);
+  reorder.add(1, 10);
+  EXPECT_FALSE(reorder.next(index));
+  reorder.add(0, 0);
+  for (const size_t expected : {0u, 10u, 20u}) {
+    ASSERT_TRUE(reorder.next(index));
+    EXPECT_EQ(index, expected);
+  }
+  EXPECT_FALSE(reorder.next(index));
+  EXPECT_EQ(reorder.held(), 0u);
+}
+
+TEST(StreamPipelineTest, FailureWakesIdleWorkers) {
+  StreamPipeline pipeline(2, 2);
+  std::vector<std::thread> workers;
+  std::atomic<size_t> finished{0};
+  for (size_t i = 0; i < 2; ++i) {
+    workers.emplace_back([&, i]() {
+      size_t index, chip;
+      EXPECT_FALSE(pipeline.takePart(i, index, chip));
+      ++finished;
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(finished, 0u);
+
+  pipeline.fail(std::make_exception_ptr(std::runtime_error("failed")));
+  for (auto& worker : workers) worker.join();
+  EXPECT_EQ(finished, 2u);
+  EXPECT_THROW(pipeline.rethrow(), std::runtime_error);
+}
@@ -23,20 +23,27 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+CONFIG += c++2a
+
 SOURCES += \
         main.cpp \
-        mainwindow.cpp \
-        hit_worker.cpp
+        mainwindow.cpp
 
 HEADERS += \
-        mainwindow.h \
-        hit_worker.h
+        mainwindow.h
 
 FORMS += \
         mainwindow.ui
 
+# the data is reduced by the DisplayWorker of FastSophiread, build sophiread
+# first; SOPHIREAD_BUILD is its build directory (default ../sophiread/build)
+SOPHIREAD_BUILD = $$(SOPHIREAD_BUILD)
+isEmpty(SOPHIREAD_BUILD): SOPHIREAD_BUILD = $$PWD/../sophiread/build
+INCLUDEPATH += $$PWD/../sophiread/FastSophiread/include
+LIBS += -L$$SOPHIREAD_BUILD/FastSophiread -lFastSophiread
+
 # qwt is a 3rd party lib and need to be linked explicitly
-LIBS += -L$(CONDA_PREFIX)/lib -lqwt
+LIBS += -L$(CONDA_PREFIX)/lib -lqwt -lhdf5_cpp -lhdf5 -ltbb -lspdlog -lfmt
 
 INCLUDEPATH += $(CONDA_PREFIX)/include
 DEPENDPATH += $(CONDA_PREFIX)/include